@@ -0,0 +1,203 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "os_time.h"
+
+#include "bench.h"
+
+#define JSON_MAX_LINE 512
+
+static inline u64 read_cycles(void);
+static f64 median(f64 *values, u32 count);
+static int compare_f64(const void *a, const void *b);
+
+bool Bench_Run(arena_t *arena, const bench_t *bench, const bench_config_t *config,
+               bench_result_t *result)
+{
+    u32 runs = bench->max_runs ? Min(config->runs, bench->max_runs) : config->runs;
+    if (runs == 0 || bench->ops == 0)
+        return false;
+
+    if (bench->setup && !bench->setup())
+    {
+        fprintf(stderr, "%s: setup failed\n", bench->name);
+        return false;
+    }
+
+    u64 pos = MemoryArena_Pos(arena);
+    f64 *ns = arena_push_array_no_zero(arena, f64, runs);
+    f64 *cycles = arena_push_array_no_zero(arena, f64, runs);
+    volatile u64 sink = 0;
+
+    for (u32 i = 0; i < config->warmup_runs + runs; i++)
+    {
+        if (bench->prepare)
+            bench->prepare();
+
+        u64 start_ns = OS_TimeNowNs();
+        u64 start_cycles = read_cycles();
+        sink += bench->run(bench->ops);
+        u64 end_cycles = read_cycles();
+        u64 end_ns = OS_TimeNowNs();
+
+        if (i < config->warmup_runs)
+            continue;
+
+        u32 run = i - config->warmup_runs;
+        ns[run] = (f64)(end_ns - start_ns) / (f64)bench->ops;
+        cycles[run] = (f64)(end_cycles - start_cycles) / (f64)bench->ops;
+    }
+    (void)sink;
+
+    if (bench->teardown)
+        bench->teardown();
+
+    MemoryZeroItem(result);
+    snprintf(result->name, sizeof(result->name), "%s", bench->name);
+    result->ops = bench->ops;
+    result->runs = runs;
+    result->cycles = median(cycles, runs);
+    result->median_ns = median(ns, runs);
+    result->min_ns = ns[0];
+
+    /* ns is sorted now, so the deviations can reuse cycles */
+    for (u32 i = 0; i < runs; i++)
+        cycles[i] = fabs(ns[i] - result->median_ns);
+    result->mad_ns = median(cycles, runs);
+
+    MemoryArena_PopTo(arena, pos);
+
+    printf("%-32s %12.2f ns/op  mad %9.2f  min %12.2f  %12.1f cycles/op\n", result->name,
+           result->median_ns, result->mad_ns, result->min_ns, result->cycles);
+    return true;
+}
+
+bool Bench_WriteJson(const char *path, const bench_result_t *results, u32 count)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        fprintf(stderr, "failed to open %s\n", path);
+        return false;
+    }
+
+    /* one benchmark per line keeps Bench_ReadJson trivial */
+    fprintf(file, "{\n  \"benchmarks\": [\n");
+    for (u32 i = 0; i < count; i++)
+    {
+        const bench_result_t *r = &results[i];
+        fprintf(file,
+                "    {\"name\": \"%s\", \"ops\": %llu, \"runs\": %u, \"median_ns\": %.4f, "
+                "\"mad_ns\": %.4f, \"min_ns\": %.4f, \"cycles\": %.2f}%s\n",
+                r->name, (unsigned long long)r->ops, r->runs, r->median_ns, r->mad_ns, r->min_ns,
+                r->cycles, i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+u32 Bench_ReadJson(arena_t *arena, const char *path, bench_result_t **results_out)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        fprintf(stderr, "failed to open %s\n", path);
+        return 0;
+    }
+
+    char line[JSON_MAX_LINE];
+    u32 count = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+        if (strstr(line, "\"name\""))
+            count++;
+    }
+
+    bench_result_t *results = arena_push_array(arena, bench_result_t, count);
+    u32 parsed = 0;
+
+    rewind(file);
+    while (parsed < count && fgets(line, sizeof(line), file))
+    {
+        bench_result_t *r = &results[parsed];
+        unsigned long long ops;
+        if (sscanf(line,
+                   " {\"name\": \"%63[^\"]\", \"ops\": %llu, \"runs\": %u, \"median_ns\": %lf, "
+                   "\"mad_ns\": %lf, \"min_ns\": %lf, \"cycles\": %lf",
+                   r->name, &ops, &r->runs, &r->median_ns, &r->mad_ns, &r->min_ns, &r->cycles) == 7)
+        {
+            r->ops = ops;
+            parsed++;
+        }
+    }
+    fclose(file);
+
+    *results_out = results;
+    return parsed;
+}
+
+u32 Bench_Compare(const bench_result_t *results, u32 count, const bench_result_t *baseline,
+                  u32 baseline_count, f64 threshold)
+{
+    u32 regressions = 0;
+
+    printf("\n%-32s %12s %12s %8s\n", "benchmark", "base ns/op", "ns/op", "delta");
+    for (u32 i = 0; i < count; i++)
+    {
+        const bench_result_t *current = &results[i];
+        const bench_result_t *base = NULL;
+        for (u32 j = 0; j < baseline_count && !base; j++)
+        {
+            if (strcmp(baseline[j].name, current->name) == 0)
+                base = &baseline[j];
+        }
+
+        if (!base || base->median_ns <= 0.0)
+        {
+            printf("%-32s %12s %12.2f %8s\n", current->name, "-", current->median_ns, "new");
+            continue;
+        }
+
+        f64 delta = current->median_ns / base->median_ns - 1.0;
+        f64 noise = 3.0 * Max(current->mad_ns, base->mad_ns);
+        bool regressed = delta > threshold && current->median_ns - base->median_ns > noise;
+        if (regressed)
+            regressions++;
+
+        printf("%-32s %12.2f %12.2f %+7.1f%%%s\n", current->name, base->median_ns,
+               current->median_ns, delta * 100.0, regressed ? "  REGRESSION" : "");
+    }
+
+    return regressions;
+}
+
+static inline u64 read_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/* sorts values */
+static f64 median(f64 *values, u32 count)
+{
+    qsort(values, count, sizeof(f64), compare_f64);
+    if (count % 2)
+        return values[count / 2];
+    return 0.5 * (values[count / 2 - 1] + values[count / 2]);
+}
+
+static int compare_f64(const void *a, const void *b)
+{
+    f64 fa = *(const f64 *)a;
+    f64 fb = *(const f64 *)b;
+
+    return (fa > fb) - (fa < fb);
+}
@@ -0,0 +1,63 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "core.h"
+#include "memory_arena.h"
+
+/* micro-benchmark harness. every run times ops calls of a benchmark, the
+   per-op times of all runs give a median and median absolute deviation.
+   cycles are tsc ticks on x86 (not core clocks under turbo), 0 elsewhere */
+
+#define BENCH_MAX_NAME 64
+
+typedef struct
+{
+    const char  *name;
+    u64         ops;
+    /* 0 = the configured run count; caps slow benchmarks */
+    u32         max_runs;
+
+    /* once, untimed. state lives in the benchmark module */
+    bool        (*setup)(void);
+    void        (*teardown)(void);
+    /* before every run, untimed */
+    void        (*prepare)(void);
+    /* performs ops operations; the result is sunk so the work stays */
+    u64         (*run)(u64 ops);
+} bench_t;
+
+typedef struct
+{
+    char    name[BENCH_MAX_NAME];
+    u64     ops;
+    u32     runs;
+    f64     median_ns;      /* per op */
+    f64     mad_ns;
+    f64     min_ns;
+    f64     cycles;         /* per op, median */
+} bench_result_t;
+
+typedef struct
+{
+    u32         warmup_runs;
+    u32         runs;
+} bench_config_t;
+
+bool Bench_Run(arena_t *arena, const bench_t *bench, const bench_config_t *config,
+               bench_result_t *result);
+
+bool Bench_WriteJson(const char *path, const bench_result_t *results, u32 count);
+
+/* reads a file written by Bench_WriteJson; returns the result count */
+u32 Bench_ReadJson(arena_t *arena, const char *path, bench_result_t **results_out);
+
+/* prints current against baseline and returns the number of regressions:
+   slower by more than threshold (0.05 = 5%) and by more than 3 MADs */
+u32 Bench_Compare(const bench_result_t *results, u32 count, const bench_result_t *baseline,
+                  u32 baseline_count, f64 threshold);
+
+/* benchmark tables of bench_core.c and bench_assets.c */
+const bench_t *BenchCore_Get(u32 *count);
+const bench_t *BenchAssets_Get(u32 *count);
+
+#endif
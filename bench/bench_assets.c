@@ -0,0 +1,580 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "core.h"
+#include "log.h"
+#include "memory_arena.h"
+#include "os_path.h"
+
+#include "block_compress.h"
+#include "frog.h"
+#include "mesh_cache.h"
+#include "mipmap.h"
+#include "obj.h"
+
+#include "bench.h"
+
+/* synthetic inputs: a uv-mapped grid obj of just over a million triangles,
+   a keyframed frog model and a noise texture, all generated in setup */
+
+#define OBJ_GRID            708     /* 2 * 708^2 = 1002528 triangles */
+#define OBJ_LINE_SAMPLES    4096
+#define OBJ_LINE_OPS        (1u << 20)
+#define OBJ_PARSE_RUNS      5
+#define OBJ_PATH            "microbench_synthetic.obj"      /* in the executable directory */
+
+#define FROG_PATH           "microbench_synthetic.frog"     /* in the executable directory */
+#define FROG_V2_PATH        "microbench_synthetic_v2.frog"
+#define FROG_MAGIC          0x4C444F4D474F5246 // "FROGMODL" little endian
+#define FROG_TRIANGLES      (1u << 15)
+#define FROG_KEYFRAMES      8
+#define FROG_PARSE_RUNS     5
+
+#define MIPMAP_SIZE         2048
+#define MIPMAP_RUNS         10
+
+#define BC7_SIZE            1024
+#define BC7_RUNS            5
+
+extern arena_t *g_engine_arena;
+extern arena_t *g_scratch;
+
+typedef struct
+{
+    char text[128];
+    u32  len;
+} obj_line_t;
+
+typedef struct
+{
+    arena_t     *arena;
+    u64         base_pos;
+
+    char        *obj_data;
+    u64         obj_size;
+    obj_line_t  *float_lines;
+    obj_line_t  *face_lines;
+
+    u64         engine_pos;
+
+    u8          *mip_chain;
+    u32         mip_levels;
+
+    u8          *bc_texels;
+    u8          *bc_blocks;
+} asset_bench_t;
+
+static asset_bench_t s_bench = {};
+
+static bool setup_obj(void);
+static bool setup_obj_file(void);
+static bool setup_frog(void);
+static bool setup_mipmap(void);
+static bool setup_bc7(void);
+static void teardown(void);
+static void teardown_obj_file(void);
+static void teardown_frog(void);
+static void reset_arena(void);
+static void reset_arena_uncooked(void);
+static void reset_engine_arena(void);
+static bool write_frog(const char *path);
+static bool write_frog_v2(const char *path);
+static const char *frog_file_path(const char *name);
+static void fill_noise(u8 *dst, u64 size);
+
+static u64 obj_parse_floats(u64 ops);
+static u64 obj_parse_face(u64 ops);
+static u64 obj_parse(u64 ops);
+static u64 obj_load(u64 ops);
+static u64 frog_load_model(u64 ops);
+static u64 frog_load_model_v2(u64 ops);
+static u64 mipmap_generate(u64 ops);
+static u64 bc7_encode(u64 ops);
+
+static const bench_t s_benches[] = {
+    {.name = "obj_parse_floats", .ops = OBJ_LINE_OPS, .setup = setup_obj, .teardown = teardown,
+     .run = obj_parse_floats},
+    {.name = "obj_parse_face", .ops = OBJ_LINE_OPS, .setup = setup_obj, .teardown = teardown,
+     .run = obj_parse_face},
+    {.name = "obj_parse_1m_triangles", .ops = 1, .max_runs = OBJ_PARSE_RUNS, .setup = setup_obj,
+     .teardown = teardown, .prepare = reset_arena, .run = obj_parse},
+    {.name = "obj_load_uncooked_1m_triangles", .ops = 1, .max_runs = OBJ_PARSE_RUNS, .setup = setup_obj_file,
+     .teardown = teardown_obj_file, .prepare = reset_arena_uncooked, .run = obj_load},
+    {.name = "obj_load_cooked_1m_triangles", .ops = 1, .max_runs = OBJ_PARSE_RUNS, .setup = setup_obj_file,
+     .teardown = teardown_obj_file, .prepare = reset_arena, .run = obj_load},
+    {.name = "frog_load_model", .ops = 1, .max_runs = FROG_PARSE_RUNS, .setup = setup_frog,
+     .teardown = teardown_frog, .prepare = reset_engine_arena, .run = frog_load_model},
+    {.name = "frog_load_model_v2", .ops = 1, .max_runs = FROG_PARSE_RUNS, .setup = setup_frog,
+     .teardown = teardown_frog, .prepare = reset_engine_arena, .run = frog_load_model_v2},
+    {.name = "mipmap_generate_2048", .ops = 1, .max_runs = MIPMAP_RUNS, .setup = setup_mipmap,
+     .teardown = teardown, .run = mipmap_generate},
+    {.name = "bc7_encode_1024", .ops = 1, .max_runs = BC7_RUNS, .setup = setup_bc7, .teardown = teardown,
+     .run = bc7_encode},
+};
+
+const bench_t *BenchAssets_Get(u32 *count)
+{
+    *count = ArrayCount(s_benches);
+    return s_benches;
+}
+
+static bool setup_obj(void)
+{
+    s_bench.arena = MemoryArena_CreateP("bench-assets", (arena_params_t){
+        .reserve_size = GB(2),
+        .commit_size = MB(4),
+    });
+
+    /* generous for the grid's number widths: 6-digit face indices take ~64 bytes */
+    u32 vertex_count = (OBJ_GRID + 1) * (OBJ_GRID + 1);
+    u32 triangle_count = 2 * OBJ_GRID * OBJ_GRID;
+    u64 capacity = (u64)vertex_count * 3 * 48 + (u64)triangle_count * 80;
+    char *data = arena_push_array_no_zero(s_bench.arena, char, capacity);
+    u64 size = 0;
+
+    size += (u64)snprintf(data + size, capacity - size, "# synthetic grid\no grid\n");
+    for (u32 y = 0; y <= OBJ_GRID; y++)
+    {
+        for (u32 x = 0; x <= OBJ_GRID; x++)
+        {
+            f32 u = (f32)x / OBJ_GRID;
+            f32 v = (f32)y / OBJ_GRID;
+            size += (u64)snprintf(data + size, capacity - size,
+                                  "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn 0.000000 1.000000 0.000000\n",
+                                  (f64)u * 100.0, (f64)(u * v), (f64)v * 100.0, (f64)u, (f64)v);
+        }
+    }
+
+    for (u32 y = 0; y < OBJ_GRID; y++)
+    {
+        for (u32 x = 0; x < OBJ_GRID; x++)
+        {
+            u32 i0 = y * (OBJ_GRID + 1) + x + 1;
+            u32 i1 = i0 + 1;
+            u32 i2 = i0 + OBJ_GRID + 1;
+            u32 i3 = i2 + 1;
+            size += (u64)snprintf(data + size, capacity - size,
+                                  "f %u/%u/%u %u/%u/%u %u/%u/%u\nf %u/%u/%u %u/%u/%u %u/%u/%u\n",
+                                  i0, i0, i0, i2, i2, i2, i1, i1, i1, i1, i1, i1, i2, i2, i2, i3, i3, i3);
+        }
+    }
+    Assert(size < capacity);
+
+    s_bench.obj_data = data;
+    s_bench.obj_size = size;
+
+    /* single-line inputs with varied widths, as the parser sees them */
+    s_bench.float_lines = arena_push_array_no_zero(s_bench.arena, obj_line_t, OBJ_LINE_SAMPLES);
+    s_bench.face_lines = arena_push_array_no_zero(s_bench.arena, obj_line_t, OBJ_LINE_SAMPLES);
+    for (u32 i = 0; i < OBJ_LINE_SAMPLES; i++)
+    {
+        obj_line_t *floats = &s_bench.float_lines[i];
+        floats->len = (u32)snprintf(floats->text, sizeof(floats->text), "%.6f %.6f %.6f", (f64)i * 0.731,
+                                    -(f64)i * 1.37, (f64)i / 7.0);
+        u32 base = i * 251 + 1;
+        obj_line_t *face = &s_bench.face_lines[i];
+        face->len = (u32)snprintf(face->text, sizeof(face->text), "%u/%u/%u %u/%u/%u %u/%u/%u", base, base,
+                                  base, base + 1, base + 1, base + 1, base + 709, base + 709, base + 709);
+    }
+
+    s_bench.base_pos = MemoryArena_Pos(s_bench.arena);
+    return true;
+}
+
+/* the grid as a loose file, cooked once so the cooked bench starts warm */
+static bool setup_obj_file(void)
+{
+    if (!setup_obj())
+        return false;
+
+    FILE *file = fopen(frog_file_path(OBJ_PATH), "wb");
+    if (!file)
+    {
+        Log(ERROR, "failed to open %s", frog_file_path(OBJ_PATH));
+        return false;
+    }
+    bool ok = fwrite(s_bench.obj_data, 1, s_bench.obj_size, file) == s_bench.obj_size;
+    ok &= fclose(file) == 0;
+    if (!ok)
+        return false;
+
+    obj_mesh_data_t mesh;
+    file_map_t cooked;
+    ok = MeshCache_LoadObj(s_bench.arena, OBJ_PATH, &mesh, &cooked);
+    File_Unmap(&cooked);
+    reset_arena();
+    return ok;
+}
+
+static bool setup_frog(void)
+{
+    if (!write_frog(frog_file_path(FROG_PATH)) || !write_frog_v2(frog_file_path(FROG_V2_PATH)))
+        return false;
+
+    g_engine_arena = MemoryArena_CreateP("engine-arena", (arena_params_t){
+        .reserve_size = GB(1),
+        .commit_size = MB(4),
+    });
+    g_scratch = MemoryArena_CreateP("global-scratch", (arena_params_t){
+        .reserve_size = GB(1),
+        .commit_size = MB(4),
+    });
+    s_bench.engine_pos = MemoryArena_Pos(g_engine_arena);
+    return true;
+}
+
+static bool setup_mipmap(void)
+{
+    s_bench.arena = MemoryArena_CreateP("bench-mipmap", (arena_params_t){
+        .reserve_size = GB(1),
+        .commit_size = MB(4),
+    });
+
+    Mipmap_Init();
+    s_bench.mip_levels = Mipmap_LevelCount(MIPMAP_SIZE, MIPMAP_SIZE);
+    s_bench.mip_chain = arena_push_array_no_zero(s_bench.arena, u8,
+                                                 Mipmap_ChainSize(MIPMAP_SIZE, MIPMAP_SIZE, s_bench.mip_levels));
+    fill_noise(s_bench.mip_chain, (u64)MIPMAP_SIZE * MIPMAP_SIZE * 4);
+    return true;
+}
+
+static bool setup_bc7(void)
+{
+    s_bench.arena = MemoryArena_CreateP("bench-bc7", (arena_params_t){
+        .reserve_size = GB(1),
+        .commit_size = MB(4),
+    });
+
+    s_bench.bc_texels = arena_push_array_no_zero(s_bench.arena, u8, (u64)BC7_SIZE * BC7_SIZE * 4);
+    s_bench.bc_blocks = arena_push_array_no_zero(s_bench.arena, u8,
+                                                 BlockCompress_LevelSize(TEXTURE_FORMAT_BC7_SRGB, BC7_SIZE,
+                                                                         BC7_SIZE));
+    fill_noise(s_bench.bc_texels, (u64)BC7_SIZE * BC7_SIZE * 4);
+    return true;
+}
+
+static void teardown(void)
+{
+    MemoryArena_Destroy(s_bench.arena);
+    MemoryZeroItem(&s_bench);
+}
+
+static void teardown_obj_file(void)
+{
+    char cooked_path[512];
+    MeshCache_GetPath(OBJ_PATH, cooked_path, sizeof(cooked_path));
+    remove(cooked_path);
+    remove(frog_file_path(OBJ_PATH));
+    teardown();
+}
+
+static void teardown_frog(void)
+{
+    MemoryArena_Destroy(g_scratch);
+    g_scratch = NULL;
+    MemoryArena_Destroy(g_engine_arena);
+    g_engine_arena = NULL;
+    remove(frog_file_path(FROG_PATH));
+    remove(frog_file_path(FROG_V2_PATH));
+}
+
+static void reset_arena(void)
+{
+    MemoryArena_PopTo(s_bench.arena, s_bench.base_pos);
+}
+
+static void reset_arena_uncooked(void)
+{
+    char cooked_path[512];
+    MeshCache_GetPath(OBJ_PATH, cooked_path, sizeof(cooked_path));
+    remove(cooked_path);
+    reset_arena();
+}
+
+static void reset_engine_arena(void)
+{
+    MemoryArena_PopTo(g_engine_arena, s_bench.engine_pos);
+}
+
+static u64 obj_parse_floats(u64 ops)
+{
+    f32 out[3];
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+    {
+        const obj_line_t *line = &s_bench.float_lines[i % OBJ_LINE_SAMPLES];
+        sink += Obj_ParseFloats(line->text, line->text + line->len, out, 3);
+        sink += (u64)out[0];
+    }
+    return sink;
+}
+
+static u64 obj_parse_face(u64 ops)
+{
+    obj_face_t face;
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+    {
+        const obj_line_t *line = &s_bench.face_lines[i % OBJ_LINE_SAMPLES];
+        sink += Obj_ParseFace(line->text, line->text + line->len, &face);
+        sink += face.v[2];
+    }
+    return sink;
+}
+
+static u64 obj_parse(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+    {
+        obj_mesh_data_t mesh;
+        if (Obj_Parse(s_bench.arena, s_bench.obj_data, s_bench.obj_size, "synthetic", &mesh))
+            sink += mesh.index_count;
+    }
+    return sink;
+}
+
+/* through the mesh cache, with the upload's read of the data */
+static u64 obj_load(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+    {
+        obj_mesh_data_t mesh;
+        file_map_t cooked;
+        if (MeshCache_LoadObj(s_bench.arena, OBJ_PATH, &mesh, &cooked))
+        {
+            const u8 *vertex_data = mesh.vertex_data;
+            for (u64 offset = 0; offset < mesh.vertex_data_size; offset += 64)
+                sink += vertex_data[offset];
+            const u8 *index_data = mesh.indices;
+            for (u64 offset = 0; offset < (u64)mesh.index_count * INDEX_TYPE_SIZE(mesh.index_type); offset += 64)
+                sink += index_data[offset];
+        }
+        File_Unmap(&cooked);
+    }
+    return sink;
+}
+
+static u64 frog_load_model(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+        sink += Frog_LoadModel(FROG_PATH) != MODEL_INVALID_HANDLE;
+    return sink;
+}
+
+static u64 frog_load_model_v2(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+        sink += Frog_LoadModel(FROG_V2_PATH) != MODEL_INVALID_HANDLE;
+    return sink;
+}
+
+/* level 0 is never written, so every run filters the same input */
+static u64 mipmap_generate(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+    {
+        Mipmap_Generate(s_bench.arena, s_bench.mip_chain, MIPMAP_SIZE, MIPMAP_SIZE, s_bench.mip_levels);
+        sink += s_bench.mip_chain[(u64)MIPMAP_SIZE * MIPMAP_SIZE * 4];
+    }
+    return sink;
+}
+
+static u64 bc7_encode(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+    {
+        BlockCompress_Encode(TEXTURE_FORMAT_BC7_SRGB, s_bench.bc_blocks, s_bench.bc_texels, BC7_SIZE, BC7_SIZE);
+        sink += s_bench.bc_blocks[0];
+    }
+    return sink;
+}
+
+/* xorshift noise: no two neighbors alike, so nothing is cheaper than real texels */
+static void fill_noise(u8 *dst, u64 size)
+{
+    u32 state = 0x9e3779b9;
+    for (u64 i = 0; i < size; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        dst[i] = (u8)state;
+    }
+}
+
+/* Frog_LoadModel and the mesh cache look the synthetic files up next to
+   the executable */
+static const char *frog_file_path(const char *name)
+{
+    static char path[512];
+    snprintf(path, sizeof(path), "%s%s", OS_GetBasePath(), name);
+    return path;
+}
+
+/* a strip of triangles with one animation; layout as documented in frog.c */
+static bool write_frog(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        Log(ERROR, "failed to open %s", path);
+        return false;
+    }
+
+    struct AttributePacked
+    {
+        u64 magic;
+        u16 version;
+        u32 triangle_count;
+        u16 material_count;
+        u16 anchor_count;
+        u16 animation_count;
+    } header = {FROG_MAGIC, 1, FROG_TRIANGLES, 2, 1, 1};
+    fwrite(&header, sizeof(header), 1, file);
+
+    static const char *material_names[] = {"skin", "hair"};
+    for (u32 i = 0; i < ArrayCount(material_names); i++)
+    {
+        u16 len = (u16)strlen(material_names[i]);
+        f32 colors[6] = {0.8f, 0.6f, 0.5f, 0.1f, 0.1f, 0.1f};
+        fwrite(&len, sizeof(len), 1, file);
+        fwrite(material_names[i], len, 1, file);
+        fwrite(colors, sizeof(colors), 1, file);
+    }
+
+    for (u32 i = 0; i < FROG_TRIANGLES; i++)
+        fputc((int)(i & 1), file);
+
+    u16 anchor_len = 4;
+    fwrite(&anchor_len, sizeof(anchor_len), 1, file);
+    fwrite("head", anchor_len, 1, file);
+
+    u16 anim_len = 4;
+    u16 keyframe_count = FROG_KEYFRAMES;
+    fwrite(&anim_len, sizeof(anim_len), 1, file);
+    fwrite("walk", anim_len, 1, file);
+    fwrite(&keyframe_count, sizeof(keyframe_count), 1, file);
+
+    for (u32 key = 0; key < FROG_KEYFRAMES; key++)
+    {
+        f32 time_s = (f32)key * 0.125f;
+        fwrite(&time_s, sizeof(time_s), 1, file);
+
+        for (u32 tri = 0; tri < FROG_TRIANGLES; tri++)
+        {
+            f32 x = (f32)tri * 0.01f;
+            f32 z = (f32)key * 0.1f;
+            f32 positions[9] = {x, 0.0f, z, x + 0.01f, 0.0f, z, x, 1.0f, z};
+            fwrite(positions, sizeof(positions), 1, file);
+        }
+
+        f32 anchor[7] = {0.0f, 1.8f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+        fwrite(anchor, sizeof(anchor), 1, file);
+    }
+
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+/* the same model as write_frog, in the version 2 block layout */
+static bool write_frog_v2(const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        Log(ERROR, "failed to open %s", path);
+        return false;
+    }
+
+    static const char names[] = "\x04\x00skin\x04\x00hair\x04\x00head\x04\x00walk";
+    u64 names_size = sizeof(names) - 1;
+    u64 vertex_size = 28;
+    u64 keyframe_size = AlignPow2(FROG_TRIANGLES * 3 * vertex_size, 16);
+
+    struct AttributePacked
+    {
+        u64 magic;
+        u16 version;
+        u16 flags;
+        u32 triangle_count;
+        u16 material_count;
+        u16 anchor_count;
+        u16 animation_count;
+        u16 reserved;
+        u32 keyframe_count;
+        u32 vertex_stride;
+        u64 offsets[6];
+    } header = {FROG_MAGIC, 2, 0, FROG_TRIANGLES, 2, 1, 1, 0, FROG_KEYFRAMES, (u32)vertex_size, {}};
+
+    /* names, materials, animations, keyframes, anchors, vertices */
+    u64 sizes[6] = {names_size, 2 * 24, 4, FROG_KEYFRAMES * 4, FROG_KEYFRAMES * 28, 0};
+    u64 offset = sizeof(header);
+    for (u32 i = 0; i < ArrayCount(sizes); i++)
+    {
+        header.offsets[i] = AlignPow2(offset, 16);
+        offset = header.offsets[i] + sizes[i];
+    }
+
+    static const u8 padding[16] = {};
+    fwrite(&header, sizeof(header), 1, file);
+    u64 pos = sizeof(header);
+
+    fwrite(padding, header.offsets[0] - pos, 1, file);
+    fwrite(names, names_size, 1, file);
+    pos = header.offsets[0] + names_size;
+
+    fwrite(padding, header.offsets[1] - pos, 1, file);
+    for (u32 i = 0; i < 2; i++)
+    {
+        f32 colors[6] = {0.8f, 0.6f, 0.5f, 0.1f, 0.1f, 0.1f};
+        fwrite(colors, sizeof(colors), 1, file);
+    }
+
+    u32 keyframe_count = FROG_KEYFRAMES;
+    fwrite(&keyframe_count, sizeof(keyframe_count), 1, file);
+
+    fwrite(padding, header.offsets[3] - (header.offsets[2] + sizes[2]), 1, file);
+    for (u32 key = 0; key < FROG_KEYFRAMES; key++)
+    {
+        f32 time_s = (f32)key * 0.125f;
+        fwrite(&time_s, sizeof(time_s), 1, file);
+    }
+
+    fwrite(padding, header.offsets[4] - (header.offsets[3] + sizes[3]), 1, file);
+    for (u32 key = 0; key < FROG_KEYFRAMES; key++)
+    {
+        f32 anchor[7] = {0.0f, 1.8f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+        fwrite(anchor, sizeof(anchor), 1, file);
+    }
+
+    fwrite(padding, header.offsets[5] - (header.offsets[4] + sizes[4]), 1, file);
+    for (u32 key = 0; key < FROG_KEYFRAMES; key++)
+    {
+        for (u32 tri = 0; tri < FROG_TRIANGLES; tri++)
+        {
+            f32 x = (f32)tri * 0.01f;
+            f32 z = (f32)key * 0.1f;
+            f32 positions[9] = {x, 0.0f, z, x + 0.01f, 0.0f, z, x, 1.0f, z};
+            f32 normal[3] = {0.0f, 0.0f, -1.0f};
+            u32 material = tri & 1;
+            for (u32 v = 0; v < 3; v++)
+            {
+                fwrite(&positions[v * 3], sizeof(f32) * 3, 1, file);
+                fwrite(normal, sizeof(normal), 1, file);
+                fwrite(&material, sizeof(material), 1, file);
+            }
+        }
+        fwrite(padding, keyframe_size - FROG_TRIANGLES * 3 * vertex_size, 1, file);
+    }
+
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
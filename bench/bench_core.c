@@ -0,0 +1,322 @@
+#include <stdlib.h>
+
+#include "core_math.h"
+#include "core_string.h"
+#include "hash_map.h"
+#include "job.h"
+#include "log.h"
+#include "memory_arena.h"
+
+#include "bench.h"
+
+#define ARENA_OPS       (1u << 20)
+#define ARENA_PUSH_SIZE 48
+#define ARENA_POP_EVERY 1024
+#define MAP_KEYS        (1u << 17)
+#define MAP_BUCKETS     (1u << 15)
+#define STRING_OPS      (1u << 16)
+#define LOG_OPS         (1u << 15)
+#define JOB_OPS         (1u << 16)
+#define JOB_RANGE       (1u << 20)
+
+typedef struct
+{
+    arena_t     *arena;
+    u64         base_pos;
+
+    u32         *u32_keys;
+    u64         *u64_keys;
+    u64         *missing_keys;
+    hash_map_t  map;
+} core_bench_t;
+
+static core_bench_t s_bench = {};
+
+static bool setup(void);
+static void teardown(void);
+static void reset_arena(void);
+static void fill_u32(void);
+static void fill_u64(void);
+static void fill_u64_ptr(void);
+
+static u64 arena_push_pop(u64 ops);
+static u64 arena_scratch(u64 ops);
+static u64 map_u32u32_insert(u64 ops);
+static u64 map_u32u32_get(u64 ops);
+static u64 map_u64u64_insert(u64 ops);
+static u64 map_u64u64_get(u64 ops);
+static u64 map_u64u64_get_miss(u64 ops);
+static u64 map_u64ptr_get(u64 ops);
+static u64 map_u64_remove(u64 ops);
+static u64 string_fmt_plain(u64 ops);
+static u64 string_fmt_string(u64 ops);
+static u64 string_fmt_vec3(u64 ops);
+static u64 log_entry(u64 ops);
+static u64 job_run_wait(u64 ops);
+static u64 job_parallel_for(u64 ops);
+
+static const bench_t s_benches[] = {
+    {.name = "arena_push_pop", .ops = ARENA_OPS, .setup = setup, .teardown = teardown,
+     .prepare = reset_arena, .run = arena_push_pop},
+    {.name = "arena_scratch", .ops = ARENA_OPS, .setup = setup, .teardown = teardown,
+     .prepare = reset_arena, .run = arena_scratch},
+    {.name = "hash_map_u32u32_insert", .ops = MAP_KEYS, .setup = setup, .teardown = teardown,
+     .prepare = reset_arena, .run = map_u32u32_insert},
+    {.name = "hash_map_u32u32_get", .ops = MAP_KEYS, .setup = setup, .teardown = teardown,
+     .prepare = fill_u32, .run = map_u32u32_get},
+    {.name = "hash_map_u64u64_insert", .ops = MAP_KEYS, .setup = setup, .teardown = teardown,
+     .prepare = reset_arena, .run = map_u64u64_insert},
+    {.name = "hash_map_u64u64_get", .ops = MAP_KEYS, .setup = setup, .teardown = teardown,
+     .prepare = fill_u64, .run = map_u64u64_get},
+    {.name = "hash_map_u64u64_get_miss", .ops = MAP_KEYS, .setup = setup, .teardown = teardown,
+     .prepare = fill_u64, .run = map_u64u64_get_miss},
+    {.name = "hash_map_u64ptr_get", .ops = MAP_KEYS, .setup = setup, .teardown = teardown,
+     .prepare = fill_u64_ptr, .run = map_u64ptr_get},
+    {.name = "hash_map_u64_remove", .ops = MAP_KEYS, .setup = setup, .teardown = teardown,
+     .prepare = fill_u64, .run = map_u64_remove},
+    {.name = "string_fmt", .ops = STRING_OPS, .setup = setup, .teardown = teardown,
+     .prepare = reset_arena, .run = string_fmt_plain},
+    {.name = "string_fmt_S", .ops = STRING_OPS, .setup = setup, .teardown = teardown,
+     .prepare = reset_arena, .run = string_fmt_string},
+    {.name = "string_fmt_v3", .ops = STRING_OPS, .setup = setup, .teardown = teardown,
+     .prepare = reset_arena, .run = string_fmt_vec3},
+    {.name = "log", .ops = LOG_OPS, .run = log_entry},
+    {.name = "job_run_wait", .ops = JOB_OPS, .run = job_run_wait},
+    {.name = "job_parallel_for", .ops = JOB_RANGE, .run = job_parallel_for},
+};
+
+const bench_t *BenchCore_Get(u32 *count)
+{
+    *count = ArrayCount(s_benches);
+    return s_benches;
+}
+
+static bool setup(void)
+{
+    s_bench.arena = MemoryArena_CreateP("bench-core", (arena_params_t){
+        .reserve_size = MB(256),
+        .commit_size = MB(1),
+    });
+
+    srand(1337);
+    s_bench.u32_keys = arena_push_array_no_zero(s_bench.arena, u32, MAP_KEYS);
+    s_bench.u64_keys = arena_push_array_no_zero(s_bench.arena, u64, MAP_KEYS);
+    s_bench.missing_keys = arena_push_array_no_zero(s_bench.arena, u64, MAP_KEYS);
+    for (u32 i = 0; i < MAP_KEYS; i++)
+    {
+        /* distinct: the high half is the index */
+        s_bench.u32_keys[i] = (i << 15) ^ (u32)(rand() & 0x7fff);
+        s_bench.u64_keys[i] = ((u64)i << 32) | (u32)rand();
+        s_bench.missing_keys[i] = ((u64)(i + MAP_KEYS) << 32) | (u32)rand();
+    }
+
+    s_bench.base_pos = MemoryArena_Pos(s_bench.arena);
+    return true;
+}
+
+static void teardown(void)
+{
+    MemoryArena_Destroy(s_bench.arena);
+    MemoryZeroItem(&s_bench);
+}
+
+static void reset_arena(void)
+{
+    MemoryArena_PopTo(s_bench.arena, s_bench.base_pos);
+}
+
+static void fill_u32(void)
+{
+    reset_arena();
+    s_bench.map = HashMap_Create(s_bench.arena, MAP_BUCKETS);
+    for (u32 i = 0; i < MAP_KEYS; i++)
+        HashMap_U32U32_Insert(&s_bench.map, s_bench.u32_keys[i], i);
+}
+
+static void fill_u64(void)
+{
+    reset_arena();
+    s_bench.map = HashMap_Create(s_bench.arena, MAP_BUCKETS);
+    for (u32 i = 0; i < MAP_KEYS; i++)
+        HashMap_U64U64_Insert(&s_bench.map, s_bench.u64_keys[i], i);
+}
+
+static void fill_u64_ptr(void)
+{
+    reset_arena();
+    s_bench.map = HashMap_Create(s_bench.arena, MAP_BUCKETS);
+    for (u32 i = 0; i < MAP_KEYS; i++)
+        HashMap_U64Ptr_Insert(&s_bench.map, s_bench.u64_keys[i], &s_bench.u64_keys[i]);
+}
+
+static u64 arena_push_pop(u64 ops)
+{
+    u64 sink = 0;
+    u64 pos = MemoryArena_Pos(s_bench.arena);
+    for (u64 i = 0; i < ops; i++)
+    {
+        u8 *ptr = MemoryArena_Push(s_bench.arena, ARENA_PUSH_SIZE, 8);
+        sink += (u64)ptr;
+        if ((i % ARENA_POP_EVERY) == ARENA_POP_EVERY - 1)
+            MemoryArena_PopTo(s_bench.arena, pos);
+    }
+    return sink;
+}
+
+static u64 arena_scratch(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+    {
+        scratch_t scratch = Scratch_Begin(s_bench.arena);
+        sink += (u64)MemoryArena_Push(scratch.arena, ARENA_PUSH_SIZE, 8);
+        Scratch_End(scratch);
+    }
+    return sink;
+}
+
+static u64 map_u32u32_insert(u64 ops)
+{
+    hash_map_t map = HashMap_Create(s_bench.arena, MAP_BUCKETS);
+    for (u64 i = 0; i < ops; i++)
+        HashMap_U32U32_Insert(&map, s_bench.u32_keys[i], (u32)i);
+    return HashMap_Size(&map);
+}
+
+static u64 map_u32u32_get(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+    {
+        u32 val = 0;
+        HashMap_U32U32_Get(&s_bench.map, s_bench.u32_keys[i], &val);
+        sink += val;
+    }
+    return sink;
+}
+
+static u64 map_u64u64_insert(u64 ops)
+{
+    hash_map_t map = HashMap_Create(s_bench.arena, MAP_BUCKETS);
+    for (u64 i = 0; i < ops; i++)
+        HashMap_U64U64_Insert(&map, s_bench.u64_keys[i], i);
+    return HashMap_Size(&map);
+}
+
+static u64 map_u64u64_get(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+    {
+        u64 val = 0;
+        HashMap_U64U64_Get(&s_bench.map, s_bench.u64_keys[i], &val);
+        sink += val;
+    }
+    return sink;
+}
+
+static u64 map_u64u64_get_miss(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+    {
+        u64 val = 0;
+        sink += HashMap_U64U64_Get(&s_bench.map, s_bench.missing_keys[i], &val);
+    }
+    return sink;
+}
+
+static u64 map_u64ptr_get(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+        sink += (u64)HashMap_U64Ptr_Get(&s_bench.map, s_bench.u64_keys[i]);
+    return sink;
+}
+
+static u64 map_u64_remove(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+        sink += HashMap_U64_Remove(&s_bench.map, s_bench.u64_keys[i]);
+    return sink;
+}
+
+static u64 string_fmt_plain(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+    {
+        scratch_t scratch = Scratch_Begin(s_bench.arena);
+        string s = string_fmt(scratch.arena, "entity %u: %s at %f", (u32)i, "frog", (f64)i * 0.5);
+        sink += s.len;
+        Scratch_End(scratch);
+    }
+    return sink;
+}
+
+static u64 string_fmt_string(u64 ops)
+{
+    string name = string_lit("human_walk_cycle");
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+    {
+        scratch_t scratch = Scratch_Begin(s_bench.arena);
+        string s = string_fmt(scratch.arena, "animation %S keyframe %u", name, (u32)i);
+        sink += s.len;
+        Scratch_End(scratch);
+    }
+    return sink;
+}
+
+static u64 string_fmt_vec3(u64 ops)
+{
+    u64 sink = 0;
+    for (u64 i = 0; i < ops; i++)
+    {
+        scratch_t scratch = Scratch_Begin(s_bench.arena);
+        vec3 position = V3((f32)i, 1.5f, -2.25f);
+        string s = string_fmt(scratch.arena, "position %v3", position);
+        sink += s.len;
+        Scratch_End(scratch);
+    }
+    return sink;
+}
+
+/* stdout echo is off, see bench_main.c; this is the ring store cost */
+static u64 log_entry(u64 ops)
+{
+    for (u64 i = 0; i < ops; i++)
+        Log(DEBUG, "entity %u moved to %v3", (u32)i, V3((f32)i, 0.0f, 1.0f));
+    return Log_Count();
+}
+
+static void empty_job(void *data)
+{
+    (void)data;
+}
+
+static void sum_range(void *data, u32 begin, u32 end)
+{
+    u64 sum = 0;
+    for (u32 i = begin; i < end; i++)
+        sum += i;
+    atomic_fetch_add((_Atomic u64 *)data, sum);
+}
+
+/* queue and join overhead: the jobs do nothing */
+static u64 job_run_wait(u64 ops)
+{
+    job_counter_t counter = {};
+    for (u64 i = 0; i < ops; i++)
+        Job_Run(empty_job, NULL, &counter);
+    Job_Wait(&counter);
+    return ops;
+}
+
+static u64 job_parallel_for(u64 ops)
+{
+    _Atomic u64 sum = 0;
+    Job_ParallelFor((u32)ops, 1024, sum_range, &sum);
+    return atomic_load(&sum);
+}
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "job.h"
+#include "log.h"
+#include "memory_arena.h"
+
+#include "bench.h"
+
+/* core micro-benchmarks, built with -Dbench=true:
+     microbench [--filter SUBSTR] [--runs N] [--warmup N] [--json PATH]
+                [--baseline PATH] [--threshold FRACTION]
+   with --baseline, exits 1 when any benchmark regressed */
+
+#define DEFAULT_RUNS        15
+#define DEFAULT_WARMUP      3
+#define DEFAULT_THRESHOLD   0.05
+#define MAX_BENCHES         64
+
+typedef struct
+{
+    bench_config_t  config;
+    const char      *filter;
+    const char      *json_path;
+    const char      *baseline_path;
+    f64             threshold;
+} bench_args_t;
+
+static bool parse_args(int argc, char **argv, bench_args_t *args);
+static void print_usage(void);
+static u32 collect(const bench_t **benches, u32 capacity);
+
+int main(int argc, char **argv)
+{
+    bench_args_t args = {
+        .config = {.warmup_runs = DEFAULT_WARMUP, .runs = DEFAULT_RUNS},
+        .threshold = DEFAULT_THRESHOLD,
+    };
+
+    if (!parse_args(argc, argv, &args))
+    {
+        print_usage();
+        return 2;
+    }
+
+    /* benchmarks log; keep stdout for results */
+    Log_Init();
+    Log_SetStdout(false);
+
+    int exit_code = 1;
+    arena_t *arena = MemoryArena_Create("bench");
+
+    if (!Job_Init(0))
+        goto exit;
+
+    const bench_t *benches[MAX_BENCHES];
+    u32 bench_count = collect(benches, MAX_BENCHES);
+    bench_result_t *results = arena_push_array(arena, bench_result_t, bench_count);
+    u32 result_count = 0;
+
+    for (u32 i = 0; i < bench_count; i++)
+    {
+        if (args.filter && !strstr(benches[i]->name, args.filter))
+            continue;
+
+        if (!Bench_Run(arena, benches[i], &args.config, &results[result_count]))
+            goto exit;
+        result_count++;
+    }
+
+    if (args.json_path && !Bench_WriteJson(args.json_path, results, result_count))
+        goto exit;
+
+    exit_code = 0;
+
+    if (args.baseline_path)
+    {
+        bench_result_t *baseline;
+        u32 baseline_count = Bench_ReadJson(arena, args.baseline_path, &baseline);
+        if (baseline_count == 0)
+        {
+            fprintf(stderr, "no results in baseline %s\n", args.baseline_path);
+            exit_code = 1;
+        }
+        else
+        {
+            u32 regressions =
+                Bench_Compare(results, result_count, baseline, baseline_count, args.threshold);
+            if (regressions)
+            {
+                printf("%u regression(s) over %.1f%%\n", regressions, args.threshold * 100.0);
+                exit_code = 1;
+            }
+        }
+    }
+
+exit:
+    Job_Destroy();
+    MemoryArena_Destroy(arena);
+    Log_Destroy();
+    return exit_code;
+}
+
+static bool parse_args(int argc, char **argv, bench_args_t *args)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const char *arg = argv[i];
+        const char *value = argv[i + 1];
+
+        if (strcmp(arg, "--filter") == 0)
+            args->filter = value;
+        else if (strcmp(arg, "--runs") == 0)
+            args->config.runs = (u32)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--warmup") == 0)
+            args->config.warmup_runs = (u32)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--json") == 0)
+            args->json_path = value;
+        else if (strcmp(arg, "--baseline") == 0)
+            args->baseline_path = value;
+        else if (strcmp(arg, "--threshold") == 0)
+            args->threshold = strtod(value, NULL);
+        else
+            return false;
+    }
+
+    return argc % 2 == 1 && args->config.runs > 0 && args->threshold >= 0.0;
+}
+
+static void print_usage(void)
+{
+    printf("usage: microbench [--filter SUBSTR] [--runs N] [--warmup N] [--json PATH]\n"
+           "                  [--baseline PATH] [--threshold FRACTION]\n");
+}
+
+static u32 collect(const bench_t **benches, u32 capacity)
+{
+    u32 count = 0;
+    u32 table_count;
+
+    const bench_t *core = BenchCore_Get(&table_count);
+    for (u32 i = 0; i < table_count && count < capacity; i++)
+        benches[count++] = &core[i];
+
+    const bench_t *assets = BenchAssets_Get(&table_count);
+    for (u32 i = 0; i < table_count && count < capacity; i++)
+        benches[count++] = &assets[i];
+
+    return count;
+}
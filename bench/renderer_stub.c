@@ -0,0 +1,47 @@
+#include "memory_arena.h"
+
+#include "renderer.h"
+
+/* what frog.c links against from the engine: its arenas, owned by
+   bench_assets.c here, and buffer creation that never touches a device */
+
+arena_t *g_engine_arena = NULL;
+arena_t *g_scratch = NULL;
+
+static u64 s_next_buffer = 1;
+
+VkBuffer Renderer_CreateStaticVertexBuffer(const void *vertices, u64 size)
+{
+    (void)vertices;
+    (void)size;
+    return (VkBuffer)(uintptr_t)s_next_buffer++;
+}
+
+VkBuffer Renderer_CreateStaticIndexBuffer(const void *indices, u32 index_count, index_type_t type)
+{
+    (void)indices;
+    (void)index_count;
+    (void)type;
+    return (VkBuffer)(uintptr_t)s_next_buffer++;
+}
+
+VkBuffer Renderer_UploadStaticVertexBuffer(const void *vertices, u64 size)
+{
+    return Renderer_CreateStaticVertexBuffer(vertices, size);
+}
+
+VkBuffer Renderer_UploadStaticIndexBuffer(const void *indices, u32 index_count, index_type_t type)
+{
+    return Renderer_CreateStaticIndexBuffer(indices, index_count, type);
+}
+
+VkBuffer Renderer_CreateStaticPullBuffer(const void *vertices, u64 size, u64 *address_out)
+{
+    *address_out = s_next_buffer << 32;
+    return Renderer_CreateStaticVertexBuffer(vertices, size);
+}
+
+VkBuffer Renderer_UploadStaticPullBuffer(const void *vertices, u64 size, u64 *address_out)
+{
+    return Renderer_CreateStaticPullBuffer(vertices, size, address_out);
+}
@@ -0,0 +1,312 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "job.h"
+#include "log.h"
+#include "memory_arena.h"
+#include "os_time.h"
+#include "profiler.h"
+#include "platform.h"
+
+#include "asset.h"
+#include "engine_main.h"
+#include "frame_stats.h"
+#include "game_main.h"
+
+/* headless benchmark: runs the game for a fixed number of frames with a
+   fixed timestep and scripted input, then prints cpu frame time
+   percentiles, draw counts, upload bytes and optionally a checksum of the
+   last frame. exits non-zero on failure or a checksum mismatch */
+
+#define DEFAULT_WIDTH       1280
+#define DEFAULT_HEIGHT      720
+#define DEFAULT_FRAMES      1000
+#define DEFAULT_WARMUP      60
+#define FIXED_TIMESTEP      (1.0f / 60.0f)
+
+typedef struct
+{
+    u32         frame;      /* within the scene period */
+    key_code_t  key;
+} scene_step_t;
+
+typedef struct
+{
+    const char          *name;
+    u32                 period;     /* frames; the steps repeat */
+    const scene_step_t  *steps;
+    u32                 step_count;
+} scene_t;
+
+/* a square walk with a camera change each lap */
+static const scene_step_t s_walk_steps[] = {
+    {  0, KEY_D}, { 15, KEY_D}, { 30, KEY_W}, { 45, KEY_W},
+    { 60, KEY_A}, { 75, KEY_A}, { 90, KEY_S}, {105, KEY_S},
+    {119, KEY_O},
+};
+
+static const scene_t s_scenes[] = {
+    {.name = "idle", .period = 1},
+    {.name = "walk", .period = 240, .steps = s_walk_steps, .step_count = ArrayCount(s_walk_steps)},
+};
+
+typedef struct
+{
+    const scene_t   *scene;
+    u32             frames;
+    u32             warmup;
+    u32             width;
+    u32             height;
+    bool            checksum;
+    bool            expect_checksum;
+    u64             expected_checksum;
+    const char      *csv_path;
+} benchmark_args_t;
+
+typedef struct
+{
+    f32 *frame_ms;
+    u64 draw_calls;
+    u32 max_draw_calls;
+    u64 triangles;
+    u64 upload_bytes;
+    u64 max_upload_bytes;
+} benchmark_result_t;
+
+static bool parse_args(int argc, char **argv, benchmark_args_t *args);
+static void print_usage(void);
+static void run_script(const scene_t *scene, u32 frame);
+static void print_report(const benchmark_args_t *args, benchmark_result_t *result);
+static int compare_f32(const void *a, const void *b);
+static f32 percentile(const f32 *sorted, u32 count, f32 p);
+
+int main(int argc, char **argv)
+{
+    benchmark_args_t args = {
+        .scene = &s_scenes[0],
+        .frames = DEFAULT_FRAMES,
+        .warmup = DEFAULT_WARMUP,
+        .width = DEFAULT_WIDTH,
+        .height = DEFAULT_HEIGHT,
+    };
+
+    if (!parse_args(argc, argv, &args))
+    {
+        print_usage();
+        return 2;
+    }
+
+    Log_Init();
+    Profiler_Init();
+
+    int exit_code = 1;
+    arena_t *arena = MemoryArena_Create("benchmark");
+
+    if (!Job_Init(0))
+        goto exit_log;
+
+    if (!Platform_Init())
+        goto exit_jobs;
+
+    platform_window_t *window = Platform_CreateWindow("dcfs benchmark", args.width, args.height);
+    if (!window)
+        goto exit_platform;
+
+    if (!Game_Init(window))
+        goto exit_window;
+
+    /* uncapped and reproducible: no limiter, fixed game time, no overlay */
+    Engine_SetFramePacing(&(frame_pacing_config_t){
+        .fps_limit = 0,
+        .frames_in_flight = 2,
+        .present_mode = PRESENT_MODE_IMMEDIATE,
+        .late_input = true,
+    });
+    Engine_SetFixedTimestep(FIXED_TIMESTEP);
+    Engine_SetStatsOverlay(false);
+
+    /* measure the scene, not the streaming: every frame sees the loaded assets */
+    Asset_WaitAll();
+
+    if (args.csv_path && !FrameStats_OpenCsv(args.csv_path))
+        goto exit_game;
+
+    benchmark_result_t result = {
+        .frame_ms = arena_push_array(arena, f32, args.frames),
+    };
+
+    u32 total_frames = args.warmup + args.frames;
+    u64 previous_ns = OS_TimeNowNs();
+
+    for (u32 frame = 0; frame < total_frames; frame++)
+    {
+        Game_WaitForFrame();
+        run_script(args.scene, frame);
+        Game_Tick();
+
+        u64 now_ns = OS_TimeNowNs();
+        if (frame >= args.warmup)
+        {
+            /* frame info lags a frame: it describes the one before this */
+            engine_frame_info_t info = Engine_GetFrameInfo();
+
+            result.frame_ms[frame - args.warmup] = (f32)(now_ns - previous_ns) / 1000000.0f;
+            result.draw_calls += info.draw_calls;
+            result.max_draw_calls = Max(result.max_draw_calls, info.draw_calls);
+            result.triangles += info.triangles;
+            result.upload_bytes += info.upload_bytes;
+            result.max_upload_bytes = Max(result.max_upload_bytes, info.upload_bytes);
+        }
+        previous_ns = now_ns;
+    }
+
+    exit_code = 0;
+
+    if (args.checksum)
+    {
+        u64 checksum = 0;
+        if (!Engine_ReadbackChecksum(&checksum))
+        {
+            exit_code = 1;
+        }
+        else
+        {
+            printf("checksum: %016llx\n", (unsigned long long)checksum);
+            if (args.expect_checksum && checksum != args.expected_checksum)
+            {
+                Log(ERROR, "checksum mismatch, expected %016llx",
+                    (unsigned long long)args.expected_checksum);
+                exit_code = 1;
+            }
+        }
+    }
+
+    print_report(&args, &result);
+
+    FrameStats_CloseCsv();
+
+exit_game:
+    Game_Destroy();
+exit_window:
+    Platform_DestroyWindow(window);
+exit_platform:
+    Platform_Shutdown();
+exit_jobs:
+    Job_Destroy();
+exit_log:
+    MemoryArena_Destroy(arena);
+    Profiler_Destroy();
+    Log_Destroy();
+
+    return exit_code;
+}
+
+static bool parse_args(int argc, char **argv, benchmark_args_t *args)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--checksum") == 0)
+        {
+            args->checksum = true;
+            continue;
+        }
+
+        if (!value)
+            return false;
+        i++;
+
+        if (strcmp(arg, "--frames") == 0)
+            args->frames = (u32)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--warmup") == 0)
+            args->warmup = (u32)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--width") == 0)
+            args->width = (u32)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--height") == 0)
+            args->height = (u32)strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--csv") == 0)
+            args->csv_path = value;
+        else if (strcmp(arg, "--expect") == 0)
+        {
+            args->checksum = true;
+            args->expect_checksum = true;
+            args->expected_checksum = strtoull(value, NULL, 16);
+        }
+        else if (strcmp(arg, "--scene") == 0)
+        {
+            args->scene = NULL;
+            for (u32 s = 0; s < ArrayCount(s_scenes); s++)
+            {
+                if (strcmp(value, s_scenes[s].name) == 0)
+                    args->scene = &s_scenes[s];
+            }
+            if (!args->scene)
+                return false;
+        }
+        else
+            return false;
+    }
+
+    return args->frames > 0 && args->width > 0 && args->height > 0;
+}
+
+static void print_usage(void)
+{
+    printf("usage: benchmark [--scene idle|walk] [--frames N] [--warmup N] [--width W] [--height H]\n"
+           "                 [--csv PATH] [--checksum] [--expect HEX]\n");
+}
+
+static void run_script(const scene_t *scene, u32 frame)
+{
+    u32 scene_frame = frame % scene->period;
+
+    for (u32 i = 0; i < scene->step_count; i++)
+    {
+        if (scene->steps[i].frame != scene_frame)
+            continue;
+
+        Game_HandleKeyDown(scene->steps[i].key);
+        Game_HandleKeyUp(scene->steps[i].key);
+    }
+}
+
+static void print_report(const benchmark_args_t *args, benchmark_result_t *result)
+{
+    u32 count = args->frames;
+    f32 *sorted = result->frame_ms;
+
+    f64 sum_ms = 0.0;
+    for (u32 i = 0; i < count; i++)
+        sum_ms += sorted[i];
+
+    qsort(sorted, count, sizeof(f32), compare_f32);
+
+    printf("scene: %s, %u frames after %u warmup, %ux%u\n", args->scene->name, count, args->warmup,
+           args->width, args->height);
+    printf("cpu frame ms: avg %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+           sum_ms / count, percentile(sorted, count, 0.50f), percentile(sorted, count, 0.95f),
+           percentile(sorted, count, 0.99f), sorted[count - 1]);
+    printf("draw calls: avg %.1f  max %u\n", (f64)result->draw_calls / count, result->max_draw_calls);
+    printf("triangles: avg %.1f\n", (f64)result->triangles / count);
+    printf("upload bytes: total %llu  avg %.1f  max %llu\n", (unsigned long long)result->upload_bytes,
+           (f64)result->upload_bytes / count, (unsigned long long)result->max_upload_bytes);
+}
+
+static int compare_f32(const void *a, const void *b)
+{
+    f32 fa = *(const f32 *)a;
+    f32 fb = *(const f32 *)b;
+
+    return (fa > fb) - (fa < fb);
+}
+
+/* nearest rank, as in frame_stats.c */
+static f32 percentile(const f32 *sorted, u32 count, f32 p)
+{
+    u32 rank = (u32)ceilf(p * (f32)count);
+    return sorted[Clamp(1u, rank, count) - 1];
+}
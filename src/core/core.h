@@ -23,6 +23,7 @@ typedef double      f64;
 
 // Constants
 #define U8_MAX  UINT8_MAX
+#define U16_MAX UINT16_MAX
 #define U32_MAX UINT32_MAX
 #define U64_MAX UINT64_MAX
 
@@ -74,6 +75,15 @@ typedef double      f64;
 #define Likely(expr)            Expect(expr, 1)
 #define Unlikely(expr)          Expect(expr, 0)
 
+// Spin-wait hint
+#if defined(__x86_64__) || defined(__i386__)
+#define CpuRelax()              __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define CpuRelax()              __asm__ volatile("yield")
+#else
+#define CpuRelax()              ((void)0)
+#endif
+
 // Attributes
 #define AttributePacked         __attribute__((packed))
 #define AttributeMaybeUnused    __attribute_maybe_unused__
@@ -112,5 +122,8 @@ typedef double      f64;
 // Misc helper macros
 #define ArrayCount(a) (sizeof(a) / sizeof((a)[0]))
 
+#define Glue_(a, b) a##b
+#define Glue(a, b) Glue_(a, b)
+
 
 #endif
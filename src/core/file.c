@@ -1,40 +1,270 @@
-#include <stdio.h>
-
 #include "file.h"
 #include "log.h"
+#include "os_file.h"
 
-u8 *File_Read(arena_t *arena, const char *path, u64 *size_out)
+/* reads in flight per batch, and the most one queue entry reads at once
+   (io_uring lengths are 32-bit) */
+#define BATCH_DEPTH     64u
+#define BATCH_CHUNK     ((u64)1 << 30)
+
+typedef struct
 {
-    u8 *data = NULL;
+    u32 read_index;
+    u32 size;
+    u64 offset;
+    bool done;
+} file_chunk_t;
 
-    FILE *file = fopen(path, "rb");
-    if (!file)
-    {
-        Log(ERROR, "failed to open file: %s", path);
-        return NULL;
-    }
+struct _file_batch_t
+{
+    file_read_t     *reads;
+    u32             read_count;
+    i64             *files;
+    bool            *failed;
+
+    file_chunk_t    *chunks;
+    u32             chunk_count;
+    u32             next_chunk;     /* first chunk not yet queued */
+    u32             done_chunks;
 
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    os_read_queue_t *queue;
+};
 
-    if (size < 0)
+static void queue_chunks(file_batch_t *batch);
+static void complete_chunk(file_batch_t *batch, u64 tag, i64 result);
+static void close_batch(file_batch_t *batch);
+
+u8 *File_Read(arena_t *arena, const char *path, u64 *size_out)
+{
+    i64 file;
+    u64 size;
+    if (!OS_FileOpen(path, &file, &size))
     {
-        Log(ERROR, "failed to read file: %s", path);
-        goto exit;
+        Log(ERROR, "failed to open file: %s", path);
+        return NULL;
     }
 
-    data = arena_push_array_no_zero(arena, u8, (u64)size);
-    if (fread(data, 1, (u64)size, file) != (u64)size)
+    u8 *data = arena_push_array_no_zero(arena, u8, size);
+    if (!OS_FileReadAt(file, data, size, 0))
     {
         Log(ERROR, "failed to read file: %s", path);
         data = NULL;
     }
 
     if (size_out)
-        *size_out = (u64)size;
+        *size_out = size;
 
-exit:
-    fclose(file);
+    OS_FileClose(file);
     return data;
 }
+
+bool File_Write(const char *path, const void *data, u64 size)
+{
+    if (!OS_FileWrite(path, data, size))
+    {
+        Log(ERROR, "failed to write file: %s", path);
+        return false;
+    }
+
+    return true;
+}
+
+bool File_Map(const char *path, file_map_t *map_out)
+{
+    if (!OS_FileMap(path, &map_out->data, &map_out->size))
+    {
+        Log(ERROR, "failed to map file: %s", path);
+        MemoryZeroItem(map_out);
+        return false;
+    }
+
+    return true;
+}
+
+void File_Unmap(file_map_t *map)
+{
+    OS_FileUnmap(map->data, map->size);
+    MemoryZeroItem(map);
+}
+
+file_batch_t *File_BatchBegin(arena_t *arena, file_read_t *reads, u32 count)
+{
+    file_batch_t *batch = arena_push(arena, file_batch_t);
+    batch->reads = reads;
+    batch->read_count = count;
+    batch->files = arena_push_array(arena, i64, count);
+    batch->failed = arena_push_array(arena, bool, count);
+
+    u32 chunk_count = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+        file_read_t *read = &reads[i];
+        read->data = NULL;
+        read->ok = false;
+
+        if (!OS_FileOpen(read->path, &batch->files[i], &read->size))
+        {
+            Log(ERROR, "failed to open file: %s", read->path);
+            batch->files[i] = -1;
+            batch->failed[i] = true;
+            continue;
+        }
+
+        read->data = arena_push_array_no_zero(arena, u8, read->size);
+        chunk_count += (u32)((read->size + BATCH_CHUNK - 1) / BATCH_CHUNK);
+    }
+
+    batch->chunks = arena_push_array_no_zero(arena, file_chunk_t, chunk_count);
+    for (u32 i = 0; i < count; i++)
+    {
+        if (batch->failed[i])
+            continue;
+
+        for (u64 offset = 0; offset < reads[i].size; offset += BATCH_CHUNK)
+        {
+            batch->chunks[batch->chunk_count++] = (file_chunk_t){
+                .read_index = i,
+                .size = (u32)Min(BATCH_CHUNK, reads[i].size - offset),
+                .offset = offset,
+            };
+        }
+    }
+
+    if (batch->chunk_count > 1)
+        batch->queue = OS_ReadQueueCreate(Min(batch->chunk_count, BATCH_DEPTH));
+
+    if (batch->queue)
+    {
+        queue_chunks(batch);
+    }
+    else
+    {
+        /* no queue, or a single read that gains nothing from one */
+        for (u32 i = 0; i < batch->chunk_count; i++)
+        {
+            file_chunk_t *chunk = &batch->chunks[i];
+            bool ok = OS_FileReadAt(batch->files[chunk->read_index],
+                                    reads[chunk->read_index].data + chunk->offset, chunk->size, chunk->offset);
+            complete_chunk(batch, i, ok ? (i64)chunk->size : -1);
+        }
+        batch->next_chunk = batch->chunk_count;
+    }
+
+    return batch;
+}
+
+bool File_BatchPoll(file_batch_t *batch)
+{
+    u64 tag;
+    i64 result;
+    while (batch->queue && OS_ReadQueuePop(batch->queue, false, &tag, &result))
+    {
+        complete_chunk(batch, tag, result);
+        queue_chunks(batch);
+    }
+
+    return batch->done_chunks == batch->chunk_count;
+}
+
+u32 File_BatchWait(file_batch_t *batch)
+{
+    u64 tag;
+    i64 result;
+    while (batch->done_chunks < batch->chunk_count && OS_ReadQueuePop(batch->queue, true, &tag, &result))
+    {
+        complete_chunk(batch, tag, result);
+        queue_chunks(batch);
+    }
+
+    /* the queue broke down mid-batch; destroying it reaps what is still in
+       flight, so the buffers are no longer written after this */
+    close_batch(batch);
+    for (u32 i = 0; i < batch->chunk_count && batch->done_chunks < batch->chunk_count; i++)
+    {
+        if (!batch->chunks[i].done)
+            complete_chunk(batch, i, -1);
+    }
+
+    u32 ok_count = 0;
+    for (u32 i = 0; i < batch->read_count; i++)
+    {
+        file_read_t *read = &batch->reads[i];
+        read->ok = !batch->failed[i];
+        if (read->ok)
+            ok_count++;
+        else if (batch->files[i] >= 0)
+            Log(ERROR, "failed to read file: %s", read->path);
+    }
+
+    return ok_count;
+}
+
+/* pushes what fits and submits it */
+static void queue_chunks(file_batch_t *batch)
+{
+    u32 first = batch->next_chunk;
+    while (batch->next_chunk < batch->chunk_count)
+    {
+        file_chunk_t *chunk = &batch->chunks[batch->next_chunk];
+        u8 *dst = batch->reads[chunk->read_index].data + chunk->offset;
+
+        if (!OS_ReadQueuePush(batch->queue, batch->files[chunk->read_index], dst, chunk->size, chunk->offset,
+                              batch->next_chunk))
+            break;
+
+        batch->next_chunk++;
+    }
+
+    if (batch->next_chunk == first || OS_ReadQueueSubmit(batch->queue))
+        return;
+
+    /* the kernel refused the reads: the ones it took still finish, the rest
+       of the batch fails */
+    Log(ERROR, "failed to submit file reads");
+    u64 tag;
+    i64 result;
+    while (OS_ReadQueuePop(batch->queue, true, &tag, &result))
+        complete_chunk(batch, tag, result);
+
+    for (u32 i = 0; i < batch->chunk_count; i++)
+    {
+        if (!batch->chunks[i].done)
+            complete_chunk(batch, i, -1);
+    }
+    batch->next_chunk = batch->chunk_count;
+}
+
+/* a short read finishes with a blocking read of the rest */
+static void complete_chunk(file_batch_t *batch, u64 tag, i64 result)
+{
+    file_chunk_t *chunk = &batch->chunks[tag];
+    u32 read_index = chunk->read_index;
+    Assert(!chunk->done);
+
+    if (result < 0)
+    {
+        batch->failed[read_index] = true;
+    }
+    else if ((u64)result < chunk->size)
+    {
+        u64 done = (u64)result;
+        u8 *dst = batch->reads[read_index].data + chunk->offset + done;
+        if (!OS_FileReadAt(batch->files[read_index], dst, chunk->size - done, chunk->offset + done))
+            batch->failed[read_index] = true;
+    }
+
+    chunk->done = true;
+    batch->done_chunks++;
+}
+
+static void close_batch(file_batch_t *batch)
+{
+    OS_ReadQueueDestroy(batch->queue);
+    batch->queue = NULL;
+
+    for (u32 i = 0; i < batch->read_count; i++)
+    {
+        if (batch->files[i] >= 0)
+            OS_FileClose(batch->files[i]);
+    }
+}
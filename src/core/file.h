@@ -4,6 +4,46 @@
 #include "core.h"
 #include "memory_arena.h"
 
+typedef struct
+{
+    const u8    *data;
+    u64         size;
+} file_map_t;
+
+typedef struct
+{
+    const char  *path;
+
+    /* filled in by the batch, valid once it is done */
+    u8          *data;
+    u64         size;
+    bool        ok;
+} file_read_t;
+
+typedef struct _file_batch_t file_batch_t;
+
+/* copies the whole file onto arena */
 u8 *File_Read(arena_t *arena, const char *path, u64 *size_out);
 
+/* replaces the whole file atomically, see OS_FileWrite */
+bool File_Write(const char *path, const void *data, u64 size);
+
+/* read-only view of the whole file for loaders that parse in place, with no
+   copy; pages fault in as they are read. an empty file maps to NULL */
+bool File_Map(const char *path, file_map_t *map_out);
+void File_Unmap(file_map_t *map);
+
+/* reads many whole files concurrently: they are opened and sized here, the
+   buffers pushed on arena, and the reads queued to the os (io_uring on
+   linux). without a queue the reads happen here, one pread after another.
+   the batch itself lives on arena too; each batch belongs to one thread */
+file_batch_t *File_BatchBegin(arena_t *arena, file_read_t *reads, u32 count);
+
+/* true once every read has finished; never blocks */
+bool File_BatchPoll(file_batch_t *batch);
+
+/* blocks until every read has finished and closes the files; returns the
+   number of reads that succeeded */
+u32 File_BatchWait(file_batch_t *batch);
+
 #endif
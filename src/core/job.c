@@ -0,0 +1,415 @@
+#include <stdio.h>
+
+#include "log.h"
+#include "os_thread.h"
+#include "profiler.h"
+
+#include "job.h"
+
+#define DEQUE_CAPACITY          4096
+#define DEQUE_MASK              (DEQUE_CAPACITY - 1)
+#define CHUNKS_PER_THREAD       4
+#define SPINS_BEFORE_SLEEP      64
+#define THREAD_NAME_LENGTH      16
+#define CACHE_LINE              64
+
+StaticAssert(IsPow2(DEQUE_CAPACITY), "bad deque capacity");
+
+typedef struct
+{
+    job_fn_t        fn;
+    void            *data;
+    job_counter_t   *counter;
+} job_t;
+
+typedef struct
+{
+    job_range_fn_t  fn;
+    void            *data;
+    u32             begin;
+    u32             end;
+} range_job_t;
+
+/* a job stored by value. the owner can refill a slot as soon as a thief
+   has moved top past it, so thieves read the fields before claiming the
+   slot and the claim validates what they read */
+typedef struct
+{
+    _Atomic(job_fn_t)       fn;
+    void *_Atomic           data;
+    job_counter_t *_Atomic  counter;
+} job_slot_t;
+
+/* chase-lev, with the c11 orderings of le et al. 2013 */
+typedef struct
+{
+    _Alignas(CACHE_LINE) _Atomic i64 top;
+    _Alignas(CACHE_LINE) _Atomic i64 bottom;
+    _Alignas(CACHE_LINE) job_slot_t slots[DEQUE_CAPACITY];
+} job_deque_t;
+
+typedef struct
+{
+    job_deque_t     deque;
+
+    u32             index;
+    u32             rng;
+    arena_t         *scratch;
+    os_thread_t     *os_thread;
+    char            name[THREAD_NAME_LENGTH];
+} job_thread_t;
+
+typedef struct
+{
+    arena_t         *arena;
+    job_thread_t    *threads;
+    u32             thread_count;
+
+    os_semaphore_t  *wake;
+    _Atomic u32     sleeping;
+    _Atomic bool    quit;
+} job_system_t;
+
+static job_system_t s_jobs = {};
+static _Thread_local job_thread_t *t_thread = NULL;
+
+static void worker_main(void *user);
+static bool push(job_thread_t *thread, job_fn_t fn, void *data, job_counter_t *counter);
+static bool pop(job_deque_t *deque, job_t *job);
+static bool steal(job_deque_t *deque, job_t *job);
+static void read_slot(job_slot_t *slot, job_t *job, memory_order order);
+static bool run_one(job_thread_t *thread);
+static void execute(job_t *job);
+static void wake_workers(u32 count);
+static bool has_work(void);
+static void run_range(void *data);
+
+bool Job_Init(u32 worker_count)
+{
+    if (s_jobs.threads)
+        return true;
+
+    if (worker_count == 0)
+        worker_count = OS_CpuCount() - 1;
+    worker_count = Min(worker_count, (u32)JOB_MAX_THREADS - 1);
+
+    u32 thread_count = worker_count + 1;
+    s_jobs.arena = MemoryArena_CreateP("job-arena", (arena_params_t){
+        .reserve_size = (u64)thread_count * sizeof(job_thread_t) + MB(1),
+        .commit_size = MB(1),
+    });
+    s_jobs.threads = arena_push_array(s_jobs.arena, job_thread_t, thread_count);
+    s_jobs.thread_count = thread_count;
+
+    s_jobs.wake = OS_SemaphoreCreate(0);
+    if (!s_jobs.wake)
+        goto fail;
+
+    for (u32 i = 0; i < thread_count; i++)
+    {
+        job_thread_t *thread = &s_jobs.threads[i];
+        thread->index = i;
+        thread->rng = i * 0x9E3779B9u + 1;
+        thread->scratch = MemoryArena_Create("job-scratch");
+        snprintf(thread->name, sizeof(thread->name), i ? "worker %u" : "main", i);
+    }
+
+    t_thread = &s_jobs.threads[0];
+
+    for (u32 i = 1; i < thread_count; i++)
+    {
+        s_jobs.threads[i].os_thread = OS_ThreadCreate(worker_main, &s_jobs.threads[i]);
+        if (!s_jobs.threads[i].os_thread)
+        {
+            Log(ERROR, "failed to create job worker %u", i);
+            goto fail;
+        }
+    }
+
+    Log(INFO, "job system initialized with %u workers", worker_count);
+    return true;
+
+fail:
+    Job_Destroy();
+    return false;
+}
+
+void Job_Destroy(void)
+{
+    if (!s_jobs.threads)
+        return;
+
+    atomic_store(&s_jobs.quit, true);
+    if (s_jobs.wake)
+        OS_SemaphoreSignal(s_jobs.wake, s_jobs.thread_count);
+
+    for (u32 i = 0; i < s_jobs.thread_count; i++)
+    {
+        job_thread_t *thread = &s_jobs.threads[i];
+        if (thread->os_thread)
+            OS_ThreadJoin(thread->os_thread);
+        if (thread->scratch)
+            MemoryArena_Destroy(thread->scratch);
+    }
+
+    if (s_jobs.wake)
+        OS_SemaphoreDestroy(s_jobs.wake);
+
+    MemoryArena_Destroy(s_jobs.arena);
+    MemoryZeroItem(&s_jobs);
+    t_thread = NULL;
+}
+
+void Job_Run(job_fn_t fn, void *data, job_counter_t *counter)
+{
+    if (counter)
+        atomic_fetch_add(&counter->pending, 1);
+
+    if (!t_thread || !push(t_thread, fn, data, counter))
+    {
+        /* no job system or a full deque: run it here */
+        job_t job = {.fn = fn, .data = data, .counter = counter};
+        execute(&job);
+        return;
+    }
+
+    wake_workers(1);
+}
+
+void Job_Wait(job_counter_t *counter)
+{
+    ProfileZone("Job_Wait");
+
+    while (atomic_load_explicit(&counter->pending, memory_order_acquire) > 0)
+    {
+        if (!t_thread || !run_one(t_thread))
+            CpuRelax();
+    }
+}
+
+bool Job_IsDone(job_counter_t *counter)
+{
+    return atomic_load_explicit(&counter->pending, memory_order_acquire) == 0;
+}
+
+void Job_ParallelFor(u32 count, u32 min_chunk, job_range_fn_t fn, void *data)
+{
+    if (count == 0)
+        return;
+
+    u32 target_chunks = Job_ThreadCount() * CHUNKS_PER_THREAD;
+    u32 chunk = Max(Max(min_chunk, 1u), (count + target_chunks - 1) / target_chunks);
+    u32 chunk_count = (count + chunk - 1) / chunk;
+
+    if (chunk_count == 1 || !t_thread)
+    {
+        fn(data, 0, count);
+        return;
+    }
+
+    ProfileZone("Job_ParallelFor");
+
+    scratch_t scratch = Scratch_Begin(t_thread->scratch);
+    range_job_t *ranges = arena_push_array_no_zero(scratch.arena, range_job_t, chunk_count);
+    job_counter_t counter = {};
+
+    for (u32 i = 0; i < chunk_count; i++)
+    {
+        ranges[i] = (range_job_t){
+            .fn = fn,
+            .data = data,
+            .begin = i * chunk,
+            .end = Min(count, (i + 1) * chunk),
+        };
+    }
+
+    /* queue all but the first, which runs here while the others get stolen */
+    for (u32 i = 1; i < chunk_count; i++)
+    {
+        atomic_fetch_add(&counter.pending, 1);
+        if (!push(t_thread, run_range, &ranges[i], &counter))
+        {
+            job_t job = {.fn = run_range, .data = &ranges[i], .counter = &counter};
+            execute(&job);
+        }
+    }
+    wake_workers(chunk_count - 1);
+
+    run_range(&ranges[0]);
+    Job_Wait(&counter);
+
+    Scratch_End(scratch);
+}
+
+arena_t *Job_Scratch(void)
+{
+    Assert(t_thread != NULL);
+    return t_thread->scratch;
+}
+
+u32 Job_ThreadIndex(void)
+{
+    return t_thread ? t_thread->index : 0;
+}
+
+u32 Job_ThreadCount(void)
+{
+    return Max(s_jobs.thread_count, 1u);
+}
+
+static void worker_main(void *user)
+{
+    job_thread_t *thread = user;
+    t_thread = thread;
+    Profiler_SetThreadName(thread->name);
+
+    u32 idle_spins = 0;
+    while (!atomic_load_explicit(&s_jobs.quit, memory_order_relaxed))
+    {
+        if (run_one(thread))
+        {
+            idle_spins = 0;
+            continue;
+        }
+
+        if (++idle_spins < SPINS_BEFORE_SLEEP)
+        {
+            CpuRelax();
+            continue;
+        }
+
+        /* announce before the final check so a concurrent push either sees
+           us sleeping or we see its job */
+        atomic_fetch_add(&s_jobs.sleeping, 1);
+        if (!has_work() && !atomic_load(&s_jobs.quit))
+            OS_SemaphoreWait(s_jobs.wake);
+        atomic_fetch_sub(&s_jobs.sleeping, 1);
+        idle_spins = 0;
+    }
+
+    t_thread = NULL;
+}
+
+/* owner only */
+static bool push(job_thread_t *thread, job_fn_t fn, void *data, job_counter_t *counter)
+{
+    job_deque_t *deque = &thread->deque;
+    i64 bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    i64 top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (bottom - top >= DEQUE_CAPACITY)
+        return false;
+
+    job_slot_t *slot = &deque->slots[bottom & DEQUE_MASK];
+    atomic_store_explicit(&slot->fn, fn, memory_order_relaxed);
+    atomic_store_explicit(&slot->data, data, memory_order_relaxed);
+    atomic_store_explicit(&slot->counter, counter, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+    return true;
+}
+
+/* owner only */
+static bool pop(job_deque_t *deque, job_t *job)
+{
+    i64 bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    i64 top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return false;
+    }
+
+    read_slot(&deque->slots[bottom & DEQUE_MASK], job, memory_order_relaxed);
+    if (top < bottom)
+        return true;
+
+    /* last job: race the thieves for it */
+    bool won = atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst,
+                                                       memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return won;
+}
+
+static bool steal(job_deque_t *deque, job_t *job)
+{
+    i64 top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    i64 bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (top >= bottom)
+        return false;
+
+    read_slot(&deque->slots[top & DEQUE_MASK], job, memory_order_acquire);
+    return atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst,
+                                                   memory_order_relaxed);
+}
+
+static void read_slot(job_slot_t *slot, job_t *job, memory_order order)
+{
+    job->fn = atomic_load_explicit(&slot->fn, order);
+    job->data = atomic_load_explicit(&slot->data, order);
+    job->counter = atomic_load_explicit(&slot->counter, order);
+}
+
+static bool run_one(job_thread_t *thread)
+{
+    job_t job;
+    bool found = pop(&thread->deque, &job);
+
+    if (!found && s_jobs.thread_count > 1)
+    {
+        /* xorshift picks where to start so thieves spread out */
+        thread->rng ^= thread->rng << 13;
+        thread->rng ^= thread->rng >> 17;
+        thread->rng ^= thread->rng << 5;
+
+        u32 start = thread->rng % s_jobs.thread_count;
+        for (u32 i = 0; i < s_jobs.thread_count && !found; i++)
+        {
+            u32 victim = (start + i) % s_jobs.thread_count;
+            if (victim != thread->index)
+                found = steal(&s_jobs.threads[victim].deque, &job);
+        }
+    }
+
+    if (!found)
+        return false;
+
+    execute(&job);
+    return true;
+}
+
+static void execute(job_t *job)
+{
+    job->fn(job->data);
+
+    if (job->counter)
+        atomic_fetch_sub_explicit(&job->counter->pending, 1, memory_order_release);
+}
+
+static void wake_workers(u32 count)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    u32 sleeping = atomic_load_explicit(&s_jobs.sleeping, memory_order_relaxed);
+    if (sleeping)
+        OS_SemaphoreSignal(s_jobs.wake, Min(count, sleeping));
+}
+
+static bool has_work(void)
+{
+    for (u32 i = 0; i < s_jobs.thread_count; i++)
+    {
+        job_deque_t *deque = &s_jobs.threads[i].deque;
+        if (atomic_load(&deque->bottom) > atomic_load(&deque->top))
+            return true;
+    }
+    return false;
+}
+
+static void run_range(void *data)
+{
+    range_job_t *range = data;
+    range->fn(range->data, range->begin, range->end);
+}
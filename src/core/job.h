@@ -0,0 +1,55 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include <stdatomic.h>
+
+#include "core.h"
+#include "memory_arena.h"
+
+/* work-stealing job system. the main thread and a fixed pool of workers
+   each own a chase-lev deque: the owner pushes and pops at the bottom, idle
+   threads steal from the top. waiting on a counter runs queued jobs instead
+   of blocking, so jobs may fork and join recursively.
+   jobs may only be queued from the main thread and from inside jobs. before
+   Job_Init (or after Job_Destroy) everything runs inline on the caller */
+
+#define JOB_MAX_THREADS 64
+
+typedef void (*job_fn_t)(void *data);
+
+/* processes indices [begin, end) of a parallel for */
+typedef void (*job_range_fn_t)(void *data, u32 begin, u32 end);
+
+/* zero initialized; counts jobs queued with it that haven't returned */
+typedef struct
+{
+    _Atomic u32 pending;
+} job_counter_t;
+
+/* worker_count 0 = one per core besides the calling (main) thread */
+bool Job_Init(u32 worker_count);
+void Job_Destroy(void);
+
+/* counter is optional; it is incremented now and decremented once fn
+   returns. data must stay valid until then */
+void Job_Run(job_fn_t fn, void *data, job_counter_t *counter);
+
+/* runs queued jobs, ours or stolen, until counter reaches zero */
+void Job_Wait(job_counter_t *counter);
+
+bool Job_IsDone(job_counter_t *counter);
+
+/* splits [0, count) into chunks of at least min_chunk indices, a few per
+   thread, and returns when all have run. the caller takes part */
+void Job_ParallelFor(u32 count, u32 min_chunk, job_range_fn_t fn, void *data);
+
+/* the calling thread's scratch arena, use with Scratch_Begin/End. jobs run
+   nested in Job_Wait share it, which the begin/end pairing keeps safe.
+   only on the main thread and in jobs, between Job_Init and Job_Destroy */
+arena_t *Job_Scratch(void);
+
+/* 0 is the main thread; Job_ThreadCount includes it */
+u32 Job_ThreadIndex(void);
+u32 Job_ThreadCount(void);
+
+#endif
@@ -1,3 +1,4 @@
+#include <stdatomic.h>
 #include <stdio.h>
 
 #include "core_string.h"
@@ -8,6 +9,8 @@
 #define MAX_ENTRY_LENGTH 256
 
 static log_t *s_logger = NULL;
+/* Log is called from job workers; readers (Log_Get) stay on the main thread */
+static atomic_flag s_lock = ATOMIC_FLAG_INIT;
 
 StaticAssert(IsPow2(LOG_CAPACITY), "bad capacity");
 
@@ -56,6 +59,12 @@ void Log_Destroy(void)
     s_logger = NULL;
 }
 
+void Log_SetStdout(bool enabled)
+{
+    if (s_logger)
+        s_logger->stdout = enabled;
+}
+
 void Log(log_severity_t severity, const char *log, ...)
 {
     if (!s_logger)
@@ -63,6 +72,9 @@ void Log(log_severity_t severity, const char *log, ...)
 
     va_list args;
 
+    while (atomic_flag_test_and_set_explicit(&s_lock, memory_order_acquire))
+        CpuRelax();
+
     if (Log_Count() >= (s_logger->capacity - 1))
     {
         s_logger->head++;
@@ -93,6 +105,8 @@ void Log(log_severity_t severity, const char *log, ...)
     s_logger->tail++;
     if (s_logger->tail == s_logger->capacity)
         s_logger->tail = 0;
+
+    atomic_flag_clear_explicit(&s_lock, memory_order_release);
 }
 
 u64 Log_Count()
@@ -37,6 +37,9 @@ typedef struct
 void Log_Init(void);
 void Log_Destroy(void);
 
+/* entries are still stored while stdout echo is off */
+void Log_SetStdout(bool enabled);
+
 
 void Log(log_severity_t severity, const char *log, ...);
 
@@ -0,0 +1,170 @@
+#include "lz4.h"
+
+#define MIN_MATCH       4u
+#define LAST_LITERALS   5u      /* a block ends in at least this many literals */
+#define MATCH_LIMIT     12u     /* and its last match starts this far from the end */
+#define MAX_OFFSET      65535u
+#define HASH_BITS       14u
+
+static u32 read_u32(const u8 *ptr);
+static u8 *write_length(u8 *dst, u64 length);
+static u8 *write_sequence(u8 *dst, const u8 *literals, u64 literal_count, u32 offset, u64 match_length);
+static bool read_length(const u8 **in, const u8 *in_end, u64 *length);
+
+u64 Lz4_CompressBound(u64 size)
+{
+    return size + size / 255 + 16;
+}
+
+u64 Lz4_Compress(const u8 *src, u64 size, u8 *dst, u64 capacity)
+{
+    if (capacity < Lz4_CompressBound(size) || size >= U32_MAX)
+        return 0;
+
+    u32 table[1u << HASH_BITS];
+    MemoryZeroArray(table);
+
+    u8 *out = dst;
+    u64 anchor = 0;
+    u64 pos = 0;
+
+    if (size > MATCH_LIMIT)
+    {
+        u64 match_end = size - LAST_LITERALS;
+        while (pos < size - MATCH_LIMIT)
+        {
+            u32 sequence = read_u32(src + pos);
+            u32 hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+            u64 candidate = table[hash];
+            table[hash] = (u32)pos;
+
+            /* the table starts zeroed, so a stale or empty slot just fails the compare */
+            if (candidate >= pos || pos - candidate > MAX_OFFSET || read_u32(src + candidate) != sequence)
+            {
+                pos++;
+                continue;
+            }
+
+            u64 length = MIN_MATCH;
+            while (pos + length < match_end && src[candidate + length] == src[pos + length])
+                length++;
+
+            out = write_sequence(out, src + anchor, pos - anchor, (u32)(pos - candidate), length);
+            pos += length;
+            anchor = pos;
+        }
+    }
+
+    out = write_sequence(out, src + anchor, size - anchor, 0, 0);
+    return (u64)(out - dst);
+}
+
+bool Lz4_Decompress(const u8 *src, u64 size, u8 *dst, u64 raw_size)
+{
+    const u8 *in = src;
+    const u8 *in_end = src + size;
+    u8 *out = dst;
+    u8 *out_end = dst + raw_size;
+
+    while (in < in_end)
+    {
+        u8 token = *in++;
+
+        u64 literal_count = token >> 4;
+        if (literal_count == 15 && !read_length(&in, in_end, &literal_count))
+            return false;
+        if (literal_count > (u64)(in_end - in) || literal_count > (u64)(out_end - out))
+            return false;
+
+        MemoryCopy(out, in, literal_count);
+        in += literal_count;
+        out += literal_count;
+
+        /* the last sequence has no match */
+        if (in == in_end)
+            break;
+
+        if (in_end - in < 2)
+            return false;
+        u32 offset = (u32)in[0] | (u32)in[1] << 8;
+        in += 2;
+        if (offset == 0 || offset > (u64)(out - dst))
+            return false;
+
+        u64 match_length = token & 15;
+        if (match_length == 15 && !read_length(&in, in_end, &match_length))
+            return false;
+        match_length += MIN_MATCH;
+        if (match_length > (u64)(out_end - out))
+            return false;
+
+        /* an offset shorter than the match repeats the bytes just written */
+        const u8 *match = out - offset;
+        if (offset >= match_length)
+        {
+            MemoryCopy(out, match, match_length);
+        }
+        else
+        {
+            for (u64 i = 0; i < match_length; i++)
+                out[i] = match[i];
+        }
+        out += match_length;
+    }
+
+    return out == out_end;
+}
+
+static u32 read_u32(const u8 *ptr)
+{
+    u32 value;
+    MemoryCopy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static u8 *write_length(u8 *dst, u64 length)
+{
+    for (; length >= 255; length -= 255)
+        *dst++ = 255;
+    *dst++ = (u8)length;
+    return dst;
+}
+
+/* match_length 0 writes the literals only, as the final sequence */
+static u8 *write_sequence(u8 *dst, const u8 *literals, u64 literal_count, u32 offset, u64 match_length)
+{
+    u8 *token = dst++;
+    *token = (u8)(Min(literal_count, (u64)15) << 4);
+    if (literal_count >= 15)
+        dst = write_length(dst, literal_count - 15);
+
+    MemoryCopy(dst, literals, literal_count);
+    dst += literal_count;
+
+    if (match_length == 0)
+        return dst;
+
+    *dst++ = (u8)offset;
+    *dst++ = (u8)(offset >> 8);
+
+    u64 length = match_length - MIN_MATCH;
+    *token |= (u8)Min(length, (u64)15);
+    if (length >= 15)
+        dst = write_length(dst, length - 15);
+
+    return dst;
+}
+
+static bool read_length(const u8 **in, const u8 *in_end, u64 *length)
+{
+    u8 byte;
+    do
+    {
+        if (*in >= in_end)
+            return false;
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
@@ -0,0 +1,21 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include "core.h"
+
+/* lz4 block format, compatible with the reference lz4 block api. the
+   compressor is a plain greedy single-probe one: fast to decode is what
+   matters, packing happens offline */
+
+/* worst case compressed size for size input bytes */
+u64 Lz4_CompressBound(u64 size);
+
+/* returns the compressed size, 0 if capacity is below Lz4_CompressBound or
+   the input is 4 GB or larger */
+u64 Lz4_Compress(const u8 *src, u64 size, u8 *dst, u64 capacity);
+
+/* raw_size must be the exact decompressed size; false on malformed input,
+   never reads or writes out of bounds */
+bool Lz4_Decompress(const u8 *src, u64 size, u8 *dst, u64 raw_size);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef OS_FILE_H
+#define OS_FILE_H
+
+#include "core.h"
+
+typedef struct _os_read_queue_t os_read_queue_t;
+
+/* read-only mapping of a whole file, hinted for one sequential pass. an
+   empty file maps to data = NULL, size = 0 */
+bool OS_FileMap(const char *path, const u8 **data_out, u64 *size_out);
+void OS_FileUnmap(const u8 *data, u64 size);
+
+/* opens for reading; handles are plain integers on every platform */
+bool OS_FileOpen(const char *path, i64 *file_out, u64 *size_out);
+void OS_FileClose(i64 file);
+
+/* blocking positional read of exactly size bytes */
+bool OS_FileReadAt(i64 file, void *buffer, u64 size, u64 offset);
+
+/* replaces the file at path with size bytes of data. the data goes to a
+   temporary file that is renamed over path, so readers see the old file or
+   the new one, never a torn write */
+bool OS_FileWrite(const char *path, const void *data, u64 size);
+
+/* true if the directory exists afterwards; parents are not created */
+bool OS_DirectoryCreate(const char *path);
+
+/* asynchronous reads, at most depth in flight; io_uring on linux. NULL if
+   the os has no queue or won't give one (old kernel, seccomp), in which
+   case callers fall back to OS_FileReadAt */
+os_read_queue_t *OS_ReadQueueCreate(u32 depth);
+void OS_ReadQueueDestroy(os_read_queue_t *queue);
+
+/* false when depth reads are already in flight; tag comes back with the
+   completion */
+bool OS_ReadQueuePush(os_read_queue_t *queue, i64 file, void *buffer, u32 size, u64 offset, u64 tag);
+
+/* hands the pushed reads to the kernel; Pop does so too. false if the
+   kernel refused them: the reads not yet taken are dropped, as if never
+   pushed, and won't complete */
+bool OS_ReadQueueSubmit(os_read_queue_t *queue);
+
+/* reaps one completion: its tag and the bytes read, negative on error.
+   returns false when none is ready (wait = false) or nothing is in flight */
+bool OS_ReadQueuePop(os_read_queue_t *queue, bool wait, u64 *tag_out, i64 *result_out);
+
+#endif
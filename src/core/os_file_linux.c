@@ -0,0 +1,340 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "os_file.h"
+
+/* io_uring through the raw syscalls, so there is no liburing dependency */
+struct _os_read_queue_t
+{
+    int                     fd;
+    u32                     depth;
+    u32                     in_flight;  /* pushed and not popped */
+    u32                     unsubmitted;
+
+    void                    *sq_ring;
+    u64                     sq_ring_size;
+    void                    *cq_ring;
+    u64                     cq_ring_size;
+    struct io_uring_sqe     *sqes;
+    u64                     sqes_size;
+
+    _Atomic u32             *sq_head;
+    _Atomic u32             *sq_tail;
+    u32                     sq_mask;
+    u32                     *sq_array;
+
+    _Atomic u32             *cq_head;
+    _Atomic u32             *cq_tail;
+    u32                     cq_mask;
+    struct io_uring_cqe     *cqes;
+};
+
+static int io_uring_setup(u32 entries, struct io_uring_params *params);
+static int io_uring_enter(int fd, u32 to_submit, u32 min_complete, u32 flags);
+
+bool OS_FileMap(const char *path, const u8 **data_out, u64 *size_out)
+{
+    i64 file;
+    u64 size;
+    if (!OS_FileOpen(path, &file, &size))
+        return false;
+
+    *data_out = NULL;
+    *size_out = size;
+
+    /* mmap rejects empty ranges */
+    if (size == 0)
+    {
+        close((int)file);
+        return true;
+    }
+
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, (int)file, 0);
+    close((int)file); /* the mapping keeps the file referenced */
+    if (data == MAP_FAILED)
+        return false;
+
+    /* loaders parse front to back once: read ahead aggressively and start
+       paging in now */
+    madvise(data, size, MADV_SEQUENTIAL);
+    madvise(data, size, MADV_WILLNEED);
+
+    *data_out = data;
+    return true;
+}
+
+void OS_FileUnmap(const u8 *data, u64 size)
+{
+    if (data)
+        munmap((void *)data, size);
+}
+
+bool OS_FileOpen(const char *path, i64 *file_out, u64 *size_out)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return false;
+    }
+
+    *file_out = fd;
+    *size_out = (u64)st.st_size;
+    return true;
+}
+
+void OS_FileClose(i64 file)
+{
+    close((int)file);
+}
+
+bool OS_FileReadAt(i64 file, void *buffer, u64 size, u64 offset)
+{
+    u8 *dst = buffer;
+    while (size > 0)
+    {
+        ssize_t n = pread((int)file, dst, size, (off_t)offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+
+        dst += n;
+        size -= (u64)n;
+        offset += (u64)n;
+    }
+
+    return true;
+}
+
+bool OS_FileWrite(const char *path, const void *data, u64 size)
+{
+    /* unique per writer, so concurrent writes of one path don't share it */
+    static _Atomic u32 s_temp_counter;
+    char temp_path[PATH_MAX];
+    int length = snprintf(temp_path, sizeof(temp_path), "%s.%d.%u.tmp", path, (int)getpid(),
+                          atomic_fetch_add(&s_temp_counter, 1));
+    if (length < 0 || (u64)length >= sizeof(temp_path))
+        return false;
+
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    const u8 *src = data;
+    while (size > 0)
+    {
+        ssize_t n = write(fd, src, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+
+        src += n;
+        size -= (u64)n;
+    }
+
+    bool result = close(fd) == 0 && size == 0 && rename(temp_path, path) == 0;
+    if (!result)
+        unlink(temp_path);
+    return result;
+}
+
+bool OS_DirectoryCreate(const char *path)
+{
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+os_read_queue_t *OS_ReadQueueCreate(u32 depth)
+{
+    struct io_uring_params params = {};
+    int fd = io_uring_setup(depth, &params);
+    if (fd < 0)
+        return NULL;
+
+    os_read_queue_t *queue = calloc(1, sizeof(os_read_queue_t));
+    if (!queue)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    queue->fd = fd;
+    queue->depth = Min(depth, params.cq_entries);
+
+    queue->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+    queue->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        queue->sq_ring_size = Max(queue->sq_ring_size, queue->cq_ring_size);
+        queue->cq_ring_size = queue->sq_ring_size;
+    }
+
+    queue->sq_ring = mmap(NULL, queue->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                          IORING_OFF_SQ_RING);
+    if (queue->sq_ring == MAP_FAILED)
+        goto fail;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        queue->cq_ring = queue->sq_ring;
+    }
+    else
+    {
+        queue->cq_ring = mmap(NULL, queue->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                              IORING_OFF_CQ_RING);
+        if (queue->cq_ring == MAP_FAILED)
+            goto fail;
+    }
+
+    queue->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    queue->sqes = mmap(NULL, queue->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                       IORING_OFF_SQES);
+    if (queue->sqes == MAP_FAILED)
+        goto fail;
+
+    u8 *sq = queue->sq_ring;
+    queue->sq_head = (_Atomic u32 *)(sq + params.sq_off.head);
+    queue->sq_tail = (_Atomic u32 *)(sq + params.sq_off.tail);
+    queue->sq_mask = *(u32 *)(sq + params.sq_off.ring_mask);
+    queue->sq_array = (u32 *)(sq + params.sq_off.array);
+
+    u8 *cq = queue->cq_ring;
+    queue->cq_head = (_Atomic u32 *)(cq + params.cq_off.head);
+    queue->cq_tail = (_Atomic u32 *)(cq + params.cq_off.tail);
+    queue->cq_mask = *(u32 *)(cq + params.cq_off.ring_mask);
+    queue->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return queue;
+
+fail:
+    OS_ReadQueueDestroy(queue);
+    return NULL;
+}
+
+void OS_ReadQueueDestroy(os_read_queue_t *queue)
+{
+    if (!queue)
+        return;
+
+    /* the kernel may still write into buffers of reads in flight */
+    u64 tag;
+    i64 result;
+    while (OS_ReadQueuePop(queue, true, &tag, &result))
+        ;
+
+    if (queue->sqes && queue->sqes != MAP_FAILED)
+        munmap(queue->sqes, queue->sqes_size);
+    if (queue->cq_ring && queue->cq_ring != MAP_FAILED && queue->cq_ring != queue->sq_ring)
+        munmap(queue->cq_ring, queue->cq_ring_size);
+    if (queue->sq_ring && queue->sq_ring != MAP_FAILED)
+        munmap(queue->sq_ring, queue->sq_ring_size);
+
+    close(queue->fd);
+    free(queue);
+}
+
+bool OS_ReadQueuePush(os_read_queue_t *queue, i64 file, void *buffer, u32 size, u64 offset, u64 tag)
+{
+    if (queue->in_flight >= queue->depth)
+        return false;
+
+    /* only this thread writes the tail; the kernel reads it */
+    u32 tail = atomic_load_explicit(queue->sq_tail, memory_order_relaxed);
+    u32 index = tail & queue->sq_mask;
+
+    struct io_uring_sqe *sqe = &queue->sqes[index];
+    MemoryZeroItem(sqe);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = (int)file;
+    sqe->addr = (u64)(uintptr_t)buffer;
+    sqe->len = size;
+    sqe->off = offset;
+    sqe->user_data = tag;
+
+    queue->sq_array[index] = index;
+    atomic_store_explicit(queue->sq_tail, tail + 1, memory_order_release);
+
+    queue->in_flight++;
+    queue->unsubmitted++;
+    return true;
+}
+
+bool OS_ReadQueueSubmit(os_read_queue_t *queue)
+{
+    while (queue->unsubmitted > 0)
+    {
+        int submitted = io_uring_enter(queue->fd, queue->unsubmitted, 0, 0);
+        if (submitted < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+
+            /* the kernel hasn't consumed the last unsubmitted entries; take
+               them back off the ring so they neither run later nor count as
+               in flight */
+            u32 tail = atomic_load_explicit(queue->sq_tail, memory_order_relaxed);
+            atomic_store_explicit(queue->sq_tail, tail - queue->unsubmitted, memory_order_release);
+            queue->in_flight -= queue->unsubmitted;
+            queue->unsubmitted = 0;
+            return false;
+        }
+        queue->unsubmitted -= (u32)submitted;
+    }
+
+    return true;
+}
+
+bool OS_ReadQueuePop(os_read_queue_t *queue, bool wait, u64 *tag_out, i64 *result_out)
+{
+    if (queue->in_flight == 0)
+        return false;
+
+    OS_ReadQueueSubmit(queue);
+
+    for (;;)
+    {
+        u32 head = atomic_load_explicit(queue->cq_head, memory_order_relaxed);
+        u32 tail = atomic_load_explicit(queue->cq_tail, memory_order_acquire);
+        if (head != tail)
+        {
+            struct io_uring_cqe *cqe = &queue->cqes[head & queue->cq_mask];
+            *tag_out = cqe->user_data;
+            *result_out = cqe->res;
+            atomic_store_explicit(queue->cq_head, head + 1, memory_order_release);
+
+            queue->in_flight--;
+            return true;
+        }
+
+        if (!wait)
+            return false;
+
+        if (io_uring_enter(queue->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+            return false;
+    }
+}
+
+static int io_uring_setup(u32 entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, u32 to_submit, u32 min_complete, u32 flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
@@ -0,0 +1,171 @@
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "os_file.h"
+
+bool OS_FileMap(const char *path, const u8 **data_out, u64 *size_out)
+{
+    i64 file;
+    u64 size;
+    if (!OS_FileOpen(path, &file, &size))
+        return false;
+
+    *data_out = NULL;
+    *size_out = size;
+
+    /* empty files can't be mapped */
+    if (size == 0)
+    {
+        OS_FileClose(file);
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA((HANDLE)(intptr_t)file, NULL, PAGE_READONLY, 0, 0, NULL);
+    OS_FileClose(file);
+    if (!mapping)
+        return false;
+
+    /* the view keeps the mapping and file alive */
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data)
+        return false;
+
+    WIN32_MEMORY_RANGE_ENTRY range = {.VirtualAddress = data, .NumberOfBytes = size};
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+
+    *data_out = data;
+    return true;
+}
+
+void OS_FileUnmap(const u8 *data, u64 size)
+{
+    (void)size;
+    if (data)
+        UnmapViewOfFile(data);
+}
+
+bool OS_FileOpen(const char *path, i64 *file_out, u64 *size_out)
+{
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    *file_out = (i64)(intptr_t)file;
+    *size_out = (u64)size.QuadPart;
+    return true;
+}
+
+void OS_FileClose(i64 file)
+{
+    CloseHandle((HANDLE)(intptr_t)file);
+}
+
+bool OS_FileReadAt(i64 file, void *buffer, u64 size, u64 offset)
+{
+    u8 *dst = buffer;
+    while (size > 0)
+    {
+        DWORD chunk = (DWORD)Min(size, (u64)1 << 30);
+        OVERLAPPED overlapped = {
+            .Offset = (DWORD)offset,
+            .OffsetHigh = (DWORD)(offset >> 32),
+        };
+
+        DWORD n = 0;
+        if (!ReadFile((HANDLE)(intptr_t)file, dst, chunk, &n, &overlapped) || n == 0)
+            return false;
+
+        dst += n;
+        size -= n;
+        offset += n;
+    }
+
+    return true;
+}
+
+bool OS_FileWrite(const char *path, const void *data, u64 size)
+{
+    /* unique per writer, so concurrent writes of one path don't share it */
+    static _Atomic u32 s_temp_counter;
+    char temp_path[MAX_PATH];
+    int length = snprintf(temp_path, sizeof(temp_path), "%s.%lu.%u.tmp", path, GetCurrentProcessId(),
+                          atomic_fetch_add(&s_temp_counter, 1));
+    if (length < 0 || (u64)length >= sizeof(temp_path))
+        return false;
+
+    HANDLE file = CreateFileA(temp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    const u8 *src = data;
+    while (size > 0)
+    {
+        DWORD chunk = (DWORD)Min(size, (u64)1 << 30);
+        DWORD n = 0;
+        if (!WriteFile(file, src, chunk, &n, NULL) || n == 0)
+            break;
+
+        src += n;
+        size -= n;
+    }
+
+    bool result = CloseHandle(file) && size == 0 && MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING);
+    if (!result)
+        DeleteFileA(temp_path);
+    return result;
+}
+
+bool OS_DirectoryCreate(const char *path)
+{
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+/* no queue backend yet; callers read with OS_FileReadAt */
+os_read_queue_t *OS_ReadQueueCreate(u32 depth)
+{
+    (void)depth;
+    return NULL;
+}
+
+void OS_ReadQueueDestroy(os_read_queue_t *queue)
+{
+    (void)queue;
+}
+
+bool OS_ReadQueuePush(os_read_queue_t *queue, i64 file, void *buffer, u32 size, u64 offset, u64 tag)
+{
+    (void)queue;
+    (void)file;
+    (void)buffer;
+    (void)size;
+    (void)offset;
+    (void)tag;
+    return false;
+}
+
+bool OS_ReadQueueSubmit(os_read_queue_t *queue)
+{
+    (void)queue;
+    return true;
+}
+
+bool OS_ReadQueuePop(os_read_queue_t *queue, bool wait, u64 *tag_out, i64 *result_out)
+{
+    (void)queue;
+    (void)wait;
+    (void)tag_out;
+    (void)result_out;
+    return false;
+}
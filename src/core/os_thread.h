@@ -0,0 +1,26 @@
+#ifndef OS_THREAD_H
+#define OS_THREAD_H
+
+#include "core.h"
+
+typedef struct _os_thread_t     os_thread_t;
+typedef struct _os_semaphore_t  os_semaphore_t;
+
+typedef void (*os_thread_fn_t)(void *user);
+
+/* logical processors available to the process */
+u32 OS_CpuCount(void);
+
+os_thread_t *OS_ThreadCreate(os_thread_fn_t fn, void *user);
+
+/* waits for the thread to return and frees it */
+void OS_ThreadJoin(os_thread_t *thread);
+
+void OS_ThreadYield(void);
+
+os_semaphore_t *OS_SemaphoreCreate(u32 initial_count);
+void OS_SemaphoreDestroy(os_semaphore_t *semaphore);
+void OS_SemaphoreSignal(os_semaphore_t *semaphore, u32 count);
+void OS_SemaphoreWait(os_semaphore_t *semaphore);
+
+#endif
@@ -0,0 +1,102 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "os_thread.h"
+
+struct _os_thread_t
+{
+    pthread_t       handle;
+    os_thread_fn_t  fn;
+    void            *user;
+};
+
+struct _os_semaphore_t
+{
+    sem_t           handle;
+};
+
+static void *thread_main(void *arg);
+
+u32 OS_CpuCount(void)
+{
+    /* respects affinity masks, e.g. taskset or container cpu sets */
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        return (u32)CPU_COUNT(&set);
+
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (u32)count : 1;
+}
+
+os_thread_t *OS_ThreadCreate(os_thread_fn_t fn, void *user)
+{
+    os_thread_t *thread = malloc(sizeof(os_thread_t));
+    if (!thread)
+        return NULL;
+
+    thread->fn = fn;
+    thread->user = user;
+
+    if (pthread_create(&thread->handle, NULL, thread_main, thread) != 0)
+    {
+        free(thread);
+        return NULL;
+    }
+
+    return thread;
+}
+
+void OS_ThreadJoin(os_thread_t *thread)
+{
+    pthread_join(thread->handle, NULL);
+    free(thread);
+}
+
+void OS_ThreadYield(void)
+{
+    sched_yield();
+}
+
+os_semaphore_t *OS_SemaphoreCreate(u32 initial_count)
+{
+    os_semaphore_t *semaphore = malloc(sizeof(os_semaphore_t));
+    if (!semaphore)
+        return NULL;
+
+    if (sem_init(&semaphore->handle, 0, initial_count) != 0)
+    {
+        free(semaphore);
+        return NULL;
+    }
+
+    return semaphore;
+}
+
+void OS_SemaphoreDestroy(os_semaphore_t *semaphore)
+{
+    sem_destroy(&semaphore->handle);
+    free(semaphore);
+}
+
+void OS_SemaphoreSignal(os_semaphore_t *semaphore, u32 count)
+{
+    for (u32 i = 0; i < count; i++)
+        sem_post(&semaphore->handle);
+}
+
+void OS_SemaphoreWait(os_semaphore_t *semaphore)
+{
+    while (sem_wait(&semaphore->handle) != 0)
+        ;
+}
+
+static void *thread_main(void *arg)
+{
+    os_thread_t *thread = arg;
+    thread->fn(thread->user);
+    return NULL;
+}
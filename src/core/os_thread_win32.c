@@ -0,0 +1,96 @@
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <stdlib.h>
+
+#include "os_thread.h"
+
+struct _os_thread_t
+{
+    HANDLE          handle;
+    os_thread_fn_t  fn;
+    void            *user;
+};
+
+struct _os_semaphore_t
+{
+    HANDLE          handle;
+};
+
+static DWORD WINAPI thread_main(LPVOID arg);
+
+u32 OS_CpuCount(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? (u32)info.dwNumberOfProcessors : 1;
+}
+
+os_thread_t *OS_ThreadCreate(os_thread_fn_t fn, void *user)
+{
+    os_thread_t *thread = malloc(sizeof(os_thread_t));
+    if (!thread)
+        return NULL;
+
+    thread->fn = fn;
+    thread->user = user;
+    thread->handle = CreateThread(NULL, 0, thread_main, thread, 0, NULL);
+    if (!thread->handle)
+    {
+        free(thread);
+        return NULL;
+    }
+
+    return thread;
+}
+
+void OS_ThreadJoin(os_thread_t *thread)
+{
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    free(thread);
+}
+
+void OS_ThreadYield(void)
+{
+    SwitchToThread();
+}
+
+os_semaphore_t *OS_SemaphoreCreate(u32 initial_count)
+{
+    os_semaphore_t *semaphore = malloc(sizeof(os_semaphore_t));
+    if (!semaphore)
+        return NULL;
+
+    semaphore->handle = CreateSemaphoreA(NULL, (LONG)initial_count, MAXLONG, NULL);
+    if (!semaphore->handle)
+    {
+        free(semaphore);
+        return NULL;
+    }
+
+    return semaphore;
+}
+
+void OS_SemaphoreDestroy(os_semaphore_t *semaphore)
+{
+    CloseHandle(semaphore->handle);
+    free(semaphore);
+}
+
+void OS_SemaphoreSignal(os_semaphore_t *semaphore, u32 count)
+{
+    if (count)
+        ReleaseSemaphore(semaphore->handle, (LONG)count, NULL);
+}
+
+void OS_SemaphoreWait(os_semaphore_t *semaphore)
+{
+    WaitForSingleObject(semaphore->handle, INFINITE);
+}
+
+static DWORD WINAPI thread_main(LPVOID arg)
+{
+    os_thread_t *thread = arg;
+    thread->fn(thread->user);
+    return 0;
+}
@@ -0,0 +1,387 @@
+#include "profiler.h"
+
+#ifdef PROFILER_ENABLED
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "log.h"
+#include "memory_arena.h"
+#include "os_time.h"
+
+#define MAX_PROFILE_THREADS     64
+#define MAX_CAPTURE_FRAMES      1024
+#define EVENTS_PER_CHUNK        4096
+#define MAX_CAPTURE_PATH        256
+#define MAX_GPU_ZONES           16384
+#define GPU_ZONE_NAME_LEN       32
+#define GPU_TRACK_TID           MAX_PROFILE_THREADS
+
+typedef struct
+{
+    const char *name;
+    u64         start;
+    u64         end;
+} profile_event_t;
+
+typedef struct
+{
+    char        name[GPU_ZONE_NAME_LEN];
+    u64         start_ns;
+    u64         end_ns;
+} gpu_zone_t;
+
+/* appended to by the owning thread only; count and next are published with
+   release stores so the capture dump can walk a thread's buffer while that
+   thread keeps recording */
+typedef struct _profile_chunk_t profile_chunk_t;
+struct _profile_chunk_t
+{
+    profile_chunk_t *_Atomic    next;
+    _Atomic u32                 count;
+    profile_event_t             events[EVENTS_PER_CHUNK];
+};
+
+typedef struct _profile_thread_t profile_thread_t;
+struct _profile_thread_t
+{
+    arena_t                     *arena;
+    const char                  *name;
+    u32                         tid;
+    u64                         events_pos;     /* arena position the chunks start at */
+
+    _Atomic u32                 generation;     /* capture the chunks belong to */
+    profile_chunk_t *_Atomic    first;
+    profile_chunk_t             *current;
+};
+
+typedef struct
+{
+    profile_thread_t *_Atomic threads[MAX_PROFILE_THREADS];
+    _Atomic u32     thread_count;
+
+    /* bumped per capture; threads drop their old events lazily when they
+       notice, so no other thread ever touches a buffer it doesn't own */
+    _Atomic u32     generation;
+    _Atomic bool    capturing;
+
+    // main thread only
+    u32             frames_requested;
+    u32             frames_captured;
+    u64             frame_ticks[MAX_CAPTURE_FRAMES + 1];
+    char            path[MAX_CAPTURE_PATH];
+
+    /* gpu results arrive a few frames late, already in ns */
+    gpu_zone_t      *gpu_zones;
+    u32             gpu_zone_count;
+
+    u64             calibration_ticks;
+    u64             calibration_ns;
+} profiler_t;
+
+static profiler_t s_profiler = {};
+static _Thread_local profile_thread_t *t_thread = NULL;
+
+static inline u64 read_ticks(void);
+static profile_thread_t *get_thread(void);
+static void push_event(profile_thread_t *thread, const char *name, u64 start, u64 end);
+static void write_capture(void);
+
+void Profiler_Init(void)
+{
+    s_profiler.calibration_ticks = read_ticks();
+    s_profiler.calibration_ns = OS_TimeNowNs();
+
+    Profiler_SetThreadName("main");
+}
+
+void Profiler_Destroy(void)
+{
+    free(s_profiler.gpu_zones);
+    s_profiler.gpu_zones = NULL;
+
+    u32 thread_count = atomic_load(&s_profiler.thread_count);
+    for (u32 i = 0; i < thread_count; i++)
+    {
+        profile_thread_t *thread = atomic_load(&s_profiler.threads[i]);
+        if (thread)
+            MemoryArena_Destroy(thread->arena);
+        atomic_store(&s_profiler.threads[i], NULL);
+    }
+
+    atomic_store(&s_profiler.thread_count, 0);
+    t_thread = NULL;
+}
+
+void Profiler_SetThreadName(const char *name)
+{
+    profile_thread_t *thread = get_thread();
+    if (thread)
+        thread->name = name;
+}
+
+void Profiler_FrameMark(void)
+{
+    profiler_t *profiler = &s_profiler;
+
+    if (!atomic_load_explicit(&profiler->capturing, memory_order_relaxed))
+    {
+        if (profiler->frames_requested == 0)
+            return;
+
+        /* armed: start on this frame boundary */
+        profiler->frames_captured = 0;
+        profiler->gpu_zone_count = 0;
+        profiler->frame_ticks[0] = read_ticks();
+        atomic_fetch_add_explicit(&profiler->generation, 1, memory_order_relaxed);
+        atomic_store_explicit(&profiler->capturing, true, memory_order_release);
+        return;
+    }
+
+    profiler->frame_ticks[++profiler->frames_captured] = read_ticks();
+    if (profiler->frames_captured < profiler->frames_requested)
+        return;
+
+    atomic_store_explicit(&profiler->capturing, false, memory_order_release);
+    profiler->frames_requested = 0;
+
+    write_capture();
+}
+
+bool Profiler_Capture(u32 frame_count, const char *path)
+{
+    profiler_t *profiler = &s_profiler;
+
+    if (Profiler_IsCapturing() || profiler->frames_requested > 0)
+    {
+        Log(WARNING, "profiler capture already running");
+        return false;
+    }
+
+    u64 path_length = MemoryStrlen(path);
+    if (frame_count == 0 || path_length >= MAX_CAPTURE_PATH)
+    {
+        Log(ERROR, "invalid profiler capture request");
+        return false;
+    }
+
+    MemoryCopy(profiler->path, path, path_length + 1);
+    profiler->frames_requested = Min(frame_count, (u32)MAX_CAPTURE_FRAMES);
+
+    Log(INFO, "profiler capture armed: %u frames to %s", profiler->frames_requested, path);
+    return true;
+}
+
+bool Profiler_IsCapturing(void)
+{
+    return atomic_load_explicit(&s_profiler.capturing, memory_order_relaxed);
+}
+
+void Profiler_AddGpuZone(const char *name, u64 start_ns, u64 end_ns)
+{
+    profiler_t *profiler = &s_profiler;
+
+    if (!Profiler_IsCapturing() || profiler->gpu_zone_count == MAX_GPU_ZONES)
+        return;
+
+    if (!profiler->gpu_zones)
+        profiler->gpu_zones = malloc(MAX_GPU_ZONES * sizeof(gpu_zone_t));
+
+    gpu_zone_t *zone = &profiler->gpu_zones[profiler->gpu_zone_count++];
+    snprintf(zone->name, GPU_ZONE_NAME_LEN, "%s", name);
+    zone->start_ns = start_ns;
+    zone->end_ns = end_ns;
+}
+
+profile_zone_t Profiler_BeginZone(const char *name)
+{
+    return (profile_zone_t){
+        .name = name,
+        .start = read_ticks(),
+    };
+}
+
+void Profiler_EndZone(profile_zone_t *zone)
+{
+    if (Likely(!atomic_load_explicit(&s_profiler.capturing, memory_order_relaxed)))
+        return;
+
+    u64 end = read_ticks();
+
+    profile_thread_t *thread = get_thread();
+    if (thread)
+        push_event(thread, zone->name, zone->start, end);
+}
+
+static inline u64 read_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return OS_TimeNowNs();
+#endif
+}
+
+static profile_thread_t *get_thread(void)
+{
+    if (Likely(t_thread != NULL))
+        return t_thread;
+
+    u32 tid = atomic_fetch_add(&s_profiler.thread_count, 1);
+    if (tid >= MAX_PROFILE_THREADS)
+    {
+        atomic_fetch_sub(&s_profiler.thread_count, 1);
+        return NULL;
+    }
+
+    arena_t *arena = MemoryArena_CreateP("profiler-thread",
+        (arena_params_t){.reserve_size = MB(64), .commit_size = KB(256)});
+
+    profile_thread_t *thread = arena_push(arena, profile_thread_t);
+    thread->arena = arena;
+    thread->tid = tid;
+    thread->name = "worker";
+    thread->generation = U32_MAX;
+    thread->events_pos = MemoryArena_Pos(arena);
+
+    atomic_store_explicit(&s_profiler.threads[tid], thread, memory_order_release);
+    t_thread = thread;
+
+    return thread;
+}
+
+static void push_event(profile_thread_t *thread, const char *name, u64 start, u64 end)
+{
+    u32 generation = atomic_load_explicit(&s_profiler.generation, memory_order_relaxed);
+    if (thread->generation != generation)
+    {
+        /* a new capture started: drop the previous one's events */
+        atomic_store_explicit(&thread->first, NULL, memory_order_release);
+        MemoryArena_PopTo(thread->arena, thread->events_pos);
+        thread->current = NULL;
+        thread->generation = generation;
+    }
+
+    profile_chunk_t *chunk = thread->current;
+    u32 count = chunk ? atomic_load_explicit(&chunk->count, memory_order_relaxed) : 0;
+
+    if (!chunk || count == EVENTS_PER_CHUNK)
+    {
+        profile_chunk_t *next = arena_push_no_zero(thread->arena, profile_chunk_t);
+        atomic_init(&next->next, NULL);
+        atomic_init(&next->count, 0);
+
+        if (chunk)
+            atomic_store_explicit(&chunk->next, next, memory_order_release);
+        else
+            atomic_store_explicit(&thread->first, next, memory_order_release);
+
+        thread->current = chunk = next;
+        count = 0;
+    }
+
+    chunk->events[count] = (profile_event_t){
+        .name = name,
+        .start = start,
+        .end = end,
+    };
+    atomic_store_explicit(&chunk->count, count + 1, memory_order_release);
+}
+
+static void write_capture(void)
+{
+    profiler_t *profiler = &s_profiler;
+
+    FILE *file = fopen(profiler->path, "w");
+    if (!file)
+    {
+        Log(ERROR, "failed to open profiler capture: %s", profiler->path);
+        return;
+    }
+
+    /* ticks are converted against the calibration taken at init, which
+       also covers rdtsc whose rate isn't known up front */
+    u64 now_ticks = read_ticks();
+    u64 now_ns = OS_TimeNowNs();
+    f64 ns_per_tick = now_ticks > profiler->calibration_ticks
+        ? (f64)(now_ns - profiler->calibration_ns) / (f64)(now_ticks - profiler->calibration_ticks)
+        : 1.0;
+
+    u64 base = profiler->frame_ticks[0];
+#define TICKS_TO_US(ticks) ((f64)((i64)(ticks) - (i64)base) * ns_per_tick / 1000.0)
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+    fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"dcfs\"}}", file);
+
+    u64 event_count = 0;
+    u32 thread_count = Min(atomic_load(&profiler->thread_count), (u32)MAX_PROFILE_THREADS);
+    u32 generation = atomic_load(&profiler->generation);
+
+    for (u32 i = 0; i < thread_count; i++)
+    {
+        profile_thread_t *thread = atomic_load_explicit(&profiler->threads[i], memory_order_acquire);
+        if (!thread)
+            continue;
+
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                thread->tid, thread->name);
+
+        /* a thread that recorded nothing this capture still holds the
+           previous capture's chunks */
+        if (thread->generation != generation)
+            continue;
+
+        profile_chunk_t *chunk = atomic_load_explicit(&thread->first, memory_order_acquire);
+        for (; chunk; chunk = atomic_load_explicit(&chunk->next, memory_order_acquire))
+        {
+            u32 count = atomic_load_explicit(&chunk->count, memory_order_acquire);
+            for (u32 e = 0; e < count; e++)
+            {
+                /* zones open when the capture started are cut at its start */
+                const profile_event_t *event = &chunk->events[e];
+                u64 start = Max(event->start, base);
+                u64 end = Max(event->end, start);
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                        event->name, thread->tid, TICKS_TO_US(start),
+                        (f64)(end - start) * ns_per_tick / 1000.0);
+            }
+            event_count += count;
+        }
+    }
+
+    /* gpu zones are in OS_TimeNowNs time; place them via the same calibration */
+    if (profiler->gpu_zone_count > 0)
+    {
+        f64 base_ns = (f64)profiler->calibration_ns +
+                      (f64)((i64)base - (i64)profiler->calibration_ticks) * ns_per_tick;
+
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}",
+                GPU_TRACK_TID);
+
+        for (u32 i = 0; i < profiler->gpu_zone_count; i++)
+        {
+            const gpu_zone_t *zone = &profiler->gpu_zones[i];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    zone->name, GPU_TRACK_TID, ((f64)zone->start_ns - base_ns) / 1000.0,
+                    (f64)(zone->end_ns - zone->start_ns) / 1000.0);
+        }
+        event_count += profiler->gpu_zone_count;
+    }
+
+    for (u32 i = 0; i <= profiler->frames_captured; i++)
+    {
+        fprintf(file, ",\n{\"name\":\"frame\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}",
+                TICKS_TO_US(profiler->frame_ticks[i]));
+    }
+
+#undef TICKS_TO_US
+
+    fputs("\n]}\n", file);
+    fclose(file);
+
+    Log(INFO, "profiler capture written: %s (%u frames, %u zones)", profiler->path,
+        profiler->frames_captured, (u32)event_count);
+}
+
+#endif
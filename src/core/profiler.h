@@ -0,0 +1,60 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "core.h"
+
+/* zone profiler, built with -Dprofiler=true. zones are recorded only while
+   a capture runs: Profiler_Capture arms it, the capture starts at the next
+   frame mark and after frame_count frames the events of every thread are
+   written to path as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+   each thread appends to its own buffer, so recording takes no locks.
+   without PROFILER_ENABLED the zone macros expand to nothing */
+
+#ifdef PROFILER_ENABLED
+
+typedef struct
+{
+    const char *name;
+    u64         start;
+} profile_zone_t;
+
+void Profiler_Init(void);
+void Profiler_Destroy(void);
+
+/* names the calling thread's track in the trace */
+void Profiler_SetThreadName(const char *name);
+
+void Profiler_FrameMark(void);
+
+bool Profiler_Capture(u32 frame_count, const char *path);
+bool Profiler_IsCapturing(void);
+
+/* name must outlive the capture; string literals in practice */
+profile_zone_t Profiler_BeginZone(const char *name);
+void Profiler_EndZone(profile_zone_t *zone);
+
+/* a zone on the GPU track, times in OS_TimeNowNs nanoseconds; name is
+   copied. dropped unless a capture is running */
+void Profiler_AddGpuZone(const char *name, u64 start_ns, u64 end_ns);
+
+/* closes when the enclosing scope exits, including through goto/return */
+#define ProfileZone(name) \
+    profile_zone_t Glue(__profile_zone_, __LINE__) \
+        __attribute__((cleanup(Profiler_EndZone))) = Profiler_BeginZone(name)
+#define ProfileFrameMark() Profiler_FrameMark()
+
+#else
+
+static inline void Profiler_Init(void) {}
+static inline void Profiler_Destroy(void) {}
+static inline void Profiler_SetThreadName(const char *name) { (void)name; }
+static inline bool Profiler_Capture(u32 frame_count, const char *path) { (void)frame_count; (void)path; return false; }
+static inline bool Profiler_IsCapturing(void) { return false; }
+static inline void Profiler_AddGpuZone(const char *name, u64 start_ns, u64 end_ns) { (void)name; (void)start_ns; (void)end_ns; }
+
+#define ProfileZone(name)
+#define ProfileFrameMark()
+
+#endif
+
+#endif
@@ -0,0 +1,191 @@
+#include <stdio.h>
+
+#include "log.h"
+#include "lz4.h"
+#include "os_file.h"
+#include "os_path.h"
+#include "profiler.h"
+#include "vfs.h"
+
+#include "xxh3.h"
+
+#define MAX_PATH_LENGTH 512
+
+typedef struct
+{
+    const u8                    *data;
+    u64                         size;
+
+    const vfs_archive_entry_t   *entries;
+    u32                         entry_count;
+} vfs_t;
+
+static vfs_t s_vfs = {};
+
+static const vfs_archive_entry_t *find_entry(u64 hash);
+static bool open_entry(arena_t *arena, const char *path, const vfs_archive_entry_t *entry, vfs_file_t *file_out);
+
+bool Vfs_Mount(const char *archive_path)
+{
+    Assert(s_vfs.data == NULL);
+
+    const u8 *data;
+    u64 size;
+    if (!OS_FileMap(archive_path, &data, &size))
+    {
+        Log(INFO, "no asset archive at %s, using loose files", archive_path);
+        return false;
+    }
+
+    vfs_archive_header_t header;
+    if (size < sizeof(header))
+        goto fail;
+    MemoryCopy(&header, data, sizeof(header));
+    if (header.magic != VFS_ARCHIVE_MAGIC || header.version != VFS_ARCHIVE_VERSION)
+        goto fail;
+
+    u64 toc_end = sizeof(header) + (u64)header.entry_count * sizeof(vfs_archive_entry_t);
+    if (toc_end > size)
+        goto fail;
+
+    /* checked once here so lookups can trust the table */
+    const vfs_archive_entry_t *entries = (const vfs_archive_entry_t *)(data + sizeof(header));
+    for (u32 i = 0; i < header.entry_count; i++)
+    {
+        const vfs_archive_entry_t *entry = &entries[i];
+        if (entry->offset < toc_end || entry->offset > size || entry->size > size - entry->offset)
+            goto fail;
+        if (entry->compression == VFS_COMPRESSION_NONE && entry->size != entry->raw_size)
+            goto fail;
+        if (entry->compression > VFS_COMPRESSION_LZ4)
+            goto fail;
+        if (i > 0 && entries[i - 1].hash >= entry->hash)
+            goto fail;
+    }
+
+    s_vfs = (vfs_t){
+        .data = data,
+        .size = size,
+        .entries = entries,
+        .entry_count = header.entry_count,
+    };
+
+    Log(INFO, "mounted asset archive %s: %u entries, %.2f MB", archive_path, header.entry_count,
+        (f64)size / (f64)MB(1));
+    return true;
+
+fail:
+    Log(ERROR, "invalid asset archive %s, using loose files", archive_path);
+    OS_FileUnmap(data, size);
+    return false;
+}
+
+void Vfs_Unmount(void)
+{
+    OS_FileUnmap(s_vfs.data, s_vfs.size);
+    MemoryZeroItem(&s_vfs);
+}
+
+bool Vfs_Open(arena_t *arena, const char *path, vfs_file_t *file_out)
+{
+    ProfileZone("Vfs_Open");
+    MemoryZeroItem(file_out);
+
+    const vfs_archive_entry_t *entry = find_entry(Vfs_HashPath(path));
+    if (entry)
+        return open_entry(arena, path, entry, file_out);
+
+    char full_path[MAX_PATH_LENGTH];
+    snprintf(full_path, sizeof(full_path), "%s%s", OS_GetBasePath(), path);
+
+    if (!File_Map(full_path, &file_out->map))
+        return false;
+
+    file_out->data = file_out->map.data;
+    file_out->size = file_out->map.size;
+    file_out->format = Vfs_FormatFromPath(path);
+    return true;
+}
+
+void Vfs_Close(vfs_file_t *file)
+{
+    File_Unmap(&file->map);
+    MemoryZeroItem(file);
+}
+
+vfs_format_t Vfs_FormatFromPath(const char *path)
+{
+    static const struct
+    {
+        const char      *extension;
+        vfs_format_t    format;
+    } formats[] = {
+        {".spv", VFS_FORMAT_SPIRV},
+        {".png", VFS_FORMAT_PNG},
+        {".obj", VFS_FORMAT_OBJ},
+        {".frog", VFS_FORMAT_FROG},
+    };
+
+    u64 length = MemoryStrlen(path);
+    for (u32 i = 0; i < ArrayCount(formats); i++)
+    {
+        u64 extension_length = MemoryStrlen(formats[i].extension);
+        if (length >= extension_length && MemoryMatch(path + length - extension_length, formats[i].extension,
+                                                      extension_length))
+            return formats[i].format;
+    }
+
+    return VFS_FORMAT_BLOB;
+}
+
+u64 Vfs_HashPath(const char *path)
+{
+    return XXH3_64bits(path, MemoryStrlen(path));
+}
+
+static const vfs_archive_entry_t *find_entry(u64 hash)
+{
+    u32 first = 0;
+    u32 count = s_vfs.entry_count;
+    while (count > 0)
+    {
+        u32 half = count / 2;
+        if (s_vfs.entries[first + half].hash < hash)
+        {
+            first += half + 1;
+            count -= half + 1;
+        }
+        else
+        {
+            count = half;
+        }
+    }
+
+    if (first < s_vfs.entry_count && s_vfs.entries[first].hash == hash)
+        return &s_vfs.entries[first];
+    return NULL;
+}
+
+static bool open_entry(arena_t *arena, const char *path, const vfs_archive_entry_t *entry, vfs_file_t *file_out)
+{
+    const u8 *stored = s_vfs.data + entry->offset;
+    file_out->size = entry->raw_size;
+    file_out->format = (vfs_format_t)entry->format;
+
+    if (entry->compression == VFS_COMPRESSION_NONE)
+    {
+        file_out->data = stored;
+        return true;
+    }
+
+    u8 *data = arena_push_array_no_zero(arena, u8, entry->raw_size);
+    if (!Lz4_Decompress(stored, entry->size, data, entry->raw_size))
+    {
+        Log(ERROR, "corrupt archive entry: %s", path);
+        MemoryZeroItem(file_out);
+        return false;
+    }
+
+    file_out->data = data;
+    return true;
+}
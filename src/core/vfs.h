@@ -0,0 +1,85 @@
+#ifndef VFS_H
+#define VFS_H
+
+#include "core.h"
+#include "file.h"
+#include "memory_arena.h"
+
+/* resource lookup through a packed asset archive, falling back to loose
+   files. paths are relative to the executable directory, '/' separated,
+   e.g. "shaders/tile.vert.spv". the archive is mapped once on mount and
+   entries are served straight from the mapping; mount and unmount on the
+   main thread, lookups are safe from any thread in between */
+
+#define VFS_ARCHIVE_NAME    "assets.pak"
+
+typedef enum
+{
+    VFS_FORMAT_BLOB,
+    VFS_FORMAT_SPIRV,
+    VFS_FORMAT_PNG,
+    VFS_FORMAT_OBJ,
+    VFS_FORMAT_FROG,
+} vfs_format_t;
+
+typedef struct
+{
+    const u8        *data;
+    u64             size;
+    vfs_format_t    format;
+
+    file_map_t      map;    /* loose files only */
+} vfs_file_t;
+
+/* false, leaving loose files as the only source, if the archive is missing
+   or damaged */
+bool Vfs_Mount(const char *archive_path);
+void Vfs_Unmount(void);
+
+/* the archive entry for path, else the loose file. stored entries cost no
+   copy; compressed ones are decompressed onto arena. data stays valid until
+   Vfs_Close, which releases nothing on arena */
+bool Vfs_Open(arena_t *arena, const char *path, vfs_file_t *file_out);
+void Vfs_Close(vfs_file_t *file);
+
+/* by file extension */
+vfs_format_t Vfs_FormatFromPath(const char *path);
+
+/*
+ * archive layout, written by tools/pack_assets.c. little endian:
+ *   header, entry_count entries sorted by hash, then the entry data.
+ *   stored entries start on a page boundary so they can be mapped or
+ *   handed to the gpu as is
+ */
+
+#define VFS_ARCHIVE_MAGIC   0x314B415053464344ull  /* "DCFSPAK1" */
+#define VFS_ARCHIVE_VERSION 1
+#define VFS_PAGE_ALIGN      4096u
+#define VFS_DATA_ALIGN      16u
+
+typedef enum
+{
+    VFS_COMPRESSION_NONE,
+    VFS_COMPRESSION_LZ4,
+} vfs_compression_t;
+
+typedef struct
+{
+    u64 magic;
+    u32 version;
+    u32 entry_count;
+} AttributePacked vfs_archive_header_t;
+
+typedef struct
+{
+    u64 hash;           /* XXH3_64bits of the path; unique within an archive */
+    u64 offset;
+    u64 size;           /* as stored */
+    u64 raw_size;
+    u32 format;         /* vfs_format_t */
+    u32 compression;    /* vfs_compression_t */
+} AttributePacked vfs_archive_entry_t;
+
+u64 Vfs_HashPath(const char *path);
+
+#endif
@@ -0,0 +1,476 @@
+#include <stdio.h>
+
+#include "core.h"
+#include "job.h"
+#include "log.h"
+#include "memory_arena.h"
+#include "os_time.h"
+#include "profiler.h"
+#include "vfs.h"
+
+#include "asset.h"
+#include "frog.h"
+#include "mesh_cache.h"
+#include "mesh_internal.h"
+#include "model_internal.h"
+#include "obj.h"
+#include "renderer.h"
+#include "texture_cache.h"
+
+#include "vulkan_texture.h"
+
+#define MAX_ASSETS          512
+#define MAX_RESOURCE_PATH   512
+
+/* upload data swapped in per Asset_Update; one load always goes through so
+   a single large asset still makes progress */
+#define UPLOAD_BUDGET       MB(32)
+
+typedef enum
+{
+    ASSET_TEXTURE,
+    ASSET_MESH,
+    ASSET_MODEL,
+} asset_type_t;
+
+typedef struct _asset_t asset_t;
+struct _asset_t
+{
+    asset_type_t        type;
+    asset_status_t      status;
+    char                path[MAX_RESOURCE_PATH];
+
+    asset_callback_t    callback;
+    void                *user;
+
+    /* the job owns everything below until the counter drops to zero */
+    job_counter_t       counter;
+    bool                decoded;
+    arena_t             *arena;         /* decoded cpu data, dropped once uploaded */
+    u64                 upload_bytes;
+
+    texture_handle_t    texture;
+    texture_flags_t     texture_flags;
+    texture_upload_t    texture_upload;
+
+    mesh_t              *mesh;
+    obj_mesh_data_t     obj;
+    file_map_t          cooked;         /* a cached obj points into it */
+
+    model_t             *model;
+    arena_t             *model_arena;   /* the loaded model's arrays; kept */
+    frog_model_data_t   frog;
+    vfs_file_t          file;           /* frog v2 vertex streams point into it */
+};
+
+typedef struct
+{
+    asset_t             *assets;
+    u32                 asset_count;
+
+    /* loads not swapped in yet, oldest first */
+    asset_id_t          pending[MAX_ASSETS];
+    u32                 pending_count;
+
+    sampler_handle_t    placeholder_sampler;
+    texture_handle_t    placeholder_texture;
+    mesh_handle_t       placeholder_cube;
+
+    /* what a loading model handle points at; shared by every load */
+    model_t             placeholder_model;
+    model_animation_t   placeholder_animation;
+    model_keyframe_t    placeholder_keyframe;
+} assets_t;
+
+static assets_t s_assets = {};
+
+extern arena_t *g_engine_arena;
+
+static bool has_room(void);
+static asset_t *create_asset(asset_type_t type, const char *path, asset_callback_t callback, void *user);
+static asset_t *get_asset(asset_id_t id);
+static void load_job(void *data);
+static bool decode_texture(asset_t *asset);
+static bool decode_mesh(asset_t *asset);
+static bool decode_model(asset_t *asset);
+static u32 upload_count(const asset_t *asset);
+static void finish_asset(asset_t *asset, bool deferred);
+static void release_asset(asset_t *asset);
+static void remove_pending(u32 index);
+
+bool Asset_Init(void)
+{
+    Assert(g_engine_arena != NULL);
+
+    s_assets.assets = arena_push_array(g_engine_arena, asset_t, MAX_ASSETS);
+
+    static const u8 white[4] = {0xff, 0xff, 0xff, 0xff};
+    s_assets.placeholder_sampler = Renderer_CreateSampler();
+    if (s_assets.placeholder_sampler == SAMPLER_HANDLE_INVALID)
+        return false;
+
+    s_assets.placeholder_texture = Renderer_CreateTexture(1, 1, white, s_assets.placeholder_sampler,
+                                                          TEXTURE_FLAG_NONE);
+    if (s_assets.placeholder_texture == TEXTURE_HANDLE_INVALID)
+        return false;
+
+    s_assets.placeholder_cube = MeshManager_GetPredefinedMesh(PREDEFINED_MESH_MATERIAL_CUBE);
+
+    s_assets.placeholder_keyframe.mesh = s_assets.placeholder_cube;
+    s_assets.placeholder_animation = (model_animation_t){
+        .name = string_lit("placeholder"),
+        .keyframe_count = 1,
+        .keyframes = &s_assets.placeholder_keyframe,
+    };
+    s_assets.placeholder_model = (model_t){
+        .animation_count = 1,
+        .animations = &s_assets.placeholder_animation,
+    };
+    s_assets.placeholder_model.animation_table_address =
+        Model_UploadAnimationTable(&s_assets.placeholder_model, false);
+    if (s_assets.placeholder_model.animation_table_address == 0)
+        return false;
+
+    Log(INFO, "Asset loader initialized");
+    return true;
+}
+
+void Asset_Destroy(void)
+{
+    for (u32 i = 0; i < s_assets.pending_count; i++)
+    {
+        asset_t *asset = get_asset(s_assets.pending[i]);
+        Job_Wait(&asset->counter);
+        release_asset(asset);
+    }
+
+    MemoryZeroItem(&s_assets);
+}
+
+void Asset_Update(void)
+{
+    ProfileZone("Asset_Update");
+    u64 budget = UPLOAD_BUDGET;
+    u32 finished = 0;
+
+    for (u32 i = 0; i < s_assets.pending_count;)
+    {
+        asset_t *asset = get_asset(s_assets.pending[i]);
+        if (!Job_IsDone(&asset->counter))
+        {
+            i++;
+            continue;
+        }
+
+        if (finished > 0 && (asset->upload_bytes > budget || upload_count(asset) > Renderer_GetUploadCapacity()))
+            break;
+
+        /* more buffers than a frame can take; only the first load of a frame
+           gets here, so blocking is the only way through */
+        bool deferred = upload_count(asset) <= Renderer_GetUploadCapacity();
+        finish_asset(asset, deferred);
+        remove_pending(i);
+
+        budget -= Min(budget, asset->upload_bytes);
+        finished++;
+    }
+}
+
+asset_id_t Asset_LoadTexture(const char *path, sampler_handle_t sampler, texture_flags_t flags,
+                             texture_handle_t *texture_out, asset_callback_t callback, void *user)
+{
+    *texture_out = TEXTURE_HANDLE_INVALID;
+
+    /* a texture slot can't be handed back, so the asset must fit first */
+    if (!has_room())
+        return ASSET_ID_INVALID;
+
+    texture_handle_t texture = VulkanTexture_CreatePending(s_assets.placeholder_texture, sampler);
+    if (texture == TEXTURE_HANDLE_INVALID)
+        return ASSET_ID_INVALID;
+
+    asset_t *asset = create_asset(ASSET_TEXTURE, path, callback, user);
+    asset->texture = texture;
+    asset->texture_flags = flags;
+    *texture_out = texture;
+
+    Job_Run(load_job, asset, &asset->counter);
+    return s_assets.asset_count;
+}
+
+asset_id_t Asset_LoadMesh(const char *path, mesh_handle_t placeholder, mesh_handle_t *mesh_out,
+                          asset_callback_t callback, void *user)
+{
+    *mesh_out = MESH_INVALID_HANDLE;
+
+    asset_t *asset = create_asset(ASSET_MESH, path, callback, user);
+    if (!asset)
+        return ASSET_ID_INVALID;
+
+    asset->mesh = arena_push(g_engine_arena, mesh_t);
+    if (placeholder != MESH_INVALID_HANDLE)
+        *asset->mesh = *placeholder;
+    *mesh_out = asset->mesh;
+
+    Job_Run(load_job, asset, &asset->counter);
+    return s_assets.asset_count;
+}
+
+asset_id_t Asset_LoadModel(const char *path, model_handle_t *model_out, asset_callback_t callback,
+                           void *user)
+{
+    *model_out = MODEL_INVALID_HANDLE;
+
+    asset_t *asset = create_asset(ASSET_MODEL, path, callback, user);
+    if (!asset)
+        return ASSET_ID_INVALID;
+
+    asset->model = arena_push(g_engine_arena, model_t);
+    *asset->model = s_assets.placeholder_model;
+    *model_out = asset->model;
+
+    Job_Run(load_job, asset, &asset->counter);
+    return s_assets.asset_count;
+}
+
+asset_status_t Asset_GetStatus(asset_id_t id)
+{
+    return get_asset(id)->status;
+}
+
+asset_status_t Asset_Wait(asset_id_t id)
+{
+    asset_t *asset = get_asset(id);
+
+    for (u32 i = 0; i < s_assets.pending_count; i++)
+    {
+        if (s_assets.pending[i] != id)
+            continue;
+
+        Job_Wait(&asset->counter);
+        finish_asset(asset, upload_count(asset) <= Renderer_GetUploadCapacity());
+        remove_pending(i);
+        break;
+    }
+
+    return asset->status;
+}
+
+void Asset_WaitAll(void)
+{
+    while (s_assets.pending_count > 0)
+        Asset_Wait(s_assets.pending[0]);
+}
+
+static bool has_room(void)
+{
+    if (s_assets.asset_count >= MAX_ASSETS)
+    {
+        Log(ERROR, "maximum number of assets reached");
+        return false;
+    }
+
+    return true;
+}
+
+static asset_t *create_asset(asset_type_t type, const char *path, asset_callback_t callback, void *user)
+{
+    if (!has_room())
+        return NULL;
+
+    asset_t *asset = &s_assets.assets[s_assets.asset_count++];
+    asset->type = type;
+    asset->status = ASSET_STATUS_PENDING;
+    asset->callback = callback;
+    asset->user = user;
+    snprintf(asset->path, sizeof(asset->path), "%s", path);
+
+    s_assets.pending[s_assets.pending_count++] = s_assets.asset_count;
+
+    return asset;
+}
+
+/* asset ids are 1-based indices so 0 stays the invalid id */
+static asset_t *get_asset(asset_id_t id)
+{
+    Assert(id != ASSET_ID_INVALID && id <= s_assets.asset_count);
+
+    return &s_assets.assets[id - 1];
+}
+
+static void load_job(void *data)
+{
+    ProfileZone("Asset_Load");
+    asset_t *asset = data;
+    u64 start_ns = OS_TimeNowNs();
+
+    switch (asset->type)
+    {
+        case ASSET_TEXTURE:
+            asset->decoded = decode_texture(asset);
+            break;
+        case ASSET_MESH:
+            asset->decoded = decode_mesh(asset);
+            break;
+        case ASSET_MODEL:
+            asset->decoded = decode_model(asset);
+            break;
+    }
+
+    if (asset->decoded)
+        Log(INFO, "decoded '%s' in %.2f ms", asset->path, (f64)(OS_TimeNowNs() - start_ns) / 1000000.0);
+}
+
+/* the image goes to the device right here: host image copy is safe off the
+   main thread, so only the descriptor write is left for Asset_Update */
+static bool decode_texture(asset_t *asset)
+{
+    asset->arena = MemoryArena_Create("asset-texture");
+
+    /* the mips are filtered and the blocks coded here too, off the main thread */
+    texture_data_t texture;
+    file_map_t map;
+    if (!TextureCache_Load(asset->arena, asset->path, asset->texture_flags, &texture, &map))
+        return false;
+
+    bool result = (VulkanTexture_IsFormatSupported(texture.format)
+                   || TextureCache_Decompress(asset->arena, &texture))
+        && VulkanTexture_Upload(&texture, &asset->texture_upload);
+    if (!result)
+        Log(ERROR, "failed to upload texture %s", asset->path);
+
+    File_Unmap(&map);
+    return result;
+}
+
+static bool decode_mesh(asset_t *asset)
+{
+    asset->arena = MemoryArena_Create("asset-mesh");
+
+    if (!MeshCache_LoadObj(asset->arena, asset->path, &asset->obj, &asset->cooked))
+        return false;
+
+    asset->upload_bytes =
+        asset->obj.vertex_data_size + (u64)asset->obj.index_count * INDEX_TYPE_SIZE(asset->obj.index_type);
+    return true;
+}
+
+static bool decode_model(asset_t *asset)
+{
+    asset->arena = MemoryArena_Create("asset-model-scratch");
+    asset->model_arena = MemoryArena_CreateP("asset-model", (arena_params_t){
+        .reserve_size = MB(1),
+        .commit_size = KB(64),
+    });
+
+    /* open until the upload, see Frog_Parse */
+    if (!Vfs_Open(asset->arena, asset->path, &asset->file))
+        return false;
+
+    if (!Frog_Parse(asset->model_arena, asset->arena, asset->file.data, asset->file.size, asset->path,
+                    &asset->frog))
+        return false;
+
+    asset->upload_bytes = Frog_UploadSize(&asset->frog);
+    return true;
+}
+
+/* deferred buffer uploads the asset needs */
+static u32 upload_count(const asset_t *asset)
+{
+    if (!asset->decoded)
+        return 0;
+
+    switch (asset->type)
+    {
+        case ASSET_MESH:
+            return 2;
+        case ASSET_MODEL:
+            return 3;   /* see Frog_Upload */
+        default:
+            return 0;
+    }
+}
+
+static void finish_asset(asset_t *asset, bool deferred)
+{
+    ProfileZone("finish_asset");
+    bool result = asset->decoded;
+
+    if (result)
+    {
+        switch (asset->type)
+        {
+            case ASSET_TEXTURE:
+                /* into a fresh slot; frames in flight keep sampling the
+                   placeholder through the pending one */
+                result = VulkanTexture_Fill(asset->texture, &asset->texture_upload);
+                break;
+
+            case ASSET_MESH:
+            {
+                const obj_mesh_data_t *obj = &asset->obj;
+                u32 stride = (u32)(obj->vertex_data_size / obj->vertex_count);
+                mesh_buffers_t buffers;
+                result = deferred
+                    ? Renderer_UploadMeshBuffers(obj->vertex_data, obj->vertex_count, stride, obj->indices,
+                                                 obj->index_count, obj->index_type, &buffers)
+                    : Renderer_CreateMeshBuffers(obj->vertex_data, obj->vertex_count, stride, obj->indices,
+                                                 obj->index_count, obj->index_type, &buffers);
+                if (result)
+                    MeshManager_SetObjMesh(asset->mesh, &buffers, obj);
+                break;
+            }
+
+            case ASSET_MODEL:
+                result = Frog_Upload(&asset->frog, deferred);
+                if (result)
+                    *asset->model = *asset->frog.model;
+                break;
+        }
+    }
+
+    /* a failed model keeps its placeholder, so its own arrays can go too */
+    if (!result && asset->model_arena)
+    {
+        MemoryArena_Destroy(asset->model_arena);
+        asset->model_arena = NULL;
+    }
+    if (asset->arena)
+    {
+        MemoryArena_Destroy(asset->arena);
+        asset->arena = NULL;
+    }
+    Vfs_Close(&asset->file);
+    File_Unmap(&asset->cooked);
+
+    asset->status = result ? ASSET_STATUS_READY : ASSET_STATUS_FAILED;
+    if (!result)
+        Log(ERROR, "failed to load asset %s", asset->path);
+
+    if (asset->callback)
+        asset->callback((asset_id_t)(asset - s_assets.assets) + 1, asset->status, asset->user);
+}
+
+/* shutdown: drops a finished load without swapping it in */
+static void release_asset(asset_t *asset)
+{
+    if (asset->type == ASSET_TEXTURE && asset->decoded)
+        VulkanTexture_Fill(asset->texture, &asset->texture_upload);
+
+    if (asset->arena)
+        MemoryArena_Destroy(asset->arena);
+    if (asset->model_arena)
+        MemoryArena_Destroy(asset->model_arena);
+    Vfs_Close(&asset->file);
+    File_Unmap(&asset->cooked);
+}
+
+static void remove_pending(u32 index)
+{
+    Assert(index < s_assets.pending_count);
+
+    s_assets.pending_count--;
+    for (u32 i = index; i < s_assets.pending_count; i++)
+        s_assets.pending[i] = s_assets.pending[i + 1];
+}
@@ -0,0 +1,63 @@
+#ifndef ASSET_H
+#define ASSET_H
+
+#include "core.h"
+#include "mesh.h"
+#include "model.h"
+#include "render_types.h"
+
+/* asynchronous asset loading. a load hands back a usable handle right away
+   and the real data takes its place once ready: textures sample a white
+   placeholder, meshes draw the given placeholder mesh (or nothing) and models
+   a unit cube. file i/o and decoding run as jobs; Asset_Update picks up the
+   finished loads on the main thread and queues their buffer uploads onto the
+   next frame's transfer submit. paths go through the vfs like the blocking
+   loaders, see Vfs_Open */
+
+#define ASSET_ID_INVALID 0
+
+typedef u32 asset_id_t;
+
+typedef enum
+{
+    ASSET_STATUS_PENDING,
+    ASSET_STATUS_READY,
+    ASSET_STATUS_FAILED,
+} asset_status_t;
+
+/* runs on the main thread, from Asset_Update or Asset_Wait */
+typedef void (*asset_callback_t)(asset_id_t id, asset_status_t status, void *user);
+
+bool Asset_Init(void);
+
+/* finishes the loads in progress without calling their callbacks */
+void Asset_Destroy(void);
+
+/* once a frame, before drawing: swaps in finished loads, a bounded amount
+   of upload data per frame */
+void Asset_Update(void);
+
+/* the handle is written before returning and stays valid, also if the load
+   fails; a failed load keeps its placeholder. callback is optional. returns
+   ASSET_ID_INVALID, with an invalid handle, if the load can't be started */
+asset_id_t Asset_LoadTexture(const char *path, sampler_handle_t sampler, texture_flags_t flags,
+                             texture_handle_t *texture_out, asset_callback_t callback, void *user);
+
+/* placeholder must share the pipeline's vertex layout with the loaded mesh;
+   MESH_INVALID_HANDLE draws nothing until ready */
+asset_id_t Asset_LoadMesh(const char *path, mesh_handle_t placeholder, mesh_handle_t *mesh_out,
+                          asset_callback_t callback, void *user);
+
+/* a frog model; until ready it has one animation of one keyframe, drawn as
+   PREDEFINED_MESH_MATERIAL_CUBE, and no materials or anchors */
+asset_id_t Asset_LoadModel(const char *path, model_handle_t *model_out, asset_callback_t callback,
+                           void *user);
+
+asset_status_t Asset_GetStatus(asset_id_t id);
+
+/* blocks until the load is done and swapped in; the callback has run by
+   the time it returns */
+asset_status_t Asset_Wait(asset_id_t id);
+void Asset_WaitAll(void);
+
+#endif
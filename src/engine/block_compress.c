@@ -0,0 +1,580 @@
+#include <math.h>
+
+#include "core.h"
+#include "core_math.h"
+#include "profiler.h"
+
+#include "block_compress.h"
+
+#define BLOCK_TEXELS 16
+
+/* bc7 interpolation weights of 4 bit indices, out of 64 */
+static const u8 s_bc7_weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+static void load_block(u8 texels[BLOCK_TEXELS][4], const u8 *rgba, u32 width, u32 height, u32 block_x,
+                       u32 block_y);
+static void fit_axis(const f32 points[BLOCK_TEXELS][4], u32 count, u32 dims, f32 lo_out[4], f32 hi_out[4]);
+static void encode_bc1(u8 *dst, const u8 texels[BLOCK_TEXELS][4]);
+static void encode_bc4(u8 *dst, const u8 texels[BLOCK_TEXELS][4]);
+static void encode_bc7(u8 *dst, const u8 texels[BLOCK_TEXELS][4]);
+static void decode_bc1(u8 texels[BLOCK_TEXELS][4], const u8 *block);
+static void decode_bc4(u8 texels[BLOCK_TEXELS][4], const u8 *block);
+static bool decode_bc7(u8 texels[BLOCK_TEXELS][4], const u8 *block);
+static u16 pack_565(const f32 color[4]);
+static void unpack_565(u16 packed, u8 color_out[4]);
+static void bc1_palette(u16 c0, u16 c1, u8 palette_out[4][4]);
+static void bc4_palette(u8 r0, u8 r1, u8 palette_out[8]);
+static void bc7_quantize(const f32 endpoint[4], u8 quantized_out[4], u8 *pbit_out);
+static u32 bc7_indices(u8 indices_out[BLOCK_TEXELS], const u8 texels[BLOCK_TEXELS][4], const u8 quantized[2][4],
+                       const u8 pbits[2]);
+static u32 nearest(const u8 *texel, const u8 *palette, u32 palette_count, u32 channels, u32 *error_out);
+static void put_bits(u8 *data, u32 *pos, u32 value, u32 count);
+static u32 get_bits(const u8 *data, u32 *pos, u32 count);
+
+static u32 block_bytes(texture_format_t format)
+{
+    Assert(TEXTURE_FORMAT_IS_COMPRESSED(format));
+    return format == TEXTURE_FORMAT_BC7_SRGB ? 16 : 8;
+}
+
+u64 BlockCompress_LevelSize(texture_format_t format, u32 width, u32 height)
+{
+    switch (format)
+    {
+        case TEXTURE_FORMAT_RGBA8_SRGB:
+            return (u64)width * height * 4;
+        case TEXTURE_FORMAT_R8:
+            return (u64)width * height;
+        default:
+            return (u64)((width + 3) / 4) * ((height + 3) / 4) * block_bytes(format);
+    }
+}
+
+void BlockCompress_Encode(texture_format_t format, void *dst, const u8 *rgba, u32 width, u32 height)
+{
+    ProfileZone("BlockCompress_Encode");
+
+    u8 *out = dst;
+    u32 size = block_bytes(format);
+    for (u32 block_y = 0; block_y < (height + 3) / 4; block_y++)
+    {
+        for (u32 block_x = 0; block_x < (width + 3) / 4; block_x++)
+        {
+            u8 texels[BLOCK_TEXELS][4];
+            load_block(texels, rgba, width, height, block_x, block_y);
+
+            if (format == TEXTURE_FORMAT_BC1_SRGB)
+                encode_bc1(out, texels);
+            else if (format == TEXTURE_FORMAT_BC4)
+                encode_bc4(out, texels);
+            else
+                encode_bc7(out, texels);
+            out += size;
+        }
+    }
+}
+
+texture_format_t BlockCompress_DecodedFormat(texture_format_t format)
+{
+    return format == TEXTURE_FORMAT_BC4 ? TEXTURE_FORMAT_R8 : TEXTURE_FORMAT_RGBA8_SRGB;
+}
+
+bool BlockCompress_Decode(texture_format_t format, u8 *dst, const void *blocks, u32 width, u32 height)
+{
+    ProfileZone("BlockCompress_Decode");
+
+    const u8 *block = blocks;
+    u32 size = block_bytes(format);
+    u32 channels = format == TEXTURE_FORMAT_BC4 ? 1 : 4;
+    for (u32 block_y = 0; block_y < (height + 3) / 4; block_y++)
+    {
+        for (u32 block_x = 0; block_x < (width + 3) / 4; block_x++)
+        {
+            u8 texels[BLOCK_TEXELS][4];
+            if (format == TEXTURE_FORMAT_BC1_SRGB)
+                decode_bc1(texels, block);
+            else if (format == TEXTURE_FORMAT_BC4)
+                decode_bc4(texels, block);
+            else if (!decode_bc7(texels, block))
+                return false;
+            block += size;
+
+            /* the padding of edge blocks is dropped */
+            for (u32 y = 0; y < 4 && block_y * 4 + y < height; y++)
+            {
+                for (u32 x = 0; x < 4 && block_x * 4 + x < width; x++)
+                {
+                    u64 offset = ((u64)(block_y * 4 + y) * width + block_x * 4 + x) * channels;
+                    MemoryCopy(dst + offset, texels[y * 4 + x], channels);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static void load_block(u8 texels[BLOCK_TEXELS][4], const u8 *rgba, u32 width, u32 height, u32 block_x,
+                       u32 block_y)
+{
+    for (u32 y = 0; y < 4; y++)
+    {
+        u32 source_y = Min(block_y * 4 + y, height - 1);
+        for (u32 x = 0; x < 4; x++)
+        {
+            u32 source_x = Min(block_x * 4 + x, width - 1);
+            MemoryCopy(texels[y * 4 + x], rgba + ((u64)source_y * width + source_x) * 4, 4);
+        }
+    }
+}
+
+/* the extremes of the points projected on their principal axis, found by
+   power iteration on the covariance. points that hardly vary project to
+   about their mean */
+static void fit_axis(const f32 points[BLOCK_TEXELS][4], u32 count, u32 dims, f32 lo_out[4], f32 hi_out[4])
+{
+    f32 mean[4] = {0};
+    for (u32 i = 0; i < count; i++)
+    {
+        for (u32 c = 0; c < dims; c++)
+            mean[c] += points[i][c];
+    }
+    for (u32 c = 0; c < dims; c++)
+        mean[c] /= (f32)count;
+
+    f32 covariance[4][4] = {0};
+    for (u32 i = 0; i < count; i++)
+    {
+        for (u32 a = 0; a < dims; a++)
+        {
+            for (u32 b = 0; b < dims; b++)
+                covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+        }
+    }
+
+    f32 axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (u32 iteration = 0; iteration < 8; iteration++)
+    {
+        f32 next[4] = {0};
+        f32 largest = 0.0f;
+        for (u32 a = 0; a < dims; a++)
+        {
+            for (u32 b = 0; b < dims; b++)
+                next[a] += covariance[a][b] * axis[b];
+            largest = Max(largest, next[a] < 0.0f ? -next[a] : next[a]);
+        }
+        if (largest < 1e-6f)
+            break;
+        for (u32 a = 0; a < dims; a++)
+            axis[a] = next[a] / largest;
+    }
+
+    f32 length = 0.0f;
+    for (u32 c = 0; c < dims; c++)
+        length += axis[c] * axis[c];
+    length = sqrtf(length);
+
+    f32 lo = 0.0f;
+    f32 hi = 0.0f;
+    for (u32 i = 0; i < count; i++)
+    {
+        f32 t = 0.0f;
+        for (u32 c = 0; c < dims; c++)
+            t += (points[i][c] - mean[c]) * axis[c] / length;
+        lo = Min(lo, t);
+        hi = Max(hi, t);
+    }
+
+    for (u32 c = 0; c < dims; c++)
+    {
+        lo_out[c] = Clamp(mean[c] + axis[c] / length * lo, 0.0f, 255.0f);
+        hi_out[c] = Clamp(mean[c] + axis[c] / length * hi, 0.0f, 255.0f);
+    }
+}
+
+/* four colors, or three and transparent black when any texel is below half
+   alpha; the endpoint order tells the decoder which */
+static void encode_bc1(u8 *dst, const u8 texels[BLOCK_TEXELS][4])
+{
+    f32 points[BLOCK_TEXELS][4];
+    u32 count = 0;
+    bool transparent = false;
+    for (u32 i = 0; i < BLOCK_TEXELS; i++)
+    {
+        if (texels[i][3] < 128)
+        {
+            transparent = true;
+            continue;
+        }
+        for (u32 c = 0; c < 3; c++)
+            points[count][c] = texels[i][c];
+        count++;
+    }
+
+    u16 c0 = 0;
+    u16 c1 = 0;
+    if (count > 0)
+    {
+        f32 lo[4], hi[4];
+        fit_axis(points, count, 3, lo, hi);
+        c0 = pack_565(hi);
+        c1 = pack_565(lo);
+    }
+
+    /* c0 > c1 selects four colors */
+    if ((c0 > c1) == transparent)
+    {
+        u16 swap = c0;
+        c0 = c1;
+        c1 = swap;
+    }
+
+    u8 palette[4][4];
+    bc1_palette(c0, c1, palette);
+    u32 palette_count = c0 > c1 ? 4 : 3;
+
+    u32 indices = 0;
+    for (u32 i = 0; i < BLOCK_TEXELS; i++)
+    {
+        u32 index = 3;
+        if (texels[i][3] >= 128 || !transparent)
+        {
+            u32 error;
+            index = nearest(texels[i], &palette[0][0], palette_count, 3, &error);
+        }
+        indices |= index << (i * 2);
+    }
+
+    dst[0] = (u8)c0;
+    dst[1] = (u8)(c0 >> 8);
+    dst[2] = (u8)c1;
+    dst[3] = (u8)(c1 >> 8);
+    for (u32 i = 0; i < 4; i++)
+        dst[4 + i] = (u8)(indices >> (i * 8));
+}
+
+static void encode_bc4(u8 *dst, const u8 texels[BLOCK_TEXELS][4])
+{
+    u8 lo = 255;
+    u8 hi = 0;
+    for (u32 i = 0; i < BLOCK_TEXELS; i++)
+    {
+        lo = Min(lo, texels[i][0]);
+        hi = Max(hi, texels[i][0]);
+    }
+
+    /* r0 > r1 selects eight values; equal ones only need index 0 */
+    u8 palette[8];
+    bc4_palette(hi, lo, palette);
+
+    u64 indices = 0;
+    if (hi > lo)
+    {
+        for (u32 i = 0; i < BLOCK_TEXELS; i++)
+        {
+            u32 error;
+            indices |= (u64)nearest(texels[i], palette, 8, 1, &error) << (i * 3);
+        }
+    }
+
+    dst[0] = hi;
+    dst[1] = lo;
+    for (u32 i = 0; i < 6; i++)
+        dst[2 + i] = (u8)(indices >> (i * 8));
+}
+
+/* mode 6: 7 bit rgba endpoints with a p-bit each, 4 bit indices. the
+   endpoints from the principal axis get one least squares refit for the
+   indices they chose, kept if it lowers the error */
+static void encode_bc7(u8 *dst, const u8 texels[BLOCK_TEXELS][4])
+{
+    f32 points[BLOCK_TEXELS][4];
+    for (u32 i = 0; i < BLOCK_TEXELS; i++)
+    {
+        for (u32 c = 0; c < 4; c++)
+            points[i][c] = texels[i][c];
+    }
+
+    f32 endpoints[2][4];
+    fit_axis(points, BLOCK_TEXELS, 4, endpoints[0], endpoints[1]);
+
+    u8 quantized[2][4];
+    u8 pbits[2];
+    bc7_quantize(endpoints[0], quantized[0], &pbits[0]);
+    bc7_quantize(endpoints[1], quantized[1], &pbits[1]);
+
+    u8 indices[BLOCK_TEXELS];
+    u32 error = bc7_indices(indices, texels, quantized, pbits);
+
+    f32 aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    f32 ax[4] = {0}, bx[4] = {0};
+    for (u32 i = 0; i < BLOCK_TEXELS; i++)
+    {
+        f32 t = (f32)s_bc7_weights[indices[i]] / 64.0f;
+        aa += (1.0f - t) * (1.0f - t);
+        ab += (1.0f - t) * t;
+        bb += t * t;
+        for (u32 c = 0; c < 4; c++)
+        {
+            ax[c] += (1.0f - t) * points[i][c];
+            bx[c] += t * points[i][c];
+        }
+    }
+
+    f32 determinant = aa * bb - ab * ab;
+    if (error > 0 && (determinant > 1e-6f || determinant < -1e-6f))
+    {
+        f32 refit[2][4];
+        for (u32 c = 0; c < 4; c++)
+        {
+            refit[0][c] = Clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+            refit[1][c] = Clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+        }
+
+        u8 refit_quantized[2][4];
+        u8 refit_pbits[2];
+        u8 refit_indices[BLOCK_TEXELS];
+        bc7_quantize(refit[0], refit_quantized[0], &refit_pbits[0]);
+        bc7_quantize(refit[1], refit_quantized[1], &refit_pbits[1]);
+        if (bc7_indices(refit_indices, texels, refit_quantized, refit_pbits) < error)
+        {
+            MemoryCopy(quantized, refit_quantized, sizeof(quantized));
+            MemoryCopy(pbits, refit_pbits, sizeof(pbits));
+            MemoryCopy(indices, refit_indices, sizeof(indices));
+        }
+    }
+
+    /* the first index has an implicit top bit of 0 */
+    if (indices[0] & 8)
+    {
+        for (u32 c = 0; c < 4; c++)
+        {
+            u8 swap = quantized[0][c];
+            quantized[0][c] = quantized[1][c];
+            quantized[1][c] = swap;
+        }
+        u8 swap = pbits[0];
+        pbits[0] = pbits[1];
+        pbits[1] = swap;
+        for (u32 i = 0; i < BLOCK_TEXELS; i++)
+            indices[i] = 15 - indices[i];
+    }
+
+    MemoryZero(dst, 16);
+    u32 pos = 0;
+    put_bits(dst, &pos, 1 << 6, 7);
+    for (u32 c = 0; c < 4; c++)
+    {
+        put_bits(dst, &pos, quantized[0][c], 7);
+        put_bits(dst, &pos, quantized[1][c], 7);
+    }
+    put_bits(dst, &pos, pbits[0], 1);
+    put_bits(dst, &pos, pbits[1], 1);
+    for (u32 i = 0; i < BLOCK_TEXELS; i++)
+        put_bits(dst, &pos, indices[i], i == 0 ? 3 : 4);
+}
+
+static void decode_bc1(u8 texels[BLOCK_TEXELS][4], const u8 *block)
+{
+    u16 c0 = (u16)(block[0] | block[1] << 8);
+    u16 c1 = (u16)(block[2] | block[3] << 8);
+    u32 indices = (u32)block[4] | (u32)block[5] << 8 | (u32)block[6] << 16 | (u32)block[7] << 24;
+
+    u8 palette[4][4];
+    bc1_palette(c0, c1, palette);
+    for (u32 i = 0; i < BLOCK_TEXELS; i++)
+        MemoryCopy(texels[i], palette[(indices >> (i * 2)) & 3], 4);
+}
+
+static void decode_bc4(u8 texels[BLOCK_TEXELS][4], const u8 *block)
+{
+    u8 palette[8];
+    bc4_palette(block[0], block[1], palette);
+
+    u64 indices = 0;
+    for (u32 i = 0; i < 6; i++)
+        indices |= (u64)block[2 + i] << (i * 8);
+    for (u32 i = 0; i < BLOCK_TEXELS; i++)
+        texels[i][0] = palette[(indices >> (i * 3)) & 7];
+}
+
+static bool decode_bc7(u8 texels[BLOCK_TEXELS][4], const u8 *block)
+{
+    u32 pos = 0;
+    if (get_bits(block, &pos, 7) != 1 << 6)
+        return false;
+
+    u8 quantized[2][4];
+    u8 pbits[2];
+    for (u32 c = 0; c < 4; c++)
+    {
+        quantized[0][c] = (u8)get_bits(block, &pos, 7);
+        quantized[1][c] = (u8)get_bits(block, &pos, 7);
+    }
+    pbits[0] = (u8)get_bits(block, &pos, 1);
+    pbits[1] = (u8)get_bits(block, &pos, 1);
+
+    for (u32 i = 0; i < BLOCK_TEXELS; i++)
+    {
+        u32 weight = s_bc7_weights[get_bits(block, &pos, i == 0 ? 3 : 4)];
+        for (u32 c = 0; c < 4; c++)
+        {
+            u32 a = (u32)quantized[0][c] << 1 | pbits[0];
+            u32 b = (u32)quantized[1][c] << 1 | pbits[1];
+            texels[i][c] = (u8)(((64 - weight) * a + weight * b + 32) >> 6);
+        }
+    }
+    return true;
+}
+
+static u16 pack_565(const f32 color[4])
+{
+    u32 r = round_u32(color[0] * 31.0f / 255.0f);
+    u32 g = round_u32(color[1] * 63.0f / 255.0f);
+    u32 b = round_u32(color[2] * 31.0f / 255.0f);
+    return (u16)(r << 11 | g << 5 | b);
+}
+
+static void unpack_565(u16 packed, u8 color_out[4])
+{
+    u32 r = packed >> 11;
+    u32 g = (packed >> 5) & 63;
+    u32 b = packed & 31;
+    color_out[0] = (u8)(r << 3 | r >> 2);
+    color_out[1] = (u8)(g << 2 | g >> 4);
+    color_out[2] = (u8)(b << 3 | b >> 2);
+    color_out[3] = 255;
+}
+
+static void bc1_palette(u16 c0, u16 c1, u8 palette_out[4][4])
+{
+    unpack_565(c0, palette_out[0]);
+    unpack_565(c1, palette_out[1]);
+
+    for (u32 c = 0; c < 3; c++)
+    {
+        u32 a = palette_out[0][c];
+        u32 b = palette_out[1][c];
+        if (c0 > c1)
+        {
+            palette_out[2][c] = (u8)((2 * a + b) / 3);
+            palette_out[3][c] = (u8)((a + 2 * b) / 3);
+        }
+        else
+        {
+            palette_out[2][c] = (u8)((a + b) / 2);
+            palette_out[3][c] = 0;
+        }
+    }
+    palette_out[2][3] = 255;
+    palette_out[3][3] = c0 > c1 ? 255 : 0;
+}
+
+static void bc4_palette(u8 r0, u8 r1, u8 palette_out[8])
+{
+    palette_out[0] = r0;
+    palette_out[1] = r1;
+    if (r0 > r1)
+    {
+        for (u32 i = 2; i < 8; i++)
+            palette_out[i] = (u8)(((8 - i) * r0 + (i - 1) * r1) / 7);
+    }
+    else
+    {
+        for (u32 i = 2; i < 6; i++)
+            palette_out[i] = (u8)(((6 - i) * r0 + (i - 1) * r1) / 5);
+        palette_out[6] = 0;
+        palette_out[7] = 255;
+    }
+}
+
+/* the p-bit is the low bit of all four channels, so it is picked for the
+   smaller error over the endpoint */
+static void bc7_quantize(const f32 endpoint[4], u8 quantized_out[4], u8 *pbit_out)
+{
+    f32 best_error = 0.0f;
+    for (u8 pbit = 0; pbit < 2; pbit++)
+    {
+        u8 quantized[4];
+        f32 error = 0.0f;
+        for (u32 c = 0; c < 4; c++)
+        {
+            f32 value = Clamp((endpoint[c] - pbit) / 2.0f, 0.0f, 127.0f);
+            quantized[c] = (u8)round_u32(value);
+            f32 delta = (f32)(quantized[c] * 2 + pbit) - endpoint[c];
+            error += delta * delta;
+        }
+
+        if (pbit == 0 || error < best_error)
+        {
+            best_error = error;
+            MemoryCopy(quantized_out, quantized, 4);
+            *pbit_out = pbit;
+        }
+    }
+}
+
+/* picks the nearest of the 16 interpolated colors for every texel; returns
+   the summed squared error */
+static u32 bc7_indices(u8 indices_out[BLOCK_TEXELS], const u8 texels[BLOCK_TEXELS][4], const u8 quantized[2][4],
+                       const u8 pbits[2])
+{
+    u8 palette[16][4];
+    for (u32 i = 0; i < 16; i++)
+    {
+        u32 weight = s_bc7_weights[i];
+        for (u32 c = 0; c < 4; c++)
+        {
+            u32 a = (u32)quantized[0][c] << 1 | pbits[0];
+            u32 b = (u32)quantized[1][c] << 1 | pbits[1];
+            palette[i][c] = (u8)(((64 - weight) * a + weight * b + 32) >> 6);
+        }
+    }
+
+    u32 total = 0;
+    for (u32 i = 0; i < BLOCK_TEXELS; i++)
+    {
+        u32 error;
+        indices_out[i] = (u8)nearest(texels[i], &palette[0][0], 16, 4, &error);
+        total += error;
+    }
+    return total;
+}
+
+/* palette entries are 4 bytes apart for rgba and 1 for single channels */
+static u32 nearest(const u8 *texel, const u8 *palette, u32 palette_count, u32 channels, u32 *error_out)
+{
+    u32 stride = channels == 1 ? 1 : 4;
+    u32 best = 0;
+    u32 best_error = U32_MAX;
+    for (u32 i = 0; i < palette_count; i++)
+    {
+        u32 error = 0;
+        for (u32 c = 0; c < channels; c++)
+        {
+            i32 delta = (i32)texel[c] - (i32)palette[i * stride + c];
+            error += (u32)(delta * delta);
+        }
+        if (error < best_error)
+        {
+            best = i;
+            best_error = error;
+        }
+    }
+    *error_out = best_error;
+    return best;
+}
+
+/* lsb first, as bc7 numbers its bits */
+static void put_bits(u8 *data, u32 *pos, u32 value, u32 count)
+{
+    for (u32 i = 0; i < count; i++, (*pos)++)
+        data[*pos >> 3] |= (u8)(((value >> i) & 1) << (*pos & 7));
+}
+
+static u32 get_bits(const u8 *data, u32 *pos, u32 count)
+{
+    u32 value = 0;
+    for (u32 i = 0; i < count; i++, (*pos)++)
+        value |= (u32)((data[*pos >> 3] >> (*pos & 7)) & 1) << i;
+    return value;
+}
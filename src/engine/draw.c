@@ -6,6 +6,7 @@
 #include "mesh.h"
 #include "render_types.h"
 #include "renderer.h"
+#include "texture_stream.h"
 
 #include "draw.h"
 
@@ -20,14 +21,14 @@ typedef struct
     vec2 uv_min;
     vec2 uv_max;
     vec4 color;
-    texture_handle_t texture;
+    u32  texture_index;
     u32  text;
 } quad_instance_t;
 StaticAssert(sizeof(quad_instance_t) == 64, "quad_instance_t must match the shader's std430 stride");
 
 typedef struct
 {
-    sbo_push_constant_t sbo;
+    mesh_push_constant_t mesh;
 } push_constant_t;
 
 
@@ -78,14 +79,14 @@ bool Draw_Init()
     }
 
     static const u8 white_pixel[4] = {255, 255, 255, 255};
-    s_draw.white_texture = Renderer_CreateTexture(1, 1, white_pixel, sampler);
+    s_draw.white_texture = Renderer_CreateTexture(1, 1, white_pixel, sampler, TEXTURE_FLAG_NONE);
     if (s_draw.white_texture == TEXTURE_HANDLE_INVALID)
     {
         Log(ERROR, "failed to create white texture");
         return false;
     }
 
-    s_draw.font_texture = Renderer_LoadTexture("resources/textures/font2.png", sampler);
+    s_draw.font_texture = Renderer_LoadTexture("resources/textures/font2.png", sampler, TEXTURE_FLAG_BC4);
     if (s_draw.font_texture == TEXTURE_HANDLE_INVALID)
     {
         Log(ERROR, "failed to load font texture");
@@ -97,20 +98,7 @@ bool Draw_Init()
         .vertex_shader = Renderer_LoadShader("shaders/2d_ssbo.vert.spv"),
         .fragment_shader = Renderer_LoadShader("shaders/2d_ssbo.frag.spv"),
         .push_constant_size = sizeof(push_constant_t),
-        .vertex_stride = sizeof(textured_vertex_t),
-        .vertex_attribute_count = 2,
-        .vertex_attributes = {
-            {
-                .location = 0,
-                .format = VERTEX_FORMAT_F32X3,
-                .offset = offsetof(textured_vertex_t, position),
-            },
-            {
-                .location = 1,
-                .format = VERTEX_FORMAT_F32X2,
-                .offset = offsetof(textured_vertex_t, texture_coord),
-            },
-        },
+        .vertex_pulling = true,
         .uniform_binding_count = 1,
         .uniform_bindings = {
             {
@@ -167,11 +155,12 @@ bool Draw_TexturedQuad(u32 x, u32 y, u32 width, u32 height, vec4 color, texture_
         .uv_min = V2(0.0f, 0.0f),
         .uv_max = V2(1.0f, 1.0f),
         .color = color,
-        .texture = texture,
+        .texture_index = Renderer_GetTextureIndex(texture),
     };
 
     Renderer_PushBufferObject(s_draw.sbo, &quad, sizeof(quad));
     s_draw.sbo_len++;
+    TextureStream_Request(texture, (f32)width, (f32)height);
 
     return true;
 }
@@ -200,7 +189,7 @@ bool Draw_Text(u32 x, u32 y, string text)
             .uv_min = V2(u0, v0),
             .uv_max = V2(u0 + 1.0f / FONT_ATLAS_COLUMNS, v0 + 1.0f / FONT_ATLAS_ROWS),
             .color = s_draw.char_color,
-            .texture = s_draw.font_texture,
+            .texture_index = Renderer_GetTextureIndex(s_draw.font_texture),
             .text = 1,
         };
 
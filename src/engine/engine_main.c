@@ -1,22 +1,38 @@
+#include <stdio.h>
+
 #include "core.h"
 #include "core_string.h"
 #include "log.h"
 #include "memory_arena.h"
+#include "os_path.h"
 #include "os_time.h"
+#include "profiler.h"
+#include "vfs.h"
 
+#include "asset.h"
 #include "engine_main.h"
+#include "frame_pacing.h"
+#include "frame_stats.h"
 #include "mesh.h"
 #include "platform.h"
 #include "render_types.h"
 #include "renderer.h"
+#include "texture_stream.h"
 #include "draw.h"
 #include "vulkan_renderer.h"
 #include "console.h"
 
-#define MAX_FRAMETIME_SAMPLES   512
-#define SAMPLE_WINDOW_S         0.2f
+#define PROFILE_CAPTURE_FRAMES  120
+#define PROFILE_CAPTURE_PATH    "dcfs_trace.json"
+
+#define HITCH_THRESHOLD_MS      16.7f       // one 60 Hz refresh
 
 #define FPS_LIMIT               500         // 0 = uncapped
+#define FRAMES_IN_FLIGHT        2
+
+#define MAX_GPU_TIMER_LINES     4
+
+#define MAX_ARCHIVE_PATH        512
 
 arena_t *g_engine_arena = NULL;
 arena_t *g_scratch = NULL;
@@ -25,16 +41,13 @@ typedef struct
 {
 
     u64 last_time_ns;
-    u64 next_frame_ns;
+    u64 game_start_ns;
 
-    // stats
-    f32 frametime_samples[MAX_FRAMETIME_SAMPLES];
-    u32 frametime_sample_i;
-    f32 frametime_sum;
-    u32 frametime_sum_count;
+    bool gpu_statistics;
+    bool stats_overlay;
+    f32 fixed_timestep;
 
-    f32 avg_frametime;
-    u32 fps;
+    engine_frame_info_t last_frame;
 
 } engine_t;
 
@@ -53,6 +66,12 @@ bool Engine_Init(platform_window_t *window)
     );
     g_scratch = MemoryArena_Create("global-scratch");
     s_engine.last_time_ns = OS_TimeNowNs();
+    s_engine.stats_overlay = true;
+
+    /* optional: without it everything loads from the loose files */
+    char archive_path[MAX_ARCHIVE_PATH];
+    snprintf(archive_path, sizeof(archive_path), "%s%s", OS_GetBasePath(), VFS_ARCHIVE_NAME);
+    Vfs_Mount(archive_path);
 
     if (!VulkanRenderer_Init(g_engine_arena, window))
         goto fail;
@@ -60,9 +79,23 @@ bool Engine_Init(platform_window_t *window)
     if (!Renderer_Init())
         goto fail_renderer;
 
+    FrameStats_Init(HITCH_THRESHOLD_MS);
+    FramePacing_Init(&(frame_pacing_config_t){
+        .fps_limit = FPS_LIMIT,
+        .frames_in_flight = FRAMES_IN_FLIGHT,
+        .present_mode = PRESENT_MODE_IMMEDIATE,
+        .late_input = true,
+    });
+
     if (!MeshManager_Init())
         goto fail_renderer;
 
+    if (!Asset_Init())
+        goto fail_renderer;
+
+    if (!TextureStream_Init())
+        goto fail_renderer;
+
     if (!Draw_Init())
         goto fail_renderer;
 
@@ -74,6 +107,7 @@ bool Engine_Init(platform_window_t *window)
 fail_renderer:
     VulkanRenderer_Destroy();
 fail:
+    Vfs_Unmount();
     MemoryArena_Destroy(g_scratch);
     g_scratch = NULL;
     MemoryArena_Destroy(g_engine_arena);
@@ -83,8 +117,12 @@ fail:
 
 void Engine_Destroy(void)
 {
+    Asset_Destroy();
+    TextureStream_Destroy();
+    FrameStats_Destroy();
     Draw_Destroy();
     VulkanRenderer_Destroy();
+    Vfs_Unmount();
 
     MemoryArena_Print(g_scratch);
     MemoryArena_Destroy(g_scratch);
@@ -106,6 +144,21 @@ void Engine_HandleResize(u32 width, u32 height)
 
 key_handle_result_t Engine_HandleKeyDown(key_code_t key)
 {
+#ifdef PROFILER_ENABLED
+    if (key == KEY_F9)
+    {
+        Profiler_Capture(PROFILE_CAPTURE_FRAMES, PROFILE_CAPTURE_PATH);
+        return KEY_EVENT_CONSUMED;
+    }
+#endif
+
+    if (key == KEY_F10)
+    {
+        if (Renderer_SetGpuStatistics(!s_engine.gpu_statistics))
+            s_engine.gpu_statistics = !s_engine.gpu_statistics;
+        return KEY_EVENT_CONSUMED;
+    }
+
     if (Console_HandleKeyDown(key) == KEY_EVENT_CONSUMED)
         return KEY_EVENT_CONSUMED;
 
@@ -120,63 +173,101 @@ key_handle_result_t Engine_HandleKeyUp(key_code_t key)
     return KEY_EVENT_PASSTHROUGH;
 }
 
+void Engine_SetFramePacing(const frame_pacing_config_t *config)
+{
+    FramePacing_Configure(config);
+}
+
+void Engine_WaitForFrame(void)
+{
+    FramePacing_Wait();
+}
+
 f32 Engine_BeginFrame(void)
 {
     engine_t *engine = &s_engine;
 
-    u64 now_ns = OS_TimeNowNs();
-    if (FPS_LIMIT > 0)
-    {
-        u64 fps_limit = FPS_LIMIT;
-        if (now_ns < engine->next_frame_ns)
-        {
-            OS_SleepNs(engine->next_frame_ns - now_ns);
-            now_ns = OS_TimeNowNs();
-        }
-
-        engine->next_frame_ns += NS_PER_SECOND / fps_limit;
-        if (engine->next_frame_ns < now_ns)
-            engine->next_frame_ns = now_ns;
-    }
+    ProfileFrameMark();
+    ProfileZone("Engine_BeginFrame");
+
+    u64 now_ns = FramePacing_BeginFrame();
 
     f32 delta_time = (f32)(now_ns - engine->last_time_ns) / (f32)NS_PER_SECOND;
     engine->last_time_ns = now_ns;
 
-    // Stats
-    engine->frametime_samples[engine->frametime_sample_i++] = delta_time;
-    if (engine->frametime_sample_i == MAX_FRAMETIME_SAMPLES)
-        engine->frametime_sample_i = 0;
-
-    engine->frametime_sum += delta_time;
-    engine->frametime_sum_count++;
-    if (engine->frametime_sum > SAMPLE_WINDOW_S)
-    {
-        engine->avg_frametime = engine->frametime_sum / engine->frametime_sum_count;
-        engine->fps = round_u32(1.0f / engine->avg_frametime);
-
-        engine->frametime_sum = 0.0f;
-        engine->frametime_sum_count = 0;
-    }
+    /* the record spans begin to begin: the previous frame's phases plus
+       this frame's pacing wait, so the renderer timings are taken here to
+       include a late input wait */
+    render_timings_t timings = Renderer_TakeTimings();
+    FrameStats_AddPhase(FRAME_PHASE_BAKE, timings.bake_ns);
+    FrameStats_AddPhase(FRAME_PHASE_SUBMIT, timings.submit_ns);
+    FrameStats_AddPhase(FRAME_PHASE_PRESENT_WAIT, timings.present_wait_ns);
+    FrameStats_EndFrame(delta_time);
+
+    /* the render stats reset in Renderer_BeginFrame */
+    engine->last_frame = (engine_frame_info_t){
+        .draw_calls = g_render_stats.n_draw_calls,
+        .triangles = g_render_stats.n_triangles,
+        .upload_bytes = timings.upload_bytes,
+    };
+
+    if (engine->fixed_timestep > 0.0f)
+        delta_time = engine->fixed_timestep;
 
     Renderer_BeginFrame(); // Needs to be first
     Draw_BeginFrame();
+    Asset_Update();
+    TextureStream_Update();
 
     Console_Update(delta_time);
 
+    engine->game_start_ns = OS_TimeNowNs();
+
     return delta_time;
 }
 
 void Engine_EndFrame(void)
 {
-    draw_version_label();
-    draw_stats();
+    ProfileZone("Engine_EndFrame");
+    engine_t *engine = &s_engine;
+
+    u64 draw_start_ns = OS_TimeNowNs();
+    FrameStats_AddPhase(FRAME_PHASE_GAME, draw_start_ns - engine->game_start_ns);
+
+    if (engine->stats_overlay)
+    {
+        draw_version_label();
+        draw_stats();
+    }
 
     Console_Draw();
     Draw_EndFrame();
 
+    FrameStats_AddPhase(FRAME_PHASE_DRAW, OS_TimeNowNs() - draw_start_ns);
+
     Renderer_EndFrame(); // Needs to be last
 }
 
+engine_frame_info_t Engine_GetFrameInfo(void)
+{
+    return s_engine.last_frame;
+}
+
+void Engine_SetFixedTimestep(f32 seconds)
+{
+    s_engine.fixed_timestep = Max(seconds, 0.0f);
+}
+
+void Engine_SetStatsOverlay(bool enabled)
+{
+    s_engine.stats_overlay = enabled;
+}
+
+bool Engine_ReadbackChecksum(u64 *checksum_out)
+{
+    return VulkanRenderer_ReadbackChecksum(checksum_out);
+}
+
 static void draw_version_label()
 {
     window_extent_t extent = Renderer_GetWindowExtent();
@@ -193,15 +284,57 @@ static void draw_stats()
     Draw_SetTextSize(16);
     Draw_SetTextColor(V4(1.0, 1.0, 1.0, 1.0));
 
-    string fps_s = string_fmt(scratch.arena, "FPS: %u", s_engine.fps);
-    string frametime_s = string_fmt(scratch.arena, "Frametime: %.3f ms", (s_engine.avg_frametime * 1000.0f));
+    const frame_stats_t *stats = FrameStats_Get();
+
+    string fps_s = string_fmt(scratch.arena, "FPS: %u", stats->fps);
+    string frametime_s = string_fmt(scratch.arena, "Frametime: %.3f ms", stats->avg_ms);
+    string percentiles_s = string_fmt(scratch.arena, "p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms",
+                                      stats->p50_ms, stats->p95_ms, stats->p99_ms, stats->max_ms);
+    string hitches_s = string_fmt(scratch.arena, "Hitches: %u (total %u)", stats->hitches,
+                                  (u32)stats->total_hitches);
+    string phases_s = string_fmt(scratch.arena, "game %.2f  draw %.2f  bake %.2f  submit %.2f  wait %.2f ms",
+                                 stats->phase_avg_ms[FRAME_PHASE_GAME],
+                                 stats->phase_avg_ms[FRAME_PHASE_DRAW],
+                                 stats->phase_avg_ms[FRAME_PHASE_BAKE],
+                                 stats->phase_avg_ms[FRAME_PHASE_SUBMIT],
+                                 stats->phase_avg_ms[FRAME_PHASE_PRESENT_WAIT]);
     string drawcalls_s = string_fmt(scratch.arena, "Draw calls: %u", g_render_stats.n_draw_calls);
     string tricount_s = string_fmt(scratch.arena, "Triangles: %u", g_render_stats.n_triangles);
 
+    frame_pacing_stats_t pacing = FramePacing_GetStats();
+    string pacing_s = string_fmt(scratch.arena, "Wake error: %.1f us (max %.1f), spin %.1f us",
+                                 pacing.wake_error_avg_us, pacing.wake_error_max_us,
+                                 pacing.spin_avg_us);
+
     Draw_Text(8, extent.height - 32, fps_s);
     Draw_Text(8, extent.height - 64, frametime_s);
     Draw_Text(8, extent.height - 96, drawcalls_s);
     Draw_Text(8, extent.height - 128, tricount_s);
+    Draw_Text(8, extent.height - 160, percentiles_s);
+    Draw_Text(8, extent.height - 192, hitches_s);
+    Draw_Text(8, extent.height - 224, phases_s);
+    Draw_Text(8, extent.height - 256, pacing_s);
+
+    /* gpu side, a few frames late; passes beyond the first few are left out */
+    const gpu_frame_timings_t *gpu = Renderer_GetGpuTimings();
+    u32 line_y = extent.height - 288;
+
+    Draw_Text(8, line_y, string_fmt(scratch.arena, "GPU: %.3f ms", gpu->frame_ms));
+    for (u32 i = 0; i < Min(gpu->timer_count, (u32)MAX_GPU_TIMER_LINES); i++)
+    {
+        const gpu_timer_t *timer = &gpu->timers[i];
+        line_y -= 32;
+        Draw_Text(24, line_y, string_fmt(scratch.arena, "%s %.3f ms", timer->label,
+                                         (f32)(timer->end_ns - timer->start_ns) / 1000000.0f));
+    }
+    if (s_engine.gpu_statistics && gpu->statistics_valid)
+    {
+        line_y -= 32;
+        Draw_Text(8, line_y, string_fmt(scratch.arena, "Invocations: vs %u  fs %u",
+                                        (u32)gpu->vertex_invocations, (u32)gpu->fragment_invocations));
+    }
+
+    FrameStats_DrawGraph(8, 8);
 
     Scratch_End(scratch);
 }
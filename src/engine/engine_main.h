@@ -2,8 +2,16 @@
 #define ENGINE_MAIN_H
 
 #include "core.h"
+#include "frame_pacing.h"
 #include "platform.h"
 
+typedef struct
+{
+    u32 draw_calls;
+    u32 triangles;
+    u64 upload_bytes;       /* buffer object copies submitted for the frame */
+} engine_frame_info_t;
+
 bool Engine_Init(platform_window_t *window);
 void Engine_Destroy(void);
 
@@ -11,8 +19,26 @@ void Engine_HandleResize(u32 width, u32 height);
 key_handle_result_t Engine_HandleKeyDown(key_code_t key);
 key_handle_result_t Engine_HandleKeyUp(key_code_t key);
 
+void Engine_SetFramePacing(const frame_pacing_config_t *config);
+
+/* frame limiter and, with late_input, the gpu frame slot wait; call before
+   polling input so the frame starts from the freshest events */
+void Engine_WaitForFrame(void);
+
 /* returns the seconds elapsed since the previous frame */
 f32  Engine_BeginFrame(void);
 void Engine_EndFrame(void);
 
+/* counters of the previous frame, updated by Engine_BeginFrame */
+engine_frame_info_t Engine_GetFrameInfo(void);
+
+/* game time advances by exactly this much per frame; 0 = wall clock */
+void Engine_SetFixedTimestep(f32 seconds);
+
+/* stats text and frame graph, on by default; off for reproducible frames */
+void Engine_SetStatsOverlay(bool enabled);
+
+/* headless only: hash of the last rendered frame's pixels */
+bool Engine_ReadbackChecksum(u64 *checksum_out);
+
 #endif
@@ -0,0 +1,190 @@
+#include "core.h"
+#include "log.h"
+#include "os_time.h"
+#include "profiler.h"
+
+#include "frame_pacing.h"
+#include "frame_stats.h"
+#include "renderer.h"
+
+/* the spin margin starts at a scheduler quantum and adapts from there */
+#define INITIAL_SPIN_THRESHOLD_NS   2000000ull
+#define MIN_SPIN_THRESHOLD_NS       100000ull
+#define MAX_SPIN_THRESHOLD_NS       4000000ull
+#define OVERSLEEP_EWMA_SHIFT        3           /* 1/8 weight per sample */
+
+#define STATS_WINDOW_NS             NS_PER_SECOND
+
+typedef struct
+{
+    frame_pacing_config_t config;
+
+    u64 next_frame_ns;
+    bool waited;            /* this frame already went through Wait */
+
+    /* oversleep of OS_SleepNs: running mean and mean deviation */
+    i64 oversleep_avg_ns;
+    i64 oversleep_dev_ns;
+    u64 spin_threshold_ns;
+
+    // stats window
+    u64 window_start_ns;
+    u64 wake_error_sum_ns;
+    u64 wake_error_max_ns;
+    u64 spin_sum_ns;
+    u32 limited_frames;
+
+    frame_pacing_stats_t stats;
+} frame_pacing_t;
+
+static frame_pacing_t s_pacing = {};
+
+static void wait_until(u64 deadline_ns);
+static void update_oversleep(i64 oversleep_ns);
+static void update_stats(u64 now_ns);
+
+void FramePacing_Init(const frame_pacing_config_t *config)
+{
+    MemoryZeroItem(&s_pacing);
+    s_pacing.spin_threshold_ns = INITIAL_SPIN_THRESHOLD_NS;
+    s_pacing.oversleep_avg_ns = (i64)INITIAL_SPIN_THRESHOLD_NS / 2;
+    s_pacing.window_start_ns = OS_TimeNowNs();
+
+    FramePacing_Configure(config);
+}
+
+void FramePacing_Configure(const frame_pacing_config_t *config)
+{
+    frame_pacing_t *pacing = &s_pacing;
+
+    pacing->config = *config;
+    pacing->config.present_mode = Renderer_SetPresentMode(config->present_mode);
+    pacing->config.frames_in_flight = Renderer_SetFramesInFlight(config->frames_in_flight);
+
+    pacing->next_frame_ns = 0;
+
+    Log(INFO, "frame pacing: fps limit %u, present mode %u, %u frames in flight, late input %s",
+        config->fps_limit, pacing->config.present_mode, pacing->config.frames_in_flight,
+        config->late_input ? "on" : "off");
+}
+
+const frame_pacing_config_t *FramePacing_GetConfig(void)
+{
+    return &s_pacing.config;
+}
+
+void FramePacing_Wait(void)
+{
+    frame_pacing_t *pacing = &s_pacing;
+
+    if (pacing->waited)
+        return;
+    pacing->waited = true;
+
+    ProfileZone("FramePacing_Wait");
+
+    if (pacing->config.late_input)
+        Renderer_WaitForFrame();
+
+    if (pacing->config.fps_limit == 0)
+        return;
+
+    u64 start_ns = OS_TimeNowNs();
+    if (start_ns < pacing->next_frame_ns)
+        wait_until(pacing->next_frame_ns);
+
+    u64 now_ns = OS_TimeNowNs();
+    FrameStats_AddPhase(FRAME_PHASE_PACING, now_ns - start_ns);
+
+    /* a late frame reschedules a full frame from now, rather than letting
+       the next one start unthrottled to catch up */
+    u64 target_ns = NS_PER_SECOND / pacing->config.fps_limit;
+    pacing->next_frame_ns += target_ns;
+    if (pacing->next_frame_ns < now_ns)
+        pacing->next_frame_ns = now_ns + target_ns;
+
+    update_stats(now_ns);
+}
+
+u64 FramePacing_BeginFrame(void)
+{
+    FramePacing_Wait();
+    s_pacing.waited = false;
+
+    return OS_TimeNowNs();
+}
+
+frame_pacing_stats_t FramePacing_GetStats(void)
+{
+    return s_pacing.stats;
+}
+
+static void wait_until(u64 deadline_ns)
+{
+    frame_pacing_t *pacing = &s_pacing;
+
+    /* sleep in chunks while more than the margin remains; each sleep also
+       measures how far past its request the os woke us */
+    u64 now_ns = OS_TimeNowNs();
+    while (deadline_ns > now_ns && deadline_ns - now_ns > pacing->spin_threshold_ns)
+    {
+        u64 request_ns = deadline_ns - now_ns - pacing->spin_threshold_ns;
+        OS_SleepNs(request_ns);
+
+        u64 after_ns = OS_TimeNowNs();
+        update_oversleep((i64)(after_ns - now_ns) - (i64)request_ns);
+        now_ns = after_ns;
+    }
+
+    u64 spin_start_ns = now_ns;
+    while (now_ns < deadline_ns)
+    {
+        CpuRelax();
+        now_ns = OS_TimeNowNs();
+    }
+
+    pacing->spin_sum_ns += now_ns - spin_start_ns;
+    pacing->wake_error_sum_ns += now_ns - deadline_ns;
+    pacing->wake_error_max_ns = Max(pacing->wake_error_max_ns, now_ns - deadline_ns);
+}
+
+static void update_oversleep(i64 oversleep_ns)
+{
+    frame_pacing_t *pacing = &s_pacing;
+
+    if (oversleep_ns < 0)
+        oversleep_ns = 0;
+
+    i64 error = oversleep_ns - pacing->oversleep_avg_ns;
+    pacing->oversleep_avg_ns += error >> OVERSLEEP_EWMA_SHIFT;
+    pacing->oversleep_dev_ns += ((error < 0 ? -error : error) - pacing->oversleep_dev_ns) >> OVERSLEEP_EWMA_SHIFT;
+
+    /* a margin of mean + 2 deviations keeps nearly every wakeup ahead of
+       the deadline without spinning away a whole quantum */
+    i64 threshold = pacing->oversleep_avg_ns + 2 * pacing->oversleep_dev_ns;
+    pacing->spin_threshold_ns = Clamp(MIN_SPIN_THRESHOLD_NS, (u64)Max(threshold, 0),
+                                      MAX_SPIN_THRESHOLD_NS);
+}
+
+static void update_stats(u64 now_ns)
+{
+    frame_pacing_t *pacing = &s_pacing;
+
+    pacing->limited_frames++;
+    if (now_ns - pacing->window_start_ns < STATS_WINDOW_NS)
+        return;
+
+    f32 frames = (f32)pacing->limited_frames;
+    pacing->stats = (frame_pacing_stats_t){
+        .wake_error_avg_us = (f32)pacing->wake_error_sum_ns / frames / 1000.0f,
+        .wake_error_max_us = (f32)pacing->wake_error_max_ns / 1000.0f,
+        .spin_avg_us = (f32)pacing->spin_sum_ns / frames / 1000.0f,
+        .spin_threshold_us = (f32)pacing->spin_threshold_ns / 1000.0f,
+    };
+
+    pacing->window_start_ns = now_ns;
+    pacing->wake_error_sum_ns = 0;
+    pacing->wake_error_max_ns = 0;
+    pacing->spin_sum_ns = 0;
+    pacing->limited_frames = 0;
+}
@@ -0,0 +1,44 @@
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+#include "core.h"
+#include "render_types.h"
+
+typedef struct
+{
+    u32             fps_limit;          /* 0 = uncapped */
+    u32             frames_in_flight;   /* see Renderer_SetFramesInFlight */
+    present_mode_t  present_mode;
+
+    /* wait for the gpu to free the next frame slot before input is polled,
+       instead of after; the frame then starts from the freshest input */
+    bool            late_input;
+} frame_pacing_config_t;
+
+/* limiter accuracy over the last stats window; wake error is how late the
+   limiter returned relative to the frame deadline */
+typedef struct
+{
+    f32 wake_error_avg_us;
+    f32 wake_error_max_us;
+    f32 spin_avg_us;        /* spent busy-waiting per limited frame */
+    f32 spin_threshold_us;  /* current sleep/spin switch-over */
+} frame_pacing_stats_t;
+
+void FramePacing_Init(const frame_pacing_config_t *config);
+void FramePacing_Configure(const frame_pacing_config_t *config);
+const frame_pacing_config_t *FramePacing_GetConfig(void);
+
+/* blocks until the next frame may start: the gpu frame slot wait when
+   late_input is set, then the fps limiter. sleeps until shortly before the
+   deadline and spins the rest, the sleep margin adapting to how much the os
+   oversleeps. call before polling input; BeginFrame calls it if the frame
+   hasn't waited yet */
+void FramePacing_Wait(void);
+
+/* returns the frame start time in ns */
+u64  FramePacing_BeginFrame(void);
+
+frame_pacing_stats_t FramePacing_GetStats(void);
+
+#endif
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core.h"
+#include "core_math.h"
+#include "log.h"
+
+#include "draw.h"
+#include "frame_stats.h"
+
+#define REFRESH_INTERVAL_S  0.2f
+
+#define GRAPH_BARS          240
+#define GRAPH_BAR_WIDTH     2
+#define GRAPH_HEIGHT        200
+#define GRAPH_PX_PER_MS     8.0f
+
+#define COLOR_GRAPH_BG      V4(0.0f, 0.0f, 0.0f, 0.5f)
+#define COLOR_GRAPH_OTHER   V4(0.5f, 0.5f, 0.5f, 1.0f)
+#define COLOR_GRAPH_HITCH   V4(0.9f, 0.3f, 0.3f, 1.0f)
+
+typedef struct
+{
+    f32 frame_ms;
+    f32 phase_ms[FRAME_PHASE_COUNT];
+} frame_record_t;
+
+typedef struct
+{
+    frame_record_t records[FRAME_STATS_WINDOW];
+    u32 record_i;       /* next slot to write */
+    u32 record_count;
+
+    frame_record_t current;
+
+    f32 hitch_threshold_ms;
+
+    f32 refresh_sum_s;
+    u32 refresh_count;
+
+    frame_stats_t stats;
+
+    FILE *csv;
+} frame_stats_state_t;
+
+static frame_stats_state_t s_stats = {};
+
+static const vec4 s_phase_colors[FRAME_PHASE_COUNT] = {
+    [FRAME_PHASE_PACING] =          {.Elements = {0.2f, 0.2f, 0.3f, 1.0f}},
+    [FRAME_PHASE_GAME] =            {.Elements = {0.3f, 0.8f, 0.3f, 1.0f}},
+    [FRAME_PHASE_DRAW] =            {.Elements = {0.3f, 0.8f, 0.8f, 1.0f}},
+    [FRAME_PHASE_BAKE] =            {.Elements = {0.9f, 0.7f, 0.2f, 1.0f}},
+    [FRAME_PHASE_SUBMIT] =          {.Elements = {0.8f, 0.4f, 0.8f, 1.0f}},
+    [FRAME_PHASE_PRESENT_WAIT] =    {.Elements = {0.3f, 0.4f, 0.9f, 1.0f}},
+};
+
+static const char *s_phase_names[FRAME_PHASE_COUNT] = {
+    [FRAME_PHASE_PACING] =          "pacing",
+    [FRAME_PHASE_GAME] =            "game",
+    [FRAME_PHASE_DRAW] =            "draw",
+    [FRAME_PHASE_BAKE] =            "bake",
+    [FRAME_PHASE_SUBMIT] =          "submit",
+    [FRAME_PHASE_PRESENT_WAIT] =    "present_wait",
+};
+
+static void refresh_stats();
+static int compare_f32(const void *a, const void *b);
+static f32 percentile(const f32 *sorted, u32 count, f32 p);
+
+void FrameStats_Init(f32 hitch_threshold_ms)
+{
+    MemoryZeroItem(&s_stats);
+    s_stats.hitch_threshold_ms = hitch_threshold_ms;
+}
+
+void FrameStats_Destroy(void)
+{
+    FrameStats_CloseCsv();
+}
+
+void FrameStats_SetHitchThreshold(f32 hitch_threshold_ms)
+{
+    s_stats.hitch_threshold_ms = hitch_threshold_ms;
+}
+
+void FrameStats_AddPhase(frame_phase_t phase, u64 duration_ns)
+{
+    Assert(phase < FRAME_PHASE_COUNT);
+
+    s_stats.current.phase_ms[phase] += (f32)duration_ns / 1000000.0f;
+}
+
+void FrameStats_EndFrame(f32 frame_time_s)
+{
+    frame_stats_state_t *state = &s_stats;
+
+    state->current.frame_ms = frame_time_s * 1000.0f;
+    if (state->current.frame_ms > state->hitch_threshold_ms)
+        state->stats.total_hitches++;
+
+    if (state->csv)
+    {
+        fprintf(state->csv, "%.4f", state->current.frame_ms);
+        for (u32 i = 0; i < FRAME_PHASE_COUNT; i++)
+            fprintf(state->csv, ",%.4f", state->current.phase_ms[i]);
+        fputc('\n', state->csv);
+    }
+
+    state->records[state->record_i] = state->current;
+    state->record_i = (state->record_i + 1) % FRAME_STATS_WINDOW;
+    state->record_count = Min(state->record_count + 1, (u32)FRAME_STATS_WINDOW);
+    MemoryZeroItem(&state->current);
+
+    /* sorting the window is cheap but not free, so the percentiles refresh
+       at the same rate as the averages */
+    state->refresh_sum_s += frame_time_s;
+    state->refresh_count++;
+    if (state->refresh_sum_s > REFRESH_INTERVAL_S)
+    {
+        state->stats.avg_ms = state->refresh_sum_s * 1000.0f / (f32)state->refresh_count;
+        state->stats.fps = round_u32((f32)state->refresh_count / state->refresh_sum_s);
+        state->refresh_sum_s = 0.0f;
+        state->refresh_count = 0;
+
+        refresh_stats();
+    }
+}
+
+const frame_stats_t *FrameStats_Get(void)
+{
+    return &s_stats.stats;
+}
+
+void FrameStats_DrawGraph(u32 x, u32 y)
+{
+    frame_stats_state_t *state = &s_stats;
+
+    Draw_Quad(x, y, GRAPH_BARS * GRAPH_BAR_WIDTH, GRAPH_HEIGHT, COLOR_GRAPH_BG);
+
+    u32 bar_count = Min(state->record_count, (u32)GRAPH_BARS);
+    for (u32 bar = 0; bar < bar_count; bar++)
+    {
+        /* oldest on the left, newest on the right */
+        u32 record = (state->record_i + FRAME_STATS_WINDOW - bar_count + bar) % FRAME_STATS_WINDOW;
+        const frame_record_t *frame = &state->records[record];
+
+        u32 bar_x = x + bar * GRAPH_BAR_WIDTH;
+        u32 stacked = 0;
+        f32 phase_sum_ms = 0.0f;
+
+        for (u32 phase = 0; phase < FRAME_PHASE_COUNT && stacked < GRAPH_HEIGHT; phase++)
+        {
+            phase_sum_ms += frame->phase_ms[phase];
+            u32 height = Min((u32)(frame->phase_ms[phase] * GRAPH_PX_PER_MS), GRAPH_HEIGHT - stacked);
+            if (height == 0)
+                continue;
+
+            Draw_Quad(bar_x, y + stacked, GRAPH_BAR_WIDTH, height, s_phase_colors[phase]);
+            stacked += height;
+        }
+
+        /* frame time not covered by any phase */
+        f32 other_ms = frame->frame_ms - phase_sum_ms;
+        if (other_ms > 0.0f && stacked < GRAPH_HEIGHT)
+        {
+            u32 height = Min((u32)(other_ms * GRAPH_PX_PER_MS), GRAPH_HEIGHT - stacked);
+            if (height > 0)
+                Draw_Quad(bar_x, y + stacked, GRAPH_BAR_WIDTH, height, COLOR_GRAPH_OTHER);
+        }
+    }
+
+    u32 hitch_y = (u32)(state->hitch_threshold_ms * GRAPH_PX_PER_MS);
+    if (hitch_y < GRAPH_HEIGHT)
+        Draw_Quad(x, y + hitch_y, GRAPH_BARS * GRAPH_BAR_WIDTH, 1, COLOR_GRAPH_HITCH);
+}
+
+bool FrameStats_OpenCsv(const char *path)
+{
+    FrameStats_CloseCsv();
+
+    s_stats.csv = fopen(path, "w");
+    if (!s_stats.csv)
+    {
+        Log(ERROR, "failed to open frame stats csv: %s", path);
+        return false;
+    }
+
+    fputs("frame_ms", s_stats.csv);
+    for (u32 i = 0; i < FRAME_PHASE_COUNT; i++)
+        fprintf(s_stats.csv, ",%s_ms", s_phase_names[i]);
+    fputc('\n', s_stats.csv);
+
+    Log(INFO, "streaming frame stats to %s", path);
+    return true;
+}
+
+void FrameStats_CloseCsv(void)
+{
+    if (s_stats.csv)
+    {
+        fclose(s_stats.csv);
+        s_stats.csv = NULL;
+    }
+}
+
+static void refresh_stats()
+{
+    frame_stats_state_t *state = &s_stats;
+    frame_stats_t *stats = &state->stats;
+
+    u32 count = state->record_count;
+    f32 sorted[FRAME_STATS_WINDOW];
+    f32 phase_sum_ms[FRAME_PHASE_COUNT] = {};
+    u32 hitches = 0;
+
+    for (u32 i = 0; i < count; i++)
+    {
+        const frame_record_t *frame = &state->records[i];
+
+        sorted[i] = frame->frame_ms;
+        if (frame->frame_ms > state->hitch_threshold_ms)
+            hitches++;
+
+        for (u32 phase = 0; phase < FRAME_PHASE_COUNT; phase++)
+            phase_sum_ms[phase] += frame->phase_ms[phase];
+    }
+
+    qsort(sorted, count, sizeof(f32), compare_f32);
+
+    stats->p50_ms = percentile(sorted, count, 0.50f);
+    stats->p95_ms = percentile(sorted, count, 0.95f);
+    stats->p99_ms = percentile(sorted, count, 0.99f);
+    stats->max_ms = count > 0 ? sorted[count - 1] : 0.0f;
+    stats->hitches = hitches;
+
+    for (u32 phase = 0; phase < FRAME_PHASE_COUNT; phase++)
+        stats->phase_avg_ms[phase] = count > 0 ? phase_sum_ms[phase] / (f32)count : 0.0f;
+}
+
+static int compare_f32(const void *a, const void *b)
+{
+    f32 fa = *(const f32 *)a;
+    f32 fb = *(const f32 *)b;
+
+    return (fa > fb) - (fa < fb);
+}
+
+/* nearest rank */
+static f32 percentile(const f32 *sorted, u32 count, f32 p)
+{
+    if (count == 0)
+        return 0.0f;
+
+    u32 rank = (u32)ceilf(p * (f32)count);
+    return sorted[Clamp(1u, rank, count) - 1];
+}
@@ -0,0 +1,59 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include "core.h"
+
+#define FRAME_STATS_WINDOW 512 /* frames the percentiles are taken over */
+
+typedef enum
+{
+    FRAME_PHASE_PACING = 0,     /* fps limiter sleep/spin */
+    FRAME_PHASE_GAME,           /* game tick between Engine_BeginFrame and Engine_EndFrame */
+    FRAME_PHASE_DRAW,           /* engine overlays and draw list build */
+    FRAME_PHASE_BAKE,           /* command buffer recording */
+    FRAME_PHASE_SUBMIT,
+    FRAME_PHASE_PRESENT_WAIT,   /* frame slot wait, acquire and present */
+
+    FRAME_PHASE_COUNT,
+} frame_phase_t;
+
+typedef struct
+{
+    /* over the last FRAME_STATS_WINDOW frames */
+    f32 p50_ms;
+    f32 p95_ms;
+    f32 p99_ms;
+    f32 max_ms;
+    f32 phase_avg_ms[FRAME_PHASE_COUNT];
+    u32 hitches;
+
+    u64 total_hitches;
+
+    /* over the last refresh interval only */
+    f32 avg_ms;
+    u32 fps;
+} frame_stats_t;
+
+void FrameStats_Init(f32 hitch_threshold_ms);
+void FrameStats_Destroy(void);
+
+/* frames slower than the threshold count as hitches */
+void FrameStats_SetHitchThreshold(f32 hitch_threshold_ms);
+
+/* adds to the phase's time for the frame being recorded */
+void FrameStats_AddPhase(frame_phase_t phase, u64 duration_ns);
+
+/* closes the frame record with its total frame time */
+void FrameStats_EndFrame(f32 frame_time_s);
+
+const frame_stats_t *FrameStats_Get(void);
+
+/* scrolling bar graph of the recent frames, one bar per frame stacked by
+   phase, with (x, y) the bottom left corner */
+void FrameStats_DrawGraph(u32 x, u32 y);
+
+/* appends one line per frame: frame time then each phase, in ms */
+bool FrameStats_OpenCsv(const char *path);
+void FrameStats_CloseCsv(void);
+
+#endif
@@ -1,27 +1,48 @@
 
-#include <stdio.h>
 #include <vulkan/vulkan_core.h>
 
 #include "HandmadeMath.h"
 #include "core.h"
 #include "core_string.h"
+#include "vfs.h"
 #include "log.h"
 #include "memory_arena.h"
+#include "profiler.h"
 
+#include "frog.h"
 #include "mesh.h"
 #include "mesh_internal.h"
+#include "mesh_optimize.h"
+#include "model_internal.h"
 #include "model.h"
 #include "renderer.h"
+#include "vertex_pack.h"
 
 #define MAGIC 0x4C444F4D474F5246 // "FROGMODL" little endian
 extern arena_t *g_engine_arena;
 extern arena_t *g_scratch;
 
-static string read_string(arena_t *arena, FILE *file);
-static bool read_vec3(vec3 *out, FILE *file);
-static bool read_quat(quat *out, FILE *file);
+typedef struct
+{
+    const u8    *data;
+    u64         size;
+    u64         pos;
+} frog_reader_t;
+
+static bool read_bytes(frog_reader_t *reader, void *out, u64 size);
+static string read_string(arena_t *arena, frog_reader_t *reader);
+static bool read_vec3(vec3 *out, frog_reader_t *reader);
+static bool read_quat(quat *out, frog_reader_t *reader);
+static bool parse_v1(arena_t *arena, arena_t *scratch, frog_reader_t *file, const char *name,
+                     frog_model_data_t *out);
+static bool parse_blocks(arena_t *arena, arena_t *scratch, const u8 *data, u64 size, u16 version,
+                         const char *name, frog_model_data_t *out);
+static bool block_in_file(u64 offset, u64 block_size, u64 file_size);
+static bool build_lods(arena_t *scratch, const char *name, frog_model_data_t *data);
+static u32 max_lod_vertex_count(const frog_model_data_t *data);
+static vec3 flat_normal(vec3 a, vec3 b, vec3 c);
 /*
-    FILE
+    FILE, version 1
       magic              u8[8]      "FROGMODL"
       version            u16
       triangle_count     u32        T  — 3·T unshared vertices; shared by every keyframe
@@ -57,6 +78,46 @@ static bool read_quat(quat *out, FILE *file);
                   position     f32[3]   12
                   orientation  f32[4]   16   quat, xyzw
 
+    FILE, version 2: fixed header plus blocks at 16 byte aligned offsets, so
+    keyframe vertices go to the gpu as stored
+      magic              u8[8]      "FROGMODL"
+      version            u16        2
+      flags              u16        0
+      triangle_count     u32        T
+      material_count     u16        P
+      anchor_count       u16        A
+      animation_count    u16        M
+      reserved           u16
+      keyframe_count     u32        K  — over all animations
+      vertex_stride      u32        28 — sizeof(normal_material_vertex_t)
+      names_offset       u64
+      materials_offset   u64
+      animations_offset  u64
+      keyframes_offset   u64
+      anchors_offset     u64
+      vertices_offset    u64
+
+      names: P material, A anchor, then M animation names, as in version 1
+      materials    × P:     base_color f32[3], specular_color f32[3]
+      animations   × M:     keyframe_count u32
+      keyframes    × K:     time f32
+      anchors      × K·A:   position f32[3], orientation f32[4]
+      vertices     × K:     3·T normal_material_vertex_t, the normals and
+                            materials resolved; each keyframe block padded
+                            to 16 bytes
+
+    FILE, version 3: version 2 with the vertices welded and ordered for the
+    post-transform cache and the vertex fetch; all keyframes share the index
+    list. written instead of version 2 when that is the smaller file
+      header             version 2 header, version 3
+      vertex_count       u32        V  — per keyframe
+      index_count        u32        3·T
+      indices_offset     u64
+
+      vertices     × K:     V normal_material_vertex_t, each keyframe block
+                            padded to 16 bytes
+      indices      × 3·T:   u32, each < V
+
 */
 
 
@@ -71,47 +132,275 @@ typedef struct
 
 } AttributePacked frog_header_t;
 
+typedef struct
+{
+    u64 magic;
+    u16 version;
+    u16 flags;
+    u32 triangle_count;
+    u16 material_count;
+    u16 anchor_count;
+    u16 animation_count;
+    u16 reserved;
+    u32 keyframe_count;
+    u32 vertex_stride;
+
+    u64 names_offset;
+    u64 materials_offset;
+    u64 animations_offset;
+    u64 keyframes_offset;
+    u64 anchors_offset;
+    u64 vertices_offset;
+} AttributePacked frog_header_v2_t;
+
+typedef struct
+{
+    frog_header_v2_t base;
+    u32 vertex_count;
+    u32 index_count;
+    u64 indices_offset;
+} AttributePacked frog_header_v3_t;
+
+StaticAssert(sizeof(frog_header_v2_t) == 80, "frog v2 header layout");
+StaticAssert(sizeof(frog_header_v3_t) == 96, "frog v3 header layout");
+StaticAssert(sizeof(normal_material_vertex_t) == 28, "frog v2 vertex layout");
+
 model_handle_t Frog_LoadModel(const char *path)
 {
-    frog_header_t header;
-    model_t *model = NULL;
+    ProfileZone("Frog_LoadModel");
+    Assert(g_engine_arena != NULL);
+    Assert(g_scratch != NULL);
+
     model_handle_t handle = MODEL_INVALID_HANDLE;
     u64 pos = MemoryArena_Pos(g_engine_arena);
 
-    FILE *file = fopen(path, "rb");
-    if (!file)
+    vfs_file_t file;
+    if (!Vfs_Open(g_scratch, path, &file))
+        goto exit;
+
+    frog_model_data_t model_data;
+    if (Frog_Parse(g_engine_arena, g_scratch, file.data, file.size, path, &model_data)
+        && Frog_Upload(&model_data, false))
     {
-        Log(ERROR, "failed to open file: %s", path);
-        return MODEL_INVALID_HANDLE;
+        handle = model_data.model;
+    }
+    else
+    {
+        MemoryArena_PopTo(g_engine_arena, pos);
     }
 
-    if (!fread(&header, sizeof(header), 1, file))
+    Vfs_Close(&file);
+exit:
+    MemoryArena_Clear(g_scratch);
+    return handle;
+}
+
+bool Frog_Parse(arena_t *arena, arena_t *scratch, const u8 *data, u64 size, const char *name,
+                frog_model_data_t *out)
+{
+    ProfileZone("Frog_Parse");
+
+    /* magic and version lead both layouts */
+    u64 magic;
+    u16 version;
+    if (size < sizeof(magic) + sizeof(version))
     {
-        Log(ERROR, "failed to read frog header from file: %s", path);
-        goto exit;
+        Log(ERROR, "failed to read frog header from file: %s", name);
+        return false;
     }
+    MemoryCopy(&magic, data, sizeof(magic));
+    MemoryCopy(&version, data + sizeof(magic), sizeof(version));
 
-    Log(DEBUG, "read frog header from file: %s { magic=%lX version=%u tri=%u mat=%u anchors=%u anims=%u",
-        path, header.magic, header.version, header.triangle_count, header.material_count, header.anchor_count, header.animation_count);
+    if (magic != MAGIC)
+    {
+        Log(ERROR, "not a frog file: %s", name);
+        return false;
+    }
 
-    Assert(g_engine_arena != NULL);
-    Assert(g_scratch != NULL);
+    bool parsed;
+    switch (version)
+    {
+        case 1:
+        {
+            frog_reader_t reader = {.data = data, .size = size};
+            parsed = parse_v1(arena, scratch, &reader, name, out);
+            break;
+        }
+        case 2:
+        case 3:
+            parsed = parse_blocks(arena, scratch, data, size, version, name, out);
+            break;
+        default:
+            Log(ERROR, "unsupported frog version %u: %s", version, name);
+            return false;
+    }
+
+    return parsed && build_lods(scratch, name, out);
+}
+
+u64 Frog_UploadSize(const frog_model_data_t *data)
+{
+    u32 index_count = data->indices ? data->index_count : data->vertex_count;
+    return VertexPack_MaterialSize(data->mesh_count, data->vertex_count)
+        + (u64)index_count * INDEX_TYPE_SIZE(VertexPack_IndexType(max_lod_vertex_count(data)));
+}
+
+bool Frog_Upload(const frog_model_data_t *data, bool deferred)
+{
+    ProfileZone("Frog_Upload");
+    scratch_t scratch = Scratch_Begin(g_scratch);
+
+    u32 index_count = data->index_count;
+    const u32 *indices = data->indices;
+    if (!indices)
+    {
+        index_count = data->vertex_count;
+        u32 *identity = arena_push_array_no_zero(scratch.arena, u32, index_count);
+        for (u32 i = 0; i < index_count; i++)
+            identity[i] = i;
+        indices = identity;
+    }
+
+    /* indices only reach into one level of one keyframe, the draws add
+       their vertex offsets */
+    index_type_t index_type = VertexPack_IndexType(max_lod_vertex_count(data));
+    const void *packed_indices = VertexPack_Indices(scratch.arena, indices, index_count, index_type);
+    VkBuffer index_buffer = deferred ? Renderer_UploadStaticIndexBuffer(packed_indices, index_count, index_type)
+                                     : Renderer_CreateStaticIndexBuffer(packed_indices, index_count, index_type);
+    if (index_buffer == VK_NULL_HANDLE)
+    {
+        Scratch_End(scratch);
+        return false;
+    }
 
-    model = arena_push(g_engine_arena, model_t);
+    /* without keyframes there is nothing to pull or animate; the model
+       keeps just its index buffer */
+    if (data->mesh_count == 0)
+    {
+        Scratch_End(scratch);
+        Log(DEBUG, "created model buffers index=%u keyframes=0", index_buffer);
+        return true;
+    }
+
+    /* every keyframe back to back in one pull buffer, packed */
+    u32 vertex_count = data->vertex_count;
+    u64 size = VertexPack_MaterialSize(data->mesh_count, vertex_count);
+    u8 *packed = arena_push_array_no_zero(scratch.arena, u8, size);
+    VertexPack_MaterialVertices(packed, data->vertices, data->mesh_count, vertex_count);
+
+    /* the packing bounds every keyframe, which is what lod selection needs */
+    const packed_material_header_t *header = (const packed_material_header_t *)packed;
+    vec3 center = V3(header->position_offset[0], header->position_offset[1], header->position_offset[2]);
+    f32 radius = HMM_LenV3(V3(header->position_scale[0], header->position_scale[1], header->position_scale[2]));
+
+    u64 address;
+    VkBuffer vertex_buffer = deferred ? Renderer_UploadStaticPullBuffer(packed, size, &address)
+                                      : Renderer_CreateStaticPullBuffer(packed, size, &address);
+    Scratch_End(scratch);
+    if (vertex_buffer == VK_NULL_HANDLE)
+        return false;
+
+    /* keyframe meshes in the order Frog_Parse read them */
+    const model_t *model = data->model;
+    u32 mesh_idx = 0;
+    for (u32 anim_idx = 0; anim_idx < model->animation_count; anim_idx++)
+    {
+        const model_animation_t *animation = &model->animations[anim_idx];
+        for (u32 key_idx = 0; key_idx < animation->keyframe_count; key_idx++)
+        {
+            mesh_t *mesh = (mesh_t *)animation->keyframes[key_idx].mesh;
+            mesh->vertex_buffer = vertex_buffer;
+            mesh->index_buffer = index_buffer;
+            mesh->index_count = data->lods[0].index_count;
+            mesh->index_type = index_type;
+            mesh->vertex_offset = mesh_idx++ * vertex_count;
+            mesh->vertex_address = address;
+            MemoryCopy(mesh->lods, data->lods, sizeof(mesh_lod_t) * data->lod_count);
+            mesh->lod_count = data->lod_count;
+            mesh->center = center;
+            mesh->radius = radius;
+        }
+    }
+    Assert(mesh_idx == data->mesh_count);
+
+    data->model->animation_table_address = Model_UploadAnimationTable(model, deferred);
+    if (data->model->animation_table_address == 0)
+        return false;
+
+    Log(DEBUG, "created model buffers vertex=%u index=%u keyframes=%u", vertex_buffer, index_buffer,
+        data->mesh_count);
+    return true;
+}
+
+static bool read_bytes(frog_reader_t *reader, void *out, u64 size)
+{
+    if (size > reader->size - reader->pos)
+        return false;
+
+    MemoryCopy(out, reader->data + reader->pos, size);
+    reader->pos += size;
+    return true;
+}
+
+static string read_string(arena_t *arena, frog_reader_t *reader)
+{
+    u16 name_len;
+
+    u64 pos = MemoryArena_Pos(arena);
+    if (!read_bytes(reader, &name_len, sizeof(u16)))
+        goto fail;
+
+    string s = string_new(arena, name_len);
+
+    if (!read_bytes(reader, s.str, name_len))
+        goto fail;
+    s.len = name_len;
+    return s;
+
+fail:
+    MemoryArena_PopTo(arena, pos);
+    return string_empty();
+}
+
+static bool read_vec3(vec3 *out, frog_reader_t *reader)
+{
+    return read_bytes(reader, out->Elements, sizeof(out->Elements));
+}
+
+static bool read_quat(quat *out, frog_reader_t *reader)
+{
+    return read_bytes(reader, out->Elements, sizeof(out->Elements));
+}
+
+/* packed fields read one at a time; normals derived from the positions */
+static bool parse_v1(arena_t *arena, arena_t *scratch, frog_reader_t *file, const char *name,
+                     frog_model_data_t *out)
+{
+    frog_header_t header;
+    if (!read_bytes(file, &header, sizeof(header)))
+    {
+        Log(ERROR, "failed to read frog header from file: %s", name);
+        return false;
+    }
+
+    Log(DEBUG, "read frog header from file: %s { magic=%lX version=%u tri=%u mat=%u anchors=%u anims=%u",
+        name, header.magic, header.version, header.triangle_count, header.material_count, header.anchor_count, header.animation_count);
+
+    model_t *model = arena_push(arena, model_t);
 
     model->material_count = header.material_count;
-    model->materials = arena_push_array(g_engine_arena, model_material_t, model->material_count);
+    model->materials = arena_push_array(arena, model_material_t, model->material_count);
     model->anchor_count = header.anchor_count;
-    model->anchor_names = arena_push_array(g_engine_arena, string, model->anchor_count);
+    model->anchor_names = arena_push_array(arena, string, model->anchor_count);
     model->animation_count = header.animation_count;
-    model->animations = arena_push_array(g_engine_arena, model_animation_t, model->animation_count);
+    model->animations = arena_push_array(arena, model_animation_t, model->animation_count);
 
     // Materials
     for (u32 i = 0; i < model->material_count; i++)
     {
         model_material_t *material = &model->materials[i];
 
-        material->name = read_string(g_engine_arena, file);
+        material->name = read_string(arena, file);
         if (!material->name.len)
             goto fail;
 
@@ -125,25 +414,26 @@ model_handle_t Frog_LoadModel(const char *path)
     }
 
     // Triangle material index
-    u8 *triangle_materials = arena_push_array(g_scratch, u8, header.triangle_count);
-    if (!fread(triangle_materials, header.triangle_count, 1, file))
+    u8 *triangle_materials = arena_push_array(scratch, u8, header.triangle_count);
+    if (!read_bytes(file, triangle_materials, header.triangle_count))
         goto fail;
 
     // Anchor names
     for (u32 i = 0; i < model->anchor_count; i++)
     {
         string *ptr = &model->anchor_names[i];
-        *ptr = read_string(g_engine_arena, file);
+        *ptr = read_string(arena, file);
         if (!ptr->len)
             goto fail;
         Log(DEBUG, "read anchor name: %S", *ptr);
     }
 
-    u32 index_count = header.triangle_count * 3;
-    u32 *indices = arena_push_array(g_scratch, u32, index_count);
-    for (u32 i = 0; i < index_count; i++)
-        indices[i] = i;
-    VkBuffer index_buffer = Renderer_CreateStaticIndexBuffer(indices, index_count);
+    /* every keyframe takes at least its time and positions, which bounds
+       the number of keyframe meshes by the file size */
+    u32 vertex_count = header.triangle_count * 3;
+    u64 max_meshes = file->size / (sizeof(f32) + (u64)vertex_count * sizeof(vec3));
+    u32 mesh_count = 0;
+    normal_material_vertex_t **vertices = arena_push_array_no_zero(scratch, normal_material_vertex_t *, max_meshes);
 
     // Animations
     for (u32 anim_idx = 0; anim_idx < model->animation_count; anim_idx++)
@@ -151,26 +441,33 @@ model_handle_t Frog_LoadModel(const char *path)
         Log(DEBUG, "anim %u", anim_idx);
         model_animation_t *animation = &model->animations[anim_idx];
 
-        animation->name = read_string(g_engine_arena, file);
+        animation->name = read_string(arena, file);
         if (!animation->name.len)
             goto fail;
 
-        if (!fread(&animation->keyframe_count, sizeof(u16), 1, file))
+        if (!read_bytes(file, &animation->keyframe_count, sizeof(u16)))
             goto fail;
 
         Log(DEBUG, "read animation header (%S, keyframes=%u)", animation->name, animation->keyframe_count);
 
-        animation->keyframes = arena_push_array(g_engine_arena, model_keyframe_t, animation->keyframe_count);
+        /* sampling and the instanced draws need a keyframe to hold */
+        if (animation->keyframe_count == 0)
+        {
+            Log(ERROR, "frog animation %S has no keyframes: %s", animation->name, name);
+            goto fail;
+        }
+
+        animation->keyframes = arena_push_array(arena, model_keyframe_t, animation->keyframe_count);
 
         for (u32 key_idx = 0; key_idx < animation->keyframe_count; key_idx++)
         {
             model_keyframe_t *keyframe = &animation->keyframes[key_idx];
 
-            if (!fread(&keyframe->time_s, sizeof(f32), 1, file))
+            if (!read_bytes(file, &keyframe->time_s, sizeof(f32)))
                 goto fail;
             Log(DEBUG, "read anim=%u keyframe %u time=%f", anim_idx, key_idx, keyframe->time_s);
 
-            normal_material_vertex_t *vertex_data = arena_push_array(g_scratch, normal_material_vertex_t, header.triangle_count * 3);
+            normal_material_vertex_t *vertex_data = arena_push_array(scratch, normal_material_vertex_t, vertex_count);
             for (u32 tri_idx =0; tri_idx < header.triangle_count; tri_idx++)
             {
                 normal_material_vertex_t *v0 = &vertex_data[tri_idx * 3];
@@ -194,21 +491,13 @@ model_handle_t Frog_LoadModel(const char *path)
                 v0->material = triangle_materials[tri_idx];
                 v1->material = triangle_materials[tri_idx];
                 v2->material = triangle_materials[tri_idx];
-                Log(DEBUG, "read triangle keyframe=%u: %v3 %v3 %v3 normal=%v3", key_idx, v0->position, v1->position, v2->position, normal);
             }
 
-            VkBuffer vertex_buffer = Renderer_CreateStaticVertexBuffer(vertex_data, sizeof(normal_material_vertex_t) * header.triangle_count * 3);
-
-            mesh_t *mesh = arena_push(g_engine_arena, mesh_t);
-            mesh->vertex_buffer = vertex_buffer;
-            mesh->index_buffer = index_buffer;
-            mesh->index_count = index_count;
-
-            Log(DEBUG, "created mesh vertex=%u index=%u count=%u", mesh->vertex_buffer, mesh->index_buffer, mesh->index_count);
-            keyframe->mesh = mesh;
+            Assert(mesh_count < max_meshes);
+            vertices[mesh_count++] = vertex_data;
+            keyframe->mesh = arena_push(arena, mesh_t);
 
-
-            keyframe->anchors = arena_push_array(g_engine_arena, model_anchor_t, header.anchor_count);
+            keyframe->anchors = arena_push_array(arena, model_anchor_t, header.anchor_count);
             for (u32 anchor_idx = 0; anchor_idx < header.anchor_count; anchor_idx++)
             {
                 model_anchor_t *anchor = &keyframe->anchors[anchor_idx];
@@ -216,56 +505,314 @@ model_handle_t Frog_LoadModel(const char *path)
                     goto fail;
                 if (!read_quat(&anchor->orientation, file))
                     goto fail;
-                Log(DEBUG, "read anchor keyframe=%u: %v3 %v4", anchor->pos, anchor->orientation);
             }
         }
     }
 
-    handle = model;
-exit:
-    fclose(file);
-    MemoryArena_Clear(g_scratch);
-    return handle;
+    // Weld across the keyframes and reorder, as the exporter does for version 3
+    u32 *indices = arena_push_array_no_zero(scratch, u32, vertex_count);
+    for (u32 i = 0; i < vertex_count; i++)
+        indices[i] = i;
+
+    u32 welded_count = vertex_count;
+    if (mesh_count > 0)
+    {
+        mesh_optimize_result_t optimized =
+            MeshOptimize_Mesh(scratch, indices, vertex_count, (void *const *)vertices, mesh_count, vertex_count,
+                              sizeof(normal_material_vertex_t));
+        Log(DEBUG, "frog '%s': %u -> %u vertices, acmr %.3f -> %.3f, atvr %.3f -> %.3f", name, vertex_count,
+            optimized.vertex_count, optimized.before.acmr, optimized.after.acmr, optimized.before.atvr,
+            optimized.after.atvr);
+        welded_count = optimized.vertex_count;
+    }
+
+    *out = (frog_model_data_t){
+        .model = model,
+        .mesh_count = mesh_count,
+        .vertices = (const normal_material_vertex_t **)vertices,
+        .vertex_count = welded_count,
+        .indices = indices,
+        .index_count = vertex_count,
+    };
+    return true;
 
 fail:
-    Log(ERROR, "failed to frog file: %s", path);
-    fclose(file);
-    MemoryArena_Clear(g_scratch);
-    MemoryArena_PopTo(g_engine_arena, pos);
-    return MODEL_INVALID_HANDLE;
+    Log(ERROR, "failed to frog file: %s", name);
+    return false;
 }
 
-static string read_string(arena_t *arena, FILE *file)
+/* versions 2 and 3; blocks are checked once, the vertex streams and the
+   indices then point into data */
+static bool parse_blocks(arena_t *arena, arena_t *scratch, const u8 *data, u64 size, u16 version,
+                         const char *name, frog_model_data_t *out)
 {
-    u16 name_len;
+    frog_header_v3_t header_v3 = {};
+    u64 header_size = version == 2 ? sizeof(frog_header_v2_t) : sizeof(frog_header_v3_t);
+    if (size < header_size)
+        goto fail;
+    MemoryCopy(&header_v3, data, header_size);
+    frog_header_v2_t header = header_v3.base;
 
-    u64 pos = MemoryArena_Pos(arena);
-    Assert(file);
-    if (!fread(&name_len, sizeof(u16), 1, file))
+    Log(DEBUG, "read frog header from file: %s { version=%u tri=%u mat=%u anchors=%u anims=%u keyframes=%u",
+        name, header.version, header.triangle_count, header.material_count, header.anchor_count,
+        header.animation_count, header.keyframe_count);
+
+    if (header.vertex_stride != sizeof(normal_material_vertex_t))
+    {
+        Log(ERROR, "frog vertex stride %u, expected %u: %s", header.vertex_stride,
+            (u32)sizeof(normal_material_vertex_t), name);
+        return false;
+    }
+
+    /* version 2 is unindexed */
+    u64 vertex_count = version == 2 ? (u64)header.triangle_count * 3 : header_v3.vertex_count;
+    u64 index_count = (u64)header.triangle_count * 3;
+    const u32 *indices = NULL;
+    if (version == 3)
+    {
+        if (header_v3.index_count != index_count
+            || !block_in_file(header_v3.indices_offset, index_count * sizeof(u32), size))
+            goto fail;
+
+        /* the indices go to the gpu as they are, so none may point past the
+           vertices */
+        indices = (const u32 *)(data + header_v3.indices_offset);
+        u32 max_index = 0;
+        for (u64 i = 0; i < index_count; i++)
+            max_index = Max(max_index, indices[i]);
+        if (index_count > 0 && max_index >= vertex_count)
+            goto fail;
+    }
+
+    u64 keyframe_size = AlignPow2(vertex_count * sizeof(normal_material_vertex_t), 16);
+    u64 anchor_size = sizeof(vec3) + sizeof(quat);
+    if (index_count > U32_MAX
+        || !block_in_file(header.materials_offset, (u64)header.material_count * 2 * sizeof(vec3), size)
+        || !block_in_file(header.animations_offset, (u64)header.animation_count * sizeof(u32), size)
+        || !block_in_file(header.keyframes_offset, (u64)header.keyframe_count * sizeof(f32), size)
+        || !block_in_file(header.anchors_offset,
+                          (u64)header.keyframe_count * header.anchor_count * anchor_size, size)
+        || !block_in_file(header.vertices_offset, (u64)header.keyframe_count * keyframe_size, size)
+        || header.names_offset > size)
         goto fail;
 
-    string s = string_new(arena, name_len);
+    model_t *model = arena_push(arena, model_t);
+    model->material_count = header.material_count;
+    model->materials = arena_push_array(arena, model_material_t, model->material_count);
+    model->anchor_count = header.anchor_count;
+    model->anchor_names = arena_push_array(arena, string, model->anchor_count);
+    model->animation_count = header.animation_count;
+    model->animations = arena_push_array(arena, model_animation_t, model->animation_count);
+
+    frog_reader_t names = {.data = data, .size = size, .pos = header.names_offset};
+    const u8 *materials = data + header.materials_offset;
+    for (u32 i = 0; i < model->material_count; i++)
+    {
+        model_material_t *material = &model->materials[i];
+        material->name = read_string(arena, &names);
+        if (!material->name.len)
+            goto fail;
+
+        MemoryCopy(material->base_color.Elements, materials + i * 2 * sizeof(vec3), sizeof(vec3));
+        MemoryCopy(material->specular_color.Elements, materials + (i * 2 + 1) * sizeof(vec3), sizeof(vec3));
+    }
+
+    for (u32 i = 0; i < model->anchor_count; i++)
+    {
+        model->anchor_names[i] = read_string(arena, &names);
+        if (!model->anchor_names[i].len)
+            goto fail;
+    }
 
-    if (!fread(s.str, name_len, 1, file))
+    const normal_material_vertex_t **vertices =
+        arena_push_array_no_zero(scratch, const normal_material_vertex_t *, header.keyframe_count);
+    u32 mesh_count = 0;
+
+    for (u32 anim_idx = 0; anim_idx < model->animation_count; anim_idx++)
+    {
+        model_animation_t *animation = &model->animations[anim_idx];
+        animation->name = read_string(arena, &names);
+        if (!animation->name.len)
+            goto fail;
+
+        u32 keyframe_count;
+        MemoryCopy(&keyframe_count, data + header.animations_offset + anim_idx * sizeof(u32), sizeof(u32));
+        if (keyframe_count > U16_MAX || keyframe_count > header.keyframe_count - mesh_count)
+            goto fail;
+        if (keyframe_count == 0)
+        {
+            Log(ERROR, "frog animation %S has no keyframes: %s", animation->name, name);
+            goto fail;
+        }
+
+        animation->keyframe_count = (u16)keyframe_count;
+        animation->keyframes = arena_push_array(arena, model_keyframe_t, keyframe_count);
+
+        for (u32 key_idx = 0; key_idx < keyframe_count; key_idx++)
+        {
+            model_keyframe_t *keyframe = &animation->keyframes[key_idx];
+            MemoryCopy(&keyframe->time_s, data + header.keyframes_offset + mesh_count * sizeof(f32), sizeof(f32));
+
+            /* the model's anchor structs may be padded, the file's aren't */
+            const u8 *anchors = data + header.anchors_offset + (u64)mesh_count * header.anchor_count * anchor_size;
+            keyframe->anchors = arena_push_array(arena, model_anchor_t, header.anchor_count);
+            for (u32 anchor_idx = 0; anchor_idx < header.anchor_count; anchor_idx++)
+            {
+                model_anchor_t *anchor = &keyframe->anchors[anchor_idx];
+                MemoryCopy(anchor->pos.Elements, anchors + anchor_idx * anchor_size, sizeof(vec3));
+                MemoryCopy(anchor->orientation.Elements, anchors + anchor_idx * anchor_size + sizeof(vec3),
+                           sizeof(quat));
+            }
+
+            keyframe->mesh = arena_push(arena, mesh_t);
+            vertices[mesh_count] = (const normal_material_vertex_t *)(data + header.vertices_offset
+                                                                      + mesh_count * keyframe_size);
+            mesh_count++;
+        }
+    }
+
+    if (mesh_count != header.keyframe_count)
         goto fail;
-    s.len = name_len;
-    return s;
+
+    *out = (frog_model_data_t){
+        .model = model,
+        .mesh_count = mesh_count,
+        .vertices = vertices,
+        .vertex_count = (u32)vertex_count,
+        .indices = indices,
+        .index_count = (u32)index_count,
+    };
+    return true;
 
 fail:
-    MemoryArena_PopTo(arena, pos);
-    return string_empty();
+    Log(ERROR, "failed to frog file: %s", name);
+    return false;
 }
 
-static bool read_vec3(vec3 *out, FILE *file)
+/* coarser levels of detail, simplified over every keyframe at once. a
+   level's triangles get flat shaded vertices of their own, appended to
+   each keyframe's stream, so a keyframe stays one block and a draw picks a
+   level by its index range and vertex_offset */
+static bool build_lods(arena_t *scratch, const char *name, frog_model_data_t *data)
 {
-    if (!fread(out->Elements, sizeof(out->Elements), 1, file))
-        return false;
+    ProfileZone("Frog build_lods");
+    u32 vertex_count = data->vertex_count;
+    u32 index_count = data->indices ? data->index_count : vertex_count;
+    data->lods[0] = (mesh_lod_t){.index_count = index_count};
+    data->lod_count = 1;
+    if (data->mesh_count == 0)
+        return true;
+
+    u32 *indices = arena_push_array_no_zero(scratch, u32, (u64)index_count * 3);
+    u32 *sources = arena_push_array_no_zero(scratch, u32, index_count);
+    for (u32 i = 0; i < index_count; i++)
+        indices[i] = data->indices ? data->indices[i] : i;
+
+    mesh_lod_t lods[MESH_MAX_LODS];
+    u32 lod_count = MeshOptimize_Lods(scratch, lods, indices, sources, index_count,
+                                      (const void *const *)data->vertices, data->mesh_count, vertex_count,
+                                      sizeof(normal_material_vertex_t));
+    if (lod_count == 1)
+        return true;
+
+    // Unshared vertices per level and keyframe, with the material of the triangle each came from
+    normal_material_vertex_t **level_vertices[MESH_MAX_LODS];
+    u32 level_vertex_counts[MESH_MAX_LODS];
+    u32 total_vertex_count = vertex_count;
+    for (u32 level = 1; level < lod_count; level++)
+    {
+        mesh_lod_t *lod = &lods[level];
+        u32 *level_indices = indices + lod->first_index;
+        u32 count = lod->index_count;
+
+        normal_material_vertex_t **streams =
+            arena_push_array_no_zero(scratch, normal_material_vertex_t *, data->mesh_count);
+        for (u32 k = 0; k < data->mesh_count; k++)
+        {
+            const normal_material_vertex_t *source = data->vertices[k];
+            streams[k] = arena_push_array_no_zero(scratch, normal_material_vertex_t, count);
+            for (u32 t = 0; t < count / 3; t++)
+            {
+                const u32 *corners = &level_indices[t * 3];
+                u32 source_triangle = sources[lod->first_index / 3 + t];
+                u32 material = data->vertices[0][indices[source_triangle * 3]].material;
+                vec3 normal = flat_normal(source[corners[0]].position, source[corners[1]].position,
+                                          source[corners[2]].position);
+                for (u32 c = 0; c < 3; c++)
+                {
+                    streams[k][t * 3 + c] = (normal_material_vertex_t){
+                        .position = source[corners[c]].position,
+                        .normal = normal,
+                        .material = material,
+                    };
+                }
+            }
+        }
+
+        /* weld and reorder like a version 1 model; the level keeps its
+           index range, now over its own vertices */
+        for (u32 i = 0; i < count; i++)
+            level_indices[i] = i;
+        mesh_optimize_result_t optimized = MeshOptimize_Mesh(scratch, level_indices, count, (void *const *)streams,
+                                                             data->mesh_count, count,
+                                                             sizeof(normal_material_vertex_t));
+
+        level_vertices[level] = streams;
+        level_vertex_counts[level] = optimized.vertex_count;
+        lod->vertex_offset = total_vertex_count;
+        total_vertex_count += optimized.vertex_count;
+        Log(DEBUG, "frog '%s': lod %u has %u triangles and %u vertices, error %.4f", name, level, count / 3,
+            optimized.vertex_count, lod->error);
+    }
+
+    // Every keyframe's stream with the levels behind the full detail
+    const normal_material_vertex_t **vertices =
+        arena_push_array_no_zero(scratch, const normal_material_vertex_t *, data->mesh_count);
+    for (u32 k = 0; k < data->mesh_count; k++)
+    {
+        normal_material_vertex_t *stream = arena_push_array_no_zero(scratch, normal_material_vertex_t,
+                                                                     total_vertex_count);
+        MemoryCopy(stream, data->vertices[k], sizeof(normal_material_vertex_t) * vertex_count);
+        for (u32 level = 1; level < lod_count; level++)
+        {
+            MemoryCopy(stream + lods[level].vertex_offset, level_vertices[level][k],
+                       sizeof(normal_material_vertex_t) * level_vertex_counts[level]);
+        }
+        vertices[k] = stream;
+    }
+
+    const mesh_lod_t *last = &lods[lod_count - 1];
+    data->vertices = vertices;
+    data->vertex_count = total_vertex_count;
+    data->indices = indices;
+    data->index_count = last->first_index + last->index_count;
+    MemoryCopy(data->lods, lods, sizeof(lods));
+    data->lod_count = lod_count;
     return true;
 }
 
-static bool read_quat(quat *out, FILE *file)
+/* the most vertices any one level indexes, counting from its vertex_offset */
+static u32 max_lod_vertex_count(const frog_model_data_t *data)
 {
-    if (!fread(out->Elements, sizeof(out->Elements), 1, file))
-        return false;
-    return true;
+    u32 max_count = 0;
+    for (u32 i = 0; i < data->lod_count; i++)
+    {
+        u32 end = i + 1 < data->lod_count ? data->lods[i + 1].vertex_offset : data->vertex_count;
+        max_count = Max(max_count, end - data->lods[i].vertex_offset);
+    }
+    return max_count;
+}
+
+/* as version 1 files get them; a zero area triangle gets +Y, as in the
+   exporter */
+static vec3 flat_normal(vec3 a, vec3 b, vec3 c)
+{
+    vec3 normal = HMM_Cross(HMM_SubV3(c, a), HMM_SubV3(b, a));
+    f32 length = HMM_LenV3(normal);
+    return length > 0.0f ? HMM_DivV3F(normal, length) : V3(0.0f, 1.0f, 0.0f);
+}
+
+static bool block_in_file(u64 offset, u64 block_size, u64 file_size)
+{
+    return offset % 16 == 0 && offset <= file_size && block_size <= file_size - offset;
 }
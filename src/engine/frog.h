@@ -1,8 +1,57 @@
 #ifndef FROG_MODEL_H
 #define FROG_MODEL_H
 
+#include "memory_arena.h"
+#include "mesh.h"
 #include "model.h"
+#include "render_types.h"
 
+/* the cpu side of a frog model: the model with its keyframe meshes allocated
+   but without buffers, and one vertex stream per keyframe mesh, in
+   animation then keyframe order */
+typedef struct
+{
+    model_t                         *model;
+
+    u32                             mesh_count;
+    const normal_material_vertex_t  **vertices;     /* vertex_count each */
+    u32                             vertex_count;
+
+    /* shared by every keyframe; NULL when unindexed, vertex_count being 3
+       per triangle then */
+    const u32                       *indices;
+    u32                             index_count;
+
+    /* lods[0] is the full detail. coarser levels each have their own
+       range of the indices and their own vertices from vertex_offset on,
+       in every keyframe stream */
+    mesh_lod_t                      lods[MESH_MAX_LODS];
+    u32                             lod_count;
+} frog_model_data_t;
+
+/* parses a whole file, version 1 to 3, and simplifies it into levels of
+   detail; the model lives on arena. version 1 vertex streams and indices
+   are built and optimized on scratch, as are those of a model with levels
+   of detail; the others point into data, so data must outlive Frog_Upload.
+   name only labels errors; an animation without keyframes fails the parse.
+   touches no engine state, so it can run on any thread */
+bool Frog_Parse(arena_t *arena, arena_t *scratch, const u8 *data, u64 size, const char *name,
+                frog_model_data_t *out);
+
+/* gives every keyframe mesh its buffers: one shared index buffer, 16 bit
+   when the vertex count allows, plus one pull buffer holding all keyframes
+   back to back as packed_material_vertex_t, each keyframe mesh starting at
+   its own vertex_offset. that lets Renderer_DrawModelAnimated blend any two
+   keyframes in the vertex shader, at any level of detail. a third buffer
+   holds the animation table for instanced draws; a model without
+   keyframes gets the index buffer only. deferred uses the per-frame upload
+   path, see Renderer_UploadStaticVertexBuffer */
+bool Frog_Upload(const frog_model_data_t *data, bool deferred);
+
+/* the index and vertex bytes Frog_Upload copies to the gpu */
+u64 Frog_UploadSize(const frog_model_data_t *data);
+
+/* path is looked up through the vfs, see Vfs_Open */
 model_handle_t Frog_LoadModel(const char *path);
 
 #endif
@@ -1,4 +1,5 @@
 #include "log.h"
+#include "profiler.h"
 
 #include "image.h"
 
@@ -12,20 +13,27 @@
 #include "stb_image.h"
 #pragma GCC diagnostic pop
 
-bool Image_Load(const char *path, image_t *image_out)
+bool Image_Decode(const u8 *data, u64 size, const char *name, image_t *image_out)
 {
+    ProfileZone("Image_Decode");
     int width, height, channels;
 
-    u8 *data = stbi_load(path, &width, &height, &channels, STBI_rgb_alpha);
-    if (data == NULL)
+    if (size > INT32_MAX)
     {
-        Log(ERROR, "failed to load image %s: %s", path, stbi_failure_reason());
+        Log(ERROR, "image too large: %s", name);
+        return false;
+    }
+
+    u8 *pixels = stbi_load_from_memory(data, (int)size, &width, &height, &channels, STBI_rgb_alpha);
+    if (pixels == NULL)
+    {
+        Log(ERROR, "failed to load image %s: %s", name, stbi_failure_reason());
         return false;
     }
 
     image_out->width = (u32)width;
     image_out->height = (u32)height;
-    image_out->data = data;
+    image_out->data = pixels;
 
     return true;
 }
@@ -11,7 +11,8 @@ struct _image_t
     u8  *data; /* rgba8, width * height * 4 bytes */
 };
 
-bool Image_Load(const char *path, image_t *image_out);
+/* decodes a png held in memory; name only labels errors */
+bool Image_Decode(const u8 *data, u64 size, const char *name, image_t *image_out);
 void Image_Unload(image_t *image);
 
 #endif
@@ -0,0 +1,32 @@
+#ifndef BLOCK_COMPRESS_H
+#define BLOCK_COMPRESS_H
+
+#include "core.h"
+#include "render_types.h"
+
+/* block compression of rgba8 levels for the texture cook, and the matching
+   decoders for devices that can't sample the formats. every format codes
+   4x4 texel blocks; levels not a multiple of 4 repeat their last row and
+   column into the padding. the encoders trade quality for speed about
+   like a single pass cook should:
+   - bc1: endpoints along the principal axis of the block, 1 bit alpha
+   - bc4: the red channel, endpoints at its extremes
+   - bc7: mode 6 only (one subset, rgba endpoints, 4 bit indices), so the
+     decoder only knows mode 6 too */
+
+/* bytes of one width x height level of format */
+u64 BlockCompress_LevelSize(texture_format_t format, u32 width, u32 height);
+
+/* codes a tightly packed rgba8 level into dst, BlockCompress_LevelSize
+   bytes. format is one of the block compressed ones */
+void BlockCompress_Encode(texture_format_t format, void *dst, const u8 *rgba, u32 width, u32 height);
+
+/* the uncompressed format a block compressed one decodes to: rgba8 srgb,
+   or r8 for bc4 */
+texture_format_t BlockCompress_DecodedFormat(texture_format_t format);
+
+/* decodes a level coded by BlockCompress_Encode into dst, tightly packed
+   in BlockCompress_DecodedFormat; false on a block it doesn't know */
+bool BlockCompress_Decode(texture_format_t format, u8 *dst, const void *blocks, u32 width, u32 height);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include "core.h"
+#include "render_types.h"
+
+/* the subset of ktx2 the texture cook writes: one 2d image in a block
+   compressed format, no array layers, faces or supercompression. the
+   levels are stored smallest first, as the format asks, so the mip tail
+   leads the level data. files are little endian */
+
+/* bytes Ktx2_Write writes for texture and one key/value entry */
+u64 Ktx2_Size(const texture_data_t *texture, const char *key, u32 value_size);
+
+/* texture as a ktx2 file into dst, Ktx2_Size bytes, with key set to value
+   in its key/value data. the padding is zeroed */
+void Ktx2_Write(void *dst, const texture_data_t *texture, const char *key, const void *value, u32 value_size);
+
+/* checks that data is a ktx2 file this subset covers, with every level
+   inside it and of the size its format gives. the levels of texture_out
+   point into data; *value_out is key's value, NULL if the file has none */
+bool Ktx2_Parse(const void *data, u64 size, const char *key, texture_data_t *texture_out, const void **value_out,
+                u32 *value_size_out);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "core.h"
+#include "file.h"
+#include "memory_arena.h"
+#include "obj.h"
+
+/* cooked obj imports: what Obj_Parse produced for a source file, stored in
+   MESH_CACHE_DIR next to the executable, one file per source path. an entry
+   is used while it was cooked from the same source bytes by the same
+   OBJ_IMPORTER_VERSION; otherwise the source is parsed and cooked again */
+
+#define MESH_CACHE_DIR      "cache/"
+#define MESH_CACHE_MAGIC    0x48534D4553464344ull  /* "DCFSMESH" */
+#define MESH_CACHE_VERSION  3
+
+/*
+ * file layout, little endian: the header, then the vertex data and the
+ * indices of index_type, each at their offset, 16 byte aligned. the
+ * indices hold every level of detail, as obj_mesh_data_t has them
+ */
+
+typedef struct
+{
+    u64 magic;
+    u32 version;                /* MESH_CACHE_VERSION */
+    u32 importer_version;       /* OBJ_IMPORTER_VERSION */
+    u64 source_hash;            /* MeshCache_SourceHash */
+    u64 source_size;
+
+    u32 layout;                 /* obj_vertex_layout_t */
+    u32 vertex_count;
+    u32 index_count;
+    u32 index_type;             /* index_type_t */
+    f32 bounds_min[3];
+    f32 bounds_max[3];
+
+    u64 vertex_offset;
+    u64 index_offset;
+
+    u32 lod_count;
+    u32 reserved;
+    mesh_lod_t lods[MESH_MAX_LODS];
+} AttributePacked mesh_cache_header_t;
+
+/* XXH3 of the source bytes, seeded with OBJ_IMPORTER_VERSION */
+u64 MeshCache_SourceHash(const void *source, u64 size);
+
+/* where the cooked entry for path lives */
+void MeshCache_GetPath(const char *path, char *out, u64 out_size);
+
+/* the obj at path (as for Vfs_Open), from its cooked entry when that is
+   current, else parsed onto arena and cooked for the next load. a cooked
+   mesh points straight into *map_out: unmap it with File_Unmap once the
+   mesh is uploaded */
+bool MeshCache_LoadObj(arena_t *arena, const char *path, obj_mesh_data_t *mesh_out, file_map_t *map_out);
+
+#endif
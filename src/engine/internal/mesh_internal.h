@@ -4,12 +4,33 @@
 #include <vulkan/vulkan_core.h>
 
 #include "core.h"
+#include "core_math.h"
+#include "mesh.h"
+#include "obj.h"
+#include "render_types.h"
+#include "renderer.h"
 
 struct _mesh_t
 {
     VkBuffer vertex_buffer;
     VkBuffer index_buffer;
     u32 index_count;
+    index_type_t index_type;
+
+    u32 vertex_offset;      /* first vertex, for meshes sharing a vertex buffer */
+    u32 first_index;        /* likewise for the index buffer */
+    u64 vertex_address;     /* 0 unless the vertex buffer is a pull buffer */
+
+    /* levels of detail, lods[0] the full one drawn by index_count from the
+       start; lod_count 0 when there are no others. the renderer picks one
+       from the bounding sphere's size on screen */
+    mesh_lod_t lods[MESH_MAX_LODS];
+    u32 lod_count;
+    vec3 center;
+    f32 radius;
 };
 
+/* fills in what the draws need of an uploaded obj mesh */
+void MeshManager_SetObjMesh(mesh_t *mesh, const mesh_buffers_t *buffers, const obj_mesh_data_t *obj);
+
 #endif
@@ -0,0 +1,89 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include "core.h"
+#include "memory_arena.h"
+#include "render_types.h"
+
+/* index and vertex order passes for the import and cook paths. they all
+   work on triangle lists of u32 indices; temporary memory comes from
+   arena and is popped again before returning */
+
+/* the post-transform cache the passes and the statistics assume: a fifo
+   of 16 entries, a conservative stand-in for current gpus */
+#define MESH_OPTIMIZE_CACHE_SIZE 16
+
+/* MeshOptimize_Lods stops before a level would go below this */
+#define MESH_OPTIMIZE_LOD_MIN_TRIANGLES 64
+
+typedef struct
+{
+    f32 acmr;   /* transformed vertices per triangle: 3 unshared, ~0.5 ideal */
+    f32 atvr;   /* transformed vertices per referenced vertex: 1 ideal */
+} mesh_cache_stats_t;
+
+typedef struct
+{
+    u32                 vertex_count;
+    mesh_cache_stats_t  before;
+    mesh_cache_stats_t  after;
+} mesh_optimize_result_t;
+
+/* welds vertices that are bytewise identical in each of stream_count
+   streams of vertex_count vertices. the keyframes of a model share one
+   index buffer, so a vertex only merges where it matches in all of them.
+   remap_out[i] is the new index of vertex i, numbered in first occurrence
+   order; returns the new vertex count */
+u32 MeshOptimize_Weld(arena_t *arena, u32 *remap_out, const void *const *streams, u32 stream_count,
+                      u32 vertex_count, u32 stride);
+
+/* reorders the triangles for post-transform cache hits (tipsify, Sander et
+   al. 2007); linear time, the vertices are untouched */
+void MeshOptimize_VertexCache(arena_t *arena, u32 *indices, u32 index_count, u32 vertex_count);
+
+/* renumbers the vertices in the order the indices first use them, so the
+   vertex fetch walks memory forwards, and rewrites the indices to match.
+   remap_out[i] is the new index of vertex i, U32_MAX if no triangle uses
+   it; returns the new vertex count */
+u32 MeshOptimize_VertexFetch(u32 *remap_out, u32 *indices, u32 index_count, u32 vertex_count);
+
+/* applies a remap to the indices and to a vertex stream: dst[remap[i]] =
+   src[i], skipping unused vertices. dst and src must not overlap */
+void MeshOptimize_RemapIndices(u32 *indices, u32 index_count, const u32 *remap);
+void MeshOptimize_RemapVertices(void *dst, const void *src, const u32 *remap, u32 vertex_count, u32 stride);
+
+/* the whole pipeline in place: weld, vertex cache order, then vertex fetch
+   order. the streams are compacted to the returned vertex count and the
+   indices keep their count */
+mesh_optimize_result_t MeshOptimize_Mesh(arena_t *arena, u32 *indices, u32 index_count, void *const *streams,
+                                         u32 stream_count, u32 vertex_count, u32 stride);
+
+/* simplifies the triangles toward target_index_count indices by edge
+   collapses in order of quadric error (Garland and Heckbert 1997), summed
+   over the stream_count streams so a collapse suits every keyframe. the
+   positions are the leading vec3 of each vertex. vertices only collapse
+   onto others at the end of a shared edge, so the result indexes the same
+   vertices; vertices with equal positions are one for the topology, and
+   open edges stay put. writes at most index_count indices, and with
+   triangles_out the input triangle each one came from; returns the index
+   count and the largest collapse error, a distance, in *error_out */
+u32 MeshOptimize_Simplify(arena_t *arena, u32 *indices_out, u32 *triangles_out, const u32 *indices,
+                          u32 index_count, const void *const *streams, u32 stream_count, u32 vertex_count,
+                          u32 stride, u32 target_index_count, f32 *error_out);
+
+/* a level of detail chain for the triangles in indices[0, index_count):
+   each level simplifies the one before to about half its triangles, until
+   MESH_MAX_LODS levels, fewer than MESH_OPTIMIZE_LOD_MIN_TRIANGLES, or
+   simplification stalls. levels are appended to indices, which must hold
+   3 * index_count; lods_out[0] is the input. triangles_out, if not NULL,
+   holds as many triangles and gets the input triangle each one came from.
+   vertex cache order of the levels is up to the caller. returns the level
+   count */
+u32 MeshOptimize_Lods(arena_t *arena, mesh_lod_t *lods_out, u32 *indices, u32 *triangles_out, u32 index_count,
+                      const void *const *streams, u32 stream_count, u32 vertex_count, u32 stride);
+
+/* simulates the MESH_OPTIMIZE_CACHE_SIZE fifo over the triangles */
+mesh_cache_stats_t MeshOptimize_AnalyzeVertexCache(arena_t *arena, const u32 *indices, u32 index_count,
+                                                   u32 vertex_count);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include "core.h"
+#include "memory_arena.h"
+
+/* mip chains for rgba8 srgb textures, built on the cpu: uploads go through
+   host image copy, which has no command buffer to blit in. each level is a
+   2x2 box filter of the one above, averaged in linear space, so dark and
+   bright texels blend like the sampler blends them. levels are tightly
+   packed and stored back to back, level 0 first */
+
+/* builds the srgb conversion tables; once, on the main thread, before
+   anything else here */
+void Mipmap_Init(void);
+
+/* levels of a full chain, down to 1x1 */
+u32 Mipmap_LevelCount(u32 width, u32 height);
+
+/* bytes of the first level_count levels of a width x height chain */
+u64 Mipmap_ChainSize(u32 width, u32 height, u32 level_count);
+
+/* fills levels [1, level_count) of chain, which holds Mipmap_ChainSize
+   bytes with level 0 at its start. odd sizes drop their last row or
+   column, like a blit does. safe on any thread; temporary memory comes
+   from arena and is popped again before returning */
+void Mipmap_Generate(arena_t *arena, u8 *chain, u32 width, u32 height, u32 level_count);
+
+#endif
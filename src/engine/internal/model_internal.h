@@ -0,0 +1,22 @@
+#ifndef MODEL_INTERNAL_H
+#define MODEL_INTERNAL_H
+
+#include "core.h"
+#include "model.h"
+
+/* the animation table instanced model shaders sample from: this header,
+   then per animation its first keyframe (counting across animations) and
+   keyframe count, then per keyframe its time and first vertex in the pull
+   buffer at vertex_address. all fields are 4 bytes after the header */
+typedef struct
+{
+    u64 vertex_address;
+    u32 animation_count;
+    u32 keyframe_count;
+} model_table_header_t;
+
+/* builds and uploads the table of a model whose keyframe meshes share one
+   pull buffer; the address, 0 on failure. deferred as in Frog_Upload */
+u64 Model_UploadAnimationTable(const model_t *model, bool deferred);
+
+#endif
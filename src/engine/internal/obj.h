@@ -0,0 +1,70 @@
+#ifndef OBJ_H
+#define OBJ_H
+
+#include "core.h"
+#include "core_math.h"
+#include "memory_arena.h"
+#include "render_types.h"
+
+/* wavefront obj parsing, kept apart from the mesh manager so it can run
+   (and be benchmarked) without a renderer */
+
+/* obj indices are packed 21 bits each into a u64 dedup key */
+#define OBJ_MAX_INDEX ((1u << 21) - 1)
+
+/* bump whenever Obj_Parse output changes; cooked meshes of older versions
+   are then parsed again, see mesh_cache.h */
+#define OBJ_IMPORTER_VERSION 4
+
+typedef enum
+{
+    OBJ_VERTEX_TEXTURED_NORMAL,     /* textured_normal_vertex_t */
+    OBJ_VERTEX_NORMAL,              /* normal_vertex_t */
+
+    OBJ_VERTEX_LAYOUT_COUNT,
+} obj_vertex_layout_t;
+
+typedef struct
+{
+    /* 1-based obj indices, 0 = not present */
+    u32 v[3];
+    u32 t[3];
+    u32 n[3];
+} obj_face_t;
+
+typedef struct
+{
+    /* textured_normal_vertex_t, or normal_vertex_t when the obj has no uvs
+       so it renders with the same pipelines as the predefined meshes */
+    obj_vertex_layout_t layout;
+    const void          *vertex_data;
+    u64                 vertex_data_size;
+    u32                 vertex_count;
+
+    /* u16 when vertex_count allows, see VertexPack_IndexType. every level
+       of detail back to back, each a range of these over all vertices;
+       lods[0] is the full detail */
+    const void          *indices;
+    u32                 index_count;
+    index_type_t        index_type;
+    mesh_lod_t          lods[MESH_MAX_LODS];
+    u32                 lod_count;
+
+    /* of the referenced positions */
+    vec3                bounds_min;
+    vec3                bounds_max;
+} obj_mesh_data_t;
+
+/* the line parsers read [str, end), which needn't be null-terminated */
+bool Obj_ParseFloats(const char *str, const char *end, f32 *out, u32 count);
+
+/* accepts triangles with refs of the forms v, v/t, v//n and v/t/n */
+bool Obj_ParseFace(const char *str, const char *end, obj_face_t *face);
+
+/* parses a whole file into a deduplicated vertex and index stream on arena;
+   the lines are parsed in chunks on the job workers. name only labels
+   errors */
+bool Obj_Parse(arena_t *arena, const char *data, u64 size, const char *name,
+               obj_mesh_data_t *mesh_out);
+
+#endif
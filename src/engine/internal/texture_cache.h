@@ -0,0 +1,53 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "core.h"
+#include "file.h"
+#include "memory_arena.h"
+#include "render_types.h"
+
+/* cooked textures: a source image with the mips and block compression its
+   flags ask for, stored as a ktx2 file in TEXTURE_CACHE_DIR next to the
+   executable, one file per source path. an entry is used while it was
+   cooked from the same source bytes with the same flags by the same
+   TEXTURE_COOK_VERSION; otherwise the source is decoded and cooked again.
+   textures without a compression flag aren't cooked, as the png is
+   smaller than their texels */
+
+#define TEXTURE_CACHE_DIR       "cache/"
+#define TEXTURE_COOK_VERSION    1
+
+/* the ktx2 key/value entry an entry is checked against */
+#define TEXTURE_COOK_KEY        "dcfs.cook"
+
+typedef struct
+{
+    u64 source_hash;            /* TextureCache_SourceHash */
+    u64 source_size;
+    u32 cook_version;           /* TEXTURE_COOK_VERSION */
+    u32 flags;                  /* texture_flags_t */
+} AttributePacked texture_cook_info_t;
+
+/* XXH3 of the source bytes, seeded with TEXTURE_COOK_VERSION */
+u64 TextureCache_SourceHash(const void *source, u64 size);
+
+/* where the cooked entry for path lives */
+void TextureCache_GetPath(const char *path, char *out, u64 out_size);
+
+/* level 0 rgba8 pixels to what flags ask for: the mip chain, then block
+   compression. the texture lives on arena; the uncompressed chain of a
+   compressed texture is popped again */
+void TextureCache_Build(arena_t *arena, const u8 *rgba, u32 width, u32 height, texture_flags_t flags,
+                        texture_data_t *texture_out);
+
+/* a block compressed texture decoded onto arena, for devices that can't
+   sample its format; anything else is left as it is */
+bool TextureCache_Decompress(arena_t *arena, texture_data_t *texture);
+
+/* the png at path (as for Vfs_Open) as flags ask for. a compressed texture
+   comes from its cooked entry when that is current and points straight
+   into *map_out: unmap it with File_Unmap once the texture is uploaded */
+bool TextureCache_Load(arena_t *arena, const char *path, texture_flags_t flags, texture_data_t *texture_out,
+                       file_map_t *map_out);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef VERTEX_PACK_H
+#define VERTEX_PACK_H
+
+#include "core.h"
+#include "memory_arena.h"
+#include "mesh.h"
+#include "render_types.h"
+
+/* the most vertices 16 bit indices address; 0xffff stays unused as it is
+   the primitive restart index */
+#define VERTEX_PACK_MAX_U16_VERTICES 0xffff
+
+/* u16 when every index of a mesh with vertex_count vertices fits */
+index_type_t VertexPack_IndexType(u32 vertex_count);
+
+/* the indices as type: indices itself for u32, else narrowed onto arena */
+const void *VertexPack_Indices(arena_t *arena, const u32 *indices, u32 index_count, index_type_t type);
+
+/* bytes VertexPack_MaterialVertices writes for stream_count streams */
+u64 VertexPack_MaterialSize(u32 stream_count, u32 vertex_count);
+
+/* writes the packed_material_header_t and then the streams back to back,
+   all quantized to the bounds of every stream */
+void VertexPack_MaterialVertices(void *dst, const normal_material_vertex_t *const *streams, u32 stream_count,
+                                 u32 vertex_count);
+
+#endif
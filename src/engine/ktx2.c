@@ -0,0 +1,235 @@
+#include <string.h>
+
+#include "core.h"
+
+#include "block_compress.h"
+#include "ktx2.h"
+
+/* lcm of the block sizes and 4, as the format asks of level offsets */
+#define LEVEL_ALIGN 16
+
+/* data format descriptor: the total size, then one basic block with a
+   single sample covering the whole block */
+#define DFD_WORDS           11
+#define DFD_BLOCK_SIZE      40
+#define DFD_VERSION         2
+#define DFD_PRIMARIES_BT709 1
+#define DFD_TRANSFER_LINEAR 1
+#define DFD_TRANSFER_SRGB   2
+
+static const u8 s_identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+typedef struct
+{
+    u8  identifier[12];
+    u32 vk_format;
+    u32 type_size;
+    u32 pixel_width;
+    u32 pixel_height;
+    u32 pixel_depth;
+    u32 layer_count;
+    u32 face_count;
+    u32 level_count;
+    u32 supercompression_scheme;
+
+    u32 dfd_offset;
+    u32 dfd_length;
+    u32 kvd_offset;
+    u32 kvd_length;
+    u64 sgd_offset;
+    u64 sgd_length;
+} AttributePacked ktx2_header_t;
+StaticAssert(sizeof(ktx2_header_t) == 80, "ktx2_header_t must match the file format");
+
+typedef struct
+{
+    u64 offset;
+    u64 length;
+    u64 uncompressed_length;
+} AttributePacked ktx2_level_t;
+
+/* vk_format is the VkFormat value; the dfd values are from the khronos
+   data format spec */
+typedef struct
+{
+    texture_format_t    format;
+    u32                 vk_format;
+    u8                  color_model;
+    u8                  transfer;
+    u8                  channel;
+    u8                  block_bytes;
+} ktx2_format_t;
+
+static const ktx2_format_t s_formats[] = {
+    {TEXTURE_FORMAT_BC1_SRGB, 134, 128, DFD_TRANSFER_SRGB, 1, 8},   /* BC1_RGBA_SRGB, BC1A, alpha present */
+    {TEXTURE_FORMAT_BC4, 139, 131, DFD_TRANSFER_LINEAR, 0, 8},      /* BC4_UNORM */
+    {TEXTURE_FORMAT_BC7_SRGB, 146, 134, DFD_TRANSFER_SRGB, 0, 16},  /* BC7_SRGB */
+};
+
+static const ktx2_format_t *find_format(texture_format_t format, u32 vk_format);
+static u32 kvd_length(const char *key, u32 value_size);
+static u64 level_data_offset(u32 level_count, const char *key, u32 value_size);
+
+u64 Ktx2_Size(const texture_data_t *texture, const char *key, u32 value_size)
+{
+    u64 offset = level_data_offset(texture->level_count, key, value_size);
+    for (u32 i = texture->level_count; i-- > 0;)
+        offset = AlignPow2(offset, LEVEL_ALIGN) + texture->level_sizes[i];
+    return offset;
+}
+
+void Ktx2_Write(void *dst, const texture_data_t *texture, const char *key, const void *value, u32 value_size)
+{
+    const ktx2_format_t *format = find_format(texture->format, 0);
+    Assert(format != NULL && texture->level_count > 0);
+
+    u8 *data = dst;
+    u64 size = Ktx2_Size(texture, key, value_size);
+    MemoryZero(data, size);
+
+    u32 level_index_offset = sizeof(ktx2_header_t);
+    u32 dfd_offset = level_index_offset + texture->level_count * (u32)sizeof(ktx2_level_t);
+    u32 kvd_offset = dfd_offset + DFD_WORDS * sizeof(u32);
+
+    ktx2_header_t header = {
+        .vk_format = format->vk_format,
+        .type_size = 1,
+        .pixel_width = texture->width,
+        .pixel_height = texture->height,
+        .face_count = 1,
+        .level_count = texture->level_count,
+        .dfd_offset = dfd_offset,
+        .dfd_length = DFD_WORDS * sizeof(u32),
+        .kvd_offset = kvd_offset,
+        .kvd_length = kvd_length(key, value_size),
+    };
+    MemoryCopy(header.identifier, s_identifier, sizeof(s_identifier));
+    MemoryCopy(data, &header, sizeof(header));
+
+    u32 dfd[DFD_WORDS] = {
+        DFD_WORDS * sizeof(u32),
+        0, /* khronos vendor, basic descriptor type */
+        DFD_VERSION | DFD_BLOCK_SIZE << 16,
+        format->color_model | DFD_PRIMARIES_BT709 << 8 | (u32)format->transfer << 16,
+        3 | 3 << 8, /* 4x4 texel blocks */
+        format->block_bytes,
+        0,
+        (u32)(format->block_bytes * 8 - 1) << 16 | (u32)format->channel << 24,
+        0,
+        0,
+        U32_MAX,
+    };
+    MemoryCopy(data + dfd_offset, dfd, sizeof(dfd));
+
+    u32 key_size = (u32)strlen(key) + 1;
+    u32 entry_length = key_size + value_size;
+    MemoryCopy(data + kvd_offset, &entry_length, sizeof(entry_length));
+    MemoryCopy(data + kvd_offset + sizeof(entry_length), key, key_size);
+    MemoryCopy(data + kvd_offset + sizeof(entry_length) + key_size, value, value_size);
+
+    u64 offset = level_data_offset(texture->level_count, key, value_size);
+    for (u32 i = texture->level_count; i-- > 0;)
+    {
+        offset = AlignPow2(offset, LEVEL_ALIGN);
+        ktx2_level_t level = {
+            .offset = offset,
+            .length = texture->level_sizes[i],
+            .uncompressed_length = texture->level_sizes[i],
+        };
+        MemoryCopy(data + level_index_offset + i * sizeof(level), &level, sizeof(level));
+        MemoryCopy(data + offset, texture->levels[i], texture->level_sizes[i]);
+        offset += texture->level_sizes[i];
+    }
+}
+
+bool Ktx2_Parse(const void *data, u64 size, const char *key, texture_data_t *texture_out, const void **value_out,
+                u32 *value_size_out)
+{
+    const u8 *bytes = data;
+    *value_out = NULL;
+    *value_size_out = 0;
+
+    ktx2_header_t header;
+    if (size < sizeof(header))
+        return false;
+    MemoryCopy(&header, bytes, sizeof(header));
+
+    const ktx2_format_t *format = find_format(TEXTURE_FORMAT_COUNT, header.vk_format);
+    if (memcmp(header.identifier, s_identifier, sizeof(s_identifier)) != 0 || format == NULL
+        || header.type_size != 1 || header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth != 0
+        || header.layer_count > 1 || header.face_count != 1 || header.supercompression_scheme != 0
+        || header.level_count == 0 || header.level_count > TEXTURE_MAX_MIP_LEVELS
+        || (u64)header.kvd_offset + header.kvd_length > size)
+        return false;
+
+    u64 level_index_size = (u64)header.level_count * sizeof(ktx2_level_t);
+    if (sizeof(header) + level_index_size > size)
+        return false;
+
+    *texture_out = (texture_data_t){
+        .format = format->format,
+        .width = header.pixel_width,
+        .height = header.pixel_height,
+        .level_count = header.level_count,
+    };
+
+    for (u32 i = 0; i < header.level_count; i++)
+    {
+        ktx2_level_t level;
+        MemoryCopy(&level, bytes + sizeof(header) + i * sizeof(level), sizeof(level));
+
+        u32 width = Max(header.pixel_width >> i, 1u);
+        u32 height = Max(header.pixel_height >> i, 1u);
+        if (level.length != BlockCompress_LevelSize(format->format, width, height) || level.offset > size
+            || level.length > size - level.offset)
+            return false;
+
+        texture_out->levels[i] = bytes + level.offset;
+        texture_out->level_sizes[i] = level.length;
+    }
+
+    /* entries are a length, the key with its terminator and the value,
+       padded to 4 bytes */
+    const u8 *kvd = bytes + header.kvd_offset;
+    u32 key_size = (u32)strlen(key) + 1;
+    for (u32 offset = 0; offset + sizeof(u32) <= header.kvd_length;)
+    {
+        u32 entry_length;
+        MemoryCopy(&entry_length, kvd + offset, sizeof(entry_length));
+        offset += sizeof(entry_length);
+        if (entry_length > header.kvd_length - offset)
+            return false;
+
+        if (entry_length >= key_size && memcmp(kvd + offset, key, key_size) == 0)
+        {
+            *value_out = kvd + offset + key_size;
+            *value_size_out = entry_length - key_size;
+            break;
+        }
+        offset = (u32)AlignPow2(offset + entry_length, 4);
+    }
+
+    return true;
+}
+
+/* by format, or by vk_format when format is TEXTURE_FORMAT_COUNT */
+static const ktx2_format_t *find_format(texture_format_t format, u32 vk_format)
+{
+    for (u32 i = 0; i < ArrayCount(s_formats); i++)
+    {
+        if (format == TEXTURE_FORMAT_COUNT ? s_formats[i].vk_format == vk_format : s_formats[i].format == format)
+            return &s_formats[i];
+    }
+    return NULL;
+}
+
+static u32 kvd_length(const char *key, u32 value_size)
+{
+    return (u32)AlignPow2(sizeof(u32) + strlen(key) + 1 + value_size, 4);
+}
+
+static u64 level_data_offset(u32 level_count, const char *key, u32 value_size)
+{
+    return sizeof(ktx2_header_t) + (u64)level_count * sizeof(ktx2_level_t) + DFD_WORDS * sizeof(u32)
+        + kvd_length(key, value_size);
+}
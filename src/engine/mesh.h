@@ -29,6 +29,9 @@ typedef enum
     PREDEFINED_MESH_TEXTURED_TRIANGLE = 10,
     PREDEFINED_MESH_TEXTURED_QUAD     = 11,
 
+    /* normal_material_vertex_t, material 0; stands in for loading models */
+    PREDEFINED_MESH_MATERIAL_CUBE     = 12,
+
     PREDEFINED_MESH_COUNT,
 } predefined_mesh_t;
 
@@ -38,6 +41,7 @@ typedef struct _colored_vertex_t colored_vertex_t;
 typedef struct _textured_vertex_t textured_vertex_t;
 typedef struct _textured_normal_vertex_t textured_normal_vertex_t;
 typedef struct _normal_material_vertex_t normal_material_vertex_t;
+typedef struct _packed_material_vertex_t packed_material_vertex_t;
 struct _simple_vertex_t
 {
     vec3 position;
@@ -75,6 +79,24 @@ struct _normal_material_vertex_t
     u32 material;
 };
 
+/* normal_material_vertex_t as the model pull buffers hold it: a
+   packed_material_header_t, then the vertices. a position is offset +
+   scale * position / 32767, a step of 1/65534 of the model bounds per axis;
+   the normal is octahedral encoded */
+struct _packed_material_vertex_t
+{
+    i16 position[3];
+    u8  material;
+    u8  reserved;
+    i16 normal[2];
+};
+
+typedef struct
+{
+    f32 position_offset[4];
+    f32 position_scale[4];
+} packed_material_header_t;
+
 bool MeshManager_Init();
 
 mesh_handle_t MeshManager_GetPredefinedMesh(predefined_mesh_t mesh);
@@ -0,0 +1,198 @@
+#include <stdio.h>
+
+#include "core.h"
+#include "log.h"
+#include "os_file.h"
+#include "os_path.h"
+#include "profiler.h"
+#include "vfs.h"
+
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "obj.h"
+#include "vertex_pack.h"
+
+#include "xxh3.h"
+
+#define MAX_CACHE_PATH  512
+#define BLOCK_ALIGN     16
+
+static const u32 s_vertex_strides[OBJ_VERTEX_LAYOUT_COUNT] = {
+    [OBJ_VERTEX_TEXTURED_NORMAL] = sizeof(textured_normal_vertex_t),
+    [OBJ_VERTEX_NORMAL] = sizeof(normal_vertex_t),
+};
+
+static bool load_cooked(const char *path, const char *cooked_path, u64 source_hash, u64 source_size,
+                        obj_mesh_data_t *mesh_out, file_map_t *map_out);
+static void store_cooked(arena_t *arena, const char *cooked_path, u64 source_hash, u64 source_size,
+                         const obj_mesh_data_t *mesh);
+static bool block_in_file(u64 offset, u64 block_size, u64 file_size);
+
+u64 MeshCache_SourceHash(const void *source, u64 size)
+{
+    return XXH3_64bits_withSeed(source, size, OBJ_IMPORTER_VERSION);
+}
+
+/* named by the source path, so a changed source overwrites its entry */
+void MeshCache_GetPath(const char *path, char *out, u64 out_size)
+{
+    snprintf(out, out_size, "%s" MESH_CACHE_DIR "%016llx.mesh", OS_GetBasePath(),
+             (unsigned long long)Vfs_HashPath(path));
+}
+
+bool MeshCache_LoadObj(arena_t *arena, const char *path, obj_mesh_data_t *mesh_out, file_map_t *map_out)
+{
+    ProfileZone("MeshCache_LoadObj");
+    MemoryZeroItem(map_out);
+
+    vfs_file_t file;
+    if (!Vfs_Open(arena, path, &file))
+        return false;
+
+    char cooked_path[MAX_CACHE_PATH];
+    MeshCache_GetPath(path, cooked_path, sizeof(cooked_path));
+
+    u64 source_hash = MeshCache_SourceHash(file.data, file.size);
+    u64 source_size = file.size;
+    if (load_cooked(path, cooked_path, source_hash, source_size, mesh_out, map_out))
+    {
+        Vfs_Close(&file);
+        return true;
+    }
+
+    /* the parser copies what it keeps, so the file goes right after */
+    bool parsed = Obj_Parse(arena, (const char *)file.data, file.size, path, mesh_out);
+    Vfs_Close(&file);
+    if (!parsed)
+        return false;
+
+    store_cooked(arena, cooked_path, source_hash, source_size, mesh_out);
+    return true;
+}
+
+static bool load_cooked(const char *path, const char *cooked_path, u64 source_hash, u64 source_size,
+                        obj_mesh_data_t *mesh_out, file_map_t *map_out)
+{
+    /* no entry is the normal first load, so no File_Map error for it */
+    file_map_t map;
+    if (!OS_FileMap(cooked_path, &map.data, &map.size))
+        return false;
+
+    mesh_cache_header_t header;
+    if (map.size < sizeof(header))
+        goto stale;
+    MemoryCopy(&header, map.data, sizeof(header));
+
+    if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION
+        || header.importer_version != OBJ_IMPORTER_VERSION || header.source_hash != source_hash
+        || header.source_size != source_size || header.layout >= OBJ_VERTEX_LAYOUT_COUNT
+        || header.index_type != VertexPack_IndexType(header.vertex_count)
+        || header.vertex_count == 0 || header.index_count == 0
+        || header.lod_count == 0 || header.lod_count > MESH_MAX_LODS)
+        goto stale;
+
+    /* the levels share the vertices, so the index check covers them */
+    for (u32 i = 0; i < header.lod_count; i++)
+    {
+        mesh_lod_t lod = header.lods[i];
+        if (lod.vertex_offset != 0 || lod.first_index > header.index_count
+            || lod.index_count > header.index_count - lod.first_index)
+            goto stale;
+    }
+
+    index_type_t index_type = (index_type_t)header.index_type;
+    u64 vertex_data_size = (u64)header.vertex_count * s_vertex_strides[header.layout];
+    if (!block_in_file(header.vertex_offset, vertex_data_size, map.size)
+        || !block_in_file(header.index_offset, (u64)header.index_count * INDEX_TYPE_SIZE(index_type), map.size))
+        goto stale;
+
+    /* the indices go to the gpu as they are, so none may point past the
+       vertices */
+    const void *indices = map.data + header.index_offset;
+    u32 max_index = 0;
+    if (index_type == INDEX_TYPE_U16)
+    {
+        for (u32 i = 0; i < header.index_count; i++)
+            max_index = Max(max_index, ((const u16 *)indices)[i]);
+    }
+    else
+    {
+        for (u32 i = 0; i < header.index_count; i++)
+            max_index = Max(max_index, ((const u32 *)indices)[i]);
+    }
+    if (max_index >= header.vertex_count)
+        goto stale;
+
+    *mesh_out = (obj_mesh_data_t){
+        .layout = (obj_vertex_layout_t)header.layout,
+        .vertex_data = map.data + header.vertex_offset,
+        .vertex_data_size = vertex_data_size,
+        .vertex_count = header.vertex_count,
+        .indices = indices,
+        .index_count = header.index_count,
+        .index_type = index_type,
+        .lod_count = header.lod_count,
+        .bounds_min = V3(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]),
+        .bounds_max = V3(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]),
+    };
+    MemoryCopy(mesh_out->lods, header.lods, sizeof(mesh_lod_t) * header.lod_count);
+    *map_out = map;
+    return true;
+
+stale:
+    Log(INFO, "cooked mesh for '%s' is stale, parsing the source", path);
+    OS_FileUnmap(map.data, map.size);
+    return false;
+}
+
+/* best effort: a failed write only costs the next load a parse */
+static void store_cooked(arena_t *arena, const char *cooked_path, u64 source_hash, u64 source_size,
+                         const obj_mesh_data_t *mesh)
+{
+    char directory[MAX_CACHE_PATH];
+    snprintf(directory, sizeof(directory), "%s" MESH_CACHE_DIR, OS_GetBasePath());
+    if (!OS_DirectoryCreate(directory))
+    {
+        Log(WARNING, "failed to create mesh cache directory %s", directory);
+        return;
+    }
+
+    u64 index_data_size = (u64)mesh->index_count * INDEX_TYPE_SIZE(mesh->index_type);
+    u64 vertex_offset = AlignPow2(sizeof(mesh_cache_header_t), BLOCK_ALIGN);
+    u64 index_offset = AlignPow2(vertex_offset + mesh->vertex_data_size, BLOCK_ALIGN);
+    u64 size = index_offset + index_data_size;
+
+    mesh_cache_header_t header = {
+        .magic = MESH_CACHE_MAGIC,
+        .version = MESH_CACHE_VERSION,
+        .importer_version = OBJ_IMPORTER_VERSION,
+        .source_hash = source_hash,
+        .source_size = source_size,
+        .layout = mesh->layout,
+        .vertex_count = mesh->vertex_count,
+        .index_count = mesh->index_count,
+        .index_type = mesh->index_type,
+        .vertex_offset = vertex_offset,
+        .index_offset = index_offset,
+        .lod_count = mesh->lod_count,
+    };
+    MemoryCopy(header.bounds_min, mesh->bounds_min.Elements, sizeof(header.bounds_min));
+    MemoryCopy(header.bounds_max, mesh->bounds_max.Elements, sizeof(header.bounds_max));
+    MemoryCopy(header.lods, mesh->lods, sizeof(mesh_lod_t) * mesh->lod_count);
+
+    scratch_t scratch = Scratch_Begin(arena);
+
+    /* zeroed, so the alignment padding is deterministic */
+    u8 *data = arena_push_array(scratch.arena, u8, size);
+    MemoryCopy(data, &header, sizeof(header));
+    MemoryCopy(data + vertex_offset, mesh->vertex_data, mesh->vertex_data_size);
+    MemoryCopy(data + index_offset, mesh->indices, index_data_size);
+    File_Write(cooked_path, data, size);
+
+    Scratch_End(scratch);
+}
+
+static bool block_in_file(u64 offset, u64 block_size, u64 file_size)
+{
+    return offset % BLOCK_ALIGN == 0 && offset <= file_size && block_size <= file_size - offset;
+}
@@ -0,0 +1,757 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "core.h"
+#include "core_math.h"
+#include "hash_map.h"
+#include "memory_arena.h"
+#include "profiler.h"
+
+#include "mesh_optimize.h"
+
+#include "xxh3.h"
+
+#define NO_VERTEX U32_MAX
+
+/* area weighted sum of the squared distances to a set of planes n.p + d =
+   0: the symmetric n n^T, n d and d^2, summed, and the total area */
+typedef struct
+{
+    f64 xx, yy, zz, xy, xz, yz;
+    f64 x, y, z;
+    f64 d;
+    f64 area;
+} quadric_t;
+
+typedef struct
+{
+    f32 cost;
+    u32 from;
+    u32 to;
+} collapse_t;
+
+/* what MeshOptimize_Simplify works on; positions are per stream, the
+   positions of a group those of its representative vertex */
+typedef struct
+{
+    const vec3  *positions;
+    const u32   *group;
+    const u32   *representative;
+    quadric_t   *quadrics;      /* per group, then stream */
+    u32         stream_count;
+    u32         vertex_count;
+
+    const u32   *triangles;
+    const u32   *adjacency;     /* triangles around each group */
+    const u32   *adjacency_offsets;
+} simplify_state_t;
+
+static bool vertices_match(const void *const *streams, u32 stream_count, u32 stride, u32 a, u32 b);
+static u32 next_fan_vertex(const u32 *candidates, u32 candidate_count, const u32 *live, const u32 *cache_time,
+                           u32 time, u32 *dead_ends, u32 *dead_end_count, u32 *cursor, u32 vertex_count);
+static void build_adjacency(const u32 *triangles, u32 triangle_count, const u32 *group, u32 group_count,
+                            u32 *offsets, u32 *adjacency);
+static bool has_half_edge(const simplify_state_t *state, u32 a, u32 b);
+static vec3 group_position(const simplify_state_t *state, u32 stream, u32 group);
+static f32 collapse_cost(const simplify_state_t *state, u32 from, u32 to);
+static f32 collapse_distance(const simplify_state_t *state, u32 from, u32 to);
+static bool collapse_flips(const simplify_state_t *state, u32 from, u32 to);
+static void quadric_add_plane(quadric_t *quadric, vec3 a, vec3 b, vec3 c);
+static void quadric_add(quadric_t *quadric, const quadric_t *other);
+static f64 quadric_error(const quadric_t *quadric, vec3 p);
+static int compare_collapses(const void *a, const void *b);
+
+u32 MeshOptimize_Weld(arena_t *arena, u32 *remap_out, const void *const *streams, u32 stream_count,
+                      u32 vertex_count, u32 stride)
+{
+    ProfileZone("MeshOptimize_Weld");
+    scratch_t scratch = Scratch_Begin(arena);
+
+    u64 bucket_count = 64;
+    while (bucket_count < vertex_count)
+        bucket_count <<= 1;
+    hash_map_t map = HashMap_Create(scratch.arena, bucket_count);
+
+    /* the first vertex of each new index, to compare candidates against */
+    u32 *originals = arena_push_array_no_zero(scratch.arena, u32, vertex_count);
+    u32 unique_count = 0;
+
+    for (u32 i = 0; i < vertex_count; i++)
+    {
+        u64 hash = 0;
+        for (u32 s = 0; s < stream_count; s++)
+            hash = XXH3_64bits_withSeed((const u8 *)streams[s] + (u64)i * stride, stride, hash);
+
+        /* a colliding hash of different bytes keeps the vertex unwelded,
+           which costs a duplicate and nothing else */
+        u32 index;
+        if (HashMap_U64U32_Get(&map, hash, &index)
+            && vertices_match(streams, stream_count, stride, originals[index], i))
+        {
+            remap_out[i] = index;
+            continue;
+        }
+
+        index = unique_count++;
+        originals[index] = i;
+        remap_out[i] = index;
+        HashMap_U64U32_Insert(&map, hash, index);
+    }
+
+    Scratch_End(scratch);
+    return unique_count;
+}
+
+void MeshOptimize_VertexCache(arena_t *arena, u32 *indices, u32 index_count, u32 vertex_count)
+{
+    ProfileZone("MeshOptimize_VertexCache");
+    u32 triangle_count = index_count / 3;
+    if (triangle_count == 0)
+        return;
+
+    scratch_t scratch = Scratch_Begin(arena);
+
+    // Triangles of every vertex, as offsets into one array
+    u32 *live = arena_push_array(scratch.arena, u32, vertex_count);
+    u32 *adjacency_offsets = arena_push_array_no_zero(scratch.arena, u32, vertex_count + 1);
+    u32 *adjacency = arena_push_array_no_zero(scratch.arena, u32, triangle_count * 3);
+
+    for (u32 i = 0; i < triangle_count * 3; i++)
+        live[indices[i]]++;
+
+    u32 offset = 0;
+    for (u32 v = 0; v < vertex_count; v++)
+    {
+        adjacency_offsets[v] = offset;
+        offset += live[v];
+    }
+    adjacency_offsets[vertex_count] = offset;
+
+    for (u32 t = 0; t < triangle_count; t++)
+    {
+        for (u32 k = 0; k < 3; k++)
+        {
+            u32 v = indices[t * 3 + k];
+            adjacency[adjacency_offsets[v]++] = t;
+        }
+    }
+    for (u32 v = vertex_count; v > 0; v--)
+        adjacency_offsets[v] = adjacency_offsets[v - 1];
+    adjacency_offsets[0] = 0;
+
+    // Fan out from one vertex at a time, emitting its remaining triangles
+    u32 *output = arena_push_array_no_zero(scratch.arena, u32, triangle_count * 3);
+    u32 *cache_time = arena_push_array(scratch.arena, u32, vertex_count);
+    bool *emitted = arena_push_array(scratch.arena, bool, triangle_count);
+    u32 *dead_ends = arena_push_array_no_zero(scratch.arena, u32, triangle_count * 3);
+    u32 *candidates = arena_push_array_no_zero(scratch.arena, u32, triangle_count * 3);
+    u32 dead_end_count = 0;
+    u32 output_count = 0;
+    u32 cursor = 0;
+
+    /* a vertex is in the simulated cache while time - cache_time <= size */
+    u32 time = MESH_OPTIMIZE_CACHE_SIZE + 1;
+
+    for (u32 fan = 0; fan != NO_VERTEX;)
+    {
+        u32 candidate_count = 0;
+        for (u32 a = adjacency_offsets[fan]; a < adjacency_offsets[fan + 1]; a++)
+        {
+            u32 t = adjacency[a];
+            if (emitted[t])
+                continue;
+            emitted[t] = true;
+
+            for (u32 k = 0; k < 3; k++)
+            {
+                u32 v = indices[t * 3 + k];
+                output[output_count++] = v;
+                dead_ends[dead_end_count++] = v;
+                candidates[candidate_count++] = v;
+                live[v]--;
+
+                if (time - cache_time[v] > MESH_OPTIMIZE_CACHE_SIZE)
+                    cache_time[v] = time++;
+            }
+        }
+
+        fan = next_fan_vertex(candidates, candidate_count, live, cache_time, time, dead_ends, &dead_end_count,
+                              &cursor, vertex_count);
+    }
+
+    Assert(output_count == triangle_count * 3);
+    MemoryCopy(indices, output, sizeof(u32) * output_count);
+    Scratch_End(scratch);
+}
+
+u32 MeshOptimize_VertexFetch(u32 *remap_out, u32 *indices, u32 index_count, u32 vertex_count)
+{
+    for (u32 v = 0; v < vertex_count; v++)
+        remap_out[v] = NO_VERTEX;
+
+    u32 next = 0;
+    for (u32 i = 0; i < index_count; i++)
+    {
+        u32 *remapped = &remap_out[indices[i]];
+        if (*remapped == NO_VERTEX)
+            *remapped = next++;
+        indices[i] = *remapped;
+    }
+
+    return next;
+}
+
+void MeshOptimize_RemapIndices(u32 *indices, u32 index_count, const u32 *remap)
+{
+    for (u32 i = 0; i < index_count; i++)
+        indices[i] = remap[indices[i]];
+}
+
+void MeshOptimize_RemapVertices(void *dst, const void *src, const u32 *remap, u32 vertex_count, u32 stride)
+{
+    for (u32 v = 0; v < vertex_count; v++)
+    {
+        if (remap[v] != NO_VERTEX)
+            MemoryCopy((u8 *)dst + (u64)remap[v] * stride, (const u8 *)src + (u64)v * stride, stride);
+    }
+}
+
+mesh_optimize_result_t MeshOptimize_Mesh(arena_t *arena, u32 *indices, u32 index_count, void *const *streams,
+                                         u32 stream_count, u32 vertex_count, u32 stride)
+{
+    ProfileZone("MeshOptimize_Mesh");
+    mesh_optimize_result_t result = {
+        .before = MeshOptimize_AnalyzeVertexCache(arena, indices, index_count, vertex_count),
+    };
+
+    scratch_t scratch = Scratch_Begin(arena);
+
+    u32 *weld_remap = arena_push_array_no_zero(scratch.arena, u32, vertex_count);
+    u32 welded_count =
+        MeshOptimize_Weld(scratch.arena, weld_remap, (const void *const *)streams, stream_count, vertex_count, stride);
+    MeshOptimize_RemapIndices(indices, index_count, weld_remap);
+
+    MeshOptimize_VertexCache(scratch.arena, indices, index_count, welded_count);
+
+    u32 *fetch_remap = arena_push_array_no_zero(scratch.arena, u32, welded_count);
+    result.vertex_count = MeshOptimize_VertexFetch(fetch_remap, indices, index_count, welded_count);
+
+    /* one remap from the original vertices to the final ones; of the
+       vertices welded together only the first occurrence is copied */
+    u32 *remap = arena_push_array_no_zero(scratch.arena, u32, vertex_count);
+    bool *copied = arena_push_array(scratch.arena, bool, welded_count);
+    for (u32 v = 0; v < vertex_count; v++)
+    {
+        u32 welded = weld_remap[v];
+        remap[v] = copied[welded] ? NO_VERTEX : fetch_remap[welded];
+        copied[welded] = true;
+    }
+
+    u8 *copy = arena_push_array_no_zero(scratch.arena, u8, (u64)vertex_count * stride);
+    for (u32 s = 0; s < stream_count; s++)
+    {
+        MemoryCopy(copy, streams[s], (u64)vertex_count * stride);
+        MeshOptimize_RemapVertices(streams[s], copy, remap, vertex_count, stride);
+    }
+
+    Scratch_End(scratch);
+
+    result.after = MeshOptimize_AnalyzeVertexCache(arena, indices, index_count, result.vertex_count);
+    return result;
+}
+
+u32 MeshOptimize_Simplify(arena_t *arena, u32 *indices_out, u32 *triangles_out, const u32 *indices,
+                          u32 index_count, const void *const *streams, u32 stream_count, u32 vertex_count,
+                          u32 stride, u32 target_index_count, f32 *error_out)
+{
+    ProfileZone("MeshOptimize_Simplify");
+    scratch_t scratch = Scratch_Begin(arena);
+
+    // Positions of every stream, and which vertices share them in all
+    vec3 *positions = arena_push_array_no_zero(scratch.arena, vec3, (u64)stream_count * vertex_count);
+    const void **position_streams = arena_push_array_no_zero(scratch.arena, const void *, stream_count);
+    for (u32 s = 0; s < stream_count; s++)
+    {
+        vec3 *stream_positions = positions + (u64)s * vertex_count;
+        for (u32 v = 0; v < vertex_count; v++)
+            MemoryCopy(&stream_positions[v], (const u8 *)streams[s] + (u64)v * stride, sizeof(vec3));
+        position_streams[s] = stream_positions;
+    }
+
+    u32 *group = arena_push_array_no_zero(scratch.arena, u32, vertex_count);
+    u32 group_count = MeshOptimize_Weld(scratch.arena, group, position_streams, stream_count, vertex_count,
+                                        sizeof(vec3));
+
+    /* groups are numbered in first occurrence order */
+    u32 *representative = arena_push_array_no_zero(scratch.arena, u32, group_count);
+    for (u32 v = 0, next = 0; v < vertex_count; v++)
+    {
+        if (group[v] == next)
+            representative[next++] = v;
+    }
+
+    // Triangles with three distinct positions; the others have no area to keep
+    u32 *triangles = arena_push_array_no_zero(scratch.arena, u32, index_count);
+    u32 *sources = arena_push_array_no_zero(scratch.arena, u32, index_count / 3);
+    u32 triangle_count = 0;
+    for (u32 t = 0; t < index_count / 3; t++)
+    {
+        const u32 *corners = &indices[t * 3];
+        u32 a = group[corners[0]];
+        u32 b = group[corners[1]];
+        u32 c = group[corners[2]];
+        if (a == b || b == c || c == a)
+            continue;
+
+        MemoryCopy(&triangles[triangle_count * 3], corners, sizeof(u32) * 3);
+        sources[triangle_count++] = t;
+    }
+
+    simplify_state_t state = {
+        .positions = positions,
+        .group = group,
+        .representative = representative,
+        .quadrics = arena_push_array(scratch.arena, quadric_t, (u64)group_count * stream_count),
+        .stream_count = stream_count,
+        .vertex_count = vertex_count,
+        .triangles = triangles,
+    };
+
+    for (u32 t = 0; t < triangle_count; t++)
+    {
+        const u32 *corners = &triangles[t * 3];
+        for (u32 s = 0; s < stream_count; s++)
+        {
+            quadric_t plane = {};
+            const vec3 *stream_positions = positions + (u64)s * vertex_count;
+            quadric_add_plane(&plane, stream_positions[corners[0]], stream_positions[corners[1]],
+                              stream_positions[corners[2]]);
+            for (u32 k = 0; k < 3; k++)
+                quadric_add(&state.quadrics[(u64)group[corners[k]] * stream_count + s], &plane);
+        }
+    }
+
+    // Open edges lock both ends, so borders and holes keep their outline
+    u32 *adjacency_offsets = arena_push_array_no_zero(scratch.arena, u32, group_count + 1);
+    u32 *adjacency = arena_push_array_no_zero(scratch.arena, u32, index_count);
+    build_adjacency(triangles, triangle_count, group, group_count, adjacency_offsets, adjacency);
+    state.adjacency = adjacency;
+    state.adjacency_offsets = adjacency_offsets;
+
+    bool *locked = arena_push_array(scratch.arena, bool, group_count);
+    for (u32 t = 0; t < triangle_count; t++)
+    {
+        for (u32 k = 0; k < 3; k++)
+        {
+            u32 a = group[triangles[t * 3 + k]];
+            u32 b = group[triangles[t * 3 + (k + 1) % 3]];
+            /* the triangle across an inner edge walks it the other way */
+            if (!has_half_edge(&state, b, a))
+                locked[a] = locked[b] = true;
+        }
+    }
+
+    // Passes of independent collapses, cheapest first
+    collapse_t *collapses = arena_push_array_no_zero(scratch.arena, collapse_t, index_count);
+    u32 *collapse_to = arena_push_array_no_zero(scratch.arena, u32, group_count);
+    u32 *vertex_to = arena_push_array_no_zero(scratch.arena, u32, vertex_count);
+    bool *touched = arena_push_array_no_zero(scratch.arena, bool, group_count);
+    MemorySet(collapse_to, 0xff, sizeof(u32) * group_count);
+    MemorySet(vertex_to, 0xff, sizeof(u32) * vertex_count);
+    f32 max_error = 0.0f;
+
+    while (triangle_count * 3 > target_index_count)
+    {
+        u32 collapse_count = 0;
+        for (u32 t = 0; t < triangle_count; t++)
+        {
+            for (u32 k = 0; k < 3; k++)
+            {
+                /* each inner edge once, from the triangle walking it upwards */
+                u32 a = group[triangles[t * 3 + k]];
+                u32 b = group[triangles[t * 3 + (k + 1) % 3]];
+                if (a > b || (locked[a] && locked[b]))
+                    continue;
+
+                f32 cost_ab = locked[a] ? INFINITY : collapse_cost(&state, a, b);
+                f32 cost_ba = locked[b] ? INFINITY : collapse_cost(&state, b, a);
+                collapses[collapse_count++] = cost_ab <= cost_ba ? (collapse_t){cost_ab, a, b}
+                                                                 : (collapse_t){cost_ba, b, a};
+            }
+        }
+        if (collapse_count == 0)
+            break;
+
+        qsort(collapses, collapse_count, sizeof(collapse_t), compare_collapses);
+
+        /* an inner collapse takes two triangles along. a collapse touches
+           its neighbourhood for the rest of the pass, so the flip test of
+           the next one sees the triangles as they are */
+        u32 wanted = Max((triangle_count - target_index_count / 3) / 2, 1u);
+        u32 collapsed = 0;
+        MemoryZero(touched, sizeof(bool) * group_count);
+        for (u32 i = 0; i < collapse_count && collapsed < wanted; i++)
+        {
+            const collapse_t *collapse = &collapses[i];
+            if (touched[collapse->from] || touched[collapse->to] || collapse_flips(&state, collapse->from, collapse->to))
+                continue;
+
+            max_error = Max(max_error, collapse_distance(&state, collapse->from, collapse->to));
+            collapse_to[collapse->from] = collapse->to;
+            for (u32 s = 0; s < stream_count; s++)
+            {
+                quadric_add(&state.quadrics[(u64)collapse->to * stream_count + s],
+                            &state.quadrics[(u64)collapse->from * stream_count + s]);
+            }
+
+            /* a vertex follows one of its own edges to the other end where
+               it has one, so attribute seams along the edge stay seams */
+            for (u32 a = adjacency_offsets[collapse->from]; a < adjacency_offsets[collapse->from + 1]; a++)
+            {
+                const u32 *corners = &triangles[adjacency[a] * 3];
+                for (u32 k = 0; k < 3; k++)
+                {
+                    touched[group[corners[k]]] = true;
+                    for (u32 j = 0; j < 3; j++)
+                    {
+                        if (group[corners[k]] == collapse->from && group[corners[j]] == collapse->to
+                            && vertex_to[corners[k]] == NO_VERTEX)
+                            vertex_to[corners[k]] = corners[j];
+                    }
+                }
+            }
+            collapsed++;
+        }
+        if (collapsed == 0)
+            break;
+
+        // Move the corners to where they collapsed, dropping triangles that lost their area
+        u32 kept = 0;
+        for (u32 t = 0; t < triangle_count; t++)
+        {
+            u32 corners[3];
+            for (u32 k = 0; k < 3; k++)
+            {
+                u32 v = triangles[t * 3 + k];
+                u32 to = collapse_to[group[v]];
+                if (to != NO_VERTEX)
+                    v = vertex_to[v] != NO_VERTEX ? vertex_to[v] : representative[to];
+                corners[k] = v;
+            }
+            if (group[corners[0]] == group[corners[1]] || group[corners[1]] == group[corners[2]]
+                || group[corners[2]] == group[corners[0]])
+                continue;
+
+            MemoryCopy(&triangles[kept * 3], corners, sizeof(corners));
+            sources[kept++] = sources[t];
+        }
+        triangle_count = kept;
+
+        build_adjacency(triangles, triangle_count, group, group_count, adjacency_offsets, adjacency);
+    }
+
+    MemoryCopy(indices_out, triangles, sizeof(u32) * 3 * triangle_count);
+    if (triangles_out)
+        MemoryCopy(triangles_out, sources, sizeof(u32) * triangle_count);
+    *error_out = max_error;
+
+    Scratch_End(scratch);
+    return triangle_count * 3;
+}
+
+u32 MeshOptimize_Lods(arena_t *arena, mesh_lod_t *lods_out, u32 *indices, u32 *triangles_out, u32 index_count,
+                      const void *const *streams, u32 stream_count, u32 vertex_count, u32 stride)
+{
+    ProfileZone("MeshOptimize_Lods");
+    lods_out[0] = (mesh_lod_t){.index_count = index_count};
+    if (triangles_out)
+    {
+        for (u32 t = 0; t < index_count / 3; t++)
+            triangles_out[t] = t;
+    }
+
+    u32 lod_count = 1;
+    while (lod_count < MESH_MAX_LODS)
+    {
+        const mesh_lod_t *previous = &lods_out[lod_count - 1];
+        u32 triangle_count = previous->index_count / 3;
+        if (triangle_count / 2 < MESH_OPTIMIZE_LOD_MIN_TRIANGLES)
+            break;
+
+        u32 first = previous->first_index + previous->index_count;
+        u32 *level_triangles = triangles_out ? triangles_out + first / 3 : NULL;
+        f32 error;
+        u32 count = MeshOptimize_Simplify(arena, indices + first, level_triangles, indices + previous->first_index,
+                                          previous->index_count, streams, stream_count, vertex_count, stride,
+                                          triangle_count / 2 * 3, &error);
+
+        /* a level that barely simplifies costs memory and buys nothing */
+        if (count > previous->index_count / 4 * 3)
+            break;
+
+        /* back to the input triangles, through the previous level */
+        if (triangles_out)
+        {
+            for (u32 t = 0; t < count / 3; t++)
+                level_triangles[t] = triangles_out[previous->first_index / 3 + level_triangles[t]];
+        }
+
+        /* each level measures its error against the one before */
+        lods_out[lod_count] = (mesh_lod_t){
+            .first_index = first,
+            .index_count = count,
+            .error = previous->error + error,
+        };
+        lod_count++;
+    }
+
+    return lod_count;
+}
+
+mesh_cache_stats_t MeshOptimize_AnalyzeVertexCache(arena_t *arena, const u32 *indices, u32 index_count,
+                                                   u32 vertex_count)
+{
+    scratch_t scratch = Scratch_Begin(arena);
+    u32 *cache_time = arena_push_array(scratch.arena, u32, vertex_count);
+    bool *referenced = arena_push_array(scratch.arena, bool, vertex_count);
+
+    u32 time = MESH_OPTIMIZE_CACHE_SIZE + 1;
+    u32 transformed = 0;
+    u32 referenced_count = 0;
+    for (u32 i = 0; i < index_count; i++)
+    {
+        u32 v = indices[i];
+        if (time - cache_time[v] > MESH_OPTIMIZE_CACHE_SIZE)
+        {
+            cache_time[v] = time++;
+            transformed++;
+        }
+        if (!referenced[v])
+        {
+            referenced[v] = true;
+            referenced_count++;
+        }
+    }
+
+    Scratch_End(scratch);
+    return (mesh_cache_stats_t){
+        .acmr = index_count >= 3 ? (f32)transformed / (f32)(index_count / 3) : 0.0f,
+        .atvr = referenced_count ? (f32)transformed / (f32)referenced_count : 0.0f,
+    };
+}
+
+static bool vertices_match(const void *const *streams, u32 stream_count, u32 stride, u32 a, u32 b)
+{
+    for (u32 s = 0; s < stream_count; s++)
+    {
+        const u8 *stream = streams[s];
+        if (!MemoryMatch(stream + (u64)a * stride, stream + (u64)b * stride, stride))
+            return false;
+    }
+    return true;
+}
+
+/* the candidate that will still be cached after its remaining triangles
+   are emitted, preferring the one that entered the cache first; else the
+   most recent vertex with triangles left, else the first such vertex */
+static u32 next_fan_vertex(const u32 *candidates, u32 candidate_count, const u32 *live, const u32 *cache_time,
+                           u32 time, u32 *dead_ends, u32 *dead_end_count, u32 *cursor, u32 vertex_count)
+{
+    u32 best = NO_VERTEX;
+    i64 best_priority = -1;
+    for (u32 i = 0; i < candidate_count; i++)
+    {
+        u32 v = candidates[i];
+        if (live[v] == 0)
+            continue;
+
+        i64 priority = 0;
+        if ((u64)(time - cache_time[v]) + 2 * (u64)live[v] <= MESH_OPTIMIZE_CACHE_SIZE)
+            priority = time - cache_time[v];
+
+        if (priority > best_priority)
+        {
+            best = v;
+            best_priority = priority;
+        }
+    }
+    if (best != NO_VERTEX)
+        return best;
+
+    while (*dead_end_count > 0)
+    {
+        u32 v = dead_ends[--*dead_end_count];
+        if (live[v] > 0)
+            return v;
+    }
+
+    for (; *cursor < vertex_count; (*cursor)++)
+    {
+        if (live[*cursor] > 0)
+            return *cursor;
+    }
+
+    return NO_VERTEX;
+}
+
+/* triangles around each group, as offsets into one array */
+static void build_adjacency(const u32 *triangles, u32 triangle_count, const u32 *group, u32 group_count,
+                            u32 *offsets, u32 *adjacency)
+{
+    MemoryZero(offsets, sizeof(u32) * (group_count + 1));
+    for (u32 i = 0; i < triangle_count * 3; i++)
+        offsets[group[triangles[i]] + 1]++;
+    for (u32 g = 0; g < group_count; g++)
+        offsets[g + 1] += offsets[g];
+
+    for (u32 t = 0; t < triangle_count; t++)
+    {
+        for (u32 k = 0; k < 3; k++)
+            adjacency[offsets[group[triangles[t * 3 + k]]]++] = t;
+    }
+    for (u32 g = group_count; g > 0; g--)
+        offsets[g] = offsets[g - 1];
+    offsets[0] = 0;
+}
+
+/* whether a triangle walks from group a to group b */
+static bool has_half_edge(const simplify_state_t *state, u32 a, u32 b)
+{
+    for (u32 i = state->adjacency_offsets[a]; i < state->adjacency_offsets[a + 1]; i++)
+    {
+        const u32 *corners = &state->triangles[state->adjacency[i] * 3];
+        for (u32 k = 0; k < 3; k++)
+        {
+            if (state->group[corners[k]] == a && state->group[corners[(k + 1) % 3]] == b)
+                return true;
+        }
+    }
+    return false;
+}
+
+static vec3 group_position(const simplify_state_t *state, u32 stream, u32 group)
+{
+    return state->positions[(u64)stream * state->vertex_count + state->representative[group]];
+}
+
+/* the error of both quadrics at the position of to, over every stream */
+static f32 collapse_cost(const simplify_state_t *state, u32 from, u32 to)
+{
+    f64 cost = 0.0;
+    for (u32 s = 0; s < state->stream_count; s++)
+    {
+        vec3 p = group_position(state, s, to);
+        cost += quadric_error(&state->quadrics[(u64)from * state->stream_count + s], p);
+        cost += quadric_error(&state->quadrics[(u64)to * state->stream_count + s], p);
+    }
+    return (f32)cost;
+}
+
+/* the area weighted rms distance of the collapsed surface from the planes
+   it started out as */
+static f32 collapse_distance(const simplify_state_t *state, u32 from, u32 to)
+{
+    f64 error = 0.0;
+    f64 area = 0.0;
+    for (u32 s = 0; s < state->stream_count; s++)
+    {
+        const quadric_t *quadric_from = &state->quadrics[(u64)from * state->stream_count + s];
+        const quadric_t *quadric_to = &state->quadrics[(u64)to * state->stream_count + s];
+        vec3 p = group_position(state, s, to);
+        error += quadric_error(quadric_from, p) + quadric_error(quadric_to, p);
+        area += quadric_from->area + quadric_to->area;
+    }
+    return area > 0.0 ? (f32)sqrt(error / area) : 0.0f;
+}
+
+/* whether moving from onto to turns a triangle around from over, or
+   squashes it flat, in any stream. the triangles on the edge go away */
+static bool collapse_flips(const simplify_state_t *state, u32 from, u32 to)
+{
+    for (u32 i = state->adjacency_offsets[from]; i < state->adjacency_offsets[from + 1]; i++)
+    {
+        const u32 *corners = &state->triangles[state->adjacency[i] * 3];
+        u32 groups[3] = {state->group[corners[0]], state->group[corners[1]], state->group[corners[2]]};
+        if (groups[0] == to || groups[1] == to || groups[2] == to)
+            continue;
+
+        for (u32 s = 0; s < state->stream_count; s++)
+        {
+            vec3 before[3];
+            vec3 after[3];
+            for (u32 k = 0; k < 3; k++)
+            {
+                before[k] = group_position(state, s, groups[k]);
+                after[k] = groups[k] == from ? group_position(state, s, to) : before[k];
+            }
+
+            vec3 normal_before = HMM_Cross(HMM_SubV3(before[1], before[0]), HMM_SubV3(before[2], before[0]));
+            vec3 normal_after = HMM_Cross(HMM_SubV3(after[1], after[0]), HMM_SubV3(after[2], after[0]));
+            if (HMM_DotV3(normal_before, normal_after) <= 0.0f)
+                return true;
+        }
+    }
+    return false;
+}
+
+static void quadric_add_plane(quadric_t *quadric, vec3 a, vec3 b, vec3 c)
+{
+    vec3 normal = HMM_Cross(HMM_SubV3(b, a), HMM_SubV3(c, a));
+    f32 length = HMM_LenV3(normal);
+    if (length == 0.0f)
+        return;
+
+    f64 x = normal.X / length;
+    f64 y = normal.Y / length;
+    f64 z = normal.Z / length;
+    f64 d = -(x * a.X + y * a.Y + z * a.Z);
+    f64 area = length * 0.5;
+
+    quadric->xx += area * x * x;
+    quadric->yy += area * y * y;
+    quadric->zz += area * z * z;
+    quadric->xy += area * x * y;
+    quadric->xz += area * x * z;
+    quadric->yz += area * y * z;
+    quadric->x += area * x * d;
+    quadric->y += area * y * d;
+    quadric->z += area * z * d;
+    quadric->d += area * d * d;
+    quadric->area += area;
+}
+
+static void quadric_add(quadric_t *quadric, const quadric_t *other)
+{
+    quadric->xx += other->xx;
+    quadric->yy += other->yy;
+    quadric->zz += other->zz;
+    quadric->xy += other->xy;
+    quadric->xz += other->xz;
+    quadric->yz += other->yz;
+    quadric->x += other->x;
+    quadric->y += other->y;
+    quadric->z += other->z;
+    quadric->d += other->d;
+    quadric->area += other->area;
+}
+
+static f64 quadric_error(const quadric_t *quadric, vec3 p)
+{
+    f64 x = p.X;
+    f64 y = p.Y;
+    f64 z = p.Z;
+    f64 error = quadric->xx * x * x + quadric->yy * y * y + quadric->zz * z * z
+        + 2.0 * (quadric->xy * x * y + quadric->xz * x * z + quadric->yz * y * z)
+        + 2.0 * (quadric->x * x + quadric->y * y + quadric->z * z) + quadric->d;
+
+    /* rounding can take a zero error just below */
+    return Max(error, 0.0);
+}
+
+static int compare_collapses(const void *a, const void *b)
+{
+    f32 cost_a = ((const collapse_t *)a)->cost;
+    f32 cost_b = ((const collapse_t *)b)->cost;
+
+    return (cost_a > cost_b) - (cost_a < cost_b);
+}
@@ -0,0 +1,160 @@
+#include <math.h>
+
+#include "core.h"
+#include "core_math.h"
+#include "profiler.h"
+
+#include "mipmap.h"
+
+/* linear values go back to srgb through a table keyed on this many bits;
+   12 keeps every output within a code of the exact conversion */
+#define ENCODE_BITS 12
+#define ENCODE_SIZE (1u << ENCODE_BITS)
+
+static struct
+{
+    f32     to_linear[256];
+    u8      to_srgb[ENCODE_SIZE];
+    bool    ready;
+} s_tables;
+
+static void downsample_srgb(vec4 *dst, const u8 *src, u32 src_width, u32 src_height, u32 dst_width,
+                            u32 dst_height);
+static void downsample_linear(vec4 *texels, u32 src_width, u32 src_height, u32 dst_width, u32 dst_height);
+static void encode_level(u8 *dst, const vec4 *texels, u64 texel_count);
+static vec4 decode_texel(const u8 *texel);
+
+void Mipmap_Init(void)
+{
+    for (u32 i = 0; i < 256; i++)
+    {
+        f32 c = (f32)i / 255.0f;
+        s_tables.to_linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    for (u32 i = 0; i < ENCODE_SIZE; i++)
+    {
+        f32 l = (f32)i / (f32)(ENCODE_SIZE - 1);
+        f32 c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+        s_tables.to_srgb[i] = (u8)round_u32(c * 255.0f);
+    }
+
+    s_tables.ready = true;
+}
+
+u32 Mipmap_LevelCount(u32 width, u32 height)
+{
+    u32 levels = 1;
+    for (u32 size = Max(width, height); size > 1; size /= 2)
+        levels++;
+    return levels;
+}
+
+u64 Mipmap_ChainSize(u32 width, u32 height, u32 level_count)
+{
+    u64 size = 0;
+    for (u32 level = 0; level < level_count; level++)
+    {
+        size += (u64)width * height * 4;
+        width = Max(width / 2, 1u);
+        height = Max(height / 2, 1u);
+    }
+    return size;
+}
+
+void Mipmap_Generate(arena_t *arena, u8 *chain, u32 width, u32 height, u32 level_count)
+{
+    ProfileZone("Mipmap_Generate");
+    Assert(s_tables.ready && level_count <= Mipmap_LevelCount(width, height));
+
+    if (level_count < 2)
+        return;
+
+    scratch_t scratch = Scratch_Begin(arena);
+
+    /* level 1 is decoded from level 0 once; the levels after it filter the
+       linear texels in place, so no level is quantized twice */
+    u32 src_width = width;
+    u32 src_height = height;
+    u32 dst_width = Max(width / 2, 1u);
+    u32 dst_height = Max(height / 2, 1u);
+    vec4 *texels = arena_push_array_no_zero(scratch.arena, vec4, (u64)dst_width * dst_height);
+
+    u8 *dst = chain + (u64)width * height * 4;
+    downsample_srgb(texels, chain, src_width, src_height, dst_width, dst_height);
+    encode_level(dst, texels, (u64)dst_width * dst_height);
+
+    for (u32 level = 2; level < level_count; level++)
+    {
+        dst += (u64)dst_width * dst_height * 4;
+        src_width = dst_width;
+        src_height = dst_height;
+        dst_width = Max(dst_width / 2, 1u);
+        dst_height = Max(dst_height / 2, 1u);
+
+        downsample_linear(texels, src_width, src_height, dst_width, dst_height);
+        encode_level(dst, texels, (u64)dst_width * dst_height);
+    }
+
+    Scratch_End(scratch);
+}
+
+/* a source 1 texel wide or high repeats its only column or row */
+static void downsample_srgb(vec4 *dst, const u8 *src, u32 src_width, u32 src_height, u32 dst_width,
+                            u32 dst_height)
+{
+    u32 step_x = src_width > 1 ? 4 : 0;
+    u64 step_y = src_height > 1 ? (u64)src_width * 4 : 0;
+
+    for (u32 y = 0; y < dst_height; y++)
+    {
+        const u8 *row = src + (u64)y * 2 * src_width * 4;
+        for (u32 x = 0; x < dst_width; x++)
+        {
+            const u8 *texel = row + (u64)x * 2 * 4;
+            vec4 sum = HMM_AddV4(HMM_AddV4(decode_texel(texel), decode_texel(texel + step_x)),
+                                 HMM_AddV4(decode_texel(texel + step_y), decode_texel(texel + step_y + step_x)));
+            dst[(u64)y * dst_width + x] = HMM_MulV4F(sum, 0.25f);
+        }
+    }
+}
+
+/* in place: texel i of the destination only reads source texels at i or
+   later, which nothing before it has overwritten */
+static void downsample_linear(vec4 *texels, u32 src_width, u32 src_height, u32 dst_width, u32 dst_height)
+{
+    u32 step_x = src_width > 1 ? 1 : 0;
+    u64 step_y = src_height > 1 ? src_width : 0;
+
+    for (u32 y = 0; y < dst_height; y++)
+    {
+        const vec4 *row = texels + (u64)y * 2 * src_width;
+        for (u32 x = 0; x < dst_width; x++)
+        {
+            const vec4 *texel = row + (u64)x * 2;
+            vec4 sum = HMM_AddV4(HMM_AddV4(texel[0], texel[step_x]),
+                                 HMM_AddV4(texel[step_y], texel[step_y + step_x]));
+            texels[(u64)y * dst_width + x] = HMM_MulV4F(sum, 0.25f);
+        }
+    }
+}
+
+static void encode_level(u8 *dst, const vec4 *texels, u64 texel_count)
+{
+    const vec4 scale = HMM_V4((f32)(ENCODE_SIZE - 1), (f32)(ENCODE_SIZE - 1), (f32)(ENCODE_SIZE - 1), 255.0f);
+
+    for (u64 i = 0; i < texel_count; i++)
+    {
+        vec4 t = HMM_MulV4(texels[i], scale);
+        dst[i * 4 + 0] = s_tables.to_srgb[Min(round_u32(t.X), ENCODE_SIZE - 1)];
+        dst[i * 4 + 1] = s_tables.to_srgb[Min(round_u32(t.Y), ENCODE_SIZE - 1)];
+        dst[i * 4 + 2] = s_tables.to_srgb[Min(round_u32(t.Z), ENCODE_SIZE - 1)];
+        dst[i * 4 + 3] = (u8)Min(round_u32(t.W), 255u);
+    }
+}
+
+static vec4 decode_texel(const u8 *texel)
+{
+    return HMM_V4(s_tables.to_linear[texel[0]], s_tables.to_linear[texel[1]], s_tables.to_linear[texel[2]],
+                  (f32)texel[3] / 255.0f);
+}
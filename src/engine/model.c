@@ -0,0 +1,165 @@
+#include <math.h>
+
+#include "log.h"
+#include "mesh_internal.h"
+#include "model.h"
+#include "model_internal.h"
+#include "renderer.h"
+
+extern arena_t *g_scratch;
+
+/* below this angle sin() loses precision, nlerp is just as good there */
+#define SLERP_NLERP_DOT 0.9995f
+
+static void sample_anchors(const model_anchor_t *a, const model_anchor_t *b, f32 t, u32 count,
+                           model_anchor_t *out);
+
+model_sample_t Model_SampleAnimation(const model_animation_t *animation, f32 time_s)
+{
+    Assert(animation->keyframe_count > 0);
+
+    const model_keyframe_t *keyframes = animation->keyframes;
+    u32 last = animation->keyframe_count - 1;
+    f32 duration = keyframes[last].time_s;
+
+    model_sample_t sample = {};
+    if (last == 0 || !(duration > 0.0f))
+        return sample;
+
+    f32 t = fmodf(time_s, duration);
+    if (t < 0.0f)
+        t += duration;
+    if (t < keyframes[0].time_s)
+        return sample;
+
+    /* last keyframe at or before t; t < duration, so it is never the last */
+    u32 lo = 0;
+    u32 hi = last;
+    while (hi - lo > 1)
+    {
+        u32 mid = (lo + hi) / 2;
+        if (keyframes[mid].time_s <= t)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    f32 span = keyframes[hi].time_s - keyframes[lo].time_s;
+    sample.keyframe_a = (u16)lo;
+    sample.keyframe_b = (u16)hi;
+    sample.blend = span > 0.0f ? Min((t - keyframes[lo].time_s) / span, 1.0f) : 0.0f;
+
+    return sample;
+}
+
+void Model_SampleAnchors(model_handle_t model, u32 animation, f32 time_s,
+                         model_anchor_t *anchors_out)
+{
+    Assert(animation < model->animation_count);
+
+    const model_animation_t *anim = &model->animations[animation];
+    model_sample_t sample = Model_SampleAnimation(anim, time_s);
+
+    sample_anchors(anim->keyframes[sample.keyframe_a].anchors,
+                   anim->keyframes[sample.keyframe_b].anchors,
+                   sample.blend, model->anchor_count, anchors_out);
+}
+
+u64 Model_UploadAnimationTable(const model_t *model, bool deferred)
+{
+    /* the header takes the first keyframe's buffer */
+    if (model->animation_count == 0 || model->animations[0].keyframe_count == 0)
+    {
+        Log(ERROR, "model has no keyframes to put in an animation table");
+        return 0;
+    }
+
+    scratch_t scratch = Scratch_Begin(g_scratch);
+
+    u32 keyframe_count = 0;
+    for (u32 i = 0; i < model->animation_count; i++)
+        keyframe_count += model->animations[i].keyframe_count;
+
+    u64 size = sizeof(model_table_header_t) + sizeof(u32) * 2 * (model->animation_count + keyframe_count);
+    u8 *table = arena_push_array_no_zero(scratch.arena, u8, size);
+
+    model_table_header_t *header = (model_table_header_t *)table;
+    u32 *animations = (u32 *)(header + 1);
+    u32 *keyframes = animations + 2 * model->animation_count;
+
+    *header = (model_table_header_t){
+        .vertex_address = model->animations[0].keyframes[0].mesh->vertex_address,
+        .animation_count = model->animation_count,
+        .keyframe_count = keyframe_count,
+    };
+
+    u32 key_idx = 0;
+    for (u32 i = 0; i < model->animation_count; i++)
+    {
+        const model_animation_t *animation = &model->animations[i];
+        animations[2 * i] = key_idx;
+        animations[2 * i + 1] = animation->keyframe_count;
+
+        for (u32 j = 0; j < animation->keyframe_count; j++, key_idx++)
+        {
+            const mesh_t *mesh = animation->keyframes[j].mesh;
+            Assert(mesh->vertex_address == header->vertex_address);
+
+            MemoryCopy(&keyframes[2 * key_idx], &animation->keyframes[j].time_s, sizeof(f32));
+            keyframes[2 * key_idx + 1] = mesh->vertex_offset;
+        }
+    }
+
+    u64 address = 0;
+    VkBuffer buffer = deferred ? Renderer_UploadStaticPullBuffer(table, size, &address)
+                               : Renderer_CreateStaticPullBuffer(table, size, &address);
+    Scratch_End(scratch);
+
+    return buffer != VK_NULL_HANDLE ? address : 0;
+}
+
+/* all anchors in one flat loop; only the slerp weights need trig */
+static void sample_anchors(const model_anchor_t *a, const model_anchor_t *b, f32 t, u32 count,
+                           model_anchor_t *out)
+{
+    for (u32 i = 0; i < count; i++)
+    {
+        quat qa = a[i].orientation;
+        quat qb = b[i].orientation;
+
+        f32 cos_theta = qa.X * qb.X + qa.Y * qb.Y + qa.Z * qb.Z + qa.W * qb.W;
+        f32 sign = 1.0f;
+        if (cos_theta < 0.0f)
+        {
+            cos_theta = -cos_theta;
+            sign = -1.0f;
+        }
+
+        f32 wa = 1.0f - t;
+        f32 wb = t;
+        if (cos_theta < SLERP_NLERP_DOT)
+        {
+            f32 theta = acosf(cos_theta);
+            f32 inv_sin = 1.0f / sinf(theta);
+            wa = sinf(wa * theta) * inv_sin;
+            wb = sinf(wb * theta) * inv_sin;
+        }
+        wb *= sign;
+
+        quat q = {
+            .X = wa * qa.X + wb * qb.X,
+            .Y = wa * qa.Y + wb * qb.Y,
+            .Z = wa * qa.Z + wb * qb.Z,
+            .W = wa * qa.W + wb * qb.W,
+        };
+        f32 inv_len = 1.0f / sqrtf(q.X * q.X + q.Y * q.Y + q.Z * q.Z + q.W * q.W);
+
+        out[i].pos = lerp(a[i].pos, t, b[i].pos);
+        out[i].orientation = (quat){
+            .X = q.X * inv_len,
+            .Y = q.Y * inv_len,
+            .Z = q.Z * inv_len,
+            .W = q.W * inv_len,
+        };
+    }
+}
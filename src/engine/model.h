@@ -55,7 +55,39 @@ struct _model_t
     model_material_t *materials;
     string *anchor_names;
     model_animation_t *animations;
+
+    /* gpu copy of the animation timing for instanced draws, see
+       model_internal.h */
+    u64 animation_table_address;
 };
 
+/* one instance of Renderer_DrawModelInstanced, std430 */
+typedef struct
+{
+    mat4 transform;
+    vec4 color;
+    u32 animation;
+    f32 time_s;
+    u32 __reserved[2];
+} model_instance_t;
+StaticAssert(sizeof(model_instance_t) == 96, "model_instance_t must match the shaders' std430 stride");
+
+/* keyframe indices into an animation and how far from a to b the sample lies */
+typedef struct
+{
+    u16 keyframe_a;
+    u16 keyframe_b;
+    f32 blend;
+} model_sample_t;
+
+/* animations loop over the time of their last keyframe; before the first
+   keyframe, and in single keyframe animations, the first one holds */
+model_sample_t Model_SampleAnimation(const model_animation_t *animation, f32 time_s);
+
+/* all anchor_count anchors of the animation at time_s: positions lerped,
+   orientations slerped along the shorter arc */
+void Model_SampleAnchors(model_handle_t model, u32 animation, f32 time_s,
+                         model_anchor_t *anchors_out);
+
 
 #endif
@@ -0,0 +1,587 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "hash_map.h"
+#include "job.h"
+#include "log.h"
+#include "memory_arena.h"
+#include "profiler.h"
+
+#include "mesh.h"
+#include "mesh_optimize.h"
+#include "obj.h"
+#include "vertex_pack.h"
+
+/* the file is split into chunks of at least OBJ_CHUNK_SIZE bytes, cut at
+   line boundaries, that are counted and then parsed as parallel jobs */
+#define OBJ_CHUNK_SIZE  KB(256)
+#define OBJ_MAX_CHUNKS  256
+
+/* longest number the strtof fallback takes */
+#define OBJ_MAX_NUMBER  64
+
+typedef enum
+{
+    OBJ_LINE_OTHER,
+    OBJ_LINE_POSITION,
+    OBJ_LINE_UV,
+    OBJ_LINE_NORMAL,
+    OBJ_LINE_FACE,
+    OBJ_LINE_OBJECT,
+} obj_line_type_t;
+
+typedef struct
+{
+    const char *begin;
+    const char *end;
+
+    /* lines of each kind, and after the prefix sum where the chunk's
+       elements start in the shared arrays */
+    u32 position_count;
+    u32 uv_count;
+    u32 normal_count;
+    u32 face_count;
+    u32 object_count;
+
+    u32 first_position;
+    u32 first_uv;
+    u32 first_normal;
+    u32 first_face;
+
+    /* first line that failed to parse, NULL if none */
+    const char *error_line;
+    const char *error_end;
+} obj_chunk_t;
+
+typedef struct
+{
+    obj_chunk_t *chunks;
+
+    vec3        *positions;
+    vec2        *uvs;
+    vec3        *normals;
+    obj_face_t  *faces;
+} obj_parse_t;
+
+/* exactly representable doubles, so one multiply or divide rounds once */
+static const f64 s_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static const char *next_line(const char *cursor, const char *end, const char **line_end);
+static obj_line_type_t line_type(const char **line, const char *line_end);
+static void count_chunks(void *data, u32 begin, u32 end);
+static void parse_chunks(void *data, u32 begin, u32 end);
+static const char *parse_f32(const char *cursor, const char *end, f32 *out);
+static const char *parse_f32_slow(const char *cursor, const char *end, f32 *out);
+static const char *parse_index(const char *cursor, const char *end, u64 *out);
+static const char *skip_blanks(const char *cursor, const char *end);
+
+bool Obj_ParseFloats(const char *str, const char *end, f32 *out, u32 count)
+{
+    const char *cursor = str;
+    for (u32 i = 0; i < count; i++)
+    {
+        cursor = parse_f32(skip_blanks(cursor, end), end, &out[i]);
+        if (!cursor)
+            return false;
+    }
+    return true;
+}
+
+bool Obj_ParseFace(const char *str, const char *end, obj_face_t *face)
+{
+    const char *cursor = str;
+    for (u32 i = 0; i < 3; i++)
+    {
+        u64 v;
+        cursor = parse_index(skip_blanks(cursor, end), end, &v);
+        if (!cursor || v == 0 || v > OBJ_MAX_INDEX)
+            return false;
+
+        u64 t = 0;
+        u64 n = 0;
+        if (cursor < end && *cursor == '/')
+        {
+            cursor++;
+            const char *t_end = parse_index(cursor, end, &t);
+            if (t_end)
+                cursor = t_end;
+            if (t > OBJ_MAX_INDEX)
+                return false;
+
+            if (cursor < end && *cursor == '/')
+            {
+                cursor = parse_index(cursor + 1, end, &n);
+                if (!cursor || n > OBJ_MAX_INDEX)
+                    return false;
+            }
+        }
+
+        face->v[i] = (u32)v;
+        face->t[i] = (u32)t;
+        face->n[i] = (u32)n;
+    }
+
+    while (cursor < end && *cursor == ' ')
+        cursor++;
+
+    /* a fourth vertex ref means a non-triangulated face */
+    return cursor == end;
+}
+
+bool Obj_Parse(arena_t *arena, const char *data, u64 size, const char *name,
+               obj_mesh_data_t *mesh_out)
+{
+    ProfileZone("Obj_Parse");
+    const char *file_end = data + size;
+
+    /* cut the file into chunks at line starts, so no line is split */
+    u32 chunk_count = (u32)Min(size / OBJ_CHUNK_SIZE + 1, (u64)OBJ_MAX_CHUNKS);
+    obj_chunk_t *chunks = arena_push_array(arena, obj_chunk_t, chunk_count);
+
+    const char *chunk_begin = data;
+    for (u32 i = 0; i < chunk_count; i++)
+    {
+        const char *chunk_end = file_end;
+        if (i + 1 < chunk_count)
+        {
+            const char *target = Max(chunk_begin, data + size / chunk_count * (i + 1));
+            const char *newline = memchr(target, '\n', (u64)(file_end - target));
+            chunk_end = newline ? newline + 1 : file_end;
+        }
+
+        chunks[i].begin = chunk_begin;
+        chunks[i].end = chunk_end;
+        chunk_begin = chunk_end;
+    }
+
+    obj_parse_t parse = {.chunks = chunks};
+    Job_ParallelFor(chunk_count, 1, count_chunks, &parse);
+
+    // Prefix sum the per chunk counts into array offsets
+    u32 position_count = 0;
+    u32 uv_count = 0;
+    u32 normal_count = 0;
+    u32 face_count = 0;
+    u32 object_count = 0;
+
+    for (u32 i = 0; i < chunk_count; i++)
+    {
+        obj_chunk_t *chunk = &chunks[i];
+        chunk->first_position = position_count;
+        chunk->first_uv = uv_count;
+        chunk->first_normal = normal_count;
+        chunk->first_face = face_count;
+
+        /* u64 sums: the per chunk counts can't overflow, the totals could */
+        if ((u64)position_count + chunk->position_count > OBJ_MAX_INDEX
+            || (u64)uv_count + chunk->uv_count > OBJ_MAX_INDEX
+            || (u64)normal_count + chunk->normal_count > OBJ_MAX_INDEX
+            || (u64)face_count + chunk->face_count > U32_MAX / 3)
+        {
+            Log(ERROR, "obj '%s' exceeds max element count", name);
+            return false;
+        }
+
+        position_count += chunk->position_count;
+        uv_count += chunk->uv_count;
+        normal_count += chunk->normal_count;
+        face_count += chunk->face_count;
+        object_count += chunk->object_count;
+    }
+
+    if (position_count == 0 || face_count == 0)
+    {
+        Log(ERROR, "obj '%s' has no geometry", name);
+        return false;
+    }
+
+    if (object_count > 1)
+    {
+        Log(ERROR, "obj '%s': multiple objects not supported", name);
+        return false;
+    }
+
+    vec3 *positions = arena_push_array_no_zero(arena, vec3, position_count);
+    vec2 *uvs = arena_push_array_no_zero(arena, vec2, uv_count);
+    vec3 *normals = arena_push_array_no_zero(arena, vec3, normal_count);
+    obj_face_t *faces = arena_push_array_no_zero(arena, obj_face_t, face_count);
+
+    // Parse elements in place, every chunk into its own slice of the arrays
+    parse.positions = positions;
+    parse.uvs = uvs;
+    parse.normals = normals;
+    parse.faces = faces;
+    Job_ParallelFor(chunk_count, 1, parse_chunks, &parse);
+
+    for (u32 i = 0; i < chunk_count; i++)
+    {
+        if (chunks[i].error_line)
+        {
+            Log(ERROR, "obj '%s': failed to parse line '%.*s'", name,
+                (int)(chunks[i].error_end - chunks[i].error_line), chunks[i].error_line);
+            return false;
+        }
+    }
+
+    // Deduplicate v/t/n triplets into a single vertex + index stream
+    u32 max_vertices = face_count * 3;
+    textured_normal_vertex_t *vertices =
+        arena_push_array_no_zero(arena, textured_normal_vertex_t, max_vertices);
+    /* with room for the level of detail chain, see MeshOptimize_Lods */
+    u32 *indices = arena_push_array_no_zero(arena, u32, (u64)max_vertices * 3);
+    u32 vertex_count = 0;
+    u32 index_count = 0;
+    vec3 bounds_min = {};
+    vec3 bounds_max = {};
+
+    u64 bucket_count = 64;
+    while (bucket_count < max_vertices)
+        bucket_count <<= 1;
+    hash_map_t vertex_map = HashMap_Create(arena, bucket_count);
+
+    for (u32 face_index = 0; face_index < face_count; face_index++)
+    {
+        const obj_face_t *face = &faces[face_index];
+
+        /* reversed ref order flips the obj winding to match the engine */
+        for (i32 i = 2; i >= 0; i--)
+        {
+            u32 v = face->v[i];
+            u32 t = face->t[i];
+            u32 n = face->n[i];
+
+            if (v > position_count || t > uv_count || n > normal_count)
+            {
+                Log(ERROR, "obj '%s': face index out of range", name);
+                return false;
+            }
+
+            u64 key = (u64)v | ((u64)t << 21) | ((u64)n << 42);
+            u32 index;
+            if (!HashMap_U64U32_Get(&vertex_map, key, &index))
+            {
+                index = vertex_count++;
+                textured_normal_vertex_t *vertex = &vertices[index];
+                vertex->position = positions[v - 1];
+                if (index == 0)
+                {
+                    bounds_min = vertex->position;
+                    bounds_max = vertex->position;
+                }
+                for (u32 axis = 0; axis < 3; axis++)
+                {
+                    bounds_min.Elements[axis] = Min(bounds_min.Elements[axis], vertex->position.Elements[axis]);
+                    bounds_max.Elements[axis] = Max(bounds_max.Elements[axis], vertex->position.Elements[axis]);
+                }
+                vertex->normal = n ? normals[n - 1] : V3(0.0f, 0.0f, 0.0f);
+                /* obj uv origin is bottom-left, engine textures are top-left */
+                vertex->texture_coord = t ? V2(uvs[t - 1].X, 1.0f - uvs[t - 1].Y)
+                                          : V2(0.0f, 0.0f);
+                HashMap_U64U32_Insert(&vertex_map, key, index);
+            }
+            indices[index_count++] = index;
+        }
+    }
+
+    // Reorder for the post-transform cache and the vertex fetch
+    void *streams[] = {vertices};
+    mesh_optimize_result_t optimized = MeshOptimize_Mesh(arena, indices, index_count, streams, 1, vertex_count,
+                                                         sizeof(textured_normal_vertex_t));
+    Log(DEBUG, "obj '%s': %u -> %u vertices, acmr %.3f -> %.3f, atvr %.3f -> %.3f", name, vertex_count,
+        optimized.vertex_count, optimized.before.acmr, optimized.after.acmr, optimized.before.atvr,
+        optimized.after.atvr);
+    vertex_count = optimized.vertex_count;
+
+    // Coarser levels of detail over the same vertices
+    mesh_out->lod_count = MeshOptimize_Lods(arena, mesh_out->lods, indices, NULL, index_count,
+                                            (const void *const *)streams, 1, vertex_count,
+                                            sizeof(textured_normal_vertex_t));
+    for (u32 i = 1; i < mesh_out->lod_count; i++)
+    {
+        const mesh_lod_t *lod = &mesh_out->lods[i];
+        MeshOptimize_VertexCache(arena, indices + lod->first_index, lod->index_count, vertex_count);
+        Log(DEBUG, "obj '%s': lod %u has %u triangles, error %.4f", name, i, lod->index_count / 3, lod->error);
+    }
+    const mesh_lod_t *last_lod = &mesh_out->lods[mesh_out->lod_count - 1];
+    index_count = last_lod->first_index + last_lod->index_count;
+
+    mesh_out->layout = OBJ_VERTEX_TEXTURED_NORMAL;
+    mesh_out->vertex_data = vertices;
+    mesh_out->vertex_data_size = vertex_count * sizeof(textured_normal_vertex_t);
+    mesh_out->vertex_count = vertex_count;
+    mesh_out->index_type = VertexPack_IndexType(vertex_count);
+    mesh_out->indices = VertexPack_Indices(arena, indices, index_count, mesh_out->index_type);
+    mesh_out->index_count = index_count;
+    mesh_out->bounds_min = bounds_min;
+    mesh_out->bounds_max = bounds_max;
+
+    /* objs without uvs use normal_vertex_t so they render with the same
+       pipelines as the predefined normaled meshes */
+    // TODO REMOVE
+    if (uv_count == 0)
+    {
+        normal_vertex_t *packed = arena_push_array_no_zero(arena, normal_vertex_t, vertex_count);
+        for (u32 i = 0; i < vertex_count; i++)
+        {
+            packed[i].position = vertices[i].position;
+            packed[i].normal = vertices[i].normal;
+        }
+        mesh_out->layout = OBJ_VERTEX_NORMAL;
+        mesh_out->vertex_data = packed;
+        mesh_out->vertex_data_size = vertex_count * sizeof(normal_vertex_t);
+    }
+
+    return true;
+}
+
+/* the line at cursor ends at *line_end (newline and CR excluded); returns
+   the start of the next one */
+static const char *next_line(const char *cursor, const char *end, const char **line_end)
+{
+    const char *newline = memchr(cursor, '\n', (u64)(end - cursor));
+    const char *stop = newline ? newline : end;
+    if (stop > cursor && stop[-1] == '\r')
+        stop--;
+
+    *line_end = stop;
+    return newline ? newline + 1 : end;
+}
+
+/* advances *line past the keyword of the element lines */
+static obj_line_type_t line_type(const char **line, const char *line_end)
+{
+    const char *str = *line;
+    u64 len = (u64)(line_end - str);
+
+    if (len >= 2 && str[1] == ' ')
+    {
+        *line = str + 2;
+        switch (str[0])
+        {
+            case 'v': return OBJ_LINE_POSITION;
+            case 'f': return OBJ_LINE_FACE;
+            case 'o': return OBJ_LINE_OBJECT;
+            default: break;
+        }
+    }
+    else if (len >= 3 && str[0] == 'v' && str[2] == ' ')
+    {
+        *line = str + 3;
+        if (str[1] == 't')
+            return OBJ_LINE_UV;
+        if (str[1] == 'n')
+            return OBJ_LINE_NORMAL;
+    }
+
+    return OBJ_LINE_OTHER;
+}
+
+static void count_chunks(void *data, u32 begin, u32 end)
+{
+    obj_parse_t *parse = data;
+
+    for (u32 i = begin; i < end; i++)
+    {
+        obj_chunk_t *chunk = &parse->chunks[i];
+        for (const char *cursor = chunk->begin; cursor < chunk->end;)
+        {
+            const char *line = cursor;
+            const char *line_end;
+            cursor = next_line(cursor, chunk->end, &line_end);
+
+            switch (line_type(&line, line_end))
+            {
+                case OBJ_LINE_POSITION: chunk->position_count++; break;
+                case OBJ_LINE_UV:       chunk->uv_count++; break;
+                case OBJ_LINE_NORMAL:   chunk->normal_count++; break;
+                case OBJ_LINE_FACE:     chunk->face_count++; break;
+                case OBJ_LINE_OBJECT:   chunk->object_count++; break;
+                case OBJ_LINE_OTHER:    break;
+            }
+        }
+    }
+}
+
+static void parse_chunks(void *data, u32 begin, u32 end)
+{
+    obj_parse_t *parse = data;
+
+    for (u32 i = begin; i < end; i++)
+    {
+        obj_chunk_t *chunk = &parse->chunks[i];
+        vec3 *position = parse->positions + chunk->first_position;
+        vec2 *uv = parse->uvs + chunk->first_uv;
+        vec3 *normal = parse->normals + chunk->first_normal;
+        obj_face_t *face = parse->faces + chunk->first_face;
+
+        for (const char *cursor = chunk->begin; cursor < chunk->end;)
+        {
+            const char *line = cursor;
+            const char *line_end;
+            cursor = next_line(cursor, chunk->end, &line_end);
+
+            const char *payload = line;
+            bool ok = true;
+            switch (line_type(&payload, line_end))
+            {
+                case OBJ_LINE_POSITION:
+                    ok = Obj_ParseFloats(payload, line_end, (position++)->Elements, 3);
+                    break;
+                case OBJ_LINE_UV:
+                    ok = Obj_ParseFloats(payload, line_end, (uv++)->Elements, 2);
+                    break;
+                case OBJ_LINE_NORMAL:
+                    ok = Obj_ParseFloats(payload, line_end, (normal++)->Elements, 3);
+                    break;
+                case OBJ_LINE_FACE:
+                    ok = Obj_ParseFace(payload, line_end, face++);
+                    break;
+                case OBJ_LINE_OBJECT:
+                case OBJ_LINE_OTHER:
+                    break;
+            }
+
+            if (!ok)
+            {
+                chunk->error_line = line;
+                chunk->error_end = line_end;
+                break;
+            }
+        }
+    }
+}
+
+/* decimal to float without strtof in the common case: up to 19 digits
+   with a power of ten of at most 22 gives a correctly rounded double with
+   one operation (clinger's fast path). rounding that double to float
+   again is exact unless it lies on a midpoint between two floats, which
+   goes to strtof like everything else unusual (inf, nan, long mantissas,
+   big exponents) */
+static const char *parse_f32(const char *cursor, const char *end, f32 *out)
+{
+    const char *start = cursor;
+
+    bool negative = false;
+    if (cursor < end && (*cursor == '-' || *cursor == '+'))
+    {
+        negative = *cursor == '-';
+        cursor++;
+    }
+
+    u64 mantissa = 0;
+    u32 digit_count = 0;
+    const char *integer = cursor;
+    while (cursor < end && (u8)(*cursor - '0') < 10)
+    {
+        mantissa = mantissa * 10 + (u8)(*cursor - '0');
+        digit_count++;
+        cursor++;
+    }
+    bool has_digits = cursor != integer;
+
+    i32 exponent = 0;
+    if (cursor < end && *cursor == '.')
+    {
+        cursor++;
+        const char *fraction = cursor;
+        while (cursor < end && (u8)(*cursor - '0') < 10)
+        {
+            mantissa = mantissa * 10 + (u8)(*cursor - '0');
+            digit_count++;
+            cursor++;
+        }
+        exponent = -(i32)(cursor - fraction);
+        has_digits |= cursor != fraction;
+    }
+
+    if (!has_digits || digit_count > 19)
+        return parse_f32_slow(start, end, out);
+
+    if (cursor < end && (*cursor == 'e' || *cursor == 'E'))
+    {
+        const char *exp_cursor = cursor + 1;
+        bool exp_negative = false;
+        if (exp_cursor < end && (*exp_cursor == '-' || *exp_cursor == '+'))
+        {
+            exp_negative = *exp_cursor == '-';
+            exp_cursor++;
+        }
+
+        i32 exp_value = 0;
+        const char *exp_digits = exp_cursor;
+        while (exp_cursor < end && (u8)(*exp_cursor - '0') < 10 && exp_value < 1000)
+        {
+            exp_value = exp_value * 10 + (u8)(*exp_cursor - '0');
+            exp_cursor++;
+        }
+        if (exp_cursor == exp_digits || (exp_cursor < end && (u8)(*exp_cursor - '0') < 10))
+            return parse_f32_slow(start, end, out);
+
+        exponent += exp_negative ? -exp_value : exp_value;
+        cursor = exp_cursor;
+    }
+
+    if (mantissa > ((u64)1 << 53) || exponent < -22 || exponent > 22)
+        return parse_f32_slow(start, end, out);
+
+    f64 value = (f64)mantissa;
+    value = exponent < 0 ? value / s_pow10[-exponent] : value * s_pow10[exponent];
+
+    /* the 29 bits a float drops being exactly one half */
+    u64 bits;
+    MemoryCopy(&bits, &value, sizeof(bits));
+    if ((bits & 0x1FFFFFFF) == 0x10000000)
+        return parse_f32_slow(start, end, out);
+
+    *out = (f32)(negative ? -value : value);
+    return cursor;
+}
+
+/* the data isn't null-terminated, so strtof gets a copy of the token */
+static const char *parse_f32_slow(const char *cursor, const char *end, f32 *out)
+{
+    char token[OBJ_MAX_NUMBER];
+    u64 len = 0;
+    while (cursor + len < end && cursor[len] != ' ' && cursor[len] != '\t')
+    {
+        if (len + 1 >= sizeof(token))
+            return NULL;
+        token[len] = cursor[len];
+        len++;
+    }
+    token[len] = '\0';
+
+    char *token_end;
+    *out = strtof(token, &token_end);
+    if (token_end == token)
+        return NULL;
+
+    return cursor + (token_end - token);
+}
+
+/* NULL without digits; values past OBJ_MAX_INDEX saturate instead of
+   wrapping */
+static const char *parse_index(const char *cursor, const char *end, u64 *out)
+{
+    const char *start = cursor;
+    u64 value = 0;
+    while (cursor < end && (u8)(*cursor - '0') < 10)
+    {
+        value = Min(value * 10 + (u8)(*cursor - '0'), (u64)OBJ_MAX_INDEX + 1);
+        cursor++;
+    }
+
+    *out = value;
+    return cursor != start ? cursor : NULL;
+}
+
+static const char *skip_blanks(const char *cursor, const char *end)
+{
+    while (cursor < end && (*cursor == ' ' || *cursor == '\t'))
+        cursor++;
+    return cursor;
+}
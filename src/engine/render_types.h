@@ -15,6 +15,10 @@
 #define TEXTURE_HANDLE_INVALID  0
 #define SAMPLER_HANDLE_INVALID  0
 
+/* textures that can exist at once; see Renderer_GetTextureIndex for where in
+   the global descriptor array each one samples from */
+#define MAX_TEXTURES 1024
+
 #define MAX_VERTEX_ATTRIBUTES 8
 #define MAX_UNIFORM_BINDINGS  4
 
@@ -30,6 +34,106 @@ typedef struct
     u32 height;
 } window_extent_t;
 
+typedef enum
+{
+    TEXTURE_FLAG_NONE = 0,
+    /* a full mip chain, filtered on the cpu at load. for textures drawn
+       smaller than their size; ui drawn texel for texel doesn't need one */
+    TEXTURE_FLAG_MIPMAPS = 1 << 0,
+
+    /* block compressed, cooked once per source: at most one of these.
+       bc7 for color, bc1 for opaque or cut out color at half of bc7's size
+       and quality, bc4 for single channel data like masks */
+    TEXTURE_FLAG_BC7 = 1 << 1,
+    TEXTURE_FLAG_BC1 = 1 << 2,
+    TEXTURE_FLAG_BC4 = 1 << 3,
+} texture_flags_t;
+
+#define TEXTURE_FLAGS_COMPRESSION (TEXTURE_FLAG_BC7 | TEXTURE_FLAG_BC1 | TEXTURE_FLAG_BC4)
+
+/* single channel formats sample their channel in all four components, so
+   shaders read them like a grey rgba texture */
+typedef enum
+{
+    TEXTURE_FORMAT_RGBA8_SRGB = 0,
+    TEXTURE_FORMAT_R8,
+    TEXTURE_FORMAT_BC1_SRGB,    /* 8 bytes per 4x4 block, 1 bit alpha */
+    TEXTURE_FORMAT_BC4,         /* 8 bytes per 4x4 block */
+    TEXTURE_FORMAT_BC7_SRGB,    /* 16 bytes per 4x4 block */
+    TEXTURE_FORMAT_COUNT,
+} texture_format_t;
+
+#define TEXTURE_FORMAT_IS_COMPRESSED(format) ((format) >= TEXTURE_FORMAT_BC1_SRGB)
+
+/* a full chain of a 32768 texel texture */
+#define TEXTURE_MAX_MIP_LEVELS 16
+
+/* texels ready for the device: level i is max(width >> i, 1) by
+   max(height >> i, 1), tightly packed in format */
+typedef struct
+{
+    texture_format_t    format;
+    u32                 width;
+    u32                 height;
+    u32                 level_count;
+    const void          *levels[TEXTURE_MAX_MIP_LEVELS];
+    u64                 level_sizes[TEXTURE_MAX_MIP_LEVELS];
+} texture_data_t;
+
+/* preferred swapchain present mode; unsupported modes fall back toward FIFO,
+   which every surface supports (MAILBOX -> IMMEDIATE -> FIFO,
+   FIFO_RELAXED -> FIFO) */
+typedef enum
+{
+    PRESENT_MODE_FIFO = 0,      /* vsync */
+    PRESENT_MODE_FIFO_RELAXED,  /* vsync, late frames tear instead of waiting a refresh */
+    PRESENT_MODE_MAILBOX,       /* no tearing, newest frame replaces the queued one */
+    PRESENT_MODE_IMMEDIATE,     /* no vsync */
+} present_mode_t;
+
+/* cpu time spent inside the renderer's end of frame. present_wait covers
+   everything blocking on the gpu or display: the frame slot wait, image
+   acquire and vkQueuePresentKHR. upload_bytes is what the transfer submits
+   copied to buffer objects */
+typedef struct
+{
+    u64 present_wait_ns;
+    u64 bake_ns;
+    u64 submit_ns;
+    u64 upload_bytes;
+} render_timings_t;
+
+#define MAX_GPU_TIMERS      32
+#define GPU_TIMER_LABEL_LEN 24
+
+/* gpu time of one pass or the transfer copies, in OS_TimeNowNs nanoseconds.
+   the gpu clock is lined up with the frame's first queue submit, so a timer
+   never starts before the cpu handed the work over */
+typedef struct
+{
+    char    label[GPU_TIMER_LABEL_LEN];
+    u64     start_ns;
+    u64     end_ns;
+} gpu_timer_t;
+
+/* the most recent frame whose queries have completed, a few frames behind */
+typedef struct
+{
+    u32         timer_count;
+    gpu_timer_t timers[MAX_GPU_TIMERS];
+    f32         frame_ms;   /* first graphics queue timestamp to last */
+
+    /* draw command buffer totals, when pipeline statistics are enabled */
+    bool        statistics_valid;
+    u64         vertex_invocations;
+    u64         fragment_invocations;
+} gpu_frame_timings_t;
+
+/* the packed formats are for attributes that don't need f32 precision:
+   16 bit floats, signed normalized 16 bit (positions relative to the mesh
+   bounds, oct encoded normals), unsigned normalized 8 bit colors and small
+   integers like material indices. 3 component variants are left out as
+   devices needn't support them as vertex formats */
 typedef enum
 {
     VERTEX_FORMAT_F32 = 0,
@@ -37,8 +141,38 @@ typedef enum
     VERTEX_FORMAT_F32X3,
     VERTEX_FORMAT_F32X4,
     VERTEX_FORMAT_U32,
+
+    VERTEX_FORMAT_F16X2,
+    VERTEX_FORMAT_F16X4,
+    VERTEX_FORMAT_SNORM16X2,
+    VERTEX_FORMAT_SNORM16X4,
+    VERTEX_FORMAT_UNORM8X4,
+    VERTEX_FORMAT_U8,
 } vertex_format_t;
 
+/* 0 is u32, so zero-initialized meshes keep the old index size */
+typedef enum
+{
+    INDEX_TYPE_U32 = 0,
+    INDEX_TYPE_U16,
+} index_type_t;
+
+#define INDEX_TYPE_SIZE(type) ((type) == INDEX_TYPE_U16 ? sizeof(u16) : sizeof(u32))
+
+/* levels of detail of one mesh, the full one included */
+#define MESH_MAX_LODS 4
+
+/* one level of detail: index_count indices from first_index of the mesh's
+   index buffer, each plus vertex_offset. error bounds how far, in mesh
+   units, its surface lies from the full detail one */
+typedef struct
+{
+    u32 first_index;
+    u32 index_count;
+    u32 vertex_offset;
+    f32 error;
+} mesh_lod_t;
+
 typedef struct
 {
     u32             location;
@@ -65,6 +199,8 @@ typedef enum
     UNIFORM_STAGE_FRAGMENT,
 } uniform_stage_t;
 
+/* binding is the slot in set 1 (< MAX_UNIFORM_BINDINGS); every slot is
+   visible to both stages, stage is kept for the buffer object type */
 typedef struct
 {
     u32                     binding;
@@ -91,6 +227,11 @@ struct _pipeline_config_t
     bool alpha_blending;
     bool disable_depth_test;
 
+    /* no vertex attributes: the vertex shader reads the mesh's vertices
+       itself, see mesh_push_constant_t. meshes of any layout can then
+       share the pipeline as far as the shader allows */
+    bool vertex_pulling;
+
     // TODO vertex topology (always triangle list for now)
 };
 
@@ -99,4 +240,36 @@ typedef struct
     u64 __instance_data_address; /* storage buffer device address, filled in by the renderer */
 } sbo_push_constant_t;
 
+/* leads the push constant of a vertex pulling pipeline, filled in by the
+   mesh draws: the instance storage buffer as in sbo_push_constant_t, then
+   the address of the mesh's vertex buffer. the vertex shader reads vertex
+   gl_VertexIndex of it, which includes the mesh's first vertex */
+typedef struct
+{
+    u64 __instance_data_address;
+    u64 __vertex_address;
+} mesh_push_constant_t;
+
+/* leads the push constant of a morph pipeline, filled in by
+   Renderer_DrawModelAnimated: vertex i blends vertices first_a + i and
+   first_b + i of the pull buffer at vertex_address by blend. padded so the
+   fields after it start 16-byte aligned, like a glsl mat4 */
+typedef struct
+{
+    u64 __vertex_address;
+    u32 __first_a;
+    u32 __first_b;
+    f32 __blend;
+    u32 __reserved[3];
+} morph_push_constant_t;
+StaticAssert(sizeof(morph_push_constant_t) == 32, "morph_push_constant_t must match the shaders");
+
+/* leads the push constant of an instanced model pipeline, filled in by
+   Renderer_DrawModelInstanced */
+typedef struct
+{
+    u64 __instance_data_address;
+    u64 __animation_table_address;
+} model_instanced_push_constant_t;
+
 #endif
@@ -1,63 +1,106 @@
-#include <stdio.h>
-
 #include "core.h"
-#include "file.h"
 #include "log.h"
 #include "mesh.h"
 #include "model.h"
-#include "os_path.h"
-#include "image.h"
+#include "profiler.h"
+#include "vfs.h"
 #include "mesh_internal.h"
+#include "mipmap.h"
 #include "renderer.h"
+#include "texture_cache.h"
 
 #include "vulkan_pass.h"
 #include "vulkan_renderer.h"
 #include "vulkan_buffer.h"
+#include "vulkan_texture.h"
 
-#define MAX_RESOURCE_PATH 512
+/* how far, in pixels, a level of detail may stray on screen */
+#define LOD_MAX_PIXEL_ERROR 1.0f
 
 render_stats_t g_render_stats = {};
 
 extern arena_t *g_engine_arena;
+extern arena_t *g_scratch;
+
+static struct
+{
+    vec3 eye;
+    f32 pixels_per_unit;    /* at distance 1, or anywhere when orthographic */
+    bool perspective;
+    bool enabled;
+} s_lod_view;
+
+static void draw_mesh(renderpass_handle_t pass_handle, pipeline_handle_t pipeline, const void *push_constant_data,
+                      buffer_object_handle_t instance_buffer, u32 instance_count, mesh_handle_t mesh, u32 lod_index);
+static bool create_mesh_buffers(bool deferred, const void *vertices, u32 vertex_count, u32 stride,
+                                const void *indices, u32 index_count, index_type_t type,
+                                mesh_buffers_t *buffers_out);
+static u32 select_lod(const mesh_t *mesh, mat4 transform);
+static mesh_lod_t get_lod(const mesh_t *mesh, u32 lod);
 
 bool Renderer_Init()
 {
+    Mipmap_Init();
     return true;
 }
 
 shader_code_t Renderer_LoadShader(const char *path)
 {
+    ProfileZone("Renderer_LoadShader");
     Assert(g_engine_arena != NULL);
 
-    char full_path[MAX_RESOURCE_PATH];
-    snprintf(full_path, sizeof(full_path), "%s%s", OS_GetBasePath(), path);
-
     shader_code_t shader = {0};
-    shader.code = File_Read(g_engine_arena, full_path, &shader.size);
+
+    /* pipelines keep the code, so it is copied out of the archive mapping */
+    scratch_t scratch = Scratch_Begin(g_scratch);
+    vfs_file_t file;
+    if (Vfs_Open(scratch.arena, path, &file))
+    {
+        u8 *code = arena_push_array_no_zero(g_engine_arena, u8, file.size);
+        MemoryCopy(code, file.data, file.size);
+        shader.code = code;
+        shader.size = file.size;
+        Vfs_Close(&file);
+    }
+    Scratch_End(scratch);
 
     return shader;
 }
 
-texture_handle_t Renderer_LoadTexture(const char *path, sampler_handle_t sampler)
+texture_handle_t Renderer_LoadTexture(const char *path, sampler_handle_t sampler, texture_flags_t flags)
 {
-    char full_path[MAX_RESOURCE_PATH];
-    snprintf(full_path, sizeof(full_path), "%s%s", OS_GetBasePath(), path);
-
-    image_t image;
-    if (!Image_Load(full_path, &image))
-        return TEXTURE_HANDLE_INVALID;
-
-    texture_handle_t texture = VulkanRenderer_CreateTexture(image.width, image.height,
-                                                            image.data, sampler);
-    Image_Unload(&image);
+    ProfileZone("Renderer_LoadTexture");
+    Assert(g_scratch != NULL);
+
+    scratch_t scratch = Scratch_Begin(g_scratch);
+    texture_handle_t texture = TEXTURE_HANDLE_INVALID;
+    texture_data_t data;
+    file_map_t map;
+    if (TextureCache_Load(scratch.arena, path, flags, &data, &map))
+    {
+        if (VulkanTexture_IsFormatSupported(data.format) || TextureCache_Decompress(scratch.arena, &data))
+            texture = VulkanRenderer_CreateTexture(&data, sampler);
+        File_Unmap(&map);
+    }
+    Scratch_End(scratch);
 
     return texture;
 }
 
 texture_handle_t Renderer_CreateTexture(u32 width, u32 height, const u8 *rgba_data,
-                                        sampler_handle_t sampler)
+                                        sampler_handle_t sampler, texture_flags_t flags)
 {
-    return VulkanRenderer_CreateTexture(width, height, rgba_data, sampler);
+    Assert(g_scratch != NULL);
+
+    scratch_t scratch = Scratch_Begin(g_scratch);
+    texture_handle_t texture = TEXTURE_HANDLE_INVALID;
+    texture_data_t data;
+    TextureCache_Build(scratch.arena, rgba_data, width, height, flags, &data);
+    if (VulkanTexture_IsFormatSupported(data.format) || TextureCache_Decompress(scratch.arena, &data))
+        texture = VulkanRenderer_CreateTexture(&data, sampler);
+    Scratch_End(scratch);
+
+    return texture;
 }
 
 sampler_handle_t Renderer_CreateSampler(void)
@@ -65,6 +108,11 @@ sampler_handle_t Renderer_CreateSampler(void)
     return VulkanRenderer_CreateSampler();
 }
 
+u32 Renderer_GetTextureIndex(texture_handle_t texture)
+{
+    return VulkanTexture_GetSlot(texture);
+}
+
 texture_handle_t Renderer_CreateRenderTexture(u32 width, u32 height, sampler_handle_t sampler)
 {
     return VulkanRenderer_CreateRenderTexture(width, height, sampler);
@@ -115,11 +163,23 @@ bool Renderer_PushBufferObject(buffer_object_handle_t handle, const void *data,
     return VulkanBuffer_PushObjectData(handle, data, size);
 }
 
+void Renderer_SetLodView(vec3 eye, mat4 projection)
+{
+    /* the projection's y scale takes a unit at distance 1 to half the
+       viewport height */
+    window_extent_t extent = Renderer_GetWindowExtent();
+    s_lod_view.eye = eye;
+    s_lod_view.pixels_per_unit = HMM_ABS(projection.Elements[1][1]) * (f32)extent.height * 0.5f;
+    s_lod_view.perspective = projection.Elements[2][3] != 0.0f;
+    s_lod_view.enabled = true;
+}
+
 void Renderer_DrawMesh(renderpass_handle_t pass_handle, pipeline_handle_t pipeline,
-                       const void *push_constant_data, mesh_handle_t mesh_handle)
+                       const void *push_constant_data, mesh_handle_t mesh_handle, mat4 transform)
 {
-    Renderer_DrawMeshInstanced(pass_handle, pipeline, push_constant_data,
-                               BUFFER_OBJECT_HANDLE_INVALID, 1, mesh_handle);
+    Assert(mesh_handle != MESH_INVALID_HANDLE);
+    draw_mesh(pass_handle, pipeline, push_constant_data, BUFFER_OBJECT_HANDLE_INVALID, 1, mesh_handle,
+              select_lod(mesh_handle, transform));
 }
 
 void Renderer_DrawMeshInstanced(renderpass_handle_t pass_handle, pipeline_handle_t pipeline,
@@ -128,34 +188,144 @@ void Renderer_DrawMeshInstanced(renderpass_handle_t pass_handle, pipeline_handle
                                 mesh_handle_t mesh)
 {
     Assert(mesh != MESH_INVALID_HANDLE);
+    draw_mesh(pass_handle, pipeline, push_constant_data, instance_buffer, instance_count, mesh, 0);
+}
+
+void Renderer_DrawModel(renderpass_handle_t pass_handle, pipeline_handle_t pipeline,
+                       const void *push_constant_data, model_handle_t model, mat4 transform)
+{
+    Renderer_DrawModelAnimated(pass_handle, pipeline, push_constant_data, model, transform, 0, 0.0f);
+}
+
+void Renderer_DrawModelAnimated(renderpass_handle_t pass_handle, pipeline_handle_t pipeline,
+                                const void *push_constant_data, model_handle_t model, mat4 transform,
+                                u32 animation, f32 time_s)
+{
+    Assert(model != MODEL_INVALID_HANDLE);
+    Assert(animation < model->animation_count);
+
+    const model_animation_t *anim = &model->animations[animation];
+    model_sample_t sample = Model_SampleAnimation(anim, time_s);
+    mesh_handle_t mesh_a = anim->keyframes[sample.keyframe_a].mesh;
+    mesh_handle_t mesh_b = anim->keyframes[sample.keyframe_b].mesh;
+
+    if (mesh_a->index_count == 0)
+        return;
+
+    /* the keyframes of a model share one pull buffer */
+    Assert(mesh_a->vertex_address != 0 && mesh_a->vertex_address == mesh_b->vertex_address);
+
+    morph_push_constant_t morph = {
+        .__vertex_address = mesh_a->vertex_address,
+        .__first_a = mesh_a->vertex_offset,
+        .__first_b = mesh_b->vertex_offset,
+        .__blend = sample.blend,
+    };
 
+    /* a level's vertices sit at the same offset in every keyframe */
+    mesh_lod_t lod = get_lod(mesh_a, select_lod(mesh_a, transform));
     draw_command_t draw_command = {
         .pass = pass_handle,
         .pipeline = pipeline,
         .push_constant_data = push_constant_data,
-        .storage_buffer = instance_buffer,
-        .vertex_buffer = mesh->vertex_buffer,
-        .index_buffer = mesh->index_buffer,
-        .index_count = mesh->index_count,
-        .instance_count = instance_count,
+        .storage_buffer = BUFFER_OBJECT_HANDLE_INVALID,
+        .push_prefix_size = sizeof(morph),
+        .vertex_buffer = mesh_a->vertex_buffer,
+        .index_buffer = mesh_a->index_buffer,
+        .first_index = lod.first_index,
+        .index_count = lod.index_count,
+        .index_type = mesh_a->index_type,
+        .instance_count = 1,
+        .vertex_offset = lod.vertex_offset,
     };
+    StaticAssert(sizeof(morph) <= sizeof(draw_command.push_prefix), "push prefix too small");
+    MemoryCopy(draw_command.push_prefix, &morph, sizeof(morph));
 
     g_render_stats.n_draw_calls++;
-    g_render_stats.n_triangles += instance_count * (mesh->index_count / 3);
+    g_render_stats.n_triangles += lod.index_count / 3;
 
     VulkanPass_AddDrawCommand(&draw_command);
 }
 
-void Renderer_DrawModel(renderpass_handle_t pass_handle, pipeline_handle_t pipeline,
-                       const void *push_constant_data, model_handle_t model)
+void Renderer_DrawModelInstanced(renderpass_handle_t pass_handle, pipeline_handle_t pipeline,
+                                 const void *push_constant_data, model_handle_t model,
+                                 buffer_object_handle_t instance_buffer, const model_instance_t *instances,
+                                 u32 instance_count)
 {
     Assert(model != MODEL_INVALID_HANDLE);
+    Assert(instance_buffer != BUFFER_OBJECT_HANDLE_INVALID);
+
+    if (model->animation_count == 0 || model->animations[0].keyframe_count == 0 || instance_count == 0)
+        return;
 
+    /* every keyframe mesh of a model shares the index buffer and levels */
     mesh_handle_t mesh = model->animations[0].keyframes[0].mesh;
-    Renderer_DrawMeshInstanced(pass_handle, pipeline, push_constant_data,
-                               BUFFER_OBJECT_HANDLE_INVALID, 1, mesh);
-}
+    if (mesh->index_count == 0)
+        return;
+
+    Assert(model->animation_table_address != 0);
+
+    // Instances grouped by level of detail, one draw per level in use
+    scratch_t scratch = Scratch_Begin(g_scratch);
+    u8 *instance_lods = arena_push_array_no_zero(scratch.arena, u8, instance_count);
+    u32 lod_counts[MESH_MAX_LODS] = {};
+    for (u32 i = 0; i < instance_count; i++)
+    {
+        instance_lods[i] = (u8)select_lod(mesh, instances[i].transform);
+        lod_counts[instance_lods[i]]++;
+    }
+
+    u32 lod_firsts[MESH_MAX_LODS];
+    u32 lod_cursors[MESH_MAX_LODS];
+    for (u32 lod = 0, first = 0; lod < MESH_MAX_LODS; lod++)
+    {
+        lod_firsts[lod] = lod_cursors[lod] = first;
+        first += lod_counts[lod];
+    }
+
+    model_instance_t *grouped = arena_push_array_no_zero(scratch.arena, model_instance_t, instance_count);
+    for (u32 i = 0; i < instance_count; i++)
+        grouped[lod_cursors[instance_lods[i]]++] = instances[i];
+
+    bool uploaded = Renderer_SetBufferObject(instance_buffer, grouped, sizeof(model_instance_t) * instance_count);
+    Scratch_End(scratch);
+    if (!uploaded)
+        return;
+
+    model_instanced_push_constant_t prefix = {
+        .__animation_table_address = model->animation_table_address,
+    };
 
+    for (u32 lod_index = 0; lod_index < MESH_MAX_LODS; lod_index++)
+    {
+        if (lod_counts[lod_index] == 0)
+            continue;
+
+        mesh_lod_t lod = get_lod(mesh, lod_index);
+        draw_command_t draw_command = {
+            .pass = pass_handle,
+            .pipeline = pipeline,
+            .push_constant_data = push_constant_data,
+            .storage_buffer = instance_buffer,
+            .push_prefix_size = sizeof(prefix),
+            .vertex_buffer = mesh->vertex_buffer,
+            .index_buffer = mesh->index_buffer,
+            .first_index = lod.first_index,
+            .index_count = lod.index_count,
+            .index_type = mesh->index_type,
+            .first_instance = lod_firsts[lod_index],
+            .instance_count = lod_counts[lod_index],
+            .vertex_offset = lod.vertex_offset,
+        };
+        StaticAssert(sizeof(prefix) <= sizeof(draw_command.push_prefix), "push prefix too small");
+        MemoryCopy(draw_command.push_prefix, &prefix, sizeof(prefix));
+
+        g_render_stats.n_draw_calls++;
+        g_render_stats.n_triangles += lod_counts[lod_index] * (lod.index_count / 3);
+
+        VulkanPass_AddDrawCommand(&draw_command);
+    }
+}
 
 void Renderer_BeginFrame()
 {
@@ -169,6 +339,36 @@ bool Renderer_EndFrame()
     return VulkanRenderer_EndFrame();
 }
 
+bool Renderer_WaitForFrame()
+{
+    return VulkanRenderer_WaitFrame();
+}
+
+present_mode_t Renderer_SetPresentMode(present_mode_t mode)
+{
+    return VulkanRenderer_SetPresentMode(mode);
+}
+
+u32 Renderer_SetFramesInFlight(u32 frames_in_flight)
+{
+    return VulkanRenderer_SetFramesInFlight(frames_in_flight);
+}
+
+render_timings_t Renderer_TakeTimings()
+{
+    return VulkanRenderer_TakeTimings();
+}
+
+const gpu_frame_timings_t *Renderer_GetGpuTimings()
+{
+    return VulkanRenderer_GetGpuTimings();
+}
+
+bool Renderer_SetGpuStatistics(bool enabled)
+{
+    return VulkanRenderer_SetGpuStatistics(enabled);
+}
+
 // TODO refactor out VkBuffer
 VkBuffer Renderer_CreateStaticVertexBuffer(const void *vertices, u64 size)
 {
@@ -179,10 +379,172 @@ VkBuffer Renderer_CreateStaticVertexBuffer(const void *vertices, u64 size)
 }
 
 // TODO refactor out VkBuffer
-VkBuffer Renderer_CreateStaticIndexBuffer(const u32 *indices, u32 index_count)
+VkBuffer Renderer_CreateStaticIndexBuffer(const void *indices, u32 index_count, index_type_t type)
 {
-    VkBuffer buffer = VulkanRenderer_CreateStaticIndexBuffer(indices, index_count);
+    VkBuffer buffer = VulkanRenderer_CreateStaticIndexBuffer(indices, index_count * INDEX_TYPE_SIZE(type));
     AssertAlways(buffer != VK_NULL_HANDLE);
 
     return buffer;
 }
+
+// TODO refactor out VkBuffer
+VkBuffer Renderer_UploadStaticVertexBuffer(const void *vertices, u64 size)
+{
+    return VulkanBuffer_CreateStaticDeferred(vertices, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+}
+
+// TODO refactor out VkBuffer
+VkBuffer Renderer_UploadStaticIndexBuffer(const void *indices, u32 index_count, index_type_t type)
+{
+    return VulkanBuffer_CreateStaticDeferred((const u8 *)indices, index_count * INDEX_TYPE_SIZE(type),
+                                             VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+}
+
+u32 Renderer_GetUploadCapacity()
+{
+    return VulkanBuffer_GetUploadCapacity();
+}
+
+// TODO refactor out VkBuffer
+VkBuffer Renderer_CreateStaticPullBuffer(const void *vertices, u64 size, u64 *address_out)
+{
+    VkBuffer buffer = VulkanRenderer_CreateStaticPullBuffer(vertices, size);
+    AssertAlways(buffer != VK_NULL_HANDLE);
+
+    *address_out = VulkanBuffer_GetStaticAddress(buffer);
+    return buffer;
+}
+
+// TODO refactor out VkBuffer
+VkBuffer Renderer_UploadStaticPullBuffer(const void *vertices, u64 size, u64 *address_out)
+{
+    VkBuffer buffer = VulkanBuffer_CreateStaticDeferred(vertices, size, VULKAN_PULL_BUFFER_USAGE);
+    *address_out = buffer != VK_NULL_HANDLE ? VulkanBuffer_GetStaticAddress(buffer) : 0;
+
+    return buffer;
+}
+
+bool Renderer_CreateMeshBuffers(const void *vertices, u32 vertex_count, u32 stride, const void *indices,
+                                u32 index_count, index_type_t type, mesh_buffers_t *buffers_out)
+{
+    return create_mesh_buffers(false, vertices, vertex_count, stride, indices, index_count, type, buffers_out);
+}
+
+bool Renderer_UploadMeshBuffers(const void *vertices, u32 vertex_count, u32 stride, const void *indices,
+                                u32 index_count, index_type_t type, mesh_buffers_t *buffers_out)
+{
+    return create_mesh_buffers(true, vertices, vertex_count, stride, indices, index_count, type, buffers_out);
+}
+
+static void draw_mesh(renderpass_handle_t pass_handle, pipeline_handle_t pipeline, const void *push_constant_data,
+                      buffer_object_handle_t instance_buffer, u32 instance_count, mesh_handle_t mesh, u32 lod_index)
+{
+    /* an async mesh without a placeholder, still loading */
+    if (mesh->index_count == 0)
+        return;
+
+    mesh_lod_t lod = get_lod(mesh, lod_index);
+    draw_command_t draw_command = {
+        .pass = pass_handle,
+        .pipeline = pipeline,
+        .push_constant_data = push_constant_data,
+        .storage_buffer = instance_buffer,
+        .vertex_buffer = mesh->vertex_buffer,
+        .vertex_address = mesh->vertex_address,
+        .index_buffer = mesh->index_buffer,
+        .first_index = mesh->first_index + lod.first_index,
+        .index_count = lod.index_count,
+        .index_type = mesh->index_type,
+        .instance_count = instance_count,
+        .vertex_offset = mesh->vertex_offset + lod.vertex_offset,
+    };
+
+    g_render_stats.n_draw_calls++;
+    g_render_stats.n_triangles += instance_count * (lod.index_count / 3);
+
+    VulkanPass_AddDrawCommand(&draw_command);
+}
+
+/* vertices land on a multiple of the stride, indices on one of the index
+   size, so both are addressed by element from the start of the buffer. a
+   full mesh buffer leaves its tail unused */
+static bool create_mesh_buffers(bool deferred, const void *vertices, u32 vertex_count, u32 stride,
+                                const void *indices, u32 index_count, index_type_t type,
+                                mesh_buffers_t *buffers_out)
+{
+    Assert(stride % 4 == 0);
+
+    u64 vertex_size = (u64)vertex_count * stride;
+    u32 index_size = INDEX_TYPE_SIZE(type);
+    u64 vertex_offset;
+    u64 index_offset;
+    bool shared = deferred
+        ? VulkanBuffer_WriteMeshDataDeferred(vertices, vertex_size, stride, &vertex_offset)
+            && VulkanBuffer_WriteMeshDataDeferred(indices, (u64)index_count * index_size, index_size, &index_offset)
+        : VulkanRenderer_WriteMeshData(vertices, vertex_size, stride, &vertex_offset)
+            && VulkanRenderer_WriteMeshData(indices, (u64)index_count * index_size, index_size, &index_offset);
+
+    if (shared)
+    {
+        VkBuffer mesh_buffer = VulkanBuffer_GetMeshBuffer();
+        *buffers_out = (mesh_buffers_t){
+            .vertex_buffer = mesh_buffer,
+            .index_buffer = mesh_buffer,
+            .vertex_address = VulkanBuffer_GetMeshAddress(),
+            .first_vertex = (u32)(vertex_offset / stride),
+            .first_index = (u32)(index_offset / index_size),
+        };
+        return true;
+    }
+
+    MemoryZeroItem(buffers_out);
+    if (deferred)
+    {
+        buffers_out->vertex_buffer = Renderer_UploadStaticPullBuffer(vertices, vertex_size,
+                                                                     &buffers_out->vertex_address);
+        buffers_out->index_buffer = Renderer_UploadStaticIndexBuffer(indices, index_count, type);
+    }
+    else
+    {
+        buffers_out->vertex_buffer = Renderer_CreateStaticPullBuffer(vertices, vertex_size,
+                                                                     &buffers_out->vertex_address);
+        buffers_out->index_buffer = Renderer_CreateStaticIndexBuffer(indices, index_count, type);
+    }
+
+    return buffers_out->vertex_buffer != VK_NULL_HANDLE && buffers_out->index_buffer != VK_NULL_HANDLE;
+}
+
+/* the coarsest level whose error stays under LOD_MAX_PIXEL_ERROR, measured
+   at the nearest point of the mesh's bounding sphere */
+static u32 select_lod(const mesh_t *mesh, mat4 transform)
+{
+    if (mesh->lod_count <= 1 || !s_lod_view.enabled)
+        return 0;
+
+    f32 scale = 0.0f;
+    for (u32 axis = 0; axis < 3; axis++)
+        scale = Max(scale, HMM_LenV3(transform.Columns[axis].XYZ));
+
+    f32 pixels_per_unit = s_lod_view.pixels_per_unit * scale;
+    if (s_lod_view.perspective)
+    {
+        vec3 center = HMM_MulM4V4(transform, HMM_V4V(mesh->center, 1.0f)).XYZ;
+        f32 distance = HMM_LenV3(HMM_SubV3(center, s_lod_view.eye)) - mesh->radius * scale;
+        if (distance <= 0.0f)
+            return 0;
+        pixels_per_unit /= distance;
+    }
+
+    u32 lod = 0;
+    while (lod + 1 < mesh->lod_count && mesh->lods[lod + 1].error * pixels_per_unit <= LOD_MAX_PIXEL_ERROR)
+        lod++;
+    return lod;
+}
+
+/* meshes without levels of detail only have the full one */
+static mesh_lod_t get_lod(const mesh_t *mesh, u32 lod)
+{
+    if (mesh->lod_count == 0)
+        return (mesh_lod_t){.index_count = mesh->index_count};
+    return mesh->lods[lod];
+}
@@ -13,6 +13,18 @@ typedef struct
     u32 n_triangles;
 } render_stats_t;
 
+/* where a static mesh lives on the gpu: its vertices from vertex
+   first_vertex of the buffer at vertex_address, its indices from index
+   first_index of index_buffer */
+typedef struct
+{
+    VkBuffer vertex_buffer;
+    VkBuffer index_buffer;
+    u64 vertex_address;
+    u32 first_vertex;
+    u32 first_index;
+} mesh_buffers_t;
+
 extern render_stats_t g_render_stats;
 
 bool Renderer_Init();
@@ -21,15 +33,22 @@ window_extent_t Renderer_GetWindowExtent(void);
 
 shader_code_t Renderer_LoadShader(const char *path);
 
-/* the returned handle indexes the global texture array in shaders */
-texture_handle_t Renderer_LoadTexture(const char *path, sampler_handle_t sampler);
+/* shaders index the global texture array by Renderer_GetTextureIndex of the
+   returned handle. a compression flag cooks the texture on its first load,
+   see texture_cache.h */
+texture_handle_t Renderer_LoadTexture(const char *path, sampler_handle_t sampler, texture_flags_t flags);
 
 /* texture from raw pixels (width * height * 4 bytes, copied during the
    call); same handle semantics as Renderer_LoadTexture */
 texture_handle_t Renderer_CreateTexture(u32 width, u32 height, const u8 *rgba_data,
-                                        sampler_handle_t sampler);
+                                        sampler_handle_t sampler, texture_flags_t flags);
 sampler_handle_t Renderer_CreateSampler(void);
 
+/* the texture's element in the global texture array, for what is drawn this
+   frame; a texture replaced by an async load or streaming moves, so look it
+   up each frame rather than keeping it */
+u32 Renderer_GetTextureIndex(texture_handle_t texture);
+
 /* a texture that a render pass draws into; sampled like any loaded texture */
 texture_handle_t Renderer_CreateRenderTexture(u32 width, u32 height, sampler_handle_t sampler);
 
@@ -56,27 +75,103 @@ bool Renderer_SetBufferObject(buffer_object_handle_t handle, const void *data, u
 bool Renderer_ClearBufferObject(buffer_object_handle_t handle);
 bool Renderer_PushBufferObject(buffer_object_handle_t handle, const void *data, u64 size);
 
+/* where draws pick their level of detail from, usually the camera of the
+   frame: the coarsest level whose error stays within about a pixel on
+   screen. until the first call every draw is full detail */
+void Renderer_SetLodView(vec3 eye, mat4 projection);
+
 /* push constant data is copied; the pointer only needs to stay valid for the
-   duration of the call */
+   duration of the call. transform is where the mesh is drawn, for picking
+   its level of detail; the shader takes its own from the push constant.
+   with a vertex pulling pipeline the push constant struct starts with a
+   mesh_push_constant_t placeholder, here and for the instanced draw */
 void Renderer_DrawMesh(renderpass_handle_t pass_handle, pipeline_handle_t pipeline,
-                       const void *push_constant_data, mesh_handle_t mesh);
+                       const void *push_constant_data, mesh_handle_t mesh, mat4 transform);
 
 /* draws instance_count instances; if instance_buffer is a valid storage
    buffer handle, the renderer writes its device address into the first 8
    bytes of the push constant, so the push constant struct must start with a
-   u64 placeholder */
+   u64 placeholder. the instances are the caller's own layout, so they
+   draw at full detail */
 void Renderer_DrawMeshInstanced(renderpass_handle_t pass_handle, pipeline_handle_t pipeline,
                                 const void *push_constant_data,
                                 buffer_object_handle_t instance_buffer, u32 instance_count,
                                 mesh_handle_t mesh);
 
+/* the first keyframe, with a pipeline as for Renderer_DrawModelAnimated:
+   model vertices are packed and only pull shaders read them */
 void Renderer_DrawModel(renderpass_handle_t pass_handle, pipeline_handle_t pipeline,
-                       const void *push_constant_data, model_handle_t model);
+                       const void *push_constant_data, model_handle_t model, mat4 transform);
+
+/* draws the model at time_s into animation (looping, see
+   Model_SampleAnimation) in one draw: the pipeline's vertex shader pulls the
+   two surrounding keyframes from the model's pull buffer and blends them,
+   so no vertices are uploaded per frame. the pipeline has no vertex
+   attributes and its push constant struct must start with a
+   morph_push_constant_t placeholder, which the renderer fills in.
+   transform picks the level of detail as for Renderer_DrawMesh */
+void Renderer_DrawModelAnimated(renderpass_handle_t pass_handle, pipeline_handle_t pipeline,
+                                const void *push_constant_data, model_handle_t model, mat4 transform,
+                                u32 animation, f32 time_s);
+
+/* draws instance_count animated copies of the model, one draw per level
+   of detail in use. the instances are copied into instance_buffer,
+   replacing its contents, grouped by level so each draw takes a range of
+   them; the vertex shader resolves each instance's keyframes from the
+   model's animation table the same way Model_SampleAnimation does. the
+   pipeline has no vertex attributes and its push constant struct must
+   start with a model_instanced_push_constant_t placeholder */
+void Renderer_DrawModelInstanced(renderpass_handle_t pass_handle, pipeline_handle_t pipeline,
+                                 const void *push_constant_data, model_handle_t model,
+                                 buffer_object_handle_t instance_buffer, const model_instance_t *instances,
+                                 u32 instance_count);
 
 void Renderer_BeginFrame();
 bool Renderer_EndFrame();
 
+/* blocks until the gpu is done with the frame slot the next frame records
+   into; see VulkanRenderer_WaitFrame */
+bool Renderer_WaitForFrame();
+
+/* returns the mode in use after fallback, see present_mode_t */
+present_mode_t Renderer_SetPresentMode(present_mode_t mode);
+/* returns the count in use, see VulkanRenderer_SetFramesInFlight */
+u32 Renderer_SetFramesInFlight(u32 frames_in_flight);
+
+/* accumulated since the previous call */
+render_timings_t Renderer_TakeTimings();
+
+/* a few frames behind; see VulkanRenderer_GetGpuTimings */
+const gpu_frame_timings_t *Renderer_GetGpuTimings();
+/* shader invocation counts; false if the device can't provide them */
+bool Renderer_SetGpuStatistics(bool enabled);
+
 VkBuffer Renderer_CreateStaticVertexBuffer(const void *vertices, u64 size);
-VkBuffer Renderer_CreateStaticIndexBuffer(const u32 *indices, u32 index_count);
+/* indices of index_type type, u16 or u32 */
+VkBuffer Renderer_CreateStaticIndexBuffer(const void *indices, u32 index_count, index_type_t type);
+
+/* no blocking copy: the upload rides along with the next frame's transfer
+   submit, which that frame's draws wait on. at most
+   Renderer_GetUploadCapacity of them per frame */
+VkBuffer Renderer_UploadStaticVertexBuffer(const void *vertices, u64 size);
+VkBuffer Renderer_UploadStaticIndexBuffer(const void *indices, u32 index_count, index_type_t type);
+u32 Renderer_GetUploadCapacity();
+
+/* vertex_count vertices of stride bytes and their indices, placed in the
+   renderer's shared mesh buffer so draws of different meshes rebind
+   nothing and vertex pulling pipelines reach any of them; once that is
+   full the mesh gets pull buffers of its own. the Upload variant is
+   deferred like Renderer_UploadStaticVertexBuffer and takes two of its
+   uploads */
+bool Renderer_CreateMeshBuffers(const void *vertices, u32 vertex_count, u32 stride, const void *indices,
+                                u32 index_count, index_type_t type, mesh_buffers_t *buffers_out);
+bool Renderer_UploadMeshBuffers(const void *vertices, u32 vertex_count, u32 stride, const void *indices,
+                                u32 index_count, index_type_t type, mesh_buffers_t *buffers_out);
+
+/* static vertex buffers that vertex shaders can also read through their
+   device address (GL_EXT_buffer_reference), written to address_out; the
+   Upload variant is deferred like Renderer_UploadStaticVertexBuffer */
+VkBuffer Renderer_CreateStaticPullBuffer(const void *vertices, u64 size, u64 *address_out);
+VkBuffer Renderer_UploadStaticPullBuffer(const void *vertices, u64 size, u64 *address_out);
 
 #endif
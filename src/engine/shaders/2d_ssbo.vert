@@ -15,24 +15,35 @@ layout(std430, buffer_reference) readonly buffer InstanceData {
     instance_data instances[];
 };
 
+// textured_vertex_t as floats: a vec3 then a vec2
+const uint VERTEX_FLOATS = 5;
+
+layout(std430, buffer_reference, buffer_reference_align = 4) readonly buffer Vertices {
+    float floats[];
+};
+
 layout(set = 1, binding = 0) uniform UniformBufferObject {
     mat4 view;
     mat4 proj;
 } vp;
 
+// mesh_push_constant_t, filled in by the renderer
 layout(push_constant) uniform pushConstants {
     InstanceData quad_data;
+    Vertices vertices;
 } pc;
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec2 inTexCoord;
-
 layout(location = 0) flat out vec4 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 layout(location = 2) flat out uint textureIndex;
 layout(location = 3) flat out vec4 alphaMask;
 
 void main() {
+    uint vertex = gl_VertexIndex * VERTEX_FLOATS;
+    vec3 inPosition = vec3(pc.vertices.floats[vertex], pc.vertices.floats[vertex + 1],
+                           pc.vertices.floats[vertex + 2]);
+    vec2 inTexCoord = vec2(pc.vertices.floats[vertex + 3], pc.vertices.floats[vertex + 4]);
+
     instance_data instance = pc.quad_data.instances[gl_InstanceIndex];
 
     fragColor = instance.color;
@@ -0,0 +1,207 @@
+#include <stdio.h>
+
+#include "core.h"
+#include "log.h"
+#include "os_file.h"
+#include "os_path.h"
+#include "profiler.h"
+#include "vfs.h"
+
+#include "block_compress.h"
+#include "image.h"
+#include "ktx2.h"
+#include "mipmap.h"
+#include "texture_cache.h"
+
+#include "xxh3.h"
+
+#define MAX_CACHE_PATH 512
+
+static bool load_cooked(const char *path, const char *cooked_path, const texture_cook_info_t *info,
+                        texture_data_t *texture_out, file_map_t *map_out);
+static void store_cooked(arena_t *arena, const char *cooked_path, const texture_cook_info_t *info,
+                         const texture_data_t *texture);
+static texture_format_t compressed_format(texture_flags_t flags);
+
+u64 TextureCache_SourceHash(const void *source, u64 size)
+{
+    return XXH3_64bits_withSeed(source, size, TEXTURE_COOK_VERSION);
+}
+
+/* named by the source path, so a changed source overwrites its entry */
+void TextureCache_GetPath(const char *path, char *out, u64 out_size)
+{
+    snprintf(out, out_size, "%s" TEXTURE_CACHE_DIR "%016llx.ktx2", OS_GetBasePath(),
+             (unsigned long long)Vfs_HashPath(path));
+}
+
+void TextureCache_Build(arena_t *arena, const u8 *rgba, u32 width, u32 height, texture_flags_t flags,
+                        texture_data_t *texture_out)
+{
+    ProfileZone("TextureCache_Build");
+
+    u32 level_count = (flags & TEXTURE_FLAG_MIPMAPS) ? Mipmap_LevelCount(width, height) : 1;
+    texture_format_t format = compressed_format(flags);
+    *texture_out = (texture_data_t){
+        .format = format,
+        .width = width,
+        .height = height,
+        .level_count = level_count,
+    };
+
+    /* the blocks go below the chain, so it can be popped once they are coded */
+    for (u32 i = 0; i < level_count; i++)
+    {
+        u64 size = BlockCompress_LevelSize(format, Max(width >> i, 1u), Max(height >> i, 1u));
+        texture_out->level_sizes[i] = size;
+        if (TEXTURE_FORMAT_IS_COMPRESSED(format))
+            texture_out->levels[i] = arena_push_array_no_zero(arena, u8, size);
+    }
+
+    scratch_t scratch = Scratch_Begin(arena);
+    u8 *chain = arena_push_array_no_zero(arena, u8, Mipmap_ChainSize(width, height, level_count));
+    MemoryCopy(chain, rgba, (u64)width * height * 4);
+    Mipmap_Generate(arena, chain, width, height, level_count);
+
+    const u8 *level = chain;
+    for (u32 i = 0; i < level_count; i++)
+    {
+        u32 level_width = Max(width >> i, 1u);
+        u32 level_height = Max(height >> i, 1u);
+        if (TEXTURE_FORMAT_IS_COMPRESSED(format))
+            BlockCompress_Encode(format, (void *)texture_out->levels[i], level, level_width, level_height);
+        else
+            texture_out->levels[i] = level;
+        level += (u64)level_width * level_height * 4;
+    }
+
+    if (TEXTURE_FORMAT_IS_COMPRESSED(format))
+        Scratch_End(scratch);
+}
+
+bool TextureCache_Decompress(arena_t *arena, texture_data_t *texture)
+{
+    ProfileZone("TextureCache_Decompress");
+
+    if (!TEXTURE_FORMAT_IS_COMPRESSED(texture->format))
+        return true;
+
+    texture_format_t format = BlockCompress_DecodedFormat(texture->format);
+    for (u32 i = 0; i < texture->level_count; i++)
+    {
+        u32 level_width = Max(texture->width >> i, 1u);
+        u32 level_height = Max(texture->height >> i, 1u);
+        u64 size = BlockCompress_LevelSize(format, level_width, level_height);
+
+        u8 *texels = arena_push_array_no_zero(arena, u8, size);
+        if (!BlockCompress_Decode(texture->format, texels, texture->levels[i], level_width, level_height))
+            return false;
+
+        texture->levels[i] = texels;
+        texture->level_sizes[i] = size;
+    }
+
+    texture->format = format;
+    return true;
+}
+
+bool TextureCache_Load(arena_t *arena, const char *path, texture_flags_t flags, texture_data_t *texture_out,
+                       file_map_t *map_out)
+{
+    ProfileZone("TextureCache_Load");
+    MemoryZeroItem(map_out);
+
+    vfs_file_t file;
+    if (!Vfs_Open(arena, path, &file))
+        return false;
+
+    bool cook = compressed_format(flags) != TEXTURE_FORMAT_RGBA8_SRGB;
+    char cooked_path[MAX_CACHE_PATH];
+    texture_cook_info_t info = {
+        .source_hash = TextureCache_SourceHash(file.data, file.size),
+        .source_size = file.size,
+        .cook_version = TEXTURE_COOK_VERSION,
+        .flags = flags,
+    };
+    if (cook)
+    {
+        TextureCache_GetPath(path, cooked_path, sizeof(cooked_path));
+        if (load_cooked(path, cooked_path, &info, texture_out, map_out))
+        {
+            Vfs_Close(&file);
+            return true;
+        }
+    }
+
+    image_t image;
+    bool decoded = Image_Decode(file.data, file.size, path, &image);
+    Vfs_Close(&file);
+    if (!decoded)
+        return false;
+
+    TextureCache_Build(arena, image.data, image.width, image.height, flags, texture_out);
+    Image_Unload(&image);
+
+    if (cook)
+        store_cooked(arena, cooked_path, &info, texture_out);
+    return true;
+}
+
+static bool load_cooked(const char *path, const char *cooked_path, const texture_cook_info_t *info,
+                        texture_data_t *texture_out, file_map_t *map_out)
+{
+    /* no entry is the normal first load, so no File_Map error for it */
+    file_map_t map;
+    if (!OS_FileMap(cooked_path, &map.data, &map.size))
+        return false;
+
+    const void *value;
+    u32 value_size;
+    if (!Ktx2_Parse(map.data, map.size, TEXTURE_COOK_KEY, texture_out, &value, &value_size)
+        || value_size != sizeof(*info) || MemoryCompare(value, info, sizeof(*info)) != 0)
+    {
+        Log(INFO, "cooked texture for '%s' is stale, decoding the source", path);
+        OS_FileUnmap(map.data, map.size);
+        return false;
+    }
+
+    *map_out = map;
+    return true;
+}
+
+/* best effort: a failed write only costs the next load a cook */
+static void store_cooked(arena_t *arena, const char *cooked_path, const texture_cook_info_t *info,
+                         const texture_data_t *texture)
+{
+    char directory[MAX_CACHE_PATH];
+    snprintf(directory, sizeof(directory), "%s" TEXTURE_CACHE_DIR, OS_GetBasePath());
+    if (!OS_DirectoryCreate(directory))
+    {
+        Log(WARNING, "failed to create texture cache directory %s", directory);
+        return;
+    }
+
+    scratch_t scratch = Scratch_Begin(arena);
+
+    u64 size = Ktx2_Size(texture, TEXTURE_COOK_KEY, sizeof(*info));
+    u8 *data = arena_push_array_no_zero(scratch.arena, u8, size);
+    Ktx2_Write(data, texture, TEXTURE_COOK_KEY, info, sizeof(*info));
+    File_Write(cooked_path, data, size);
+
+    Scratch_End(scratch);
+}
+
+/* TEXTURE_FORMAT_RGBA8_SRGB without a compression flag */
+static texture_format_t compressed_format(texture_flags_t flags)
+{
+    u32 compression = flags & TEXTURE_FLAGS_COMPRESSION;
+    Assert((compression & (compression - 1)) == 0);
+
+    if (flags & TEXTURE_FLAG_BC7)
+        return TEXTURE_FORMAT_BC7_SRGB;
+    if (flags & TEXTURE_FLAG_BC1)
+        return TEXTURE_FORMAT_BC1_SRGB;
+    if (flags & TEXTURE_FLAG_BC4)
+        return TEXTURE_FORMAT_BC4;
+    return TEXTURE_FORMAT_RGBA8_SRGB;
+}
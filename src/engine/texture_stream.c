@@ -0,0 +1,421 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "core.h"
+#include "file.h"
+#include "job.h"
+#include "log.h"
+#include "memory_arena.h"
+#include "profiler.h"
+
+#include "block_compress.h"
+#include "renderer.h"
+#include "texture_cache.h"
+#include "texture_stream.h"
+
+#include "vulkan_texture.h"
+
+#define MAX_STREAM_PATH 512
+
+/* jobs in flight, first loads included, so the tails of newly registered
+   textures go in before anything streams finer levels */
+#define MAX_STREAM_JOBS 4
+
+typedef struct _stream_texture_t stream_texture_t;
+struct _stream_texture_t
+{
+    char                path[MAX_STREAM_PATH];
+    texture_flags_t     flags;
+    texture_handle_t    handle;
+
+    /* main thread, set once the first job is done */
+    bool                loaded;
+    u32                 width;
+    u32                 height;
+    u32                 tail_level;         /* the finest level of the tail */
+    u64                 level_bytes[TEXTURE_MAX_MIP_LEVELS + 1];   /* of levels [i, count) on the device */
+    u32                 resident_level;     /* the finest level on the device */
+    u32                 target_level;       /* resident_level, or what the job in flight loads */
+    u32                 wanted_level;       /* the finest level the last requests asked for */
+    u64                 last_used_frame;
+
+    /* this frame's largest request */
+    bool                requested;
+    f32                 requested_width;
+    f32                 requested_height;
+
+    /* the job owns everything below until the counter drops to zero */
+    job_counter_t       counter;
+    bool                busy;
+    bool                uploaded;
+    u32                 job_level;          /* the first job picks the tail itself */
+    texture_upload_t    upload;
+    file_map_t          map;                /* the cooked entry, mapped for good */
+    texture_data_t      chain;              /* the full chain, pointing into map */
+};
+
+typedef struct
+{
+    stream_texture_t    *textures;
+    u32                 texture_count;
+
+    /* 1-based index into textures by texture handle, 0 if not streamed */
+    u16                 by_handle[MAX_TEXTURES + 1];
+
+    u64                 budget;
+    u64                 committed_bytes;    /* of every texture's target_level */
+    u64                 resident_bytes;     /* of every texture's resident_level */
+    u32                 job_count;
+    u32                 cursor;
+    u64                 frame;
+
+    texture_handle_t    placeholder;
+} texture_stream_t;
+
+static texture_stream_t s_stream = {};
+
+extern arena_t *g_engine_arena;
+
+static void stream_job(void *data);
+static bool open_chain(arena_t *arena, stream_texture_t *texture, bool *whole_out);
+static u32 find_tail_level(const texture_data_t *chain);
+static void start_job(stream_texture_t *texture, u32 level);
+static void finish_job(stream_texture_t *texture);
+static void init_levels(stream_texture_t *texture);
+static u32 fit_level(stream_texture_t *texture);
+static bool evict_one(const stream_texture_t *except);
+static u32 request_level(const stream_texture_t *texture);
+
+bool TextureStream_Init(void)
+{
+    Assert(g_engine_arena != NULL);
+
+    s_stream.textures = arena_push_array(g_engine_arena, stream_texture_t, TEXTURE_STREAM_MAX);
+    s_stream.budget = TEXTURE_STREAM_DEFAULT_BUDGET;
+
+    static const u8 white[4] = {0xff, 0xff, 0xff, 0xff};
+    sampler_handle_t sampler = Renderer_CreateSampler();
+    if (sampler == SAMPLER_HANDLE_INVALID)
+        return false;
+
+    s_stream.placeholder = Renderer_CreateTexture(1, 1, white, sampler, TEXTURE_FLAG_NONE);
+    if (s_stream.placeholder == TEXTURE_HANDLE_INVALID)
+        return false;
+
+    Log(INFO, "Texture streaming initialized [%ju MB budget]", s_stream.budget / MB(1));
+    return true;
+}
+
+void TextureStream_Destroy(void)
+{
+    for (u32 i = 0; i < s_stream.texture_count; i++)
+    {
+        stream_texture_t *texture = &s_stream.textures[i];
+        if (texture->busy)
+        {
+            /* swapped in all the same, so the image is destroyed with the
+               rest of the textures */
+            Job_Wait(&texture->counter);
+            if (texture->uploaded)
+                VulkanTexture_Fill(texture->handle, &texture->upload);
+        }
+        File_Unmap(&texture->map);
+    }
+
+    MemoryZeroItem(&s_stream);
+}
+
+void TextureStream_Update(void)
+{
+    ProfileZone("TextureStream_Update");
+    s_stream.frame++;
+
+    for (u32 i = 0; i < s_stream.texture_count; i++)
+    {
+        stream_texture_t *texture = &s_stream.textures[i];
+        if (texture->busy && Job_IsDone(&texture->counter))
+            finish_job(texture);
+
+        if (texture->requested)
+        {
+            if (texture->loaded)
+                texture->wanted_level = request_level(texture);
+            texture->last_used_frame = s_stream.frame;
+            texture->requested = false;
+            texture->requested_width = 0.0f;
+            texture->requested_height = 0.0f;
+        }
+    }
+
+    /* the budget may have been lowered */
+    while (s_stream.committed_bytes > s_stream.budget && evict_one(NULL))
+        ;
+
+    /* round robin, so one texture's requests can't hold up the others */
+    u32 count = s_stream.texture_count;
+    for (u32 n = 0; n < count && s_stream.job_count < MAX_STREAM_JOBS; n++)
+    {
+        u32 index = (s_stream.cursor + n) % count;
+        stream_texture_t *texture = &s_stream.textures[index];
+        if (!texture->loaded || texture->busy || texture->wanted_level >= texture->target_level)
+            continue;
+
+        /* the evictions fit_level makes room with are jobs too, and may
+           have taken the last ones; then this texture goes first next time */
+        u32 level = fit_level(texture);
+        if (s_stream.job_count >= MAX_STREAM_JOBS)
+        {
+            s_stream.cursor = index;
+            break;
+        }
+
+        if (level < texture->target_level)
+        {
+            start_job(texture, level);
+            s_stream.cursor = (index + 1) % count;
+        }
+    }
+}
+
+texture_handle_t TextureStream_Register(const char *path, sampler_handle_t sampler, texture_flags_t flags)
+{
+    Assert((flags & TEXTURE_FLAG_MIPMAPS) && (flags & TEXTURE_FLAGS_COMPRESSION));
+
+    if (s_stream.texture_count >= TEXTURE_STREAM_MAX)
+    {
+        Log(ERROR, "maximum number of streamed textures reached");
+        return TEXTURE_HANDLE_INVALID;
+    }
+
+    texture_handle_t handle = VulkanTexture_CreatePending(s_stream.placeholder, sampler);
+    if (handle == TEXTURE_HANDLE_INVALID)
+        return TEXTURE_HANDLE_INVALID;
+
+    stream_texture_t *texture = &s_stream.textures[s_stream.texture_count++];
+    snprintf(texture->path, sizeof(texture->path), "%s", path);
+    texture->flags = flags;
+    texture->handle = handle;
+    s_stream.by_handle[handle] = (u16)s_stream.texture_count;
+
+    texture->busy = true;
+    s_stream.job_count++;
+    Job_Run(stream_job, texture, &texture->counter);
+
+    return handle;
+}
+
+void TextureStream_Request(texture_handle_t texture, f32 width, f32 height)
+{
+    if (texture > MAX_TEXTURES || s_stream.by_handle[texture] == 0)
+        return;
+
+    stream_texture_t *streamed = &s_stream.textures[s_stream.by_handle[texture] - 1];
+    streamed->requested = true;
+    streamed->requested_width = Max(streamed->requested_width, width);
+    streamed->requested_height = Max(streamed->requested_height, height);
+}
+
+void TextureStream_SetBudget(u64 bytes)
+{
+    s_stream.budget = bytes;
+}
+
+u64 TextureStream_GetResidentBytes(void)
+{
+    return s_stream.resident_bytes;
+}
+
+/* uploads levels [job_level, count) as an image of their own; the device
+   samples them like the full chain, just with fewer levels to pick from */
+static void stream_job(void *data)
+{
+    ProfileZone("TextureStream_Load");
+    stream_texture_t *texture = data;
+    arena_t *arena = MemoryArena_Create("texture-stream");
+
+    texture->uploaded = false;
+    if (texture->chain.level_count == 0)
+    {
+        bool whole;
+        if (!open_chain(arena, texture, &whole))
+            goto done;
+        texture->job_level = whole ? 0 : find_tail_level(&texture->chain);
+    }
+
+    const texture_data_t *chain = &texture->chain;
+    u32 first = texture->job_level;
+    texture_data_t levels = {
+        .format = chain->format,
+        .width = Max(chain->width >> first, 1u),
+        .height = Max(chain->height >> first, 1u),
+        .level_count = chain->level_count - first,
+    };
+    for (u32 i = 0; i < levels.level_count; i++)
+    {
+        levels.levels[i] = chain->levels[first + i];
+        levels.level_sizes[i] = chain->level_sizes[first + i];
+    }
+
+    texture->uploaded = (VulkanTexture_IsFormatSupported(levels.format) || TextureCache_Decompress(arena, &levels))
+        && VulkanTexture_Upload(&levels, &texture->upload);
+
+done:
+    MemoryArena_Destroy(arena);
+}
+
+/* a fresh cook comes back on the arena instead of mapped, so the entry it
+   just stored is loaded again. without an entry there is nothing to stream
+   from: the texture is loaded whole, with all of it as its tail, and its
+   levels are gone with the arena */
+static bool open_chain(arena_t *arena, stream_texture_t *texture, bool *whole_out)
+{
+    *whole_out = false;
+    for (u32 attempt = 0; attempt < 2; attempt++)
+    {
+        if (!TextureCache_Load(arena, texture->path, texture->flags, &texture->chain, &texture->map))
+            return false;
+        if (texture->map.data != NULL)
+            return true;
+    }
+
+    Log(WARNING, "no texture cache entry for '%s', it is loaded whole", texture->path);
+    *whole_out = true;
+    return true;
+}
+
+static u32 find_tail_level(const texture_data_t *chain)
+{
+    u32 level = 0;
+    while (level + 1 < chain->level_count
+           && Max(chain->width >> level, chain->height >> level) > TEXTURE_STREAM_TAIL_SIZE)
+        level++;
+    return level;
+}
+
+static void start_job(stream_texture_t *texture, u32 level)
+{
+    Log(DEBUG, "streaming '%s' from level %u to %u", texture->path, texture->target_level, level);
+
+    s_stream.committed_bytes = s_stream.committed_bytes - texture->level_bytes[texture->target_level]
+        + texture->level_bytes[level];
+    texture->target_level = level;
+    texture->job_level = level;
+
+    texture->busy = true;
+    s_stream.job_count++;
+    Job_Run(stream_job, texture, &texture->counter);
+}
+
+static void finish_job(stream_texture_t *texture)
+{
+    texture->busy = false;
+    s_stream.job_count--;
+
+    /* VulkanTexture_Fill takes the upload's image also when it fails */
+    bool filled = texture->uploaded && VulkanTexture_Fill(texture->handle, &texture->upload);
+
+    if (!texture->loaded)
+    {
+        if (!filled)
+        {
+            Log(ERROR, "failed to load streamed texture %s", texture->path);
+            return;
+        }
+
+        init_levels(texture);
+        s_stream.committed_bytes += texture->level_bytes[texture->tail_level];
+        s_stream.resident_bytes += texture->level_bytes[texture->tail_level];
+        return;
+    }
+
+    if (!filled)
+    {
+        /* keeps what is resident and stops asking for more until the next request */
+        Log(ERROR, "failed to stream texture %s", texture->path);
+        s_stream.committed_bytes = s_stream.committed_bytes - texture->level_bytes[texture->target_level]
+            + texture->level_bytes[texture->resident_level];
+        texture->target_level = texture->resident_level;
+        texture->wanted_level = texture->resident_level;
+        return;
+    }
+
+    s_stream.resident_bytes = s_stream.resident_bytes - texture->level_bytes[texture->resident_level]
+        + texture->level_bytes[texture->job_level];
+    texture->resident_level = texture->job_level;
+}
+
+/* once the first job has opened the chain and filled the tail */
+static void init_levels(stream_texture_t *texture)
+{
+    const texture_data_t *chain = &texture->chain;
+    texture_format_t format = VulkanTexture_IsFormatSupported(chain->format)
+        ? chain->format
+        : BlockCompress_DecodedFormat(chain->format);
+
+    texture->level_bytes[chain->level_count] = 0;
+    for (u32 i = chain->level_count; i-- > 0;)
+    {
+        texture->level_bytes[i] = texture->level_bytes[i + 1]
+            + BlockCompress_LevelSize(format, Max(chain->width >> i, 1u), Max(chain->height >> i, 1u));
+    }
+
+    texture->width = chain->width;
+    texture->height = chain->height;
+    texture->tail_level = texture->job_level;
+    texture->resident_level = texture->job_level;
+    texture->target_level = texture->job_level;
+    texture->wanted_level = texture->job_level;
+    texture->loaded = true;
+}
+
+/* the finest level from wanted_level on that fits the budget once the
+   textures drawn longest ago are evicted for it; target_level if none */
+static u32 fit_level(stream_texture_t *texture)
+{
+    u64 others = s_stream.committed_bytes - texture->level_bytes[texture->target_level];
+    while (others + texture->level_bytes[texture->wanted_level] > s_stream.budget && evict_one(texture))
+        others = s_stream.committed_bytes - texture->level_bytes[texture->target_level];
+
+    for (u32 level = texture->wanted_level; level < texture->target_level; level++)
+    {
+        if (others + texture->level_bytes[level] <= s_stream.budget)
+            return level;
+    }
+    return texture->target_level;
+}
+
+/* drops the texture drawn longest ago, and not last frame, to its tail */
+static bool evict_one(const stream_texture_t *except)
+{
+    if (s_stream.job_count >= MAX_STREAM_JOBS)
+        return false;
+
+    stream_texture_t *oldest = NULL;
+    for (u32 i = 0; i < s_stream.texture_count; i++)
+    {
+        stream_texture_t *texture = &s_stream.textures[i];
+        if (texture == except || !texture->loaded || texture->busy || texture->target_level >= texture->tail_level
+            || texture->last_used_frame == s_stream.frame)
+            continue;
+
+        if (oldest == NULL || texture->last_used_frame < oldest->last_used_frame)
+            oldest = texture;
+    }
+
+    if (oldest == NULL)
+        return false;
+
+    oldest->wanted_level = oldest->tail_level;
+    start_job(oldest, oldest->tail_level);
+    return true;
+}
+
+/* the level the sampler reads at the requested size; trilinear filtering
+   blends it with the next coarser one */
+static u32 request_level(const stream_texture_t *texture)
+{
+    f32 ratio = Max((f32)texture->width / Max(texture->requested_width, 1.0f),
+                    (f32)texture->height / Max(texture->requested_height, 1.0f));
+    u32 level = ratio > 1.0f ? (u32)log2f(ratio) : 0;
+    return Min(level, texture->tail_level);
+}
@@ -0,0 +1,46 @@
+#ifndef TEXTURE_STREAM_H
+#define TEXTURE_STREAM_H
+
+#include "core.h"
+#include "render_types.h"
+
+/* texture streaming. a streamed texture keeps its cooked mip chain on disk
+   (see texture_cache.h) and only the levels draws ask for on the device. it
+   starts out with its mip tail, the levels of at most
+   TEXTURE_STREAM_TAIL_SIZE texels a side, which stays resident for good;
+   TextureStream_Request records how large it is drawn and
+   TextureStream_Update streams the finer levels in as jobs. while the
+   streamed textures don't fit the budget, the ones drawn longest ago drop
+   back to their tail; the ones drawn last frame stay, so what is on screen
+   may overrun it. the handle stays valid throughout and samples whatever
+   is resident */
+
+#define TEXTURE_STREAM_MAX              256
+#define TEXTURE_STREAM_TAIL_SIZE        64
+#define TEXTURE_STREAM_DEFAULT_BUDGET   MB(256)
+
+bool TextureStream_Init(void);
+
+/* finishes the loads in progress; the textures stay as they are */
+void TextureStream_Destroy(void);
+
+/* once a frame, before drawing: swaps in the finished levels, then evicts
+   and streams for the last frame's requests */
+void TextureStream_Update(void);
+
+/* flags need TEXTURE_FLAG_MIPMAPS and a compression flag, as the cooked
+   ktx2 is what streams. the texture samples white until its tail is in;
+   a failed load keeps that. returns TEXTURE_HANDLE_INVALID if the load
+   can't be started */
+texture_handle_t TextureStream_Register(const char *path, sampler_handle_t sampler, texture_flags_t flags);
+
+/* feedback: texture covers about width x height pixels this frame. any
+   handle may be passed; ones that aren't streamed are ignored */
+void TextureStream_Request(texture_handle_t texture, f32 width, f32 height);
+
+/* the level bytes all streamed textures may hold together, tails
+   included; images round up a little on top. from the next update on */
+void TextureStream_SetBudget(u64 bytes);
+u64  TextureStream_GetResidentBytes(void);
+
+#endif
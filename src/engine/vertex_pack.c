@@ -0,0 +1,111 @@
+#include <math.h>
+
+#include "core.h"
+#include "core_math.h"
+#include "profiler.h"
+
+#include "vertex_pack.h"
+
+StaticAssert(sizeof(packed_material_vertex_t) == 12, "packed_material_vertex_t must match the shaders");
+StaticAssert(sizeof(packed_material_header_t) == 32, "packed_material_header_t must match the shaders");
+
+static i16 pack_snorm16(f32 value);
+static void pack_octahedral(vec3 normal, i16 out[2]);
+
+index_type_t VertexPack_IndexType(u32 vertex_count)
+{
+    return vertex_count <= VERTEX_PACK_MAX_U16_VERTICES ? INDEX_TYPE_U16 : INDEX_TYPE_U32;
+}
+
+const void *VertexPack_Indices(arena_t *arena, const u32 *indices, u32 index_count, index_type_t type)
+{
+    if (type == INDEX_TYPE_U32)
+        return indices;
+
+    u16 *narrow = arena_push_array_no_zero(arena, u16, index_count);
+    for (u32 i = 0; i < index_count; i++)
+    {
+        Assert(indices[i] < VERTEX_PACK_MAX_U16_VERTICES);
+        narrow[i] = (u16)indices[i];
+    }
+    return narrow;
+}
+
+u64 VertexPack_MaterialSize(u32 stream_count, u32 vertex_count)
+{
+    return sizeof(packed_material_header_t) + (u64)stream_count * vertex_count * sizeof(packed_material_vertex_t);
+}
+
+void VertexPack_MaterialVertices(void *dst, const normal_material_vertex_t *const *streams, u32 stream_count,
+                                 u32 vertex_count)
+{
+    ProfileZone("VertexPack_MaterialVertices");
+
+    /* one quantization for all streams, so keyframes blend exactly. no
+       vertices at all still get a valid header */
+    vec3 min = stream_count > 0 && vertex_count > 0 ? streams[0][0].position : V3(0.0f, 0.0f, 0.0f);
+    vec3 max = min;
+    for (u32 s = 0; s < stream_count; s++)
+    {
+        for (u32 v = 0; v < vertex_count; v++)
+        {
+            vec3 position = streams[s][v].position;
+            min = V3(Min(min.X, position.X), Min(min.Y, position.Y), Min(min.Z, position.Z));
+            max = V3(Max(max.X, position.X), Max(max.Y, position.Y), Max(max.Z, position.Z));
+        }
+    }
+
+    packed_material_header_t *header = dst;
+    vec3 offset;
+    vec3 inverse_scale;
+    for (u32 axis = 0; axis < 3; axis++)
+    {
+        /* a flat axis still divides by something */
+        f32 half_extent = Max((max.Elements[axis] - min.Elements[axis]) * 0.5f, 1e-6f);
+        offset.Elements[axis] = (min.Elements[axis] + max.Elements[axis]) * 0.5f;
+        inverse_scale.Elements[axis] = 1.0f / half_extent;
+        header->position_offset[axis] = offset.Elements[axis];
+        header->position_scale[axis] = half_extent;
+    }
+    header->position_offset[3] = 0.0f;
+    header->position_scale[3] = 0.0f;
+
+    packed_material_vertex_t *out = (packed_material_vertex_t *)(header + 1);
+    for (u32 s = 0; s < stream_count; s++)
+    {
+        for (u32 v = 0; v < vertex_count; v++, out++)
+        {
+            const normal_material_vertex_t *vertex = &streams[s][v];
+            vec3 position = HMM_MulV3(HMM_SubV3(vertex->position, offset), inverse_scale);
+            out->position[0] = pack_snorm16(position.X);
+            out->position[1] = pack_snorm16(position.Y);
+            out->position[2] = pack_snorm16(position.Z);
+            Assert(vertex->material <= U8_MAX);
+            out->material = (u8)vertex->material;
+            out->reserved = 0;
+            pack_octahedral(vertex->normal, out->normal);
+        }
+    }
+}
+
+static i16 pack_snorm16(f32 value)
+{
+    /* value is in [-1, 1] by construction, give or take rounding, which
+       the truncation absorbs; copysignf keeps the rounding branch free */
+    f32 scaled = value * 32767.0f;
+    return (i16)(scaled + copysignf(0.5f, scaled));
+}
+
+/* the normal projected onto the octahedron |x| + |y| + |z| = 1, the lower
+   half folded over the upper one; decoded as in the model shaders */
+static void pack_octahedral(vec3 normal, i16 out[2])
+{
+    f32 length = fabsf(normal.X) + fabsf(normal.Y) + fabsf(normal.Z);
+    f32 inverse_length = length > 0.0f ? 1.0f / length : 0.0f;
+    f32 u = normal.X * inverse_length;
+    f32 v = normal.Y * inverse_length;
+    f32 folded_u = copysignf(1.0f - fabsf(v), u);
+    f32 folded_v = copysignf(1.0f - fabsf(u), v);
+    out[0] = pack_snorm16(normal.Z < 0.0f ? folded_u : u);
+    out[1] = pack_snorm16(normal.Z < 0.0f ? folded_v : v);
+}
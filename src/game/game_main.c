@@ -3,16 +3,17 @@
 #include "core_math.h"
 #include "log.h"
 
+#include "asset.h"
 #include "engine_main.h"
 #include "engine_types.h"
 #include "game_main.h"
 #include "memory_arena.h"
+#include "profiler.h"
 #include "mesh.h"
 #include "model.h"
 #include "platform.h"
 #include "render_types.h"
 #include "renderer.h"
-#include "frog.h"
 
 #define GRID_WIDTH              256
 #define GRID_HEIGHT             256
@@ -26,6 +27,12 @@
 #define PLAYER_BUMP_SPEED       5.0f
 #define PLAYER_BUMP_DISTANCE    0.3f
 
+#define CROWD_SIZE              500
+#define CROWD_SPACING           2       /* tiles between frogs */
+#define CROWD_RADIUS            24      /* tiles around the start, >= spacing * sqrt(size) / 2 */
+#define CROWD_COLOR_A           V4(0.35f, 0.55f, 0.25f, 1.0f)
+#define CROWD_COLOR_B           V4(0.55f, 0.65f, 0.20f, 1.0f)
+
 
 #define CAMERA_BOT_CLAMP -2.0f
 #define CAMERA_TOP_CLAMP 5.0f
@@ -50,7 +57,7 @@
 
 typedef struct
 {
-    sbo_push_constant_t sbo;
+    mesh_push_constant_t mesh;
 } tile_push_constant_t;
 
 typedef struct
@@ -62,9 +69,24 @@ StaticAssert(sizeof(tile_instance_t) == 80, "quad_instance_t must match the shad
 
 typedef struct
 {
+    morph_push_constant_t __morph;
     mat4 transform;
     vec4 color;
 } player_push_constant_t;
+StaticAssert(offsetof(player_push_constant_t, transform) == 32, "player_push_constant_t must match frog_player_morph.vert");
+
+typedef struct
+{
+    model_instanced_push_constant_t model;
+} crowd_push_constant_t;
+
+typedef struct
+{
+    vec3 pos;
+    f32  rot;
+    f32  time_offset;   /* so the crowd doesn't move in lockstep */
+    vec4 color;
+} crowd_frog_t;
 
 typedef enum
 {
@@ -102,6 +124,11 @@ typedef struct
 
     pipeline_handle_t player_pipeline;
 
+    pipeline_handle_t crowd_pipeline;
+    buffer_object_handle_t crowd_sbo;
+    crowd_frog_t crowd[CROWD_SIZE];
+    model_instance_t crowd_instances[CROWD_SIZE];
+
     buffer_object_handle_t vp_uniform;
 
 
@@ -112,6 +139,7 @@ typedef struct
 
     player_anim_t player_anim;
     f32 player_anim_progress;
+    f32 player_model_time;      /* playback time of the model's animation */
 
     vec3 player_gfx_pos;
     vec3 player_gfx_target_pos;
@@ -139,6 +167,8 @@ static camera_rig_t camera_rig_for(camera_mode_t mode, f32 aspect);
 static void camera_set_mode(camera_mode_t mode);
 static void draw_grid(void);
 static void draw_player(void);
+static void init_crowd(void);
+static void draw_crowd(void);
 static vec3 tile_center(i32 x, i32 y);
 static vec3 player_center(i32 x, i32 y);
 static f32  wrap_angle_deg(f32 angle);
@@ -167,20 +197,7 @@ bool Game_Init(platform_window_t *window)
         .vertex_shader = Renderer_LoadShader("shaders/tile.vert.spv"),
         .fragment_shader = Renderer_LoadShader("shaders/tile.frag.spv"),
         .push_constant_size = sizeof(tile_push_constant_t),
-        .vertex_stride = sizeof(normal_vertex_t),
-        .vertex_attribute_count = 2,
-        .vertex_attributes = {
-            {
-                .location = 0,
-                .format = VERTEX_FORMAT_F32X3,
-                .offset = offsetof(normal_vertex_t, position),
-            },
-            {
-                .location = 1,
-                .format = VERTEX_FORMAT_F32X3,
-                .offset = offsetof(normal_vertex_t, normal),
-            },
-        },
+        .vertex_pulling = true,
         .uniform_binding_count = 1,
         .uniform_bindings = {
             {
@@ -202,28 +219,10 @@ bool Game_Init(platform_window_t *window)
 
     pipeline_config_t player_pipeline_config = {
         .name = "player",
-        .vertex_shader = Renderer_LoadShader("shaders/frog_player.vert.spv"),
+        /* pulls and blends keyframes itself, so no vertex attributes */
+        .vertex_shader = Renderer_LoadShader("shaders/frog_player_morph.vert.spv"),
         .fragment_shader = Renderer_LoadShader("shaders/frog_player.frag.spv"),
         .push_constant_size = sizeof(player_push_constant_t),
-        .vertex_stride = sizeof(normal_material_vertex_t),
-        .vertex_attribute_count = 2,
-        .vertex_attributes = {
-            {
-                .location = 0,
-                .format = VERTEX_FORMAT_F32X3,
-                .offset = offsetof(normal_material_vertex_t, position),
-            },
-            {
-                .location = 1,
-                .format = VERTEX_FORMAT_F32X3,
-                .offset = offsetof(normal_material_vertex_t, normal),
-            },
-            {
-                .location = 2,
-                .format = VERTEX_FORMAT_U32,
-                .offset = offsetof(normal_material_vertex_t, material),
-            },
-        },
         .uniform_binding_count = 1,
         .uniform_bindings = {
             {
@@ -242,8 +241,34 @@ bool Game_Init(platform_window_t *window)
         return false;
     }
 
-    g_game.player_mesh = MeshManager_LoadMesh(string_lit("resources/models/suzanne.obj"));
-    g_game.player_model = Frog_LoadModel("resources/models/human.frog");
+    pipeline_config_t crowd_pipeline_config = {
+        .name = "crowd",
+        .vertex_shader = Renderer_LoadShader("shaders/frog_crowd.vert.spv"),
+        .fragment_shader = Renderer_LoadShader("shaders/frog_player.frag.spv"),
+        .push_constant_size = sizeof(crowd_push_constant_t),
+        .uniform_binding_count = 1,
+        .uniform_bindings = {
+            {
+                .binding = 0,
+                .buffer_object = g_game.vp_uniform,
+                .stage = UNIFORM_STAGE_VERTEX,
+            },
+        },
+    };
+    g_game.crowd_sbo = Renderer_CreateStorageBuffer(sizeof(model_instance_t) * CROWD_SIZE);
+
+    g_game.crowd_pipeline = Renderer_AddPipeline(SWAPCHAIN_PASS_HANDLE, &crowd_pipeline_config);
+    if (g_game.crowd_pipeline == PIPELINE_HANDLE_INVALID)
+    {
+        Log(ERROR, "failed to create crowd pipeline");
+        Engine_Destroy();
+        return false;
+    }
+
+    /* both stream in behind placeholders; the obj has no uvs, so it shares
+       the normaled cube's vertex layout */
+    Asset_LoadMesh("resources/models/suzanne.obj", g_game.cube_mesh, &g_game.player_mesh, NULL, NULL);
+    Asset_LoadModel("resources/models/human.frog", &g_game.player_model, NULL, NULL);
 
     g_game.player_pos_x = GRID_WIDTH / 2;
     g_game.player_pos_y = GRID_HEIGHT / 2;
@@ -256,6 +281,8 @@ bool Game_Init(platform_window_t *window)
     g_game.camera_mode = CAMERA_MODE_DEFAULT;
     g_game.camera_blend = 1.0f;     /* already settled on the default rig */
 
+    init_crowd();
+
     return true;
 }
 
@@ -360,14 +387,21 @@ void Game_HandleResize(u32 width, u32 height)
     Engine_HandleResize(width, height);
 }
 
+void Game_WaitForFrame(void)
+{
+    Engine_WaitForFrame();
+}
+
 void Game_Tick(void)
 {
+    ProfileZone("Game_Tick");
     f32 delta_time = Engine_BeginFrame();
 
     update_player(delta_time);
     update_camera(delta_time);
 
     draw_grid();
+    draw_crowd();
     draw_player();
 
     Engine_EndFrame();
@@ -375,6 +409,8 @@ void Game_Tick(void)
 
 static void update_player(f32 delta_time)
 {
+    g_game.player_model_time += delta_time;
+
     switch (g_game.player_anim)
     {
         case PLAYER_ANIM_MOVE:
@@ -547,6 +583,7 @@ static void update_camera(f32 delta_time)
         .proj = game->camera_cur.proj,
     };
     Renderer_SetBufferObject(g_game.vp_uniform, &vp, sizeof(vp));
+    Renderer_SetLodView(game->camera_cur.eye, game->camera_cur.proj);
 }
 
 static void draw_grid(void)
@@ -602,10 +639,69 @@ static void draw_player(void)
                     ),
         .color = PLAYER_COLOR,
     };
-    Renderer_DrawModel(SWAPCHAIN_PASS_HANDLE, g_game.player_pipeline,
-                      &push_constant, g_game.player_model);
+    Renderer_DrawModelAnimated(SWAPCHAIN_PASS_HANDLE, g_game.player_pipeline,
+                               &push_constant, g_game.player_model, push_constant.transform,
+                               0, g_game.player_model_time);
+}
+
+/* every CROWD_SPACING-th tile around the start, nearest rings first, with
+   a hashed heading, phase and tint per frog */
+static void init_crowd(void)
+{
+    u32 count = 0;
+    for (i32 ring = CROWD_SPACING; ring <= CROWD_RADIUS && count < CROWD_SIZE; ring += CROWD_SPACING)
+    {
+        for (i32 dy = -ring; dy <= ring && count < CROWD_SIZE; dy += CROWD_SPACING)
+        {
+            for (i32 dx = -ring; dx <= ring && count < CROWD_SIZE; dx += CROWD_SPACING)
+            {
+                /* the ring's edge only, the inside holds the previous rings */
+                if (dx != -ring && dx != ring && dy != -ring && dy != ring)
+                    continue;
+
+                u32 hash = (u32)count * 2654435761u;
+                hash ^= hash >> 15;
+                f32 r0 = (f32)(hash & 0xffff) / 65535.0f;
+                f32 r1 = (f32)(hash >> 16) / 65535.0f;
+
+                crowd_frog_t *frog = &g_game.crowd[count++];
+                frog->pos = player_center(g_game.player_pos_x + dx, g_game.player_pos_y + dy);
+                frog->rot = r0 * 360.0f;
+                frog->time_offset = r1 * 10.0f;
+                frog->color = lerp(CROWD_COLOR_A, r1, CROWD_COLOR_B);
+            }
+        }
+    }
+    Assert(count == CROWD_SIZE);
 }
 
+/* one instanced draw per level of detail; each frog's keyframes are
+   resolved on the gpu */
+static void draw_crowd(void)
+{
+    crowd_push_constant_t push_constant = {};
+
+    mat4 scale = HMM_Scale(V3(PLAYER_SIZE, PLAYER_SIZE, PLAYER_SIZE));
+    u32 animation_count = g_game.player_model->animation_count;
+    for (u32 i = 0; i < CROWD_SIZE; i++)
+    {
+        const crowd_frog_t *frog = &g_game.crowd[i];
+
+        g_game.crowd_instances[i] = (model_instance_t){
+            .transform = HMM_MulM4(
+                            HMM_Translate(frog->pos),
+                            HMM_MulM4(
+                                HMM_Rotate_RH(HMM_AngleDeg(frog->rot), V3(0.0f, 1.0f, 0.0f)),
+                                scale)),
+            .color = frog->color,
+            .animation = i % animation_count,
+            .time_s = g_game.player_model_time + frog->time_offset,
+        };
+    }
+
+    Renderer_DrawModelInstanced(SWAPCHAIN_PASS_HANDLE, g_game.crowd_pipeline, &push_constant,
+                                g_game.player_model, g_game.crowd_sbo, g_game.crowd_instances, CROWD_SIZE);
+}
 
 static vec3 tile_center(i32 x, i32 y)
 {
@@ -10,6 +10,7 @@ void Game_Destroy(void);
 void Game_HandleKeyDown(key_code_t key);
 void Game_HandleKeyUp(key_code_t key);
 void Game_HandleResize(u32 width, u32 height);
+void Game_WaitForFrame(void);
 void Game_Tick(void);
 
 #endif
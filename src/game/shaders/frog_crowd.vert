@@ -0,0 +1,144 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_buffer_reference : require
+
+// packed_material_vertex_t as words: std430 would pad a struct of it
+const uint VERTEX_WORDS = 3;
+
+struct instance_data {
+    mat4 transform;
+    vec4 color;
+    uint animation;
+    float time;
+    uint reserved0;
+    uint reserved1;
+};
+
+// packed_material_header_t, then the vertices
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer Vertices {
+    vec4 position_offset;
+    vec4 position_scale;
+    uint words[];
+};
+
+layout(std430, buffer_reference) readonly buffer InstanceData {
+    instance_data instances[];
+};
+
+// model_table_header_t, then the animation and keyframe entries (see model_internal.h)
+layout(std430, buffer_reference, buffer_reference_align = 8) readonly buffer AnimationTable {
+    Vertices vertices;
+    uint animation_count;
+    uint keyframe_count;
+    uint words[];
+};
+
+// model_instanced_push_constant_t, filled in by Renderer_DrawModelInstanced
+layout(push_constant) uniform pushConstants {
+    InstanceData instance_data;
+    AnimationTable table;
+} pc;
+
+layout(set = 1, binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+} vp;
+
+layout(location = 0) flat out vec3 fragColor;
+
+const vec3 light_dir = normalize(vec3(-1.0, -1.0, -1.0));
+const vec3 light_color = vec3(1.0, 1.0, 1.0);
+
+const float ambient_strength = 0.0;
+
+float keyframe_time(uint keyframe) {
+    return uintBitsToFloat(pc.table.words[2 * (pc.table.animation_count + keyframe)]);
+}
+
+uint keyframe_first_vertex(uint keyframe) {
+    return pc.table.words[2 * (pc.table.animation_count + keyframe) + 1];
+}
+
+vec3 load_position(uint vertex) {
+    uint i = vertex * VERTEX_WORDS;
+    vec2 xy = unpackSnorm2x16(pc.table.vertices.words[i]);
+    float z = unpackSnorm2x16(pc.table.vertices.words[i + 1]).x;
+    return pc.table.vertices.position_offset.xyz + pc.table.vertices.position_scale.xyz * vec3(xy, z);
+}
+
+// octahedral, see VertexPack_MaterialVertices
+vec3 load_normal(uint vertex) {
+    vec2 e = unpackSnorm2x16(pc.table.vertices.words[vertex * VERTEX_WORDS + 2]);
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
+// same rules as Model_SampleAnimation: loop over the last keyframe's time,
+// hold the first keyframe before it starts
+void sample_animation(uint animation, float time, out uint key_a, out uint key_b, out float blend) {
+    // the loader rejects empty animations; clamped all the same, so a bad
+    // table can't index past the keyframes
+    animation = min(animation, max(pc.table.animation_count, 1u) - 1);
+    uint first = pc.table.words[2 * animation];
+    uint last = max(pc.table.words[2 * animation + 1], 1u) - 1;
+    float duration = keyframe_time(first + last);
+
+    uint lo = 0;
+    uint hi = 0;
+    blend = 0.0;
+
+    if (last > 0 && duration > 0.0) {
+        float t = mod(time, duration);
+        if (t >= keyframe_time(first)) {
+            hi = last;
+            while (hi - lo > 1) {
+                uint mid = (lo + hi) / 2;
+                if (keyframe_time(first + mid) <= t)
+                    lo = mid;
+                else
+                    hi = mid;
+            }
+
+            float time_lo = keyframe_time(first + lo);
+            float span = keyframe_time(first + hi) - time_lo;
+            blend = span > 0.0 ? min((t - time_lo) / span, 1.0) : 0.0;
+        }
+    }
+
+    key_a = first + lo;
+    key_b = first + hi;
+}
+
+void main() {
+    instance_data instance = pc.instance_data.instances[gl_InstanceIndex];
+
+    uint key_a, key_b;
+    float blend;
+    sample_animation(instance.animation, instance.time, key_a, key_b, blend);
+
+    uint a = keyframe_first_vertex(key_a) + gl_VertexIndex;
+    uint b = keyframe_first_vertex(key_b) + gl_VertexIndex;
+
+    vec3 inPosition = mix(load_position(a), load_position(b), blend);
+    vec3 inNormal = normalize(mix(load_normal(a), load_normal(b), blend));
+
+    vec3 position = (instance.transform * vec4(inPosition, 1.0)).xyz;
+    vec3 normal = normalize((instance.transform * vec4(inNormal, 0.0)).xyz);
+
+    gl_Position = vp.proj * vp.view * vec4(position, 1.0);
+
+    float diffuse_factor = max(dot(normal, -light_dir), 0.0);
+    vec3 diffuse = diffuse_factor * light_color;
+
+    vec3 eyeVector = -normalize((vp.view * vec4(position, 1.0)).xyz);
+    vec3 reflectVectorWorld = normalize(reflect(light_dir, normal));
+    vec3 reflectVector = normalize(vec3(vp.view * vec4(reflectVectorWorld, 0.0)));
+
+    float spec_factor = pow(max(dot(eyeVector, reflectVector), 0.0), 64);
+    vec3 specular = 0.15 * spec_factor * light_color;
+
+
+    fragColor = min(diffuse + ambient_strength, 1.0) * instance.color.xyz + specular;
+}
@@ -0,0 +1,81 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_buffer_reference : require
+
+// packed_material_vertex_t as words: std430 would pad a struct of it
+const uint VERTEX_WORDS = 3;
+
+// packed_material_header_t, then the vertices
+layout(std430, buffer_reference, buffer_reference_align = 16) readonly buffer Vertices {
+    vec4 position_offset;
+    vec4 position_scale;
+    uint words[];
+};
+
+// starts with morph_push_constant_t, filled in by Renderer_DrawModelAnimated
+layout (push_constant) uniform pushConstants {
+    Vertices vertices;
+    uint first_a;
+    uint first_b;
+    float blend;
+    uint reserved0;
+    uint reserved1;
+    uint reserved2;
+
+    mat4 transform;
+    vec4 color;
+} model;
+
+layout(set = 1, binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+} vp;
+
+layout(location = 0) flat out vec3 fragColor;
+
+const vec3 light_dir = normalize(vec3(-1.0, -1.0, -1.0));
+const vec3 light_color = vec3(1.0, 1.0, 1.0);
+
+const float ambient_strength = 0.0;
+
+vec3 load_position(uint vertex) {
+    uint i = vertex * VERTEX_WORDS;
+    vec2 xy = unpackSnorm2x16(model.vertices.words[i]);
+    float z = unpackSnorm2x16(model.vertices.words[i + 1]).x;
+    return model.vertices.position_offset.xyz + model.vertices.position_scale.xyz * vec3(xy, z);
+}
+
+// octahedral, see VertexPack_MaterialVertices
+vec3 load_normal(uint vertex) {
+    vec2 e = unpackSnorm2x16(model.vertices.words[vertex * VERTEX_WORDS + 2]);
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
+void main() {
+    uint a = model.first_a + gl_VertexIndex;
+    uint b = model.first_b + gl_VertexIndex;
+
+    vec3 inPosition = mix(load_position(a), load_position(b), model.blend);
+    vec3 inNormal = normalize(mix(load_normal(a), load_normal(b), model.blend));
+
+    vec3 position = (model.transform * vec4(inPosition, 1.0)).xyz;
+    vec3 normal = normalize((model.transform * vec4(inNormal, 0.0)).xyz);
+
+    gl_Position = vp.proj * vp.view * vec4(position, 1.0);
+
+    float diffuse_factor = max(dot(normal, -light_dir), 0.0);
+    vec3 diffuse = diffuse_factor * light_color;
+
+    vec3 eyeVector = -normalize((vp.view * vec4(position, 1.0)).xyz);
+    vec3 reflectVectorWorld = normalize(reflect(light_dir, normal));
+    vec3 reflectVector = normalize(vec3(vp.view * vec4(reflectVectorWorld, 0.0)));
+
+    float spec_factor = pow(max(dot(eyeVector, reflectVector), 0.0), 64);
+    vec3 specular = 0.15 * spec_factor * light_color;
+
+
+    fragColor = min(diffuse + ambient_strength, 1.0) * model.color.xyz + specular;
+}
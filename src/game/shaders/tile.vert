@@ -10,23 +10,36 @@ layout(std430, buffer_reference) readonly buffer InstanceData {
     instance_data instances[];
 };
 
+// normal_vertex_t as floats: std430 would pad a struct of vec3s
+const uint VERTEX_FLOATS = 6;
+
+layout(std430, buffer_reference, buffer_reference_align = 4) readonly buffer Vertices {
+    float floats[];
+};
+
 layout(set = 1, binding = 0) uniform UniformBufferObject {
     mat4 view;
     mat4 proj;
 } vp;
 
+// mesh_push_constant_t, filled in by the renderer
 layout(push_constant) uniform pushConstants {
     InstanceData instance_data;
+    Vertices vertices;
 } pc;
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
-
 layout(location = 0) flat out vec4 fragColor;
 layout(location = 1) out vec3 localPosition;
 layout(location = 2) flat out vec3 localNormal;
 
+vec3 load_vec3(uint i) {
+    return vec3(pc.vertices.floats[i], pc.vertices.floats[i + 1], pc.vertices.floats[i + 2]);
+}
+
 void main() {
+    uint vertex = gl_VertexIndex * VERTEX_FLOATS;
+    vec3 inPosition = load_vec3(vertex);
+    vec3 inNormal = load_vec3(vertex + 3);
 
     instance_data instance = pc.instance_data.instances[gl_InstanceIndex];
 
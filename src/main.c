@@ -1,4 +1,6 @@
+#include "job.h"
 #include "log.h"
+#include "profiler.h"
 #include "platform.h"
 #include "game_main.h"
 
@@ -12,15 +14,23 @@ int main(int argc, char **argv)
     (void)argv;
 
     Log_Init();
+    Profiler_Init();
+
+    if (!Job_Init(0))
+        return -1;
 
     if (!Platform_Init())
+    {
+        Job_Destroy();
         return -1;
+    }
 
     platform_window_t *window = Platform_CreateWindow("dungeon crawl frog soup",
                                                       DEFAULT_WIDTH, DEFAULT_HEIGHT);
     if (!window)
     {
         Platform_Shutdown();
+        Job_Destroy();
         return -1;
     }
 
@@ -32,6 +42,8 @@ int main(int argc, char **argv)
     bool m_running = true;
     while (m_running)
     {
+        Game_WaitForFrame();
+
         platform_event_t event;
         while (Platform_PollEvent(&event))
         {
@@ -67,6 +79,8 @@ exit:
     Platform_DestroyWindow(window);
     Platform_Shutdown();
 
+    Job_Destroy();
+    Profiler_Destroy();
     Log_Destroy();
 
     return 0;
@@ -0,0 +1,79 @@
+#include "log.h"
+
+#include "platform.h"
+#include "platform_vulkan.h"
+
+/* no display: a window is just an extent and never produces events. the
+   vulkan backend sees the null surface and renders offscreen */
+
+struct platform_window_struct
+{
+    u32 width;
+    u32 height;
+};
+
+static platform_window_t s_window;
+
+bool Platform_Init(void)
+{
+    Log(INFO, "headless platform");
+    return true;
+}
+
+void Platform_Shutdown(void)
+{
+}
+
+platform_window_t *Platform_CreateWindow(const char *title, u32 width, u32 height)
+{
+    (void)title;
+
+    if (width == 0 || height == 0)
+    {
+        Log(ERROR, "invalid headless window size %ux%u", width, height);
+        return NULL;
+    }
+
+    s_window.width = width;
+    s_window.height = height;
+    return &s_window;
+}
+
+void Platform_DestroyWindow(platform_window_t *window)
+{
+    MemoryZeroItem(window);
+}
+
+void Platform_ShowWindow(platform_window_t *window)
+{
+    (void)window;
+}
+
+bool Platform_GetWindowSize(platform_window_t *window, u32 *width, u32 *height)
+{
+    *width = window->width;
+    *height = window->height;
+    return true;
+}
+
+bool Platform_PollEvent(platform_event_t *event)
+{
+    (void)event;
+    return false;
+}
+
+const char *const *Platform_Vulkan_GetInstanceExtensions(u32 *count)
+{
+    *count = 0;
+    return NULL;
+}
+
+bool Platform_Vulkan_CreateSurface(platform_window_t *window, VkInstance instance,
+                                   VkSurfaceKHR *surface)
+{
+    (void)window;
+    (void)instance;
+
+    *surface = VK_NULL_HANDLE;
+    return true;
+}
@@ -8,6 +8,8 @@
 /* the returned array is owned by the platform layer */
 const char *const *Platform_Vulkan_GetInstanceExtensions(u32 *count);
 
+/* a headless platform returns true with a null surface; the renderer then
+   draws into offscreen images instead of a swapchain */
 bool Platform_Vulkan_CreateSurface(platform_window_t *window, VkInstance instance,
                                    VkSurfaceKHR *surface);
 
@@ -4,15 +4,19 @@
 #include "log.h"
 
 #include "memory_arena.h"
+#include "profiler.h"
 #include "render_types.h"
 #include "vulkan_buffer.h"
 #include "vulkan_context.h"
 #include "vulkan_memory.h"
+#include "vulkan_query.h"
 #include "vulkan_types.h"
 
 #define MAX_BUFFER_OBJECT   1024
 #define MAX_STATIC_BUFFERS  256
-#define MAX_RETIRED_BUFFERS 64
+#define MAX_RETIRED_BUFFERS 256
+#define MAX_PENDING_UPLOADS 128
+#define MESH_BUFFER_SIZE    MB(64)
 
 typedef struct _buffer_object_t buffer_object_t;
 struct _buffer_object_t
@@ -41,26 +45,40 @@ struct _buffer_object_t
     bool dirty[MAX_FRAMES_IN_FLIGHT];
 };
 
-/* buffers whose last GPU use may still be in flight; destroyed once
-   MAX_FRAMES_IN_FLIGHT later frames have waited their fences */
+/* buffers whose last GPU use may still be in flight; destroyed once the
+   frame timeline reaches the last value submitted when they were retired */
 typedef struct _retired_buffer_t retired_buffer_t;
 struct _retired_buffer_t
 {
     VkBuffer        buffer;
     VkDeviceMemory  memory;
-    u64             frame;
+    u64             timeline_value;
+};
+
+/* a deferred static buffer, or a range of the mesh buffer, whose copy
+   goes into the next bake */
+typedef struct _pending_upload_t pending_upload_t;
+struct _pending_upload_t
+{
+    VkBuffer        staging_buffer;
+    VkDeviceMemory  staging_memory;
+    VkBuffer        buffer;
+    u64             offset;
+    u64             size;
 };
 
 static bool copy_buffer_sync(VkCommandPool command_pool, VkQueue submit_queue, VkBuffer src,
-                             VkBuffer dst, VkDeviceSize size);
+                             VkBuffer dst, VkDeviceSize dst_offset, VkDeviceSize size);
 static buffer_object_t *get_buffer_object(buffer_object_handle_t handle);
 static bool create_vulkan_buffer(VkDeviceSize size, VkBufferUsageFlags usage,
                                  VkMemoryPropertyFlags memory_flags, VkBuffer *buffer_out,
                                  VkDeviceMemory *memory_out);
 static bool create_object_buffers(buffer_object_t *object, u32 frame_index);
 static bool grow_object(buffer_object_t *object, u64 required);
-static void retire_buffer(VkBuffer buffer, VkDeviceMemory memory);
-static void flush_retired_buffers(bool destroy_all);
+static void add_static_buffer(VkBuffer buffer, VkDeviceMemory memory);
+static void retire_buffer(VkBuffer buffer, VkDeviceMemory memory, u64 timeline_value);
+static void flush_retired_buffers(bool destroy_all, u64 completed_value);
+static bool reserve_mesh_data(u64 size, u32 alignment, u64 *offset_out);
 
 typedef struct _buffers_t buffers_t;
 struct _buffers_t
@@ -72,9 +90,19 @@ struct _buffers_t
     VkDeviceMemory  static_buffer_memories[MAX_STATIC_BUFFERS];
     u32             static_buffer_count;
 
+    pending_upload_t pending_uploads[MAX_PENDING_UPLOADS];
+    u32             pending_upload_count;
+
+    /* created on first use; bump allocated, never freed, like the static
+       buffers */
+    VkBuffer        mesh_buffer;
+    VkDeviceMemory  mesh_memory;
+    VkDeviceAddress mesh_address;
+    u64             mesh_used;
+
     retired_buffer_t retired[MAX_RETIRED_BUFFERS];
     u32             retired_count;
-    u64             frame_counter; /* one tick per baked frame */
+    u64             baked_upload_bytes;
 };
 
 static buffers_t s_buffers = {};
@@ -96,7 +124,13 @@ bool VulkanBuffer_Init()
 void VulkanBuffer_Destroy()
 {
     /* only called after VulkanRenderer_WaitIdle */
-    flush_retired_buffers(true);
+    flush_retired_buffers(true, 0);
+
+    for (u32 i = 0; i < s_buffers.pending_upload_count; i++)
+    {
+        vkDestroyBuffer(g_device, s_buffers.pending_uploads[i].staging_buffer, NULL);
+        vkFreeMemory(g_device, s_buffers.pending_uploads[i].staging_memory, NULL);
+    }
 
     // Free static buffers
     for (u32 i = 0; i < s_buffers.static_buffer_count; i++)
@@ -104,6 +138,8 @@ void VulkanBuffer_Destroy()
         vkDestroyBuffer(g_device, s_buffers.static_buffers[i], NULL);
         vkFreeMemory(g_device, s_buffers.static_buffer_memories[i], NULL);
     }
+    vkDestroyBuffer(g_device, s_buffers.mesh_buffer, NULL);
+    vkFreeMemory(g_device, s_buffers.mesh_memory, NULL);
 
     // Free buffer objects
     for (u32 i = 0; i < s_buffers.buffer_object_count; i++)
@@ -145,20 +181,14 @@ VkBuffer VulkanBuffer_CreateStatic(VkCommandPool command_pool, VkQueue submit_qu
                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer, &memory))
         goto exit;
 
-    if (!copy_buffer_sync(command_pool, submit_queue, staging_buffer, buffer, size))
+    if (!copy_buffer_sync(command_pool, submit_queue, staging_buffer, buffer, 0, size))
     {
         vkDestroyBuffer(g_device, buffer, NULL);
         vkFreeMemory(g_device, memory, NULL);
         goto exit;
     }
 
-    if (buffer != VK_NULL_HANDLE)
-    {
-        s_buffers.static_buffers[s_buffers.static_buffer_count] = buffer;
-        s_buffers.static_buffer_memories[s_buffers.static_buffer_count] = memory;
-        s_buffers.static_buffer_count++;
-    }
-
+    add_static_buffer(buffer, memory);
     static_buffer = buffer;
 
 exit:
@@ -169,6 +199,108 @@ exit:
     return static_buffer;
 }
 
+VkBuffer VulkanBuffer_CreateStaticDeferred(const u8 *data, u64 size, VkBufferUsageFlags usage)
+{
+    if (s_buffers.static_buffer_count >= MAX_STATIC_BUFFERS)
+    {
+        Log(ERROR, "maximum number of static buffers reached");
+        return VK_NULL_HANDLE;
+    }
+    if (s_buffers.pending_upload_count >= MAX_PENDING_UPLOADS)
+    {
+        Log(ERROR, "maximum number of pending uploads reached");
+        return VK_NULL_HANDLE;
+    }
+
+    pending_upload_t upload = {.size = size};
+    if (!VulkanBuffer_CreateStaging(data, size, &upload.staging_buffer, &upload.staging_memory))
+        return VK_NULL_HANDLE;
+
+    VkDeviceMemory memory;
+    if (!create_vulkan_buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &upload.buffer, &memory))
+    {
+        vkDestroyBuffer(g_device, upload.staging_buffer, NULL);
+        vkFreeMemory(g_device, upload.staging_memory, NULL);
+        return VK_NULL_HANDLE;
+    }
+
+    add_static_buffer(upload.buffer, memory);
+    s_buffers.pending_uploads[s_buffers.pending_upload_count++] = upload;
+
+    return upload.buffer;
+}
+
+bool VulkanBuffer_WriteMeshData(VkCommandPool command_pool, VkQueue submit_queue, const void *data,
+                                u64 size, u32 alignment, u64 *offset_out)
+{
+    u64 offset;
+    if (!reserve_mesh_data(size, alignment, &offset))
+        return false;
+
+    VkBuffer staging_buffer;
+    VkDeviceMemory staging_memory;
+    if (!VulkanBuffer_CreateStaging(data, size, &staging_buffer, &staging_memory))
+        return false;
+
+    bool result = copy_buffer_sync(command_pool, submit_queue, staging_buffer, s_buffers.mesh_buffer, offset, size);
+    vkDestroyBuffer(g_device, staging_buffer, NULL);
+    vkFreeMemory(g_device, staging_memory, NULL);
+    if (!result)
+        return false;
+
+    s_buffers.mesh_used = offset + size;
+    *offset_out = offset;
+    return true;
+}
+
+bool VulkanBuffer_WriteMeshDataDeferred(const void *data, u64 size, u32 alignment, u64 *offset_out)
+{
+    if (s_buffers.pending_upload_count >= MAX_PENDING_UPLOADS)
+    {
+        Log(ERROR, "maximum number of pending uploads reached");
+        return false;
+    }
+
+    pending_upload_t upload = {.size = size};
+    if (!reserve_mesh_data(size, alignment, &upload.offset)
+        || !VulkanBuffer_CreateStaging(data, size, &upload.staging_buffer, &upload.staging_memory))
+        return false;
+
+    upload.buffer = s_buffers.mesh_buffer;
+    s_buffers.pending_uploads[s_buffers.pending_upload_count++] = upload;
+
+    s_buffers.mesh_used = upload.offset + size;
+    *offset_out = upload.offset;
+    return true;
+}
+
+VkBuffer VulkanBuffer_GetMeshBuffer()
+{
+    return s_buffers.mesh_buffer;
+}
+
+VkDeviceAddress VulkanBuffer_GetMeshAddress()
+{
+    return s_buffers.mesh_address;
+}
+
+VkDeviceAddress VulkanBuffer_GetStaticAddress(VkBuffer buffer)
+{
+    VkBufferDeviceAddressInfo address_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .buffer = buffer,
+    };
+
+    return vkGetBufferDeviceAddress(g_device, &address_info);
+}
+
+u32 VulkanBuffer_GetUploadCapacity()
+{
+    return Min(MAX_PENDING_UPLOADS - s_buffers.pending_upload_count,
+               MAX_STATIC_BUFFERS - s_buffers.static_buffer_count);
+}
+
 bool VulkanBuffer_CreateStaging(const void *data, u64 size, VkBuffer *buffer_out,
                                 VkDeviceMemory *memory_out)
 {
@@ -197,6 +329,15 @@ bool VulkanBuffer_CreateStaging(const void *data, u64 size, VkBuffer *buffer_out
     return true;
 }
 
+bool VulkanBuffer_CreateReadback(u64 size, VkBuffer *buffer_out, VkDeviceMemory *memory_out)
+{
+    /* cached memory would be faster to read, coherent is always available */
+    return create_vulkan_buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                buffer_out, memory_out);
+}
+
 buffer_object_handle_t VulkanBuffer_CreateObject(arena_t *arena, u64 capacity,
                                                  buffer_object_type_t type)
 {
@@ -312,12 +453,14 @@ VkDeviceAddress VulkanBuffer_GetDeviceAddress(buffer_object_handle_t handle, u32
     return object->device_addresses[frame_index];
 }
 
-bool VulkanBuffer_BakeCommandBuffer(VkCommandBuffer command_buffer, u32 image_index)
+bool VulkanBuffer_BakeCommandBuffer(VkCommandBuffer command_buffer, u32 image_index,
+                                    u64 submitted_value, u64 completed_value)
 {
+    ProfileZone("VulkanBuffer_BakeCommandBuffer");
     bool transfer_required = false;
 
-    s_buffers.frame_counter++;
-    flush_retired_buffers(false);
+    s_buffers.baked_upload_bytes = 0;
+    flush_retired_buffers(false, completed_value);
 
     VkCommandBufferBeginInfo begin_info = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -331,6 +474,9 @@ bool VulkanBuffer_BakeCommandBuffer(VkCommandBuffer command_buffer, u32 image_in
         return false;
     }
 
+    /* reads unavailable on frames where the buffer isn't submitted */
+    u32 timer = VulkanQuery_BeginTimer(command_buffer, true, "transfer");
+
     for (u32 i = 0; i < s_buffers.buffer_object_count; i++)
     {
         buffer_object_t *bo = s_buffers.buffer_objects[i];
@@ -347,8 +493,10 @@ bool VulkanBuffer_BakeCommandBuffer(VkCommandBuffer command_buffer, u32 image_in
            them (in-flight frames keep the retired ones) */
         if (Unlikely(bo->buffer_capacities[image_index] < bo->capacity))
         {
-            retire_buffer(bo->staging_buffers[image_index], bo->staging_mem[image_index]);
-            retire_buffer(bo->device_buffers[image_index], bo->device_mem[image_index]);
+            retire_buffer(bo->staging_buffers[image_index], bo->staging_mem[image_index],
+                          submitted_value);
+            retire_buffer(bo->device_buffers[image_index], bo->device_mem[image_index],
+                          submitted_value);
 
             if (!create_object_buffers(bo, image_index))
             {
@@ -378,10 +526,31 @@ bool VulkanBuffer_BakeCommandBuffer(VkCommandBuffer command_buffer, u32 image_in
             .size = bo->cpu_buf_len,
         };
         vkCmdCopyBuffer(command_buffer, staging_buffer, device_buffer, 1, &copy_region);
+        s_buffers.baked_upload_bytes += bo->cpu_buf_len;
 
         transfer_required = true;
     }
 
+    /* deferred static buffers: the staging copies are freed once this
+       frame's transfer submit, signaled as submitted_value + 1, completes */
+    for (u32 i = 0; i < s_buffers.pending_upload_count; i++)
+    {
+        pending_upload_t *upload = &s_buffers.pending_uploads[i];
+
+        VkBufferCopy copy_region = {
+            .dstOffset = upload->offset,
+            .size = upload->size,
+        };
+        vkCmdCopyBuffer(command_buffer, upload->staging_buffer, upload->buffer, 1, &copy_region);
+        s_buffers.baked_upload_bytes += upload->size;
+
+        retire_buffer(upload->staging_buffer, upload->staging_memory, submitted_value + 1);
+        transfer_required = true;
+    }
+    s_buffers.pending_upload_count = 0;
+
+    VulkanQuery_EndTimer(command_buffer, timer);
+
     if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS)
     {
         Log(ERROR, "failed to end draw command buffer");
@@ -391,6 +560,11 @@ bool VulkanBuffer_BakeCommandBuffer(VkCommandBuffer command_buffer, u32 image_in
     return transfer_required;
 }
 
+u64 VulkanBuffer_GetBakedUploadBytes()
+{
+    return s_buffers.baked_upload_bytes;
+}
+
 
 /* creates one frame in flight's staging + device buffers at the object's
    current capacity */
@@ -430,14 +604,11 @@ static bool create_object_buffers(buffer_object_t *object, u32 frame_index)
 }
 
 /* doubles the cpu buffer until required fits; the device buffers are
-   rebuilt lazily at bake time. BO_STORAGE only: uniform buffers are
-   referenced by descriptor sets written at pipeline creation, so their
-   buffers cannot be swapped out */
+   rebuilt lazily at bake time. uniforms grow the same way: their buffers
+   are pushed as descriptors at bake time, so nothing holds on to the old
+   ones */
 static bool grow_object(buffer_object_t *object, u64 required)
 {
-    if (object->type != BO_STORAGE)
-        return false;
-
     u64 capacity = object->capacity;
     while (capacity < required)
         capacity *= 2;
@@ -455,22 +626,58 @@ static bool grow_object(buffer_object_t *object, u64 required)
     return true;
 }
 
-static void retire_buffer(VkBuffer buffer, VkDeviceMemory memory)
+/* the first multiple of alignment past what is in use; the mesh buffer is
+   created here on first use */
+static bool reserve_mesh_data(u64 size, u32 alignment, u64 *offset_out)
+{
+    Assert(alignment > 0);
+
+    if (s_buffers.mesh_buffer == VK_NULL_HANDLE)
+    {
+        if (!create_vulkan_buffer(MESH_BUFFER_SIZE,
+                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+                                      | VULKAN_PULL_BUFFER_USAGE,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &s_buffers.mesh_buffer,
+                                  &s_buffers.mesh_memory))
+            return false;
+
+        s_buffers.mesh_address = VulkanBuffer_GetStaticAddress(s_buffers.mesh_buffer);
+    }
+
+    /* vertex strides needn't be powers of two */
+    u64 offset = (s_buffers.mesh_used + alignment - 1) / alignment * alignment;
+    if (offset > MESH_BUFFER_SIZE || size > MESH_BUFFER_SIZE - offset)
+        return false;
+
+    *offset_out = offset;
+    return true;
+}
+
+static void add_static_buffer(VkBuffer buffer, VkDeviceMemory memory)
+{
+    Assert(s_buffers.static_buffer_count < MAX_STATIC_BUFFERS);
+
+    s_buffers.static_buffers[s_buffers.static_buffer_count] = buffer;
+    s_buffers.static_buffer_memories[s_buffers.static_buffer_count] = memory;
+    s_buffers.static_buffer_count++;
+}
+
+static void retire_buffer(VkBuffer buffer, VkDeviceMemory memory, u64 timeline_value)
 {
     if (s_buffers.retired_count >= MAX_RETIRED_BUFFERS)
     {
         Log(WARNING, "retired buffer list full; forcing device idle");
         vkDeviceWaitIdle(g_device);
-        flush_retired_buffers(true);
+        flush_retired_buffers(true, 0);
     }
 
     retired_buffer_t *slot = &s_buffers.retired[s_buffers.retired_count++];
     slot->buffer = buffer;
     slot->memory = memory;
-    slot->frame = s_buffers.frame_counter;
+    slot->timeline_value = timeline_value;
 }
 
-static void flush_retired_buffers(bool destroy_all)
+static void flush_retired_buffers(bool destroy_all, u64 completed_value)
 {
     u32 kept = 0;
 
@@ -478,8 +685,7 @@ static void flush_retired_buffers(bool destroy_all)
     {
         retired_buffer_t *retired = &s_buffers.retired[i];
 
-        if (destroy_all ||
-            s_buffers.frame_counter - retired->frame >= MAX_FRAMES_IN_FLIGHT)
+        if (destroy_all || completed_value >= retired->timeline_value)
         {
             vkDestroyBuffer(g_device, retired->buffer, NULL);
             vkFreeMemory(g_device, retired->memory, NULL);
@@ -559,7 +765,7 @@ static bool create_vulkan_buffer(VkDeviceSize size, VkBufferUsageFlags usage,
 
 /* synchronous copy on the graphics queue */
 static bool copy_buffer_sync(VkCommandPool command_pool, VkQueue submit_queue, VkBuffer src,
-                             VkBuffer dst, VkDeviceSize size)
+                             VkBuffer dst, VkDeviceSize dst_offset, VkDeviceSize size)
 {
     VkCommandBufferAllocateInfo allocate_info = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -581,6 +787,7 @@ static bool copy_buffer_sync(VkCommandPool command_pool, VkQueue submit_queue, V
     };
 
     VkBufferCopy region = {
+        .dstOffset = dst_offset,
         .size = size,
     };
 
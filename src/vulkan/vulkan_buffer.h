@@ -13,11 +13,37 @@ void VulkanBuffer_Destroy();
 VkBuffer VulkanBuffer_CreateStatic(VkCommandPool command_pool, VkQueue submit_queue,
                                    const u8 *data, u64 size, VkBufferUsageFlags usage);
 
+/* like VulkanBuffer_CreateStatic, but the copy is recorded into the next
+   BakeCommandBuffer instead of a blocking submit. the frame's draws wait on
+   that transfer, so the buffer can be drawn from the current frame on */
+VkBuffer VulkanBuffer_CreateStaticDeferred(const u8 *data, u64 size, VkBufferUsageFlags usage);
+
+/* device address of a static buffer created with
+   VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT */
+VkDeviceAddress VulkanBuffer_GetStaticAddress(VkBuffer buffer);
+
+/* static mesh data shares one buffer, usable as index buffer and as pull
+   buffer, so draws of different meshes need no rebinding. writes data at
+   the first multiple of alignment that is free, offset_out; false when the
+   buffer is full. the Deferred variant copies like
+   VulkanBuffer_CreateStaticDeferred */
+bool VulkanBuffer_WriteMeshData(VkCommandPool command_pool, VkQueue submit_queue, const void *data,
+                                u64 size, u32 alignment, u64 *offset_out);
+bool VulkanBuffer_WriteMeshDataDeferred(const void *data, u64 size, u32 alignment, u64 *offset_out);
+
+/* VK_NULL_HANDLE and 0 until the first mesh data is written */
+VkBuffer VulkanBuffer_GetMeshBuffer();
+VkDeviceAddress VulkanBuffer_GetMeshAddress();
+
 /* host-visible transfer source prefilled with data; the caller owns the
    buffer and memory */
 bool VulkanBuffer_CreateStaging(const void *data, u64 size, VkBuffer *buffer_out,
                                 VkDeviceMemory *memory_out);
 
+/* host-visible transfer destination for reading results back; the caller
+   owns the buffer and memory */
+bool VulkanBuffer_CreateReadback(u64 size, VkBuffer *buffer_out, VkDeviceMemory *memory_out);
+
 buffer_object_handle_t VulkanBuffer_CreateObject(arena_t *arena, u64 capacity,
                                                  buffer_object_type_t type);
 bool VulkanBuffer_SetObjectData(buffer_object_handle_t handle, const void *data, u64 size);
@@ -31,6 +57,16 @@ u64 VulkanBuffer_GetObjectCapacity(buffer_object_handle_t handle);
    flight, for shaders using GL_EXT_buffer_reference */
 VkDeviceAddress VulkanBuffer_GetDeviceAddress(buffer_object_handle_t handle, u32 frame_index);
 
-bool VulkanBuffer_BakeCommandBuffer(VkCommandBuffer command_buffer, u32 image_index);
+/* submitted_value is the frame timeline's last submitted value and
+   completed_value what the GPU has reached; retired buffers are freed
+   against them */
+bool VulkanBuffer_BakeCommandBuffer(VkCommandBuffer command_buffer, u32 image_index,
+                                    u64 submitted_value, u64 completed_value);
+
+/* how many more deferred static buffers fit before the next bake */
+u32 VulkanBuffer_GetUploadCapacity();
+
+/* bytes recorded for copy by the last BakeCommandBuffer */
+u64 VulkanBuffer_GetBakedUploadBytes();
 
 #endif
@@ -3,9 +3,12 @@
 #include "core.h"
 #include "log.h"
 
+#include "render_types.h"
 #include "vulkan_context.h"
 #include "vulkan_image.h"
 
+/* resolved once in VulkanImage_Init; uploads read it from any thread */
+static VkImageLayout s_host_copy_dst_layout = VK_IMAGE_LAYOUT_UNDEFINED;
 
 static bool create_image(VkExtent2D extent, u32 mip_levels, VkSampleCountFlags num_samples,
                          VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
@@ -16,17 +19,56 @@ static bool find_supported_format(const VkFormat *candidate_formats, u32 candida
                                   VkFormat *format_out);
 static VkImageLayout host_copy_dst_layout();
 
+/* the copy destination layout must be in the device's pCopyDstLayouts;
+   SHADER_READ_ONLY_OPTIMAL is preferred (and near-universal), GENERAL is the
+   spec-guaranteed fallback */
+void VulkanImage_Init()
+{
+    VkImageLayout dst_layouts[32];
+    VkPhysicalDeviceHostImageCopyProperties host_copy_properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES,
+        .copyDstLayoutCount = ArrayCount(dst_layouts),
+        .pCopyDstLayouts = dst_layouts,
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &host_copy_properties,
+    };
+
+    vkGetPhysicalDeviceProperties2(g_physical_device, &properties);
+
+    s_host_copy_dst_layout = VK_IMAGE_LAYOUT_GENERAL;
+    for (u32 i = 0; i < host_copy_properties.copyDstLayoutCount; i++)
+    {
+        if (dst_layouts[i] == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+        {
+            s_host_copy_dst_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            break;
+        }
+    }
+}
+
 bool VulkanImage_CreateView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags,
                             u32 mip_levels, VkImageView *image_view_out)
+{
+    VkComponentMapping identity = {
+        .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+        .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+    };
+
+    return VulkanImage_CreateSwizzledView(image, format, aspect_flags, mip_levels, identity, image_view_out);
+}
+
+bool VulkanImage_CreateSwizzledView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags,
+                                    u32 mip_levels, VkComponentMapping components, VkImageView *image_view_out)
 {
     VkImageViewCreateInfo create_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
         .viewType = VK_IMAGE_VIEW_TYPE_2D,
         .format = format,
-        .components = (VkComponentMapping){.r = VK_COMPONENT_SWIZZLE_IDENTITY,
-                                           .g = VK_COMPONENT_SWIZZLE_IDENTITY,
-                                           .b = VK_COMPONENT_SWIZZLE_IDENTITY,
-                                           .a = VK_COMPONENT_SWIZZLE_IDENTITY},
+        .components = components,
         .subresourceRange =
             (VkImageSubresourceRange){
                 .aspectMask = aspect_flags,
@@ -44,19 +86,24 @@ bool VulkanImage_CreateView(VkImage image, VkFormat format, VkImageAspectFlags a
     return true;
 }
 
-bool VulkanImage_CreateStatic(u32 width, u32 height, const u8 *rgba_data, VkImage *image_out,
-                              VkDeviceMemory *image_memory_out, VkImageLayout *layout_out)
+bool VulkanImage_CreateStatic(VkFormat format, u32 width, u32 height, u32 mip_levels, const void *const *levels,
+                              VkImage *image_out, VkDeviceMemory *image_memory_out, VkImageLayout *layout_out)
 {
-    Assert(width > 0 && height > 0 && rgba_data != NULL);
+    Assert(width > 0 && height > 0 && mip_levels > 0 && levels != NULL);
     bool result = false;
 
+    if (mip_levels > TEXTURE_MAX_MIP_LEVELS)
+    {
+        Log(ERROR, "too many mip levels: %u", mip_levels);
+        return false;
+    }
+
     VkImage image = VK_NULL_HANDLE;
     VkDeviceMemory image_memory = VK_NULL_HANDLE;
     VkImageLayout layout = host_copy_dst_layout();
 
-    if (!create_image((VkExtent2D){width, height}, 1, VK_SAMPLE_COUNT_1_BIT,
-                      VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-                      VK_IMAGE_USAGE_HOST_TRANSFER_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+    if (!create_image((VkExtent2D){width, height}, mip_levels, VK_SAMPLE_COUNT_1_BIT, format,
+                      VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_HOST_TRANSFER_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &image, &image_memory))
         goto exit;
 
@@ -70,7 +117,7 @@ bool VulkanImage_CreateStatic(u32 width, u32 height, const u8 *rgba_data, VkImag
         .subresourceRange =
             (VkImageSubresourceRange){
                 .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .levelCount = 1,
+                .levelCount = mip_levels,
                 .layerCount = 1,
             },
     };
@@ -81,27 +128,34 @@ bool VulkanImage_CreateStatic(u32 width, u32 height, const u8 *rgba_data, VkImag
         goto exit;
     }
 
-    VkMemoryToImageCopy region = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY,
-        .pHostPointer = rgba_data,
-        .imageSubresource =
-            (VkImageSubresourceLayers){
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .layerCount = 1,
+    /* one copy for the whole chain; a zero row length is tightly packed,
+       in texel blocks for the compressed formats */
+    VkMemoryToImageCopy regions[TEXTURE_MAX_MIP_LEVELS];
+    for (u32 level = 0; level < mip_levels; level++)
+    {
+        regions[level] = (VkMemoryToImageCopy){
+            .sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY,
+            .pHostPointer = levels[level],
+            .imageSubresource =
+                (VkImageSubresourceLayers){
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = level,
+                    .layerCount = 1,
+                },
+            .imageExtent = {
+                .width = Max(width >> level, 1u),
+                .height = Max(height >> level, 1u),
+                .depth = 1,
             },
-        .imageExtent = {
-            .width = width,
-            .height = height,
-            .depth = 1,
-        },
-    };
+        };
+    }
 
     VkCopyMemoryToImageInfo copy_info = {
         .sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO,
         .dstImage = image,
         .dstImageLayout = layout,
-        .regionCount = 1,
-        .pRegions = &region,
+        .regionCount = mip_levels,
+        .pRegions = regions,
     };
 
     if (vkCopyMemoryToImage(g_device, &copy_info) != VK_SUCCESS)
@@ -145,40 +199,21 @@ bool VulkanImage_CreateColorAttachment(u32 width, u32 height, VkImage *image_out
     return true;
 }
 
-/* the copy destination layout must be in the device's pCopyDstLayouts;
-   SHADER_READ_ONLY_OPTIMAL is preferred (and near-universal), GENERAL is the
-   spec-guaranteed fallback */
-static VkImageLayout host_copy_dst_layout()
+bool VulkanImage_CreateOffscreenTarget(VkExtent2D extent, VkFormat format, VkImage *image_out,
+                                       VkDeviceMemory *image_memory_out)
 {
-    static VkImageLayout s_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    Assert(extent.width > 0 && extent.height > 0);
 
-    if (s_layout != VK_IMAGE_LAYOUT_UNDEFINED)
-        return s_layout;
-
-    VkImageLayout dst_layouts[32];
-    VkPhysicalDeviceHostImageCopyProperties host_copy_properties = {
-        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES,
-        .copyDstLayoutCount = ArrayCount(dst_layouts),
-        .pCopyDstLayouts = dst_layouts,
-    };
-    VkPhysicalDeviceProperties2 properties = {
-        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
-        .pNext = &host_copy_properties,
-    };
-
-    vkGetPhysicalDeviceProperties2(g_physical_device, &properties);
+    return create_image(extent, 1, VK_SAMPLE_COUNT_1_BIT, format, VK_IMAGE_TILING_OPTIMAL,
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image_out, image_memory_out);
+}
 
-    s_layout = VK_IMAGE_LAYOUT_GENERAL;
-    for (u32 i = 0; i < host_copy_properties.copyDstLayoutCount; i++)
-    {
-        if (dst_layouts[i] == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-        {
-            s_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            break;
-        }
-    }
+static VkImageLayout host_copy_dst_layout()
+{
+    Assert(s_host_copy_dst_layout != VK_IMAGE_LAYOUT_UNDEFINED);
 
-    return s_layout;
+    return s_host_copy_dst_layout;
 }
 
 bool VulkanImage_CreateDepthResources(VkExtent2D image_extent, VkFormat depth_format,
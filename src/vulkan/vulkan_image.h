@@ -5,17 +5,32 @@
 
 #include "core.h"
 
+/* main thread, before any image is created; picks the host image copy
+   layout the uploads on job threads then share */
+void VulkanImage_Init();
+
 bool VulkanImage_CreateView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags,
                             u32 mip_levels, VkImageView *image_view_out);
 
-/* device-local VK_FORMAT_R8G8B8A8_SRGB sampled image uploaded via host image
-   copy from rgba_data (width * height * 4 bytes); layout_out is the layout
-   the image is left in, for descriptor writes */
-bool VulkanImage_CreateStatic(u32 width, u32 height, const u8 *rgba_data, VkImage *image_out,
-                              VkDeviceMemory *image_memory_out, VkImageLayout *layout_out);
+/* a view reading the image's channels as components says; zeroed
+   components are the identity */
+bool VulkanImage_CreateSwizzledView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags,
+                                    u32 mip_levels, VkComponentMapping components, VkImageView *image_view_out);
+
+/* device-local sampled image uploaded via host image copy: levels[i] is
+   mip level i, tightly packed in format, each level half the size of the
+   one before down to 1 texel. layout_out is the layout the image is left
+   in, for descriptor writes */
+bool VulkanImage_CreateStatic(VkFormat format, u32 width, u32 height, u32 mip_levels, const void *const *levels,
+                              VkImage *image_out, VkDeviceMemory *image_memory_out, VkImageLayout *layout_out);
 
 bool VulkanImage_CreateColorAttachment(u32 width, u32 height, VkImage *image_out, VkDeviceMemory *image_memory_out, VkImageLayout *layout_out);
 
+/* stands in for a swapchain image when rendering headless; left in
+   TRANSFER_SRC_OPTIMAL by the swapchain pass so it can be read back */
+bool VulkanImage_CreateOffscreenTarget(VkExtent2D extent, VkFormat format, VkImage *image_out,
+                                       VkDeviceMemory *image_memory_out);
+
 bool VulkanImage_CreateDepthResources(VkExtent2D image_extent, VkFormat depth_format,
                                       VkImage *image_out, VkImageView *image_view_out,
                                       VkDeviceMemory *device_memory_out);
@@ -1,18 +1,21 @@
+#include <stdio.h>
 #include <vulkan/vulkan_core.h>
 
 #include "core.h"
 #include "log.h"
+#include "profiler.h"
 #include "render_types.h"
 #include "vulkan_buffer.h"
 #include "vulkan_context.h"
 #include "vulkan_pass.h"
 #include "vulkan_image.h"
 #include "vulkan_pipeline.h"
+#include "vulkan_query.h"
 #include "vulkan_renderer.h"
 #include "vulkan_texture.h"
 
 
-#define MAX_PIPELINES_PER_PASS 64 // TODO: this need be dynamic
+#define INITIAL_PIPELINES_PER_PASS 8
 #define MAX_DRAW_COMMANDS_PER_PASS 1024
 #define MAX_IMAGE_PASSES 16
 
@@ -23,6 +26,7 @@ struct _swapchain_target_t
     /* borrowed from the swapchain; destroyed with it, not with the target */
     VkImage         color_images[MAX_FRAMES_IN_FLIGHT];
     VkImageView     color_image_views[MAX_FRAMES_IN_FLIGHT];
+    VkImageLayout   final_layout;
 
     VkImage         depth_image;
     VkImageView     depth_image_view;
@@ -59,6 +63,16 @@ struct _render_target
 };
 
 
+/* a pipeline as added to one pass: the shared pipeline plus the uniform
+   buffers it was configured with, pushed into set 1 at bake time */
+typedef struct _pass_pipeline_t pass_pipeline_t;
+struct _pass_pipeline_t
+{
+    pipeline_t          *pipeline;
+    u32                 uniform_binding_count;
+    uniform_binding_t   uniform_bindings[MAX_UNIFORM_BINDINGS];
+};
+
 typedef struct _render_pass render_pass_t;
 struct _render_pass
 {
@@ -68,8 +82,11 @@ struct _render_pass
     render_target_t target;
     VkFormat        color_format;
 
-    pipeline_t      pipelines[MAX_PIPELINES_PER_PASS];
-    u64             pipeline_count;
+    /* shared with the pipeline cache; grown from the pass arena */
+    arena_t         *arena;
+    pass_pipeline_t *pipelines;
+    u32             pipeline_capacity;
+    u32             pipeline_count;
 
     draw_command_t  *draw_commands;
     u32             draw_command_capacity;
@@ -97,7 +114,10 @@ struct _vk_passes
 static vk_passes_t s_passes = {};
 
 static render_pass_t *get_render_pass(renderpass_handle_t pass_handle);
-static const pipeline_t *get_pipeline(const render_pass_t *pass, pipeline_handle_t handle);
+static const pass_pipeline_t *get_pipeline(const render_pass_t *pass, pipeline_handle_t handle);
+static bool same_uniforms(const pass_pipeline_t *a, const pass_pipeline_t *b);
+static void push_uniforms(VkCommandBuffer command_buffer, const pass_pipeline_t *entry,
+                          u32 image_index);
 static bool create_swapchain_target(swapchain_t *swapchain, swapchain_target_t *target);
 static bool bake_command_buffer(render_pass_t *pass, VkCommandBuffer command_buffer, u32 image_index);
 static void destroy_render_pass(render_pass_t *pass);
@@ -146,6 +166,7 @@ bool VulkanPass_CreateSwapchainPass(arena_t *arena, swapchain_t *swapchain)
 
     pass->draw_commands = arena_push_array(arena, draw_command_t, MAX_DRAW_COMMANDS_PER_PASS);
     pass->draw_command_capacity = MAX_DRAW_COMMANDS_PER_PASS;
+    pass->arena = arena;
 
     pass->handle = SWAPCHAIN_PASS_HANDLE;
     pass->color_format = swapchain->format;
@@ -187,6 +208,7 @@ renderpass_handle_t VulkanPass_CreateImagePass(arena_t *arena, texture_handle_t
 
     pass->draw_commands = arena_push_array(arena, draw_command_t, MAX_DRAW_COMMANDS_PER_PASS);
     pass->draw_command_capacity = MAX_DRAW_COMMANDS_PER_PASS;
+    pass->arena = arena;
 
     pass->handle = (renderpass_handle_t)(s_passes.image_pass_count + 1); /* 1-based */
     pass->order = order;
@@ -253,6 +275,7 @@ static bool create_swapchain_target(swapchain_t *swapchain, swapchain_target_t *
         target->color_images[i] = swapchain->images[i];
         target->color_image_views[i] = swapchain->image_views[i];
     }
+    target->final_layout = swapchain->final_layout;
 
     return true;
 }
@@ -267,29 +290,93 @@ pipeline_handle_t VulkanPass_AddPipeline(renderpass_handle_t pass_handle,
         return PIPELINE_HANDLE_INVALID;
     }
 
-    if (pass->pipeline_count >= MAX_PIPELINES_PER_PASS)
-    {
-        Log(ERROR, "render pass pipeline limit reached");
+    pipeline_t *pipeline = VulkanPipeline_Acquire(pass->color_format, s_passes.depth_format, config);
+    if (!pipeline)
         return PIPELINE_HANDLE_INVALID;
+
+    pass_pipeline_t entry = {
+        .pipeline = pipeline,
+        .uniform_binding_count = config->uniform_binding_count,
+    };
+    for (u32 i = 0; i < config->uniform_binding_count; i++)
+        entry.uniform_bindings[i] = config->uniform_bindings[i];
+
+    /* the same config added twice to a pass hands back the existing handle */
+    for (u32 i = 0; i < pass->pipeline_count; i++)
+    {
+        if (pass->pipelines[i].pipeline == pipeline && same_uniforms(&pass->pipelines[i], &entry))
+        {
+            VulkanPipeline_Release(pipeline);
+            return (pipeline_handle_t)(i + 1);
+        }
     }
 
-    pipeline_t *pipeline = &pass->pipelines[pass->pipeline_count];
-    if (!VulkanPipeline_Create(pass->color_format, s_passes.depth_format, config, pipeline))
-        return PIPELINE_HANDLE_INVALID;
+    if (pass->pipeline_count == pass->pipeline_capacity)
+    {
+        /* the old array is left behind in the arena; pipelines are added at
+           load time so this only happens a handful of times */
+        u32 capacity = pass->pipeline_capacity ? pass->pipeline_capacity * 2
+                                               : INITIAL_PIPELINES_PER_PASS;
+        pass_pipeline_t *pipelines = arena_push_array(pass->arena, pass_pipeline_t, capacity);
+        if (pass->pipeline_count > 0)
+            MemoryCopy(pipelines, pass->pipelines, pass->pipeline_count * sizeof(*pipelines));
+
+        pass->pipelines = pipelines;
+        pass->pipeline_capacity = capacity;
+    }
 
-    pass->pipeline_count++;
+    pass->pipelines[pass->pipeline_count++] = entry;
 
     return (pipeline_handle_t)pass->pipeline_count; /* 1-based */
 }
 
 /* pipeline handles are 1-based indices so 0 stays the invalid handle */
-static const pipeline_t *get_pipeline(const render_pass_t *pass, pipeline_handle_t handle)
+static const pass_pipeline_t *get_pipeline(const render_pass_t *pass, pipeline_handle_t handle)
 {
     Assert(handle != PIPELINE_HANDLE_INVALID && handle <= pass->pipeline_count);
 
     return &pass->pipelines[handle - 1];
 }
 
+static bool same_uniforms(const pass_pipeline_t *a, const pass_pipeline_t *b)
+{
+    return a->uniform_binding_count == b->uniform_binding_count &&
+           MemoryMatch(a->uniform_bindings, b->uniform_bindings,
+                       a->uniform_binding_count * sizeof(uniform_binding_t));
+}
+
+/* the buffers are looked up at bake time, so a uniform buffer object that
+   grew is picked up without touching any descriptor */
+static void push_uniforms(VkCommandBuffer command_buffer, const pass_pipeline_t *entry,
+                          u32 image_index)
+{
+    VkDescriptorBufferInfo buffer_infos[MAX_UNIFORM_BINDINGS];
+    VkWriteDescriptorSet writes[MAX_UNIFORM_BINDINGS];
+
+    for (u32 i = 0; i < entry->uniform_binding_count; i++)
+    {
+        const uniform_binding_t *binding = &entry->uniform_bindings[i];
+
+        buffer_infos[i] = (VkDescriptorBufferInfo){
+            .buffer = VulkanBuffer_GetDeviceBuffer(binding->buffer_object, image_index),
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        };
+
+        writes[i] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstBinding = binding->binding,
+            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &buffer_infos[i],
+        };
+    }
+
+    vkCmdPushDescriptorSet(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           VulkanPipeline_GetLayout(), DESCRIPTOR_SET_UNIFORMS,
+                           entry->uniform_binding_count, writes);
+}
+
 static render_pass_t *get_render_pass(renderpass_handle_t pass_handle)
 {
     if (pass_handle == SWAPCHAIN_PASS_HANDLE && s_passes.swapchain_set &&
@@ -335,7 +422,7 @@ void VulkanPass_AddDrawCommand(const draw_command_t *draw_command)
     draw_command_t *slot = &pass->draw_commands[pass->draw_command_count++];
     *slot = *draw_command;
 
-    const pipeline_t *pipeline = get_pipeline(pass, draw_command->pipeline);
+    const pipeline_t *pipeline = get_pipeline(pass, draw_command->pipeline)->pipeline;
     if (pipeline->push_constant_size > 0 && draw_command->push_constant_data)
     {
         u8 *push_constant_copy = arena_push_array_no_zero(s_passes.frame_arena, u8,
@@ -348,6 +435,7 @@ void VulkanPass_AddDrawCommand(const draw_command_t *draw_command)
 
 bool VulkanPass_BakeCommandBuffer(VkCommandBuffer command_buffer, u32 image_index)
 {
+    ProfileZone("VulkanPass_BakeCommandBuffer");
     Assert(s_passes.swapchain_set && s_passes.swapchain_pass.active);
 
     VkCommandBufferBeginInfo begin_info = {
@@ -362,18 +450,39 @@ bool VulkanPass_BakeCommandBuffer(VkCommandBuffer command_buffer, u32 image_inde
         return false;
     }
 
+    VulkanQuery_BeginStatistics(command_buffer);
+
+    /* every pipeline shares one layout, so the global texture set is bound
+       once for the whole command buffer and survives pipeline binds */
+    VkDescriptorSet texture_set = VulkanTexture_GetDescriptorSet();
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            VulkanPipeline_GetLayout(), DESCRIPTOR_SET_TEXTURES, 1, &texture_set,
+                            0, NULL);
+
     /* image passes bake first, in pass order, so their targets are ready to
        be sampled by the passes that follow */
     for (u32 i = 0; i < s_passes.image_pass_count; i++)
     {
-        render_pass_t *pass = &s_passes.image_passes[s_passes.image_pass_order[i]];
+        u32 pass_index = s_passes.image_pass_order[i];
+        render_pass_t *pass = &s_passes.image_passes[pass_index];
+        if (!pass->active)
+            continue;
+
+        char label[GPU_TIMER_LABEL_LEN];
+        snprintf(label, sizeof(label), "image pass %u", pass_index + 1);
 
-        if (pass->active && !bake_command_buffer(pass, command_buffer, image_index))
+        u32 timer = VulkanQuery_BeginTimer(command_buffer, false, label);
+        if (!bake_command_buffer(pass, command_buffer, image_index))
             return false;
+        VulkanQuery_EndTimer(command_buffer, timer);
     }
 
+    u32 timer = VulkanQuery_BeginTimer(command_buffer, false, "swapchain pass");
     if (!bake_command_buffer(&s_passes.swapchain_pass, command_buffer, image_index))
         return false;
+    VulkanQuery_EndTimer(command_buffer, timer);
+
+    VulkanQuery_EndStatistics(command_buffer);
 
     if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS)
     {
@@ -510,38 +619,54 @@ static bool bake_command_buffer(render_pass_t *pass, VkCommandBuffer command_buf
 
     // TODO sort draw commands by pipeline to minimize rebinds
 
+    VkPipelineLayout layout = VulkanPipeline_GetLayout();
+
     const pipeline_t *bound_pipeline = NULL;
+    const pass_pipeline_t *pushed_uniforms = NULL;
+
+    /* meshes share the mesh buffer, so consecutive draws mostly leave the
+       bindings alone */
+    VkBuffer bound_vertex_buffer = VK_NULL_HANDLE;
+    VkBuffer bound_index_buffer = VK_NULL_HANDLE;
+    index_type_t bound_index_type = INDEX_TYPE_U32;
     for (u32 i = 0; i < pass->draw_command_count; i++)
     {
         const draw_command_t *command = &pass->draw_commands[i];
 
-        const pipeline_t *pipeline = get_pipeline(pass, command->pipeline);
+        const pass_pipeline_t *entry = get_pipeline(pass, command->pipeline);
+        const pipeline_t *pipeline = entry->pipeline;
 
         if (pipeline != bound_pipeline)
         {
             vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                               pipeline->vk_pipeline);
-
-            /* set 0 = global bindless textures, set 1 = per-pipeline uniforms */
-            VkDescriptorSet descriptor_sets[] = {
-                VulkanTexture_GetDescriptorSet(),
-                pipeline->descriptor_sets[image_index],
-            };
-            u32 set_count = pipeline->descriptor_sets[image_index] != VK_NULL_HANDLE ? 2 : 1;
-
-            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                    pipeline->layout, 0, set_count, descriptor_sets, 0, NULL);
-
             bound_pipeline = pipeline;
         }
 
+        /* pipelines sharing the same uniforms (e.g. one view projection)
+           don't touch set 1 at all */
+        if (entry->uniform_binding_count > 0 &&
+            (!pushed_uniforms || !same_uniforms(entry, pushed_uniforms)))
+        {
+            push_uniforms(command_buffer, entry, image_index);
+            pushed_uniforms = entry;
+        }
+
         if (pipeline->push_constant_size > 0 && command->push_constant_data)
         {
-            vkCmdPushConstants(command_buffer, pipeline->layout,
+            vkCmdPushConstants(command_buffer, layout,
                                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
                                pipeline->push_constant_size, command->push_constant_data);
         }
 
+        if (command->push_prefix_size > 0)
+        {
+            Assert(pipeline->push_constant_size >= command->push_prefix_size);
+            vkCmdPushConstants(command_buffer, layout,
+                               VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                               command->push_prefix_size, command->push_prefix);
+        }
+
         if (command->storage_buffer != BUFFER_OBJECT_HANDLE_INVALID)
         {
             /* the shader dereferences the address via GL_EXT_buffer_reference */
@@ -549,28 +674,51 @@ static bool bake_command_buffer(render_pass_t *pass, VkCommandBuffer command_buf
                 VulkanBuffer_GetDeviceAddress(command->storage_buffer, image_index);
 
             Assert(pipeline->push_constant_size >= sizeof(address));
-            vkCmdPushConstants(command_buffer, pipeline->layout,
+            vkCmdPushConstants(command_buffer, layout,
                                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
                                sizeof(address), &address);
         }
 
-        VkDeviceSize vertex_buffer_offset = 0;
-        vkCmdBindVertexBuffers(command_buffer, 0, 1, &command->vertex_buffer, &vertex_buffer_offset);
-        vkCmdBindIndexBuffer(command_buffer, command->index_buffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(command_buffer, command->index_count, command->instance_count, 0, 0, 0);
+        if (pipeline->config.vertex_pulling)
+        {
+            Assert(command->vertex_address != 0);
+            vkCmdPushConstants(command_buffer, layout,
+                               VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                               offsetof(mesh_push_constant_t, __vertex_address), sizeof(command->vertex_address),
+                               &command->vertex_address);
+        }
+
+        /* pipelines without vertex attributes pull their vertices, if any */
+        if (pipeline->config.vertex_attribute_count > 0 && command->vertex_buffer != bound_vertex_buffer)
+        {
+            VkDeviceSize vertex_buffer_offset = 0;
+            vkCmdBindVertexBuffers(command_buffer, 0, 1, &command->vertex_buffer, &vertex_buffer_offset);
+            bound_vertex_buffer = command->vertex_buffer;
+        }
+
+        if (command->index_buffer != bound_index_buffer || command->index_type != bound_index_type)
+        {
+            vkCmdBindIndexBuffer(command_buffer, command->index_buffer, 0,
+                                 command->index_type == INDEX_TYPE_U16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+            bound_index_buffer = command->index_buffer;
+            bound_index_type = command->index_type;
+        }
+        vkCmdDrawIndexed(command_buffer, command->index_count, command->instance_count, command->first_index,
+                         (i32)command->vertex_offset, command->first_instance);
     }
 
     vkCmdEndRendering(command_buffer);
 
-    /* a swapchain image must be in PRESENT_SRC for vkQueuePresentKHR; an
-       image target moves to SHADER_READ_ONLY for sampling by later passes */
+    /* a swapchain image must be in PRESENT_SRC for vkQueuePresentKHR (or
+       TRANSFER_SRC offscreen, for readback); an image target moves to
+       SHADER_READ_ONLY for sampling by later passes */
     VkImageMemoryBarrier finish_barrier = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
         .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
         .dstAccessMask = image_target ? VK_ACCESS_SHADER_READ_BIT : 0,
         .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
         .newLayout = image_target ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-                                  : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                                  : pass->target.swapchain_target.final_layout,
         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
         .image = color_image,
@@ -605,8 +753,8 @@ static void destroy_render_pass(render_pass_t *pass)
         break;
     }
 
-    for (u64 i = 0; i < pass->pipeline_count; i++)
-        VulkanPipeline_Destroy(&pass->pipelines[i]);
+    for (u32 i = 0; i < pass->pipeline_count; i++)
+        VulkanPipeline_Release(pass->pipelines[i].pipeline);
     pass->pipeline_count = 0;
 
     pass->active = false;
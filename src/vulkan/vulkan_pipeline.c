@@ -1,49 +1,238 @@
 #include "core.h"
+#include "hash_map.h"
+#include "list.h"
 #include "log.h"
 
 #include "render_types.h"
-#include "vulkan_buffer.h"
 #include "vulkan_context.h"
 #include "vulkan_pipeline.h"
 #include "vulkan_texture.h"
 #include <vulkan/vulkan_core.h>
 
+#include "xxh3.h"
+
+#define PIPELINE_CACHE_BUCKETS 64
+
+/* modules keep a pointer to their spir-v, which outlives them in the engine
+   arena, so a hash hit can be verified. one whose hash collided with
+   different code isn't in the map and isn't shared */
+struct _shader_module_t
+{
+    u64             hash;
+    u64             size;
+    u8              *code;
+    VkShaderModule  module;
+    u32             ref_count;
+    bool            cached;
+
+    shader_module_t *next; /* free list */
+};
+
+/* everything that ends up in the VkPipeline. hashed and compared field by
+   field, never as raw bytes, so padding and attributes past the count don't
+   matter; the shaders by the hash and size of their bytes, with the bytes
+   themselves compared on a hit */
+typedef struct
+{
+    u64                 vertex_shader_hash;
+    u64                 fragment_shader_hash;
+    u64                 vertex_shader_size;
+    u64                 fragment_shader_size;
+    VkFormat            color_format;
+    VkFormat            depth_format;
+    u32                 push_constant_size;
+    u32                 vertex_stride;
+    u32                 vertex_attribute_count;
+    vertex_attribute_t  vertex_attributes[MAX_VERTEX_ATTRIBUTES];
+    bool                alpha_blending;
+    bool                disable_depth_test;
+    bool                vertex_pulling;
+} pipeline_key_t;
+
+/* pipelines keep their key around so a hash hit can be verified. one whose
+   hash collided with a different key isn't in the map and isn't shared */
+typedef struct
+{
+    pipeline_t      pipeline;
+    pipeline_key_t  key;
+    bool            cached;
+} pipeline_entry_t;
+
+typedef struct _pipeline_cache_t pipeline_cache_t;
+struct _pipeline_cache_t
+{
+    arena_t     *arena;
+
+    hash_map_t  pipelines;      /* key hash -> pipeline_entry_t* */
+    hash_map_t  shader_modules; /* spir-v hash -> shader_module_t* */
+
+    pipeline_t          *free_pipelines;
+    shader_module_t     *free_shader_modules;
+
+    VkDescriptorSetLayout   uniform_set_layout;
+    VkPipelineLayout        layout;
+};
+
+static pipeline_cache_t s_cache = {};
+
 static VkFormat vertex_format_to_vk(vertex_format_t format);
-static VkShaderStageFlags uniform_stage_to_vk(uniform_stage_t stage);
-static bool create_shader_module(shader_code_t shader, VkShaderModule *module_out);
-static bool create_descriptor_sets(const pipeline_config_t *config, pipeline_t *pipeline);
+static shader_module_t *acquire_shader_module(shader_code_t shader);
+static void release_shader_module(shader_module_t *module);
+static bool create_layout();
+static bool create_pipeline(VkFormat color_format, VkFormat depth_format,
+                            const pipeline_config_t *config, pipeline_t *pipeline);
+static void destroy_pipeline(pipeline_t *pipeline);
+static u64 hash_key(const pipeline_key_t *key);
+static u64 hash_field(u64 hash, const void *data, u64 size);
+static bool key_equal(const pipeline_key_t *a, const pipeline_key_t *b);
+static bool shader_equal(shader_code_t a, shader_code_t b);
+
+bool VulkanPipeline_Init(arena_t *arena)
+{
+    MemoryZeroItem(&s_cache);
+
+    s_cache.arena = arena;
+    s_cache.pipelines = HashMap_Create(arena, PIPELINE_CACHE_BUCKETS);
+    s_cache.shader_modules = HashMap_Create(arena, PIPELINE_CACHE_BUCKETS);
 
-bool VulkanPipeline_Create(VkFormat color_format, VkFormat depth_format,
-                           const pipeline_config_t *config, pipeline_t *pipeline_out)
+    return create_layout();
+}
+
+void VulkanPipeline_Destroy()
 {
+    if (HashMap_Size(&s_cache.pipelines) > 0)
+        Log(WARNING, "%u pipelines still referenced at shutdown",
+            (u32)HashMap_Size(&s_cache.pipelines));
+
+    if (s_cache.layout != VK_NULL_HANDLE)
+        vkDestroyPipelineLayout(g_device, s_cache.layout, NULL);
+    if (s_cache.uniform_set_layout != VK_NULL_HANDLE)
+        vkDestroyDescriptorSetLayout(g_device, s_cache.uniform_set_layout, NULL);
+
+    MemoryZeroItem(&s_cache);
+}
+
+pipeline_t *VulkanPipeline_Acquire(VkFormat color_format, VkFormat depth_format,
+                                   const pipeline_config_t *config)
+{
+    Assert(s_cache.arena != NULL);
     Assert(config->vertex_attribute_count <= MAX_VERTEX_ATTRIBUTES);
+    Assert(!config->vertex_pulling || config->vertex_attribute_count == 0);
+    Assert(config->uniform_binding_count <= MAX_UNIFORM_BINDINGS);
 
-    bool result = false;
+    if (config->vertex_shader.code == NULL || config->fragment_shader.code == NULL)
+    {
+        Log(ERROR, "invalid shader code");
+        return NULL;
+    }
 
-    MemoryZeroItem(pipeline_out);
+    if (config->push_constant_size > MAX_PUSH_CONSTANT_SIZE)
+    {
+        Log(ERROR, "pipeline %s: push constant size %u exceeds %u", config->name,
+            config->push_constant_size, MAX_PUSH_CONSTANT_SIZE);
+        return NULL;
+    }
 
-    VkShaderModule vertex_shader = VK_NULL_HANDLE;
-    VkShaderModule fragment_shader = VK_NULL_HANDLE;
-    VkPipelineLayout layout = VK_NULL_HANDLE;
+    if (config->vertex_pulling && config->push_constant_size < sizeof(mesh_push_constant_t))
+    {
+        Log(ERROR, "pipeline %s: vertex pulling needs a mesh_push_constant_t", config->name);
+        return NULL;
+    }
 
-    if (!create_shader_module(config->vertex_shader, &vertex_shader) ||
-        !create_shader_module(config->fragment_shader, &fragment_shader))
-        goto exit;
+    pipeline_key_t key;
+    MemoryZeroItem(&key);
+    key.vertex_shader_hash = XXH3_64bits(config->vertex_shader.code, config->vertex_shader.size);
+    key.fragment_shader_hash =
+        XXH3_64bits(config->fragment_shader.code, config->fragment_shader.size);
+    key.vertex_shader_size = config->vertex_shader.size;
+    key.fragment_shader_size = config->fragment_shader.size;
+    key.color_format = color_format;
+    key.depth_format = depth_format;
+    key.push_constant_size = config->push_constant_size;
+    key.vertex_stride = config->vertex_stride;
+    key.vertex_attribute_count = config->vertex_attribute_count;
+    for (u32 i = 0; i < config->vertex_attribute_count; i++)
+        key.vertex_attributes[i] = config->vertex_attributes[i];
+    key.alpha_blending = config->alpha_blending;
+    key.disable_depth_test = config->disable_depth_test;
+    key.vertex_pulling = config->vertex_pulling;
+
+    u64 hash = hash_key(&key);
+
+    /* a collision gets a pipeline of its own, outside the map */
+    pipeline_entry_t *entry = HashMap_U64Ptr_Get(&s_cache.pipelines, hash);
+    bool cached = entry == NULL;
+    if (entry && key_equal(&entry->key, &key)
+        && shader_equal(entry->pipeline.config.vertex_shader, config->vertex_shader)
+        && shader_equal(entry->pipeline.config.fragment_shader, config->fragment_shader))
+    {
+        pipeline_t *pipeline = &entry->pipeline;
+        pipeline->ref_count++;
+        Log(DEBUG, "Reusing pipeline %s for %s", pipeline->config.name, config->name);
+        return pipeline;
+    }
+    if (entry)
+        Log(WARNING, "pipeline hash collision: %s vs %s, not shared", config->name, entry->pipeline.config.name);
+
+    /* released entries go on the free list as their embedded pipeline_t */
+    pipeline_t *pipeline = s_cache.free_pipelines;
+    if (pipeline)
+        SLLPopFirst(s_cache.free_pipelines, next);
+    else
+        pipeline = &arena_push(s_cache.arena, pipeline_entry_t)->pipeline;
+    entry = (pipeline_entry_t *)pipeline;
+    MemoryZeroItem(entry);
+
+    if (!create_pipeline(color_format, depth_format, config, pipeline))
+    {
+        SLLInsertFirst(s_cache.free_pipelines, next, pipeline);
+        return NULL;
+    }
+
+    pipeline->hash = hash;
+    pipeline->ref_count = 1;
+    entry->key = key;
+    entry->cached = cached;
+    if (cached)
+        HashMap_U64Ptr_Insert(&s_cache.pipelines, hash, entry);
+
+    return pipeline;
+}
+
+void VulkanPipeline_Release(pipeline_t *pipeline)
+{
+    Assert(pipeline->ref_count > 0);
+
+    if (--pipeline->ref_count > 0)
+        return;
+
+    if (((pipeline_entry_t *)pipeline)->cached)
+        HashMap_U64_Remove(&s_cache.pipelines, pipeline->hash);
+    destroy_pipeline(pipeline);
+    SLLInsertFirst(s_cache.free_pipelines, next, pipeline);
+}
 
-    if (!create_descriptor_sets(config, pipeline_out))
+static bool create_pipeline(VkFormat color_format, VkFormat depth_format,
+                            const pipeline_config_t *config, pipeline_t *pipeline_out)
+{
+    bool result = false;
+
+    pipeline_out->vertex_module = acquire_shader_module(config->vertex_shader);
+    pipeline_out->fragment_module = acquire_shader_module(config->fragment_shader);
+    if (!pipeline_out->vertex_module || !pipeline_out->fragment_module)
         goto exit;
 
     VkPipelineShaderStageCreateInfo shader_stages[] = {
         {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .stage = VK_SHADER_STAGE_VERTEX_BIT,
-            .module = vertex_shader,
+            .module = pipeline_out->vertex_module->module,
             .pName = "main",
         },
         {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .module = fragment_shader,
+            .module = pipeline_out->fragment_module->module,
             .pName = "main",
         },
     };
@@ -65,9 +254,11 @@ bool VulkanPipeline_Create(VkFormat color_format, VkFormat depth_format,
         };
     }
 
+    /* pipelines pulling their vertices from a storage buffer have no
+       vertex input at all */
     VkPipelineVertexInputStateCreateInfo vertex_input_state = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .vertexBindingDescriptionCount = 1,
+        .vertexBindingDescriptionCount = config->vertex_attribute_count > 0 ? 1 : 0,
         .pVertexBindingDescriptions = &vertex_binding,
         .vertexAttributeDescriptionCount = config->vertex_attribute_count,
         .pVertexAttributeDescriptions = vertex_attributes,
@@ -139,33 +330,6 @@ bool VulkanPipeline_Create(VkFormat color_format, VkFormat depth_format,
         .pAttachments = &color_blend_attachment,
     };
 
-    VkPushConstantRange push_constant_range = {
-        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-        .offset = 0,
-        .size = config->push_constant_size,
-    };
-
-    /* set 0 is always the global bindless texture array so it stays
-       compatible across all pipelines; per-pipeline uniforms live in set 1 */
-    VkDescriptorSetLayout set_layouts[] = {
-        VulkanTexture_GetDescriptorSetLayout(),
-        pipeline_out->descriptor_set_layout,
-    };
-
-    VkPipelineLayoutCreateInfo layout_create_info = {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .pushConstantRangeCount = config->push_constant_size > 0 ? 1U : 0U,
-        .pPushConstantRanges = &push_constant_range,
-        .setLayoutCount = pipeline_out->descriptor_set_layout != VK_NULL_HANDLE ? 2U : 1U,
-        .pSetLayouts = set_layouts,
-    };
-
-    if (vkCreatePipelineLayout(g_device, &layout_create_info, NULL, &layout) != VK_SUCCESS)
-    {
-        Log(ERROR, "failed to create pipeline layout");
-        goto exit;
-    }
-
     /* dynamic rendering: the pipeline binds to attachment formats, not a
        render pass object */
     VkPipelineRenderingCreateInfo rendering_create_info = {
@@ -188,7 +352,7 @@ bool VulkanPipeline_Create(VkFormat color_format, VkFormat depth_format,
         .pMultisampleState = &multisample_state,
         .pDepthStencilState = &depth_stencil_state,
         .pColorBlendState = &color_blend_state,
-        .layout = layout,
+        .layout = s_cache.layout,
     };
 
     VkPipeline vk_pipeline;
@@ -200,156 +364,158 @@ bool VulkanPipeline_Create(VkFormat color_format, VkFormat depth_format,
     }
 
     pipeline_out->vk_pipeline = vk_pipeline;
-    pipeline_out->layout = layout;
     pipeline_out->push_constant_size = config->push_constant_size;
     MemoryCopyStruct(&pipeline_out->config, config);
-    layout = VK_NULL_HANDLE;
 
     result = true;
     Log(INFO, "Created pipeline: %s", config->name);
 
 exit:
     if (!result)
-    {
-        if (pipeline_out->descriptor_pool != VK_NULL_HANDLE)
-            vkDestroyDescriptorPool(g_device, pipeline_out->descriptor_pool, NULL);
-        if (pipeline_out->descriptor_set_layout != VK_NULL_HANDLE)
-            vkDestroyDescriptorSetLayout(g_device, pipeline_out->descriptor_set_layout, NULL);
-    }
-    if (layout != VK_NULL_HANDLE)
-        vkDestroyPipelineLayout(g_device, layout, NULL);
-    if (vertex_shader != VK_NULL_HANDLE)
-        vkDestroyShaderModule(g_device, vertex_shader, NULL);
-    if (fragment_shader != VK_NULL_HANDLE)
-        vkDestroyShaderModule(g_device, fragment_shader, NULL);
+        destroy_pipeline(pipeline_out);
 
     return result;
 }
 
-void VulkanPipeline_Destroy(pipeline_t *pipeline)
+static void destroy_pipeline(pipeline_t *pipeline)
 {
-    if (pipeline->descriptor_pool != VK_NULL_HANDLE)
-        vkDestroyDescriptorPool(g_device, pipeline->descriptor_pool, NULL);
-    if (pipeline->descriptor_set_layout != VK_NULL_HANDLE)
-        vkDestroyDescriptorSetLayout(g_device, pipeline->descriptor_set_layout, NULL);
-
-    vkDestroyPipeline(g_device, pipeline->vk_pipeline, NULL);
-    vkDestroyPipelineLayout(g_device, pipeline->layout, NULL);
+    if (pipeline->vk_pipeline != VK_NULL_HANDLE)
+        vkDestroyPipeline(g_device, pipeline->vk_pipeline, NULL);
+    if (pipeline->vertex_module)
+        release_shader_module(pipeline->vertex_module);
+    if (pipeline->fragment_module)
+        release_shader_module(pipeline->fragment_module);
 
     MemoryZeroItem(pipeline);
 }
 
-static bool create_descriptor_sets(const pipeline_config_t *config, pipeline_t *pipeline)
+static shader_module_t *acquire_shader_module(shader_code_t shader)
 {
-    if (config->uniform_binding_count == 0)
-        return true;
+    if (shader.code == NULL || shader.size == 0)
+    {
+        Log(ERROR, "invalid shader code");
+        return NULL;
+    }
 
-    Assert(config->uniform_binding_count <= MAX_UNIFORM_BINDINGS);
+    u64 hash = XXH3_64bits(shader.code, shader.size);
+
+    /* a collision gets a module of its own, outside the map */
+    shader_module_t *module = HashMap_U64Ptr_Get(&s_cache.shader_modules, hash);
+    bool cached = module == NULL;
+    if (module && shader_equal((shader_code_t){ .code = module->code, .size = module->size }, shader))
+    {
+        module->ref_count++;
+        return module;
+    }
+    if (module)
+        Log(WARNING, "shader module hash collision, not shared");
+
+    VkShaderModuleCreateInfo create_info = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = shader.size,
+        .pCode = (const u32 *)shader.code,
+    };
+
+    VkShaderModule vk_module;
+    if (vkCreateShaderModule(g_device, &create_info, NULL, &vk_module) != VK_SUCCESS)
+    {
+        Log(ERROR, "failed to create shader module");
+        return NULL;
+    }
+
+    module = s_cache.free_shader_modules;
+    if (module)
+        SLLPopFirst(s_cache.free_shader_modules, next);
+    else
+        module = arena_push(s_cache.arena, shader_module_t);
+    MemoryZeroItem(module);
+
+    module->hash = hash;
+    module->size = shader.size;
+    module->code = shader.code;
+    module->module = vk_module;
+    module->ref_count = 1;
+    module->cached = cached;
+    if (cached)
+        HashMap_U64Ptr_Insert(&s_cache.shader_modules, hash, module);
+
+    return module;
+}
+
+static void release_shader_module(shader_module_t *module)
+{
+    Assert(module->ref_count > 0);
 
-    VkDescriptorSetLayoutBinding layout_bindings[MAX_UNIFORM_BINDINGS];
-    for (u32 i = 0; i < config->uniform_binding_count; i++)
+    if (--module->ref_count > 0)
+        return;
+
+    if (module->cached)
+        HashMap_U64_Remove(&s_cache.shader_modules, module->hash);
+    vkDestroyShaderModule(g_device, module->module, NULL);
+    SLLInsertFirst(s_cache.free_shader_modules, next, module);
+}
+
+static bool create_layout()
+{
+    /* uniform buffers are pushed straight into the command buffer at bake
+       time, so there are no pools or per-pipeline sets to manage and a
+       uniform that grows just gets its new buffer pushed next frame */
+    VkDescriptorSetLayoutBinding uniform_bindings[MAX_UNIFORM_BINDINGS];
+    for (u32 i = 0; i < MAX_UNIFORM_BINDINGS; i++)
     {
-        const uniform_binding_t *binding = &config->uniform_bindings[i];
-        layout_bindings[i] = (VkDescriptorSetLayoutBinding){
-            .binding = binding->binding,
+        uniform_bindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding = i,
             .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
             .descriptorCount = 1,
-            .stageFlags = uniform_stage_to_vk(binding->stage),
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
         };
     }
 
-    VkDescriptorSetLayoutCreateInfo layout_create_info = {
+    VkDescriptorSetLayoutCreateInfo set_layout_create_info = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .bindingCount = config->uniform_binding_count,
-        .pBindings = layout_bindings,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT,
+        .bindingCount = ArrayCount(uniform_bindings),
+        .pBindings = uniform_bindings,
     };
 
-    if (vkCreateDescriptorSetLayout(g_device, &layout_create_info, NULL,
-                                    &pipeline->descriptor_set_layout) != VK_SUCCESS)
+    if (vkCreateDescriptorSetLayout(g_device, &set_layout_create_info, NULL,
+                                    &s_cache.uniform_set_layout) != VK_SUCCESS)
     {
-        Log(ERROR, "failed to create descriptor set layout");
+        Log(ERROR, "failed to create uniform descriptor set layout");
         return false;
     }
 
-    VkDescriptorPoolSize pool_size = {
-        .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        .descriptorCount = config->uniform_binding_count * MAX_FRAMES_IN_FLIGHT,
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+        .offset = 0,
+        .size = MAX_PUSH_CONSTANT_SIZE,
     };
 
-    // TODO a shared descriptor pool instead of one per pipeline
-    VkDescriptorPoolCreateInfo pool_create_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .maxSets = MAX_FRAMES_IN_FLIGHT,
-        .poolSizeCount = 1,
-        .pPoolSizes = &pool_size,
+    VkDescriptorSetLayout set_layouts[] = {
+        [DESCRIPTOR_SET_TEXTURES] = VulkanTexture_GetDescriptorSetLayout(),
+        [DESCRIPTOR_SET_UNIFORMS] = s_cache.uniform_set_layout,
     };
 
-    if (vkCreateDescriptorPool(g_device, &pool_create_info, NULL,
-                               &pipeline->descriptor_pool) != VK_SUCCESS)
-    {
-        Log(ERROR, "failed to create descriptor pool");
-        return false;
-    }
-
-    VkDescriptorSetLayout set_layouts[MAX_FRAMES_IN_FLIGHT];
-    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-        set_layouts[i] = pipeline->descriptor_set_layout;
-
-    VkDescriptorSetAllocateInfo allocate_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-        .descriptorPool = pipeline->descriptor_pool,
-        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+    VkPipelineLayoutCreateInfo layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range,
+        .setLayoutCount = ArrayCount(set_layouts),
         .pSetLayouts = set_layouts,
     };
 
-    if (vkAllocateDescriptorSets(g_device, &allocate_info, pipeline->descriptor_sets) != VK_SUCCESS)
+    if (vkCreatePipelineLayout(g_device, &layout_create_info, NULL, &s_cache.layout) != VK_SUCCESS)
     {
-        Log(ERROR, "failed to allocate descriptor sets");
+        Log(ERROR, "failed to create pipeline layout");
         return false;
     }
 
-    for (u32 frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
-    {
-        VkDescriptorBufferInfo buffer_infos[MAX_UNIFORM_BINDINGS];
-        VkWriteDescriptorSet writes[MAX_UNIFORM_BINDINGS];
-
-        for (u32 i = 0; i < config->uniform_binding_count; i++)
-        {
-            const uniform_binding_t *binding = &config->uniform_bindings[i];
-
-            buffer_infos[i] = (VkDescriptorBufferInfo){
-                .buffer = VulkanBuffer_GetDeviceBuffer(binding->buffer_object, frame),
-                .offset = 0,
-                .range = VulkanBuffer_GetObjectCapacity(binding->buffer_object),
-            };
-
-            writes[i] = (VkWriteDescriptorSet){
-                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                .dstSet = pipeline->descriptor_sets[frame],
-                .dstBinding = binding->binding,
-                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                .descriptorCount = 1,
-                .pBufferInfo = &buffer_infos[i],
-            };
-        }
-
-        vkUpdateDescriptorSets(g_device, config->uniform_binding_count, writes, 0, NULL);
-    }
-
     return true;
 }
 
-static VkShaderStageFlags uniform_stage_to_vk(uniform_stage_t stage)
+VkPipelineLayout VulkanPipeline_GetLayout()
 {
-    switch (stage)
-    {
-    case UNIFORM_STAGE_VERTEX:
-        return VK_SHADER_STAGE_VERTEX_BIT;
-    case UNIFORM_STAGE_FRAGMENT:
-        return VK_SHADER_STAGE_FRAGMENT_BIT;
-    }
-
-    return 0;
+    return s_cache.layout;
 }
 
 static VkFormat vertex_format_to_vk(vertex_format_t format)
@@ -366,30 +532,74 @@ static VkFormat vertex_format_to_vk(vertex_format_t format)
             return VK_FORMAT_R32G32B32A32_SFLOAT;
         case VERTEX_FORMAT_U32:
             return VK_FORMAT_R32_UINT;
+        case VERTEX_FORMAT_F16X2:
+            return VK_FORMAT_R16G16_SFLOAT;
+        case VERTEX_FORMAT_F16X4:
+            return VK_FORMAT_R16G16B16A16_SFLOAT;
+        case VERTEX_FORMAT_SNORM16X2:
+            return VK_FORMAT_R16G16_SNORM;
+        case VERTEX_FORMAT_SNORM16X4:
+            return VK_FORMAT_R16G16B16A16_SNORM;
+        case VERTEX_FORMAT_UNORM8X4:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+        case VERTEX_FORMAT_U8:
+            return VK_FORMAT_R8_UINT;
     }
 
     return VK_FORMAT_UNDEFINED;
 }
 
-static bool create_shader_module(shader_code_t shader, VkShaderModule *module_out)
+static u64 hash_key(const pipeline_key_t *key)
 {
-    if (shader.code == NULL || shader.size == 0)
+    u64 hash = 0;
+    hash = hash_field(hash, &key->vertex_shader_hash, sizeof(key->vertex_shader_hash));
+    hash = hash_field(hash, &key->fragment_shader_hash, sizeof(key->fragment_shader_hash));
+    hash = hash_field(hash, &key->vertex_shader_size, sizeof(key->vertex_shader_size));
+    hash = hash_field(hash, &key->fragment_shader_size, sizeof(key->fragment_shader_size));
+    hash = hash_field(hash, &key->color_format, sizeof(key->color_format));
+    hash = hash_field(hash, &key->depth_format, sizeof(key->depth_format));
+    hash = hash_field(hash, &key->push_constant_size, sizeof(key->push_constant_size));
+    hash = hash_field(hash, &key->vertex_stride, sizeof(key->vertex_stride));
+    hash = hash_field(hash, &key->vertex_attribute_count, sizeof(key->vertex_attribute_count));
+    for (u32 i = 0; i < key->vertex_attribute_count; i++)
     {
-        Log(ERROR, "invalid shader code");
-        return false;
+        const vertex_attribute_t *attribute = &key->vertex_attributes[i];
+        hash = hash_field(hash, &attribute->location, sizeof(attribute->location));
+        hash = hash_field(hash, &attribute->format, sizeof(attribute->format));
+        hash = hash_field(hash, &attribute->offset, sizeof(attribute->offset));
     }
 
-    VkShaderModuleCreateInfo create_info = {
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = shader.size,
-        .pCode = (const u32 *)shader.code,
-    };
+    u8 flags = (u8)(key->alpha_blending | key->disable_depth_test << 1 | key->vertex_pulling << 2);
+    return hash_field(hash, &flags, sizeof(flags));
+}
 
-    if (vkCreateShaderModule(g_device, &create_info, NULL, module_out) != VK_SUCCESS)
-    {
-        Log(ERROR, "failed to create shader module");
+/* each field seeds the next */
+static u64 hash_field(u64 hash, const void *data, u64 size)
+{
+    return XXH3_64bits_withSeed(data, size, hash);
+}
+
+static bool key_equal(const pipeline_key_t *a, const pipeline_key_t *b)
+{
+    if (a->vertex_shader_hash != b->vertex_shader_hash || a->fragment_shader_hash != b->fragment_shader_hash
+        || a->vertex_shader_size != b->vertex_shader_size || a->fragment_shader_size != b->fragment_shader_size
+        || a->color_format != b->color_format || a->depth_format != b->depth_format
+        || a->push_constant_size != b->push_constant_size || a->vertex_stride != b->vertex_stride
+        || a->vertex_attribute_count != b->vertex_attribute_count || a->alpha_blending != b->alpha_blending
+        || a->disable_depth_test != b->disable_depth_test || a->vertex_pulling != b->vertex_pulling)
         return false;
-    }
 
+    for (u32 i = 0; i < a->vertex_attribute_count; i++)
+    {
+        const vertex_attribute_t *x = &a->vertex_attributes[i];
+        const vertex_attribute_t *y = &b->vertex_attributes[i];
+        if (x->location != y->location || x->format != y->format || x->offset != y->offset)
+            return false;
+    }
     return true;
 }
+
+static bool shader_equal(shader_code_t a, shader_code_t b)
+{
+    return a.size == b.size && (a.code == b.code || MemoryCompare(a.code, b.code, a.size) == 0);
+}
@@ -4,27 +4,54 @@
 #include <vulkan/vulkan_core.h>
 
 #include "core.h"
+#include "memory_arena.h"
 
 #include "render_types.h"
 #include "vulkan_types.h"
 
+/* the spec's guaranteed minimum for maxPushConstantsSize; every pipeline
+   shares one push constant range of this size */
+#define MAX_PUSH_CONSTANT_SIZE 128
+
+/* the shared pipeline layout's descriptor sets */
+#define DESCRIPTOR_SET_TEXTURES 0
+#define DESCRIPTOR_SET_UNIFORMS 1
+
 typedef struct _pipeline_t pipeline_t;
+typedef struct _shader_module_t shader_module_t;
 
+/* pipelines are deduplicated on an XXH3 hash of their normalized config (the
+   shader bytes and attachment formats, not the config pointers or name), so
+   passes adding identical configs share one VkPipeline. shader modules are
+   shared the same way; both are refcounted. uniform bindings are not part of
+   the key: they are pushed at bake time, see VulkanPipeline_GetLayout */
 struct _pipeline_t
 {
     pipeline_config_t   config;
+    u64                 hash;
+    u32                 ref_count;
 
     VkPipeline          vk_pipeline;
-    VkPipelineLayout    layout;
     u32                 push_constant_size;
 
-    VkDescriptorSetLayout   descriptor_set_layout;
-    VkDescriptorPool        descriptor_pool;
-    VkDescriptorSet         descriptor_sets[MAX_FRAMES_IN_FLIGHT];
+    shader_module_t     *vertex_module;
+    shader_module_t     *fragment_module;
+
+    pipeline_t          *next; /* free list */
 };
 
-bool VulkanPipeline_Create(VkFormat color_format, VkFormat depth_format,
-                           const pipeline_config_t *config, pipeline_t *pipeline_out);
-void VulkanPipeline_Destroy(pipeline_t *pipeline);
+bool VulkanPipeline_Init(arena_t *arena);
+void VulkanPipeline_Destroy();
+
+pipeline_t *VulkanPipeline_Acquire(VkFormat color_format, VkFormat depth_format,
+                                   const pipeline_config_t *config);
+void VulkanPipeline_Release(pipeline_t *pipeline);
+
+/* the one layout every pipeline is created with: set 0 is the global
+   bindless texture array, set 1 is a push descriptor set with
+   MAX_UNIFORM_BINDINGS uniform buffer slots visible to both stages, and the
+   push constant range is MAX_PUSH_CONSTANT_SIZE bytes. binding a pipeline
+   never invalidates the sets */
+VkPipelineLayout      VulkanPipeline_GetLayout();
 
 #endif
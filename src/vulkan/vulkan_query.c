@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <vulkan/vulkan_core.h>
+
+#include "core.h"
+#include "log.h"
+#include "profiler.h"
+#include "vulkan_context.h"
+#include "vulkan_query.h"
+#include "vulkan_types.h"
+
+#define MAX_QUEUE_FAMILIES      16
+#define TIMESTAMPS_PER_FRAME    (MAX_GPU_TIMERS * 2)
+
+typedef struct _query_frame_t query_frame_t;
+struct _query_frame_t
+{
+    VkQueryPool timestamp_pool;
+    VkQueryPool statistics_pool;
+
+    u32         timer_count;
+    char        labels[MAX_GPU_TIMERS][GPU_TIMER_LABEL_LEN];
+    bool        transfer[MAX_GPU_TIMERS];   /* written on the transfer queue */
+
+    u64         submit_ns;
+    bool        recorded;       /* has results waiting to be read */
+    bool        statistics_recorded;
+};
+
+typedef struct _vk_queries_t vk_queries_t;
+struct _vk_queries_t
+{
+    query_frame_t   frames[MAX_FRAMES_IN_FLIGHT];
+    query_frame_t   *current;
+
+    f64             ns_per_tick;
+    u64             graphics_mask;  /* timestampValidBits, 0 = no timestamps */
+    u64             transfer_mask;
+
+    bool            statistics_supported;
+    bool            statistics_enabled;
+
+    gpu_frame_timings_t timings;
+};
+
+static vk_queries_t s_queries = {};
+
+static u64 valid_bits_mask(u32 valid_bits);
+static void collect_results(query_frame_t *frame);
+static f32 collect_queue_timers(query_frame_t *frame, const u64 (*results)[2], u32 timer_count,
+                                bool transfer);
+
+bool VulkanQuery_Init(u32 graphics_family_index, u32 transfer_family_index)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(g_physical_device, &properties);
+
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(g_physical_device, &features);
+
+    u32 family_count = MAX_QUEUE_FAMILIES;
+    VkQueueFamilyProperties families[MAX_QUEUE_FAMILIES];
+    vkGetPhysicalDeviceQueueFamilyProperties(g_physical_device, &family_count, families);
+
+    Assert(graphics_family_index < family_count && transfer_family_index < family_count);
+
+    s_queries.ns_per_tick = properties.limits.timestampPeriod;
+    s_queries.graphics_mask = valid_bits_mask(families[graphics_family_index].timestampValidBits);
+    s_queries.transfer_mask = valid_bits_mask(families[transfer_family_index].timestampValidBits);
+    s_queries.statistics_supported = features.pipelineStatisticsQuery;
+
+    if (s_queries.graphics_mask == 0)
+        Log(WARNING, "graphics queue has no timestamp support; gpu timers disabled");
+
+    VkQueryPoolCreateInfo timestamp_create = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = TIMESTAMPS_PER_FRAME,
+    };
+    VkQueryPoolCreateInfo statistics_create = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+        .queryCount = 1,
+        .pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                              VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT,
+    };
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        query_frame_t *frame = &s_queries.frames[i];
+
+        if (vkCreateQueryPool(g_device, &timestamp_create, NULL, &frame->timestamp_pool) != VK_SUCCESS)
+        {
+            Log(ERROR, "failed to create timestamp query pool");
+            return false;
+        }
+        vkResetQueryPool(g_device, frame->timestamp_pool, 0, TIMESTAMPS_PER_FRAME);
+
+        if (s_queries.statistics_supported)
+        {
+            if (vkCreateQueryPool(g_device, &statistics_create, NULL, &frame->statistics_pool) != VK_SUCCESS)
+            {
+                Log(ERROR, "failed to create pipeline statistics query pool");
+                return false;
+            }
+            vkResetQueryPool(g_device, frame->statistics_pool, 0, 1);
+        }
+    }
+
+    s_queries.current = &s_queries.frames[0];
+
+    Log(INFO, "gpu timestamps: period %.2f ns, pipeline statistics %s", s_queries.ns_per_tick,
+        s_queries.statistics_supported ? "supported" : "unsupported");
+    return true;
+}
+
+void VulkanQuery_Destroy()
+{
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroyQueryPool(g_device, s_queries.frames[i].timestamp_pool, NULL);
+        vkDestroyQueryPool(g_device, s_queries.frames[i].statistics_pool, NULL);
+    }
+    MemoryZeroItem(&s_queries);
+}
+
+void VulkanQuery_BeginFrame(u32 frame_slot)
+{
+    Assert(frame_slot < MAX_FRAMES_IN_FLIGHT);
+    query_frame_t *frame = &s_queries.frames[frame_slot];
+
+    if (frame->recorded)
+        collect_results(frame);
+
+    vkResetQueryPool(g_device, frame->timestamp_pool, 0, TIMESTAMPS_PER_FRAME);
+    if (frame->statistics_pool)
+        vkResetQueryPool(g_device, frame->statistics_pool, 0, 1);
+
+    frame->timer_count = 0;
+    frame->submit_ns = 0;
+    frame->recorded = false;
+    frame->statistics_recorded = false;
+
+    s_queries.current = frame;
+}
+
+void VulkanQuery_MarkSubmit(u64 submit_ns)
+{
+    if (s_queries.current->submit_ns == 0)
+        s_queries.current->submit_ns = submit_ns;
+}
+
+u32 VulkanQuery_BeginTimer(VkCommandBuffer command_buffer, bool transfer_queue, const char *label)
+{
+    query_frame_t *frame = s_queries.current;
+
+    u64 mask = transfer_queue ? s_queries.transfer_mask : s_queries.graphics_mask;
+    if (mask == 0 || frame->timer_count == MAX_GPU_TIMERS)
+        return GPU_TIMER_INVALID;
+
+    u32 timer = frame->timer_count++;
+    snprintf(frame->labels[timer], GPU_TIMER_LABEL_LEN, "%s", label);
+    frame->transfer[timer] = transfer_queue;
+    frame->recorded = true;
+
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame->timestamp_pool,
+                        timer * 2);
+
+    return timer;
+}
+
+void VulkanQuery_EndTimer(VkCommandBuffer command_buffer, u32 timer)
+{
+    if (timer == GPU_TIMER_INVALID)
+        return;
+
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        s_queries.current->timestamp_pool, timer * 2 + 1);
+}
+
+void VulkanQuery_BeginStatistics(VkCommandBuffer command_buffer)
+{
+    if (!s_queries.statistics_enabled)
+        return;
+
+    vkCmdBeginQuery(command_buffer, s_queries.current->statistics_pool, 0, 0);
+    s_queries.current->statistics_recorded = true;
+    s_queries.current->recorded = true;
+}
+
+void VulkanQuery_EndStatistics(VkCommandBuffer command_buffer)
+{
+    if (!s_queries.current->statistics_recorded)
+        return;
+
+    vkCmdEndQuery(command_buffer, s_queries.current->statistics_pool, 0);
+}
+
+bool VulkanQuery_SetStatisticsEnabled(bool enabled)
+{
+    if (enabled && !s_queries.statistics_supported)
+    {
+        Log(WARNING, "pipeline statistics queries are not supported by this device");
+        return false;
+    }
+
+    s_queries.statistics_enabled = enabled;
+    return true;
+}
+
+bool VulkanQuery_StatisticsSupported()
+{
+    return s_queries.statistics_supported;
+}
+
+const gpu_frame_timings_t *VulkanQuery_GetTimings()
+{
+    return &s_queries.timings;
+}
+
+static u64 valid_bits_mask(u32 valid_bits)
+{
+    if (valid_bits == 0)
+        return 0;
+
+    return valid_bits >= 64 ? U64_MAX : (1ull << valid_bits) - 1;
+}
+
+static void collect_results(query_frame_t *frame)
+{
+    gpu_frame_timings_t *timings = &s_queries.timings;
+
+    /* value + availability per query: a timer whose command buffer was
+       never submitted (no transfer this frame) simply reads unavailable */
+    u64 results[TIMESTAMPS_PER_FRAME][2];
+    u32 query_count = frame->timer_count * 2;
+
+    timings->timer_count = 0;
+    timings->frame_ms = 0.0f;
+
+    if (query_count > 0)
+    {
+        VkResult result = vkGetQueryPoolResults(g_device, frame->timestamp_pool, 0, query_count,
+                                                sizeof(results), results, sizeof(results[0]),
+                                                VK_QUERY_RESULT_64_BIT |
+                                                VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result != VK_SUCCESS && result != VK_NOT_READY)
+        {
+            Log(ERROR, "failed to read timestamp queries");
+            query_count = 0;
+        }
+    }
+
+    /* queues need not share a timebase, so each one's timers are lined up
+       on their own; the frame span is the graphics queue's */
+    timings->frame_ms = collect_queue_timers(frame, results, query_count / 2, false);
+    collect_queue_timers(frame, results, query_count / 2, true);
+
+    timings->statistics_valid = false;
+    if (frame->statistics_recorded)
+    {
+        u64 statistics[3]; /* vertex, fragment, availability */
+        if (vkGetQueryPoolResults(g_device, frame->statistics_pool, 0, 1, sizeof(statistics),
+                                  statistics, sizeof(statistics),
+                                  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) ==
+                VK_SUCCESS &&
+            statistics[2])
+        {
+            timings->statistics_valid = true;
+            timings->vertex_invocations = statistics[0];
+            timings->fragment_invocations = statistics[1];
+        }
+    }
+}
+
+/* the queue's first available timestamp is placed at the frame's first
+   submit; the gpu can't have started earlier, so this is the tightest bound
+   the core api gives without calibrated timestamps. ticks are differenced
+   under the queue's valid bits, so a counter wrapping mid-frame still
+   yields the right span. returns the span of the queue's timers in ms */
+static f32 collect_queue_timers(query_frame_t *frame, const u64 (*results)[2], u32 timer_count,
+                                bool transfer)
+{
+    gpu_frame_timings_t *timings = &s_queries.timings;
+    u64 mask = transfer ? s_queries.transfer_mask : s_queries.graphics_mask;
+
+    /* timers are recorded in submission order, so the first one starts first */
+    bool anchored = false;
+    u64 first_tick = 0;
+    u64 span = 0;
+    for (u32 timer = 0; timer < timer_count; timer++)
+    {
+        const u64 *begin = results[timer * 2];
+        const u64 *end = results[timer * 2 + 1];
+        if (frame->transfer[timer] != transfer || !begin[1] || !end[1])
+            continue;
+
+        if (!anchored)
+        {
+            first_tick = begin[0];
+            anchored = true;
+        }
+
+        u64 start_ticks = (begin[0] - first_tick) & mask;
+        u64 end_ticks = start_ticks + ((end[0] - begin[0]) & mask);
+        span = Max(span, end_ticks);
+
+        gpu_timer_t *out = &timings->timers[timings->timer_count++];
+        MemoryCopy(out->label, frame->labels[timer], GPU_TIMER_LABEL_LEN);
+        out->start_ns = frame->submit_ns + (u64)((f64)start_ticks * s_queries.ns_per_tick);
+        out->end_ns = frame->submit_ns + (u64)((f64)end_ticks * s_queries.ns_per_tick);
+
+        Profiler_AddGpuZone(out->label, out->start_ns, out->end_ns);
+    }
+
+    return (f32)((f64)span * s_queries.ns_per_tick / 1000000.0);
+}
@@ -0,0 +1,41 @@
+#ifndef VULKAN_QUERY_H
+#define VULKAN_QUERY_H
+
+#include <vulkan/vulkan_core.h>
+
+#include "core.h"
+
+#include "render_types.h"
+
+#define GPU_TIMER_INVALID U32_MAX
+
+/* gpu timestamps per frame slot: a query pool per slot, reset from the host
+   and read back once the slot's frame has completed, so reading never
+   stalls. timers on a queue family without timestamp support are skipped */
+bool VulkanQuery_Init(u32 graphics_family_index, u32 transfer_family_index);
+void VulkanQuery_Destroy();
+
+/* call after the slot's previous frame is known complete; collects its
+   results and resets the slot's queries for recording */
+void VulkanQuery_BeginFrame(u32 frame_slot);
+
+/* cpu time of the frame's first queue submit, for lining up the clocks */
+void VulkanQuery_MarkSubmit(u64 submit_ns);
+
+/* label is copied; returns GPU_TIMER_INVALID when out of timers or the
+   queue can't take timestamps */
+u32  VulkanQuery_BeginTimer(VkCommandBuffer command_buffer, bool transfer_queue, const char *label);
+void VulkanQuery_EndTimer(VkCommandBuffer command_buffer, u32 timer);
+
+/* vertex and fragment shader invocations over the whole draw command
+   buffer; no-ops unless statistics are enabled */
+void VulkanQuery_BeginStatistics(VkCommandBuffer command_buffer);
+void VulkanQuery_EndStatistics(VkCommandBuffer command_buffer);
+
+/* returns false if the device lacks pipelineStatisticsQuery */
+bool VulkanQuery_SetStatisticsEnabled(bool enabled);
+bool VulkanQuery_StatisticsSupported();
+
+const gpu_frame_timings_t *VulkanQuery_GetTimings();
+
+#endif
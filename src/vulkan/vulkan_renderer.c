@@ -3,7 +3,9 @@
 
 #include "core.h"
 #include "log.h"
+#include "os_time.h"
 #include "platform_vulkan.h"
+#include "profiler.h"
 
 #include "vulkan_context.h"
 #include "vulkan_renderer.h"
@@ -11,8 +13,12 @@
 #include "vulkan_buffer.h"
 #include "vulkan_image.h"
 #include "vulkan_pass.h"
+#include "vulkan_pipeline.h"
+#include "vulkan_query.h"
 #include "vulkan_texture.h"
 
+#include "xxh3.h"
+
 #define APPLICATION_NAME    "todo"
 #define APPLICATION_VERSION VK_MAKE_VERSION(0, 0, 1)
 #define ENGINE_NAME         "dcfs"
@@ -48,15 +54,24 @@ struct _queue_families_t
     VkQueue present_queue;
 };
 
+/* one timeline semaphore orders everything the renderer submits: the
+   transfer submit waits on the previous graphics submit and signals a value
+   the next graphics submit waits on, so values complete in submission order
+   even on a separate transfer queue. each graphics submit signals the value
+   its frame slot waits for before reuse. acquire and present still need
+   binary semaphores */
 typedef struct _frame_sync_t frame_sync_t;
 struct _frame_sync_t
 {
     VkSemaphore image_available_semaphores[MAX_FRAMES_IN_FLIGHT];
-    VkSemaphore transfer_finished_semaphores[MAX_FRAMES_IN_FLIGHT];
     VkSemaphore render_finished_semaphores[MAX_FRAMES_IN_FLIGHT];
-    VkFence     inflight_fences[MAX_FRAMES_IN_FLIGHT];
+
+    VkSemaphore timeline;
+    u64         timeline_value;                     /* last value submitted */
+    u64         frame_values[MAX_FRAMES_IN_FLIGHT]; /* per slot, 0 = never used */
 
     u32 inflight_counter;
+    u32 frames_in_flight;
 };
 
 struct _vk_renderer_t
@@ -68,6 +83,7 @@ struct _vk_renderer_t
     // data
     VkInstance         instance;
     VkSurfaceKHR       surface;
+    bool               headless;                /* no surface: offscreen images, no acquire or present */
     VkExtent2D         window_extent;
     VkCommandPool      command_pool;
     VkCommandPool      transfer_command_pool;
@@ -77,12 +93,20 @@ struct _vk_renderer_t
     queue_families_t   queue_families;
     swapchain_t        swapchain;
     frame_sync_t       frame_sync;
+    u32                last_image_index;        /* rendered by the last submitted frame */
+
+    present_mode_t     requested_present_mode;
+    present_mode_t     present_mode;            /* in use, after fallback */
+
+    render_timings_t   timings;                 /* since the last TakeTimings */
 };
 
 
 static vk_renderer_t *s_renderer;
 
-static bool create_swapchain(bool vsync);
+static bool create_swapchain();
+static bool create_offscreen_images();
+static VkPresentModeKHR choose_present_mode(present_mode_t requested, present_mode_t *chosen_out);
 static void destroy_swapchain();
 static bool recreate_swapchain();
 static void recover_failed_frame();
@@ -98,10 +122,13 @@ static bool create_logical_device();
 // Sync
 static VkSemaphore  sync_image_available_semaphore();
 static VkSemaphore  sync_render_finished_semaphore(u32 image_index);
-static VkSemaphore  sync_transfer_finished_semaphore(u32 image_index);
-static VkFence      sync_inflight_fence();
+static bool         sync_wait_frame_slot();
+static u64          sync_completed_value();
 static void         sync_step();
 
+static VkResult     queue_submit(VkQueue queue, const VkSubmitInfo *submit_info);
+static VkResult     queue_present(const VkPresentInfoKHR *present_info);
+
 static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(
     VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
     VkDebugUtilsMessageTypeFlagsEXT messageType,
@@ -127,7 +154,10 @@ bool VulkanRenderer_Init(arena_t *arena, platform_window_t *window)
         goto fail;
     if (!create_logical_device())
         goto fail;
-    if (!create_swapchain(false))
+    s_renderer->requested_present_mode = PRESENT_MODE_IMMEDIATE;
+    s_renderer->frame_sync.frames_in_flight = MAX_FRAMES_IN_FLIGHT;
+
+    if (!create_swapchain())
         goto fail;
     if (!create_sync_objects())
         goto fail;
@@ -138,6 +168,12 @@ bool VulkanRenderer_Init(arena_t *arena, platform_window_t *window)
         goto fail;
     if (!VulkanTexture_Init())
         goto fail;
+    if (!VulkanQuery_Init(s_renderer->queue_families.graphics_family_index,
+                          s_renderer->queue_families.transfer_family_index))
+        goto fail;
+    /* the shared pipeline layout includes the texture set layout */
+    if (!VulkanPipeline_Init(s_renderer->global_arena))
+        goto fail;
     if (!VulkanPass_CreateSwapchainPass(s_renderer->global_arena, &s_renderer->swapchain))
         goto fail;
 
@@ -164,16 +200,19 @@ bool VulkanRenderer_Destroy()
         destroy_sync_objects();
 
         VulkanPass_Destroy();
+        VulkanPipeline_Destroy();
 
         destroy_swapchain();
 
         VulkanBuffer_Destroy();
         VulkanTexture_Destroy();
+        VulkanQuery_Destroy();
 
         vkDestroyCommandPool(g_device, s_renderer->command_pool, NULL);
         vkDestroyCommandPool(g_device, s_renderer->transfer_command_pool, NULL);
         vkDestroyDevice(g_device, NULL);
-        vkDestroySurfaceKHR(s_renderer->instance, s_renderer->surface, NULL);
+        if (s_renderer->surface)
+            vkDestroySurfaceKHR(s_renderer->instance, s_renderer->surface, NULL);
         vkDestroyInstance(s_renderer->instance, NULL);
 
         MemoryArena_Print(s_renderer->frame_arena);
@@ -203,121 +242,193 @@ void VulkanRenderer_BeginFrame()
 
 bool VulkanRenderer_EndFrame()
 {
-    VkFence inflight_fence = sync_inflight_fence();
-    VkSemaphore signal_semaphore;
+    ProfileZone("VulkanRenderer_EndFrame");
+    frame_sync_t *sync = &s_renderer->frame_sync;
+    u64 start_ns = OS_TimeNowNs();
 
-    if (vkWaitForFences(g_device, 1, &inflight_fence, VK_TRUE, U64_MAX) != VK_SUCCESS)
-    {
-        Log(ERROR, "failed to wait for inflight fence");
+    if (!sync_wait_frame_slot())
         return false;
-    }
 
     u32 image_index;
-    VkResult result = vkAcquireNextImageKHR(g_device, s_renderer->swapchain.handle,
-                                            U64_MAX, sync_image_available_semaphore(),
-                                            VK_NULL_HANDLE, &image_index);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR)
+    VkResult result;
+    if (s_renderer->headless)
     {
-        /* skip this frame; the inflight fence was not reset so the next
-           frame's wait passes right through */
-        recreate_swapchain();
-        return false;
+        /* one offscreen image per slot, freed by the slot wait above */
+        image_index = sync->inflight_counter;
     }
-    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+    else
     {
-        Log(ERROR, "failed to acquire swapchain image");
-        return false;
+        result = vkAcquireNextImageKHR(g_device, s_renderer->swapchain.handle, U64_MAX,
+                                       sync_image_available_semaphore(), VK_NULL_HANDLE,
+                                       &image_index);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            /* skip this frame; nothing was submitted so the slot stays free */
+            recreate_swapchain();
+            return false;
+        }
+        if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+        {
+            Log(ERROR, "failed to acquire swapchain image");
+            return false;
+        }
     }
+    u64 acquired_ns = OS_TimeNowNs();
+
+    /* the slot's previous frame is complete, so its queries can be read */
+    VulkanQuery_BeginFrame(sync->inflight_counter);
 
     VkCommandBuffer transfer_command_buffer =
-        s_renderer->transfer_command_buffers[s_renderer->frame_sync.inflight_counter];
+        s_renderer->transfer_command_buffers[sync->inflight_counter];
     VkCommandBuffer draw_command_buffer =
-        s_renderer->draw_command_buffers[s_renderer->frame_sync.inflight_counter];
+        s_renderer->draw_command_buffers[sync->inflight_counter];
 
-    bool transfer_required = VulkanBuffer_BakeCommandBuffer(transfer_command_buffer, image_index);
+    u64 completed_value = sync_completed_value();
+    bool transfer_required = VulkanBuffer_BakeCommandBuffer(transfer_command_buffer, image_index,
+                                                            sync->timeline_value, completed_value);
 
     if (!VulkanPass_BakeCommandBuffer(draw_command_buffer, image_index))
     {
         Log(ERROR, "failed to bake draw command buffer");
         goto error;
     }
+    u64 baked_ns = OS_TimeNowNs();
+    VulkanQuery_MarkSubmit(baked_ns);
 
+    u64 transfer_value = 0;
     if (transfer_required)
     {
-        signal_semaphore = sync_transfer_finished_semaphore(image_index);
+        /* without the wait, a transfer queue running ahead could signal past
+           a graphics value that is still pending, and the frame it belongs
+           to would read as complete */
+        u64 previous_value = sync->timeline_value;
+        VkPipelineStageFlags transfer_wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        transfer_value = sync->timeline_value + 1;
+
+        VkTimelineSemaphoreSubmitInfo transfer_timeline_info = {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .waitSemaphoreValueCount = 1,
+            .pWaitSemaphoreValues = &previous_value,
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &transfer_value,
+        };
 
         VkSubmitInfo transfer_submit_info = {
             .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = &transfer_timeline_info,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &sync->timeline,
+            .pWaitDstStageMask = &transfer_wait_stage,
             .commandBufferCount = 1,
             .pCommandBuffers = &transfer_command_buffer,
             .signalSemaphoreCount = 1,
-            .pSignalSemaphores = &signal_semaphore,
+            .pSignalSemaphores = &sync->timeline,
         };
 
-        if (vkQueueSubmit(s_renderer->queue_families.transfer_queue, 1, &transfer_submit_info, VK_NULL_HANDLE) !=
-            VK_SUCCESS)
+        if (queue_submit(s_renderer->queue_families.transfer_queue, &transfer_submit_info) != VK_SUCCESS)
         {
             Log(ERROR, "failed to submit transfer command buffer");
             goto error;
         }
-    }
 
-    vkResetFences(g_device, 1, &inflight_fence);
+        sync->timeline_value = transfer_value;
+    }
 
+    /* binary semaphores ignore their entry in the value arrays */
     VkSemaphore wait_semaphores[2];
+    u64 wait_values[2];
     VkPipelineStageFlags wait_stages[2];
     u8 semaphore_count = 0;
 
     if (transfer_required)
     {
-        wait_semaphores[semaphore_count] = sync_transfer_finished_semaphore(image_index);
+        wait_semaphores[semaphore_count] = sync->timeline;
+        wait_values[semaphore_count] = transfer_value;
         wait_stages[semaphore_count++] = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
     }
-    wait_semaphores[semaphore_count] = sync_image_available_semaphore();
-    wait_stages[semaphore_count++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    if (!s_renderer->headless)
+    {
+        wait_semaphores[semaphore_count] = sync_image_available_semaphore();
+        wait_values[semaphore_count] = 0;
+        wait_stages[semaphore_count++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    }
 
-    signal_semaphore = sync_render_finished_semaphore(image_index);
+    u64 frame_value = sync->timeline_value + 1;
+    VkSemaphore signal_semaphores[] = {
+        sync->timeline,
+        sync_render_finished_semaphore(image_index),
+    };
+    u64 signal_values[] = {
+        frame_value,
+        0,
+    };
+    /* nothing presents a headless frame, so only the timeline is signaled */
+    u32 signal_count = s_renderer->headless ? 1 : ArrayCount(signal_semaphores);
+
+    VkTimelineSemaphoreSubmitInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = semaphore_count,
+        .pWaitSemaphoreValues = wait_values,
+        .signalSemaphoreValueCount = signal_count,
+        .pSignalSemaphoreValues = signal_values,
+    };
 
     VkSubmitInfo submit_info = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timeline_info,
         .waitSemaphoreCount = semaphore_count,
         .pWaitSemaphores = wait_semaphores,
         .pWaitDstStageMask = wait_stages,
         .commandBufferCount = 1,
         .pCommandBuffers = &draw_command_buffer,
-        .signalSemaphoreCount = 1,
-        .pSignalSemaphores = &signal_semaphore,
+        .signalSemaphoreCount = signal_count,
+        .pSignalSemaphores = signal_semaphores,
     };
 
-    if (vkQueueSubmit(s_renderer->queue_families.graphics_queue, 1, &submit_info,
-                      inflight_fence) != VK_SUCCESS)
+    if (queue_submit(s_renderer->queue_families.graphics_queue, &submit_info) != VK_SUCCESS)
     {
         Log(ERROR, "failed to submit draw command buffer");
         goto error;
     }
 
-    VkPresentInfoKHR present_info = {
-        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &signal_semaphore,
-        .swapchainCount = 1,
-        .pSwapchains = &s_renderer->swapchain.handle,
-        .pImageIndices = &image_index,
-    };
+    sync->timeline_value = frame_value;
+    sync->frame_values[sync->inflight_counter] = frame_value;
+    VulkanTexture_EndFrame(frame_value, completed_value);
+    s_renderer->last_image_index = image_index;
+    u64 submitted_ns = OS_TimeNowNs();
 
-    result = vkQueuePresentKHR(s_renderer->queue_families.present_queue, &present_info);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+    if (!s_renderer->headless)
     {
-        recreate_swapchain();
-    }
-    else if (result != VK_SUCCESS)
-    {
-        Log(ERROR, "failed to present swapchain image");
-        goto error;
+        VkPresentInfoKHR present_info = {
+            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &signal_semaphores[1],
+            .swapchainCount = 1,
+            .pSwapchains = &s_renderer->swapchain.handle,
+            .pImageIndices = &image_index,
+        };
+
+        result = queue_present(&present_info);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+        {
+            recreate_swapchain();
+        }
+        else if (result != VK_SUCCESS)
+        {
+            Log(ERROR, "failed to present swapchain image");
+            goto error;
+        }
     }
 
     sync_step();
 
+    render_timings_t *timings = &s_renderer->timings;
+    timings->present_wait_ns += (acquired_ns - start_ns) + (OS_TimeNowNs() - submitted_ns);
+    timings->bake_ns += baked_ns - acquired_ns;
+    timings->submit_ns += submitted_ns - baked_ns;
+    if (transfer_required)
+        timings->upload_bytes += VulkanBuffer_GetBakedUploadBytes();
+
     return true;
 error:
     recover_failed_frame();
@@ -329,6 +440,196 @@ void VulkanRenderer_WaitIdle()
     vkDeviceWaitIdle(g_device);
 }
 
+bool VulkanRenderer_WaitFrame()
+{
+    u64 start_ns = OS_TimeNowNs();
+    bool result = sync_wait_frame_slot();
+
+    s_renderer->timings.present_wait_ns += OS_TimeNowNs() - start_ns;
+    return result;
+}
+
+const gpu_frame_timings_t *VulkanRenderer_GetGpuTimings()
+{
+    return VulkanQuery_GetTimings();
+}
+
+bool VulkanRenderer_SetGpuStatistics(bool enabled)
+{
+    return VulkanQuery_SetStatisticsEnabled(enabled);
+}
+
+bool VulkanRenderer_IsHeadless()
+{
+    return s_renderer->headless;
+}
+
+bool VulkanRenderer_ReadbackChecksum(u64 *checksum_out)
+{
+    if (!s_renderer->headless)
+    {
+        Log(ERROR, "frame readback needs the headless renderer");
+        return false;
+    }
+
+    swapchain_t *swapchain = &s_renderer->swapchain;
+    VkImage image = swapchain->images[s_renderer->last_image_index];
+    u64 size = (u64)swapchain->extent.width * swapchain->extent.height * 4;
+
+    VulkanRenderer_WaitIdle();
+
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    if (!VulkanBuffer_CreateReadback(size, &buffer, &memory))
+        return false;
+
+    VkCommandBufferAllocateInfo allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = s_renderer->command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    bool result = false;
+
+    if (vkAllocateCommandBuffers(g_device, &allocate_info, &command_buffer) != VK_SUCCESS)
+    {
+        Log(ERROR, "failed to allocate readback command buffer");
+        goto exit;
+    }
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS)
+    {
+        Log(ERROR, "failed to begin readback command buffer");
+        goto exit;
+    }
+
+    /* the swapchain pass left the image in TRANSFER_SRC; this only makes
+       its color writes visible to the copy */
+    VkImageMemoryBarrier image_barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .layerCount = 1,
+        },
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &image_barrier);
+
+    VkBufferImageCopy region = {
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .layerCount = 1,
+        },
+        .imageExtent = {
+            .width = swapchain->extent.width,
+            .height = swapchain->extent.height,
+            .depth = 1,
+        },
+    };
+    vkCmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1,
+                           &region);
+
+    VkBufferMemoryBarrier host_barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = buffer,
+        .size = VK_WHOLE_SIZE,
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 0, NULL, 1, &host_barrier, 0, NULL);
+
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer,
+    };
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS ||
+        queue_submit(s_renderer->queue_families.graphics_queue, &submit_info) != VK_SUCCESS ||
+        vkQueueWaitIdle(s_renderer->queue_families.graphics_queue) != VK_SUCCESS)
+    {
+        Log(ERROR, "failed to submit frame readback");
+        goto exit;
+    }
+
+    void *mapped;
+    if (vkMapMemory(g_device, memory, 0, size, 0, &mapped) != VK_SUCCESS)
+    {
+        Log(ERROR, "failed to map readback memory");
+        goto exit;
+    }
+    *checksum_out = XXH3_64bits(mapped, size);
+    vkUnmapMemory(g_device, memory);
+
+    result = true;
+
+exit:
+    if (command_buffer != VK_NULL_HANDLE)
+        vkFreeCommandBuffers(g_device, s_renderer->command_pool, 1, &command_buffer);
+    vkDestroyBuffer(g_device, buffer, NULL);
+    vkFreeMemory(g_device, memory, NULL);
+
+    return result;
+}
+
+render_timings_t VulkanRenderer_TakeTimings()
+{
+    render_timings_t timings = s_renderer->timings;
+    MemoryZeroItem(&s_renderer->timings);
+
+    return timings;
+}
+
+present_mode_t VulkanRenderer_SetPresentMode(present_mode_t mode)
+{
+    s_renderer->requested_present_mode = mode;
+
+    if (!recreate_swapchain())
+        Log(ERROR, "failed to recreate swapchain for present mode %u", mode);
+
+    return s_renderer->present_mode;
+}
+
+u32 VulkanRenderer_SetFramesInFlight(u32 frames_in_flight)
+{
+    frame_sync_t *sync = &s_renderer->frame_sync;
+
+    if (frames_in_flight < 1 || frames_in_flight > MAX_FRAMES_IN_FLIGHT)
+    {
+        Log(WARNING, "%u frames in flight outside [1, %u], clamped", frames_in_flight, MAX_FRAMES_IN_FLIGHT);
+        frames_in_flight = Clamp(1, frames_in_flight, MAX_FRAMES_IN_FLIGHT);
+    }
+    if (frames_in_flight == sync->frames_in_flight)
+        return frames_in_flight;
+
+    /* with the device idle every slot is free, so the slot rotation can
+       restart from 0 without any slot waiting on work it didn't submit */
+    VulkanRenderer_WaitIdle();
+
+    sync->frames_in_flight = frames_in_flight;
+    sync->inflight_counter = 0;
+
+    Log(INFO, "frames in flight: %u", frames_in_flight);
+    return frames_in_flight;
+}
+
 VkExtent2D VulkanRenderer_GetExtent()
 {
     return s_renderer->swapchain.extent;
@@ -349,11 +650,26 @@ VkBuffer VulkanRenderer_CreateStaticVertexBuffer(const void *vertices, u64 size)
     return buffer;
 }
 
-VkBuffer VulkanRenderer_CreateStaticIndexBuffer(const u32 *indices, u32 index_count)
+VkBuffer VulkanRenderer_CreateStaticPullBuffer(const void *vertices, u64 size)
+{
+    VkBuffer buffer = VulkanBuffer_CreateStatic(
+        s_renderer->command_pool, s_renderer->queue_families.graphics_queue, vertices, size,
+        VULKAN_PULL_BUFFER_USAGE);
+
+    return buffer;
+}
+
+bool VulkanRenderer_WriteMeshData(const void *data, u64 size, u32 alignment, u64 *offset_out)
+{
+    return VulkanBuffer_WriteMeshData(s_renderer->command_pool, s_renderer->queue_families.graphics_queue, data,
+                                      size, alignment, offset_out);
+}
+
+VkBuffer VulkanRenderer_CreateStaticIndexBuffer(const void *indices, u64 size)
 {
     VkBuffer buffer = VulkanBuffer_CreateStatic(
         s_renderer->command_pool, s_renderer->queue_families.graphics_queue, (const u8 *)indices,
-        index_count * sizeof(u32), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+        size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
 
     return buffer;
 }
@@ -371,10 +687,9 @@ buffer_object_handle_t VulkanRenderer_CreateStorageBuffer(u64 capacity)
     return VulkanBuffer_CreateObject(s_renderer->global_arena, capacity, BO_STORAGE);
 }
 
-texture_handle_t VulkanRenderer_CreateTexture(u32 width, u32 height, const u8 *rgba_data,
-                                              sampler_handle_t sampler)
+texture_handle_t VulkanRenderer_CreateTexture(const texture_data_t *texture, sampler_handle_t sampler)
 {
-    return VulkanTexture_Create(width, height, rgba_data, sampler);
+    return VulkanTexture_Create(texture, sampler);
 }
 
 texture_handle_t VulkanRenderer_CreateRenderTexture(u32 width, u32 height,
@@ -394,8 +709,11 @@ renderpass_handle_t VulkanRenderer_CreateRenderPass(texture_handle_t target_text
     return VulkanPass_CreateImagePass(s_renderer->global_arena, target_texture, pass_order);
 }
 
-static bool create_swapchain(bool vsync)
+static bool create_swapchain()
 {
+    if (s_renderer->headless)
+        return create_offscreen_images();
+
     VkSurfaceCapabilitiesKHR capabilities;
     VkExtent2D extent;
 
@@ -441,9 +759,8 @@ static bool create_swapchain(bool vsync)
         return false;
     }
 
-    /* choose swapchain present mode */
     VkPresentModeKHR present_mode =
-        vsync ? VK_PRESENT_MODE_FIFO_KHR : VK_PRESENT_MODE_IMMEDIATE_KHR;
+        choose_present_mode(s_renderer->requested_present_mode, &s_renderer->present_mode);
 
     /* verify surface capabilities */
     if (capabilities.currentExtent.height == U32_MAX ||
@@ -528,10 +845,86 @@ static bool create_swapchain(bool vsync)
 
     s_renderer->swapchain.extent = extent;
     s_renderer->swapchain.format = format.format;
+    s_renderer->swapchain.final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     return true;
 }
 
+/* headless stand-in for the swapchain: an image per frame slot at the
+   window extent, in the format a surface would have been asked for */
+static bool create_offscreen_images()
+{
+    swapchain_t *swapchain = &s_renderer->swapchain;
+
+    swapchain->format = VK_FORMAT_B8G8R8A8_SRGB;
+    swapchain->extent = s_renderer->window_extent;
+    swapchain->final_layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    /* nothing is presented, so the mode has no effect */
+    s_renderer->present_mode = s_renderer->requested_present_mode;
+
+    for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        if (!VulkanImage_CreateOffscreenTarget(swapchain->extent, swapchain->format,
+                                               &swapchain->images[i], &swapchain->image_memory[i]) ||
+            !VulkanImage_CreateView(swapchain->images[i], swapchain->format,
+                                    VK_IMAGE_ASPECT_COLOR_BIT, 1, &swapchain->image_views[i]))
+        {
+            Log(ERROR, "failed to create offscreen image");
+            return false;
+        }
+    }
+
+    Log(INFO, "offscreen images [%ux%u]", swapchain->extent.width, swapchain->extent.height);
+    return true;
+}
+
+static VkPresentModeKHR choose_present_mode(present_mode_t requested, present_mode_t *chosen_out)
+{
+    VkPresentModeKHR supported[MAX_PRESENT_MODES];
+    u32 supported_count = MAX_PRESENT_MODES;
+
+    VkResult res = vkGetPhysicalDeviceSurfacePresentModesKHR(g_physical_device, s_renderer->surface,
+                                                             &supported_count, supported);
+    if (res != VK_SUCCESS && res != VK_INCOMPLETE)
+    {
+        Log(WARNING, "failed to get surface present modes, using FIFO");
+        supported_count = 0;
+    }
+
+    static const VkPresentModeKHR vk_modes[] = {
+        [PRESENT_MODE_FIFO] =           VK_PRESENT_MODE_FIFO_KHR,
+        [PRESENT_MODE_FIFO_RELAXED] =   VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+        [PRESENT_MODE_MAILBOX] =        VK_PRESENT_MODE_MAILBOX_KHR,
+        [PRESENT_MODE_IMMEDIATE] =      VK_PRESENT_MODE_IMMEDIATE_KHR,
+    };
+    static const present_mode_t fallback[] = {
+        [PRESENT_MODE_FIFO] =           PRESENT_MODE_FIFO,
+        [PRESENT_MODE_FIFO_RELAXED] =   PRESENT_MODE_FIFO,
+        [PRESENT_MODE_MAILBOX] =        PRESENT_MODE_IMMEDIATE,
+        [PRESENT_MODE_IMMEDIATE] =      PRESENT_MODE_FIFO,
+    };
+
+    /* FIFO is required to be supported, so the walk always ends there */
+    present_mode_t mode = requested;
+    while (mode != PRESENT_MODE_FIFO)
+    {
+        for (u32 i = 0; i < supported_count; i++)
+        {
+            if (supported[i] == vk_modes[mode])
+                goto found;
+        }
+        mode = fallback[mode];
+    }
+
+found:
+    if (mode != requested)
+        Log(INFO, "present mode %u unsupported, falling back to %u", requested, mode);
+
+    *chosen_out = mode;
+    return vk_modes[mode];
+}
+
 static void destroy_swapchain()
 {
     swapchain_t *swapchain = &s_renderer->swapchain;
@@ -539,7 +932,18 @@ static void destroy_swapchain()
     for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         vkDestroyImageView(g_device, swapchain->image_views[i], NULL);
 
-    vkDestroySwapchainKHR(g_device, swapchain->handle, NULL);
+    if (s_renderer->headless)
+    {
+        for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            vkDestroyImage(g_device, swapchain->images[i], NULL);
+            vkFreeMemory(g_device, swapchain->image_memory[i], NULL);
+        }
+    }
+    else
+    {
+        vkDestroySwapchainKHR(g_device, swapchain->handle, NULL);
+    }
 
     MemoryZeroItem(swapchain);
 }
@@ -550,7 +954,7 @@ static bool recreate_swapchain()
 
     destroy_swapchain();
 
-    if (!create_swapchain(false))
+    if (!create_swapchain())
     {
         Log(ERROR, "failed to recreate swapchain");
         return false;
@@ -568,9 +972,18 @@ static void recover_failed_frame()
 
     VulkanRenderer_WaitIdle();
 
-    destroy_sync_objects();
-    if (!create_sync_objects())
-        Log(ERROR, "failed to recreate sync objects during frame recovery");
+    /* the timeline needs no repair (a signal nobody waited on is harmless),
+       but this slot's acquire semaphore may be left signaled with no submit
+       waiting on it, so it is replaced */
+    frame_sync_t *sync = &s_renderer->frame_sync;
+    VkSemaphoreCreateInfo semaphore_create = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+
+    vkDestroySemaphore(g_device, sync->image_available_semaphores[sync->inflight_counter], NULL);
+    if (vkCreateSemaphore(g_device, &semaphore_create, NULL,
+                          &sync->image_available_semaphores[sync->inflight_counter]) != VK_SUCCESS)
+        Log(ERROR, "failed to recreate acquire semaphore during frame recovery");
 
     if (!recreate_swapchain())
         Log(ERROR, "failed to recreate swapchain during frame recovery");
@@ -583,26 +996,36 @@ static bool create_sync_objects()
     VkSemaphoreCreateInfo semaphore_create = {
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
     };
-    VkFenceCreateInfo fence_create = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
-    };
 
     for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
         if (vkCreateSemaphore(g_device, &semaphore_create, NULL,
                               &sync->image_available_semaphores[i]) != VK_SUCCESS ||
             vkCreateSemaphore(g_device, &semaphore_create, NULL,
-                              &sync->transfer_finished_semaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(g_device, &semaphore_create, NULL,
-                              &sync->render_finished_semaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(g_device, &fence_create, NULL,
-                          &sync->inflight_fences[i]) != VK_SUCCESS)
+                              &sync->render_finished_semaphores[i]) != VK_SUCCESS)
         {
             Log(ERROR, "failed to create frame sync objects");
             return false;
         }
+        sync->frame_values[i] = 0;
+    }
+
+    VkSemaphoreTypeCreateInfo timeline_type = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+    VkSemaphoreCreateInfo timeline_create = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &timeline_type,
+    };
+
+    if (vkCreateSemaphore(g_device, &timeline_create, NULL, &sync->timeline) != VK_SUCCESS)
+    {
+        Log(ERROR, "failed to create timeline semaphore");
+        return false;
     }
+    sync->timeline_value = 0;
 
     return true;
 }
@@ -614,10 +1037,9 @@ static void destroy_sync_objects()
     for (u32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
         vkDestroySemaphore(g_device, sync->image_available_semaphores[i], NULL);
-        vkDestroySemaphore(g_device, sync->transfer_finished_semaphores[i], NULL);
         vkDestroySemaphore(g_device, sync->render_finished_semaphores[i], NULL);
-        vkDestroyFence(g_device, sync->inflight_fences[i], NULL);
     }
+    vkDestroySemaphore(g_device, sync->timeline, NULL);
 }
 
 static inline VkSemaphore sync_image_available_semaphore()
@@ -625,25 +1047,63 @@ static inline VkSemaphore sync_image_available_semaphore()
     return s_renderer->frame_sync.image_available_semaphores[s_renderer->frame_sync.inflight_counter];
 }
 
-static inline VkSemaphore sync_transfer_finished_semaphore(u32 image_index)
+static inline VkSemaphore sync_render_finished_semaphore(u32 image_index)
 {
-    return s_renderer->frame_sync.transfer_finished_semaphores[image_index];
+    return s_renderer->frame_sync.render_finished_semaphores[image_index];
 }
 
-static inline VkSemaphore sync_render_finished_semaphore(u32 image_index)
+/* blocks until the GPU is done with the work last submitted from this
+   frame slot, so its command buffers can be re-recorded */
+static bool sync_wait_frame_slot()
 {
-    return s_renderer->frame_sync.render_finished_semaphores[image_index];
+    ProfileZone("sync_wait_frame_slot");
+    frame_sync_t *sync = &s_renderer->frame_sync;
+
+    u64 value = sync->frame_values[sync->inflight_counter];
+    if (value == 0)
+        return true;
+
+    VkSemaphoreWaitInfo wait_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &sync->timeline,
+        .pValues = &value,
+    };
+
+    if (vkWaitSemaphores(g_device, &wait_info, U64_MAX) != VK_SUCCESS)
+    {
+        Log(ERROR, "failed to wait for frame timeline");
+        return false;
+    }
+
+    return true;
+}
+
+static u64 sync_completed_value()
+{
+    u64 value = 0;
+    if (vkGetSemaphoreCounterValue(g_device, s_renderer->frame_sync.timeline, &value) != VK_SUCCESS)
+        Log(ERROR, "failed to read frame timeline value");
+
+    return value;
 }
 
-static inline VkFence sync_inflight_fence()
+static VkResult queue_submit(VkQueue queue, const VkSubmitInfo *submit_info)
 {
-    return s_renderer->frame_sync.inflight_fences[s_renderer->frame_sync.inflight_counter];
+    ProfileZone("vkQueueSubmit");
+    return vkQueueSubmit(queue, 1, submit_info, VK_NULL_HANDLE);
+}
+
+static VkResult queue_present(const VkPresentInfoKHR *present_info)
+{
+    ProfileZone("vkQueuePresentKHR");
+    return vkQueuePresentKHR(s_renderer->queue_families.present_queue, present_info);
 }
 
 static void sync_step()
 {
     s_renderer->frame_sync.inflight_counter =
-        (s_renderer->frame_sync.inflight_counter + 1) % MAX_FRAMES_IN_FLIGHT;
+        (s_renderer->frame_sync.inflight_counter + 1) % s_renderer->frame_sync.frames_in_flight;
 }
 
 static bool create_instance()
@@ -715,6 +1175,8 @@ static bool create_surface(platform_window_t *window)
     if (!Platform_Vulkan_CreateSurface(window, s_renderer->instance, &s_renderer->surface))
         return false;
 
+    s_renderer->headless = s_renderer->surface == VK_NULL_HANDLE;
+
     u32 width, height;
     if (!Platform_GetWindowSize(window, &width, &height))
     {
@@ -723,7 +1185,7 @@ static bool create_surface(platform_window_t *window)
     }
     s_renderer->window_extent = (VkExtent2D){width, height};
 
-    Log(INFO, "Created surface");
+    Log(INFO, s_renderer->headless ? "No surface, rendering headless" : "Created surface");
     return true;
 }
 
@@ -848,7 +1310,7 @@ static bool setup_physical_device()
                 queue_families.compute_queue_index = 0;
             }
         }
-        if (queue_families.present_family_index == U32_MAX)
+        if (queue_families.present_family_index == U32_MAX && !s_renderer->headless)
         {
             VkBool32 present_supported = VK_FALSE;
 
@@ -859,6 +1321,10 @@ static bool setup_physical_device()
         }
     }
 
+    /* headless never presents; the graphics queue stands in */
+    if (s_renderer->headless)
+        queue_families.present_family_index = queue_families.graphics_family_index;
+
     if (queue_families.graphics_family_index == U32_MAX
             || queue_families.transfer_family_index == U32_MAX
             || queue_families.compute_family_index == U32_MAX
@@ -924,13 +1390,25 @@ static bool create_logical_device()
     }
 
     const char *extensions[] = {"VK_KHR_swapchain"};
-    VkPhysicalDeviceFeatures features = {.samplerAnisotropy = true};
+    /* pipeline statistics are optional, see VulkanQuery_SetStatisticsEnabled */
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(g_physical_device, &supported_features);
+
+    /* without bc support the block compressed textures are decoded at load,
+       see VulkanTexture_IsFormatSupported */
+    VkPhysicalDeviceFeatures features = {
+        .samplerAnisotropy = true,
+        .textureCompressionBC = supported_features.textureCompressionBC,
+        .pipelineStatisticsQuery = supported_features.pipelineStatisticsQuery,
+    };
 
     /* texture uploads via vkCopyMemoryToImage: no staging buffer, command
-       buffer or queue submit */
+       buffer or queue submit. pushDescriptor: uniform buffers are pushed
+       into set 1 at bake time instead of living in per-pipeline sets */
     VkPhysicalDeviceVulkan14Features features14 = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_4_FEATURES,
         .hostImageCopy = true,
+        .pushDescriptor = true,
     };
 
     /* rendering without VkRenderPass/VkFramebuffer objects */
@@ -941,9 +1419,11 @@ static bool create_logical_device()
     };
 
     /* bindless textures: one global runtime-sized descriptor array that
-       stays bound while texture slots are written at load time.
+       stays bound while texture slots are written as textures load.
        bufferDeviceAddress: storage buffers referenced by a 64-bit address in
-       the push constant instead of descriptors */
+       the push constant instead of descriptors. timelineSemaphore: frame
+       sync, see frame_sync_t. hostQueryReset: gpu timer pools are reset
+       without a command buffer */
     VkPhysicalDeviceVulkan12Features features12 = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
         .pNext = &features13,
@@ -952,6 +1432,8 @@ static bool create_logical_device()
         .descriptorBindingPartiallyBound = true,
         .runtimeDescriptorArray = true,
         .bufferDeviceAddress = true,
+        .timelineSemaphore = true,
+        .hostQueryReset = true,
     };
 
     VkDeviceCreateInfo device_create = {
@@ -960,7 +1442,7 @@ static bool create_logical_device()
         .pQueueCreateInfos = queue_creates,
         .queueCreateInfoCount = queue_create_count,
         .ppEnabledExtensionNames = extensions,
-        .enabledExtensionCount = ArrayCount(extensions),
+        .enabledExtensionCount = s_renderer->headless ? 0 : ArrayCount(extensions),
         .pEnabledFeatures = &features,
     };
 
@@ -21,19 +21,52 @@ void VulkanRenderer_BeginFrame();
 bool VulkanRenderer_EndFrame();
 void VulkanRenderer_WaitIdle();
 
+/* blocks until the gpu has finished the work last submitted from the next
+   frame slot; EndFrame does this anyway, calling it earlier lets input be
+   polled after the wait instead of before it */
+bool VulkanRenderer_WaitFrame();
+
+/* returns the cpu time accumulated since the previous call and resets it */
+render_timings_t VulkanRenderer_TakeTimings();
+
+bool VulkanRenderer_IsHeadless();
+
+/* headless only: waits for the device to go idle, then hashes the pixels of
+   the last submitted frame */
+bool VulkanRenderer_ReadbackChecksum(u64 *checksum_out);
+
+/* gpu timers of the most recent frame whose results are in, typically
+   frames_in_flight frames old */
+const gpu_frame_timings_t *VulkanRenderer_GetGpuTimings();
+bool VulkanRenderer_SetGpuStatistics(bool enabled);
+
+/* recreates the swapchain; returns the mode actually in use */
+present_mode_t VulkanRenderer_SetPresentMode(present_mode_t mode);
+
+/* how many of the MAX_FRAMES_IN_FLIGHT frame slots the cpu rotates through.
+   every slot's command buffers, semaphores and queries stay allocated, as do
+   the swapchain images, so this only bounds how far the cpu records ahead.
+   values outside [1, MAX_FRAMES_IN_FLIGHT] are clamped; returns the count in
+   use. waits for the device to go idle */
+u32 VulkanRenderer_SetFramesInFlight(u32 frames_in_flight);
+
 VkExtent2D VulkanRenderer_GetExtent();
 
 pipeline_handle_t VulkanRenderer_AddPipeline(renderpass_handle_t pass_handle,
                                              const pipeline_config_t *config);
 
 VkBuffer VulkanRenderer_CreateStaticVertexBuffer(const void *vertices, u64 size);
-VkBuffer VulkanRenderer_CreateStaticIndexBuffer(const u32 *indices, u32 index_count);
+VkBuffer VulkanRenderer_CreateStaticIndexBuffer(const void *indices, u64 size);
+/* a vertex buffer that is also a storage buffer with a device address */
+VkBuffer VulkanRenderer_CreateStaticPullBuffer(const void *vertices, u64 size);
+
+/* see VulkanBuffer_WriteMeshData */
+bool VulkanRenderer_WriteMeshData(const void *data, u64 size, u32 alignment, u64 *offset_out);
 
 buffer_object_handle_t VulkanRenderer_CreateUniformBuffer(u64 size, uniform_stage_t stage);
 buffer_object_handle_t VulkanRenderer_CreateStorageBuffer(u64 capacity);
 
-texture_handle_t VulkanRenderer_CreateTexture(u32 width, u32 height, const u8 *rgba_data,
-                                              sampler_handle_t sampler);
+texture_handle_t VulkanRenderer_CreateTexture(const texture_data_t *texture, sampler_handle_t sampler);
 texture_handle_t VulkanRenderer_CreateRenderTexture(u32 width, u32 height,
                                                     sampler_handle_t sampler);
 sampler_handle_t VulkanRenderer_CreateSampler();
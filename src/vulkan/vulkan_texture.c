@@ -7,11 +7,27 @@
 #include "vulkan_image.h"
 #include "vulkan_texture.h"
 
-#define MAX_TEXTURES 1024
 #define MAX_SAMPLERS 16
 
+/* descriptor array elements: one per texture, and as many again for the
+   ones a refill leaves behind until the frames that sampled them are done.
+   element 0 is never written */
+#define MAX_TEXTURE_SLOTS (MAX_TEXTURES * 2)
+
+/* retired between frames: stamped with the value of the next frame
+   submitted, as every frame up to it may still sample the slot */
+#define RETIRE_AT_NEXT_SUBMIT U64_MAX
+
 #define BINDLESS_TEXTURE_BINDING 0
 
+static const VkFormat s_formats[TEXTURE_FORMAT_COUNT] = {
+    [TEXTURE_FORMAT_RGBA8_SRGB] = VK_FORMAT_R8G8B8A8_SRGB,
+    [TEXTURE_FORMAT_R8] = VK_FORMAT_R8_UNORM,
+    [TEXTURE_FORMAT_BC1_SRGB] = VK_FORMAT_BC1_RGBA_SRGB_BLOCK,
+    [TEXTURE_FORMAT_BC4] = VK_FORMAT_BC4_UNORM_BLOCK,
+    [TEXTURE_FORMAT_BC7_SRGB] = VK_FORMAT_BC7_SRGB_BLOCK,
+};
+
 typedef struct _texture_t texture_t;
 struct _texture_t
 {
@@ -21,7 +37,25 @@ struct _texture_t
 
     u32             width;
     u32             height;
+    u32             mip_levels;
     VkFormat        format;
+
+    /* as written to the descriptor */
+    VkImageLayout   layout;
+    sampler_handle_t sampler;
+    u32             slot;
+};
+
+/* a descriptor element and the image it was written with, both free once
+   the frame timeline reaches timeline_value */
+typedef struct _retired_slot_t retired_slot_t;
+struct _retired_slot_t
+{
+    u32             slot;
+    VkImage         image;
+    VkImageView     image_view;
+    VkDeviceMemory  image_memory;
+    u64             timeline_value;
 };
 
 typedef struct _textures_t textures_t;
@@ -33,12 +67,22 @@ struct _textures_t
     VkSampler   samplers[MAX_SAMPLERS];
     u32         sampler_count;
 
-    /* one global runtime-sized descriptor array; a texture's handle is its
-       element index. handles are 1-based (0 = invalid) so element 0 is
-       never written, which the partially-bound binding allows */
+    bool        format_supported[TEXTURE_FORMAT_COUNT];
+
+    /* one global runtime-sized descriptor array. a texture samples from its
+       slot, the element its handle maps to; elements are never rewritten
+       while frames in flight may sample them, so a refill writes a fresh
+       slot and retires the old one. the partially-bound binding allows the
+       elements never written */
     VkDescriptorSetLayout   descriptor_set_layout;
     VkDescriptorPool        descriptor_pool;
     VkDescriptorSet         descriptor_set;
+
+    u32             slot_count;     /* elements handed out so far, from 1 */
+    u32             free_slots[MAX_TEXTURE_SLOTS];
+    u32             free_slot_count;
+    retired_slot_t  retired[MAX_TEXTURES];
+    u32             retired_count;
 };
 
 static textures_t s_textures = {};
@@ -46,6 +90,10 @@ static textures_t s_textures = {};
 static texture_t *get_texture(texture_handle_t handle);
 static texture_handle_t register_texture(texture_t *texture, VkImageLayout layout,
                                          sampler_handle_t sampler);
+static bool take_slot(u32 *slot_out);
+static void write_descriptor(u32 slot, VkImageView image_view, VkImageLayout layout, sampler_handle_t sampler);
+static bool create_view(VkImage image, VkFormat format, u32 mip_levels, VkImageView *view_out);
+static void query_formats();
 
 
 bool VulkanTexture_Init()
@@ -62,7 +110,7 @@ bool VulkanTexture_Init()
     VkDescriptorSetLayoutBinding layout_binding = {
         .binding = BINDLESS_TEXTURE_BINDING,
         .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .descriptorCount = MAX_TEXTURES,
+        .descriptorCount = MAX_TEXTURE_SLOTS,
         .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
     };
 
@@ -83,7 +131,7 @@ bool VulkanTexture_Init()
 
     VkDescriptorPoolSize pool_size = {
         .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-        .descriptorCount = MAX_TEXTURES,
+        .descriptorCount = MAX_TEXTURE_SLOTS,
     };
 
     VkDescriptorPoolCreateInfo pool_create_info = {
@@ -115,7 +163,10 @@ bool VulkanTexture_Init()
         return false;
     }
 
-    Log(INFO, "Created bindless texture descriptor set [%u slots]", MAX_TEXTURES);
+    Log(INFO, "Created bindless texture descriptor set [%u slots]", MAX_TEXTURE_SLOTS);
+
+    VulkanImage_Init();
+    query_formats();
 
     return true;
 }
@@ -131,6 +182,15 @@ void VulkanTexture_Destroy()
         vkFreeMemory(g_device, texture->image_memory, NULL);
     }
 
+    for (u32 i = 0; i < s_textures.retired_count; i++)
+    {
+        retired_slot_t *retired = &s_textures.retired[i];
+
+        vkDestroyImageView(g_device, retired->image_view, NULL);
+        vkDestroyImage(g_device, retired->image, NULL);
+        vkFreeMemory(g_device, retired->image_memory, NULL);
+    }
+
     for (u32 i = 0; i < s_textures.sampler_count; i++)
         vkDestroySampler(g_device, s_textures.samplers[i], NULL);
 
@@ -142,18 +202,20 @@ void VulkanTexture_Destroy()
     MemoryZeroItem(&s_textures);
 }
 
-texture_handle_t VulkanTexture_Create(u32 width, u32 height, const u8 *rgba_data,
-                                      sampler_handle_t sampler)
+texture_handle_t VulkanTexture_Create(const texture_data_t *data, sampler_handle_t sampler)
 {
+    Assert(s_textures.format_supported[data->format]);
+
     texture_t texture = {
-        .width = width,
-        .height = height,
-        .format = VK_FORMAT_R8G8B8A8_SRGB,
+        .width = data->width,
+        .height = data->height,
+        .mip_levels = data->level_count,
+        .format = s_formats[data->format],
     };
 
     VkImageLayout layout;
-    if (!VulkanImage_CreateStatic(width, height, rgba_data, &texture.image,
-                                  &texture.image_memory, &layout))
+    if (!VulkanImage_CreateStatic(texture.format, data->width, data->height, data->level_count, data->levels,
+                                  &texture.image, &texture.image_memory, &layout))
     {
         Log(ERROR, "failed to create texture image");
         return TEXTURE_HANDLE_INVALID;
@@ -167,6 +229,7 @@ texture_handle_t VulkanTexture_CreateRenderTarget(u32 width, u32 height, sampler
     texture_t texture = {
         .width = width,
         .height = height,
+        .mip_levels = 1,
         .format = VK_FORMAT_R8G8B8A8_SRGB,
     };
 
@@ -181,6 +244,133 @@ texture_handle_t VulkanTexture_CreateRenderTarget(u32 width, u32 height, sampler
     return register_texture(&texture, layout, sampler);
 }
 
+texture_handle_t VulkanTexture_CreatePending(texture_handle_t placeholder, sampler_handle_t sampler)
+{
+    texture_t *source = get_texture(placeholder);
+
+    if (s_textures.texture_count >= MAX_TEXTURES)
+    {
+        Log(ERROR, "maximum number of textures reached");
+        return TEXTURE_HANDLE_INVALID;
+    }
+    if (sampler == SAMPLER_HANDLE_INVALID || sampler > s_textures.sampler_count)
+    {
+        Log(ERROR, "invalid sampler handle %u", sampler);
+        return TEXTURE_HANDLE_INVALID;
+    }
+
+    u32 slot;
+    if (!take_slot(&slot))
+        return TEXTURE_HANDLE_INVALID;
+
+    /* no image of its own yet; destroying the null handles is a no-op */
+    s_textures.textures[s_textures.texture_count++] = (texture_t){
+        .width = source->width,
+        .height = source->height,
+        .mip_levels = source->mip_levels,
+        .format = source->format,
+        .layout = source->layout,
+        .sampler = sampler,
+        .slot = slot,
+    };
+    texture_handle_t handle = (texture_handle_t)s_textures.texture_count; /* 1-based */
+
+    write_descriptor(slot, source->image_view, source->layout, sampler);
+
+    return handle;
+}
+
+bool VulkanTexture_Upload(const texture_data_t *texture, texture_upload_t *upload_out)
+{
+    Assert(s_textures.format_supported[texture->format]);
+
+    upload_out->format = s_formats[texture->format];
+    upload_out->width = texture->width;
+    upload_out->height = texture->height;
+    upload_out->mip_levels = texture->level_count;
+
+    return VulkanImage_CreateStatic(upload_out->format, texture->width, texture->height, texture->level_count,
+                                    texture->levels, &upload_out->image, &upload_out->memory, &upload_out->layout);
+}
+
+bool VulkanTexture_Fill(texture_handle_t handle, const texture_upload_t *upload)
+{
+    texture_t *texture = get_texture(handle);
+
+    /* out of slots only if textures are refilled faster than frames
+       complete */
+    u32 slot;
+    if (s_textures.retired_count >= MAX_TEXTURES || !take_slot(&slot))
+    {
+        Log(ERROR, "no free texture slot to fill texture %u", handle);
+        vkDestroyImage(g_device, upload->image, NULL);
+        vkFreeMemory(g_device, upload->memory, NULL);
+        return false;
+    }
+
+    VkImageView image_view;
+    if (!create_view(upload->image, upload->format, upload->mip_levels, &image_view))
+    {
+        Log(ERROR, "failed to create texture image view");
+        s_textures.free_slots[s_textures.free_slot_count++] = slot;
+        vkDestroyImage(g_device, upload->image, NULL);
+        vkFreeMemory(g_device, upload->memory, NULL);
+        return false;
+    }
+
+    /* frames already recorded may still sample the old slot, so the new image
+       goes into a fresh one; the old slot and image (none for a pending
+       texture) are kept until those frames are done */
+    s_textures.retired[s_textures.retired_count++] = (retired_slot_t){
+        .slot = texture->slot,
+        .image = texture->image,
+        .image_view = texture->image_view,
+        .image_memory = texture->image_memory,
+        .timeline_value = RETIRE_AT_NEXT_SUBMIT,
+    };
+
+    texture->slot = slot;
+    texture->image = upload->image;
+    texture->image_memory = upload->memory;
+    texture->image_view = image_view;
+    texture->width = upload->width;
+    texture->height = upload->height;
+    texture->mip_levels = upload->mip_levels;
+    texture->format = upload->format;
+    texture->layout = upload->layout;
+
+    write_descriptor(slot, image_view, upload->layout, texture->sampler);
+
+    Log(INFO, "Filled texture %u [%ux%u, %u mips]", handle, texture->width, texture->height,
+        texture->mip_levels);
+
+    return true;
+}
+
+void VulkanTexture_EndFrame(u64 submitted_value, u64 completed_value)
+{
+    u32 kept = 0;
+    for (u32 i = 0; i < s_textures.retired_count; i++)
+    {
+        retired_slot_t *retired = &s_textures.retired[i];
+        if (retired->timeline_value == RETIRE_AT_NEXT_SUBMIT)
+            retired->timeline_value = submitted_value;
+
+        if (completed_value >= retired->timeline_value)
+        {
+            vkDestroyImageView(g_device, retired->image_view, NULL);
+            vkDestroyImage(g_device, retired->image, NULL);
+            vkFreeMemory(g_device, retired->image_memory, NULL);
+            s_textures.free_slots[s_textures.free_slot_count++] = retired->slot;
+        }
+        else
+        {
+            s_textures.retired[kept++] = *retired;
+        }
+    }
+    s_textures.retired_count = kept;
+}
+
 /* creates the view, appends to the registry and writes the texture's slot in
    the global descriptor array; takes ownership of the texture's image */
 static texture_handle_t register_texture(texture_t *texture, VkImageLayout layout,
@@ -196,20 +386,58 @@ static texture_handle_t register_texture(texture_t *texture, VkImageLayout layou
         Log(ERROR, "invalid sampler handle %u", sampler);
         goto fail;
     }
+    if (!take_slot(&texture->slot))
+        goto fail;
 
-    if (!VulkanImage_CreateView(texture->image, texture->format, VK_IMAGE_ASPECT_COLOR_BIT, 1,
-                                &texture->image_view))
+    if (!create_view(texture->image, texture->format, texture->mip_levels, &texture->image_view))
     {
         Log(ERROR, "failed to create texture image view");
+        s_textures.free_slots[s_textures.free_slot_count++] = texture->slot;
         goto fail;
     }
 
+    texture->layout = layout;
+    texture->sampler = sampler;
     s_textures.textures[s_textures.texture_count++] = *texture;
     texture_handle_t handle = (texture_handle_t)s_textures.texture_count; /* 1-based */
 
+    write_descriptor(texture->slot, texture->image_view, layout, sampler);
+
+    Log(INFO, "Created texture %u [%ux%u, %u mips]", handle, texture->width, texture->height,
+        texture->mip_levels);
+
+    return handle;
+
+fail:
+    vkDestroyImage(g_device, texture->image, NULL);
+    vkFreeMemory(g_device, texture->image_memory, NULL);
+    return TEXTURE_HANDLE_INVALID;
+}
+
+/* freed slots first, so the array stays as short as the textures allow */
+static bool take_slot(u32 *slot_out)
+{
+    if (s_textures.free_slot_count > 0)
+    {
+        *slot_out = s_textures.free_slots[--s_textures.free_slot_count];
+        return true;
+    }
+
+    if (s_textures.slot_count + 1 >= MAX_TEXTURE_SLOTS)
+    {
+        Log(ERROR, "maximum number of texture slots reached");
+        return false;
+    }
+
+    *slot_out = ++s_textures.slot_count;
+    return true;
+}
+
+static void write_descriptor(u32 slot, VkImageView image_view, VkImageLayout layout, sampler_handle_t sampler)
+{
     VkDescriptorImageInfo image_info = {
         .sampler = s_textures.samplers[sampler - 1],
-        .imageView = texture->image_view,
+        .imageView = image_view,
         .imageLayout = layout,
     };
 
@@ -217,22 +445,69 @@ static texture_handle_t register_texture(texture_t *texture, VkImageLayout layou
         .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
         .dstSet = s_textures.descriptor_set,
         .dstBinding = BINDLESS_TEXTURE_BINDING,
-        .dstArrayElement = handle,
+        .dstArrayElement = slot,
         .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
         .descriptorCount = 1,
         .pImageInfo = &image_info,
     };
 
     vkUpdateDescriptorSets(g_device, 1, &write, 0, NULL);
+}
 
-    Log(INFO, "Created texture %u [%ux%u]", handle, texture->width, texture->height);
+/* single channel formats read their channel in every component */
+static bool create_view(VkImage image, VkFormat format, u32 mip_levels, VkImageView *view_out)
+{
+    VkComponentMapping components = {};
+    if (format == VK_FORMAT_R8_UNORM || format == VK_FORMAT_BC4_UNORM_BLOCK)
+    {
+        components = (VkComponentMapping){
+            .r = VK_COMPONENT_SWIZZLE_R,
+            .g = VK_COMPONENT_SWIZZLE_R,
+            .b = VK_COMPONENT_SWIZZLE_R,
+            .a = VK_COMPONENT_SWIZZLE_R,
+        };
+    }
 
-    return handle;
+    return VulkanImage_CreateSwizzledView(image, format, VK_IMAGE_ASPECT_COLOR_BIT, mip_levels, components,
+                                          view_out);
+}
 
-fail:
-    vkDestroyImage(g_device, texture->image, NULL);
-    vkFreeMemory(g_device, texture->image_memory, NULL);
-    return TEXTURE_HANDLE_INVALID;
+/* the block compressed formats also need the device feature, which is
+   enabled wherever it is supported */
+static void query_formats()
+{
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(g_physical_device, &features);
+
+    VkFormatFeatureFlags2 required = VK_FORMAT_FEATURE_2_SAMPLED_IMAGE_BIT
+        | VK_FORMAT_FEATURE_2_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_2_HOST_IMAGE_TRANSFER_BIT;
+
+    for (u32 i = 0; i < TEXTURE_FORMAT_COUNT; i++)
+    {
+        VkFormatProperties3 properties3 = {
+            .sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3,
+        };
+        VkFormatProperties2 properties = {
+            .sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2,
+            .pNext = &properties3,
+        };
+        vkGetPhysicalDeviceFormatProperties2(g_physical_device, s_formats[i], &properties);
+
+        bool supported = (properties3.optimalTilingFeatures & required) == required;
+        if (TEXTURE_FORMAT_IS_COMPRESSED(i))
+            supported = supported && features.textureCompressionBC;
+
+        s_textures.format_supported[i] = supported;
+        if (!supported)
+            Log(WARNING, "texture format %u is not supported, textures in it are decoded at load", i);
+    }
+}
+
+bool VulkanTexture_IsFormatSupported(texture_format_t format)
+{
+    Assert(format < TEXTURE_FORMAT_COUNT);
+
+    return s_textures.format_supported[format];
 }
 
 sampler_handle_t VulkanTexture_CreateSampler()
@@ -254,8 +529,9 @@ sampler_handle_t VulkanTexture_CreateSampler()
         .anisotropyEnable = true,
         .maxAnisotropy = 16.0f,
         .compareOp = VK_COMPARE_OP_ALWAYS,
-        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
-        .maxLod = 1.0f,
+        /* trilinear; textures without mips clamp to their one level */
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+        .maxLod = VK_LOD_CLAMP_NONE,
         .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
     };
 
@@ -279,6 +555,11 @@ static texture_t *get_texture(texture_handle_t handle)
     return &s_textures.textures[handle - 1];
 }
 
+u32 VulkanTexture_GetSlot(texture_handle_t handle)
+{
+    return get_texture(handle)->slot;
+}
+
 VkImage VulkanTexture_GetImage(texture_handle_t handle)
 {
     return get_texture(handle)->image;
@@ -10,16 +10,46 @@
 bool VulkanTexture_Init();
 void VulkanTexture_Destroy();
 
-/* rgba_data is copied to the device during the call (width * height * 4
-   bytes); the returned handle is the texture's index in the global
-   descriptor array */
-texture_handle_t VulkanTexture_Create(u32 width, u32 height, const u8 *rgba_data,
-                                      sampler_handle_t sampler);
+/* texture's levels are copied to the device during the call */
+texture_handle_t VulkanTexture_Create(const texture_data_t *texture, sampler_handle_t sampler);
+
+/* whether the device samples format with linear filtering and takes it
+   through host image copy; the block compressed formats need not be */
+bool VulkanTexture_IsFormatSupported(texture_format_t format);
 
 /* a texture an image pass renders into; sampled like any other texture */
 texture_handle_t VulkanTexture_CreateRenderTarget(u32 width, u32 height,
                                                   sampler_handle_t sampler);
 
+/* a texture image uploaded off the main thread, see VulkanTexture_Upload */
+typedef struct
+{
+    VkImage         image;
+    VkDeviceMemory  memory;
+    VkImageLayout   layout;
+    VkFormat        format;
+    u32             width;
+    u32             height;
+    u32             mip_levels;
+} texture_upload_t;
+
+/* async loading: a texture whose slot samples the placeholder's image until
+   VulkanTexture_Fill; the returned handle stays valid throughout */
+texture_handle_t VulkanTexture_CreatePending(texture_handle_t placeholder, sampler_handle_t sampler);
+
+/* safe on any thread: host image copy needs no queue or command buffer */
+bool VulkanTexture_Upload(const texture_data_t *texture, texture_upload_t *upload_out);
+
+/* main thread; takes ownership of the upload's image, also on failure. the
+   image goes into a fresh slot: draws recorded from here on sample it, the
+   ones already recorded keep the old slot and image until
+   VulkanTexture_EndFrame frees them */
+bool VulkanTexture_Fill(texture_handle_t handle, const texture_upload_t *upload);
+
+/* after each frame's submit: the slots retired since the last call wait for
+   submitted_value, those completed_value has reached are freed */
+void VulkanTexture_EndFrame(u64 submitted_value, u64 completed_value);
+
 sampler_handle_t VulkanTexture_CreateSampler();
 
 VkImage     VulkanTexture_GetImage(texture_handle_t handle);
@@ -27,6 +57,10 @@ VkImageView VulkanTexture_GetImageView(texture_handle_t handle);
 VkFormat    VulkanTexture_GetFormat(texture_handle_t handle);
 VkExtent2D  VulkanTexture_GetExtent(texture_handle_t handle);
 
+/* the texture's element in the global bindless array, for the draws recorded
+   now; VulkanTexture_Fill moves it */
+u32 VulkanTexture_GetSlot(texture_handle_t handle);
+
 /* global bindless texture array, set 0 in every pipeline layout */
 VkDescriptorSetLayout VulkanTexture_GetDescriptorSetLayout();
 VkDescriptorSet       VulkanTexture_GetDescriptorSet();
@@ -8,19 +8,37 @@
 
 /* types shared between the vulkan backend modules */
 
+/* swapchain image count and the upper bound of frames the cpu may record
+   ahead of the gpu; the actual frames in flight is set at runtime, see
+   VulkanRenderer_SetFramesInFlight */
 #define MAX_FRAMES_IN_FLIGHT 3
 
+/* renderer-owned fields leading a push constant, see draw_command_t */
+#define MAX_PUSH_CONSTANT_PREFIX 32
+
+/* vertex buffers that vertex shaders also read by device address */
+#define VULKAN_PULL_BUFFER_USAGE (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT           \
+                                  | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT        \
+                                  | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
+
 typedef struct _swapchain_t swapchain_t;
 typedef struct _draw_command_t draw_command_t;
 
 struct _swapchain_t
 {
-    VkSwapchainKHR handle;
+    VkSwapchainKHR handle;          /* null when headless */
 
     VkImage     images[MAX_FRAMES_IN_FLIGHT];
     VkImageView image_views[MAX_FRAMES_IN_FLIGHT];
     VkFormat    format;
     VkExtent2D  extent;
+
+    /* layout the swapchain pass leaves its image in: PRESENT_SRC, or
+       TRANSFER_SRC for the offscreen images of a headless renderer */
+    VkImageLayout final_layout;
+
+    /* headless only: the offscreen images are owned here */
+    VkDeviceMemory image_memory[MAX_FRAMES_IN_FLIGHT];
 };
 
 struct _draw_command_t
@@ -35,10 +53,21 @@ struct _draw_command_t
        push constant at bake time */
     buffer_object_handle_t storage_buffer;
 
+    /* optional (push_prefix_size 0 = none): fields the renderer fills in,
+       pushed over the start of the push constant at bake time before the
+       storage buffer address, e.g. a morph_push_constant_t */
+    u32 push_prefix_size;
+    u8  push_prefix[MAX_PUSH_CONSTANT_PREFIX];
+
     VkBuffer vertex_buffer;
+    u64      vertex_address;    /* pushed for vertex pulling pipelines */
     VkBuffer index_buffer;
+    u32      first_index;
     u32      index_count;
+    index_type_t index_type;
+    u32      first_instance;
     u32      instance_count;
+    u32      vertex_offset;     /* added to every index */
 
     // TODO dynamic buffer draws
 };
@@ -0,0 +1,121 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "core.h"
+#include "file.h"
+#include "memory_arena.h"
+
+#define FILE_COUNT  96
+#define MAX_SIZE    200000
+
+static arena_t *s_arena;
+static char s_paths[FILE_COUNT][64];
+
+/* sizes vary from empty to a few hundred KB, contents depend on the file */
+static u32 file_size(u32 index)
+{
+    return (index * 7919u) % MAX_SIZE;
+}
+
+static u8 file_byte(u32 index, u32 offset)
+{
+    return (u8)((index * 31u + offset) & 0xff);
+}
+
+static void setup(void)
+{
+    s_arena = MemoryArena_Create("file-test");
+
+    for (u32 i = 0; i < FILE_COUNT; i++)
+    {
+        snprintf(s_paths[i], sizeof(s_paths[i]), "file_test_%u.bin", i);
+        FILE *file = fopen(s_paths[i], "wb");
+        cr_assert(file);
+        for (u32 j = 0; j < file_size(i); j++)
+            fputc(file_byte(i, j), file);
+        fclose(file);
+    }
+}
+
+static void teardown(void)
+{
+    for (u32 i = 0; i < FILE_COUNT; i++)
+        remove(s_paths[i]);
+    MemoryArena_Destroy(s_arena);
+}
+
+static bool matches(u32 index, const u8 *data, u64 size)
+{
+    if (size != file_size(index))
+        return false;
+    for (u32 j = 0; j < size; j++)
+    {
+        if (data[j] != file_byte(index, j))
+            return false;
+    }
+    return true;
+}
+
+Test(file, read_and_map_agree, .init = setup, .fini = teardown)
+{
+    for (u32 i = 0; i < FILE_COUNT; i++)
+    {
+        u64 size = 0;
+        u8 *data = File_Read(s_arena, s_paths[i], &size);
+        cr_expect(data && matches(i, data, size), "File_Read %s", s_paths[i]);
+
+        file_map_t map;
+        cr_assert(File_Map(s_paths[i], &map));
+        cr_expect(matches(i, map.data, map.size), "File_Map %s", s_paths[i]);
+        File_Unmap(&map);
+    }
+}
+
+Test(file, batch_reads_every_file, .init = setup, .fini = teardown)
+{
+    file_read_t reads[FILE_COUNT + 1];
+    for (u32 i = 0; i < FILE_COUNT; i++)
+        reads[i] = (file_read_t){.path = s_paths[i]};
+    reads[FILE_COUNT] = (file_read_t){.path = "file_test_missing.bin"};
+
+    file_batch_t *batch = File_BatchBegin(s_arena, reads, ArrayCount(reads));
+    while (!File_BatchPoll(batch))
+        ;
+    cr_expect(File_BatchWait(batch) == FILE_COUNT);
+
+    for (u32 i = 0; i < FILE_COUNT; i++)
+        cr_expect(reads[i].ok && matches(i, reads[i].data, reads[i].size), "batch %s", s_paths[i]);
+    cr_expect(!reads[FILE_COUNT].ok);
+}
+
+Test(file, missing_file_fails)
+{
+    file_map_t map;
+    cr_expect(!File_Map("file_test_missing.bin", &map));
+    cr_expect(map.data == NULL && map.size == 0);
+}
+
+Test(file, write_replaces_whole_file, .init = setup, .fini = teardown)
+{
+    /* rewrites a file with the first half of its own contents under a
+       different pattern, so a leftover tail or stale bytes would show */
+    u32 index = FILE_COUNT - 1;
+    u32 size = file_size(index) / 2;
+    cr_assert(size > 0);
+    u8 *data = arena_push_array_no_zero(s_arena, u8, size);
+    for (u32 j = 0; j < size; j++)
+        data[j] = file_byte(index + 1, j);
+
+    cr_assert(File_Write(s_paths[index], data, size));
+
+    file_map_t map;
+    cr_assert(File_Map(s_paths[index], &map));
+    cr_expect(map.size == size, "size %lu after writing %u", (unsigned long)map.size, size);
+    cr_expect(map.size >= size && memcmp(map.data, data, size) == 0);
+    File_Unmap(&map);
+
+    cr_expect(!File_Write("file_test_missing_dir/file.bin", data, size));
+}
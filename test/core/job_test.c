@@ -0,0 +1,94 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+
+#include <stdatomic.h>
+
+#include "core.h"
+#include "job.h"
+
+#define WORKERS     4
+#define COUNT       100000
+#define FORK_DEPTH  10
+
+static _Atomic u64 s_sum;
+static u8 s_visited[COUNT];
+
+static void add_job(void *data)
+{
+    atomic_fetch_add(&s_sum, (u64)(uintptr_t)data);
+}
+
+static void visit_range(void *data, u32 begin, u32 end)
+{
+    (void)data;
+    for (u32 i = begin; i < end; i++)
+        s_visited[i]++;
+}
+
+/* each level forks two children and joins them */
+static void fork_job(void *data)
+{
+    u32 depth = (u32)(uintptr_t)data;
+    atomic_fetch_add(&s_sum, 1);
+    if (depth == 0)
+        return;
+
+    job_counter_t counter = {};
+    Job_Run(fork_job, (void *)(uintptr_t)(depth - 1), &counter);
+    Job_Run(fork_job, (void *)(uintptr_t)(depth - 1), &counter);
+    Job_Wait(&counter);
+}
+
+static void setup(void)
+{
+    atomic_store(&s_sum, 0);
+    MemoryZeroArray(s_visited);
+    cr_assert(Job_Init(WORKERS));
+}
+
+static void teardown(void)
+{
+    Job_Destroy();
+}
+
+Test(job, counter_waits_for_all, .init = setup, .fini = teardown)
+{
+    job_counter_t counter = {};
+    for (u32 i = 1; i <= COUNT; i++)
+        Job_Run(add_job, (void *)(uintptr_t)i, &counter);
+    Job_Wait(&counter);
+
+    cr_expect(Job_IsDone(&counter));
+    cr_expect(atomic_load(&s_sum) == (u64)COUNT * (COUNT + 1) / 2, "jobs lost or repeated");
+}
+
+Test(job, parallel_for_visits_each_index_once, .init = setup, .fini = teardown)
+{
+    Job_ParallelFor(COUNT, 64, visit_range, NULL);
+
+    for (u32 i = 0; i < COUNT; i++)
+        cr_expect(s_visited[i] == 1, "index %u visited %u times", i, s_visited[i]);
+}
+
+Test(job, nested_fork_join, .init = setup, .fini = teardown)
+{
+    job_counter_t counter = {};
+    Job_Run(fork_job, (void *)(uintptr_t)FORK_DEPTH, &counter);
+    Job_Wait(&counter);
+
+    cr_expect(atomic_load(&s_sum) == (1u << (FORK_DEPTH + 1)) - 1);
+}
+
+Test(job, runs_inline_without_init)
+{
+    atomic_store(&s_sum, 0);
+    MemoryZeroArray(s_visited);
+
+    job_counter_t counter = {};
+    Job_Run(add_job, (void *)(uintptr_t)7, &counter);
+    cr_expect(Job_IsDone(&counter));
+    cr_expect(atomic_load(&s_sum) == 7);
+
+    Job_ParallelFor(COUNT, 1, visit_range, NULL);
+    cr_expect(s_visited[0] == 1 && s_visited[COUNT - 1] == 1);
+}
@@ -0,0 +1,162 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "job.h"
+#include "memory_arena.h"
+#include "mesh.h"
+#include "obj.h"
+
+#define WORKERS         4
+#define RANDOM_COUNT    20000
+/* a bit over a megabyte of obj, so the file is cut into several chunks and
+   the cuts land inside lines */
+#define TRIANGLE_COUNT  15000
+#define VERTEX_COUNT    (TRIANGLE_COUNT * 3)
+
+static arena_t *s_arena;
+
+static void setup(void)
+{
+    s_arena = MemoryArena_CreateP("obj-test", (arena_params_t){
+        .reserve_size = GB(1),
+        .commit_size = MB(4),
+    });
+    cr_assert(Job_Init(WORKERS));
+}
+
+static void teardown(void)
+{
+    Job_Destroy();
+    MemoryArena_Destroy(s_arena);
+}
+
+/* bit for bit, so signed zeros and infinities count too */
+static bool parses_like_strtof(const char *text)
+{
+    f32 parsed;
+    if (!Obj_ParseFloats(text, text + strlen(text), &parsed, 1))
+        return false;
+
+    f32 expected = strtof(text, NULL);
+    return MemoryMatch(&parsed, &expected, sizeof(f32));
+}
+
+/* vertex i sits at (i, (i*i % 1000) / 4, -(i % 7)), exact in f32 and not
+   collinear, so every parsed position can be traced back to its line */
+static u64 write_obj(char *data, u64 capacity, const char *newline)
+{
+    u64 size = 0;
+    size += (u64)snprintf(data + size, capacity - size, "# chunk test%so chunks%s", newline, newline);
+    for (u32 i = 0; i < VERTEX_COUNT; i++)
+        size += (u64)snprintf(data + size, capacity - size, "v %u %.2f -%u%s", i,
+                              (f64)((u64)i * i % 1000) * 0.25, i % 7, newline);
+    for (u32 i = 0; i < TRIANGLE_COUNT; i++)
+        size += (u64)snprintf(data + size, capacity - size, "f %u %u %u%s", i * 3 + 1, i * 3 + 2, i * 3 + 3,
+                              newline);
+    Assert(size < capacity);
+    return size;
+}
+
+static bool check_positions(const obj_mesh_data_t *mesh)
+{
+    if (mesh->layout != OBJ_VERTEX_NORMAL || mesh->vertex_count != VERTEX_COUNT
+        || mesh->lods[0].index_count != TRIANGLE_COUNT * 3)
+        return false;
+
+    u8 *seen = arena_push_array(s_arena, u8, VERTEX_COUNT);
+    const normal_vertex_t *vertices = mesh->vertex_data;
+    for (u32 i = 0; i < mesh->vertex_count; i++)
+    {
+        vec3 position = vertices[i].position;
+        u32 index = (u32)position.X;
+        if ((f32)index != position.X || index >= VERTEX_COUNT || seen[index]++)
+            return false;
+        if (position.Y != (f32)((u64)index * index % 1000) * 0.25f || position.Z != -(f32)(index % 7))
+            return false;
+    }
+    return true;
+}
+
+Test(obj, floats_match_strtof)
+{
+    static const char *const values[] = {
+        /* signs and zeros */
+        "0", "-0", "+0", "0.0", "-0.0", "+1.5", "-1.5", ".5", "-.75", "5.", "007",
+        /* exponents */
+        "1e0", "1e10", "1E-10", "-.75e+2", "2.5e-3", "1e22", "1e-22", "1e23", "1e-23", "4.7e38", "1e39",
+        "-1e39", "1e-50", "1e400", "1e-400", "1e0000000000000001",
+        /* around the float limits, normal and denormal */
+        "3.4028235e38", "3.40282357e38", "-3.4028235e38", "1.17549435e-38", "1.17549421e-38",
+        "1.0e-40", "-2.5e-42", "1.4e-45", "7e-46", "1e-46",
+        /* long mantissas and ties between two floats */
+        "16777216", "16777217", "16777219", "33554435", "9007199254740993", "1.00000005960464477539062500",
+        "0.1000000000000000055511151231257827", "0.333333333333333333333333", "123456789012345678901234567890",
+        "9999999999999999999", "18446744073709551616", "0.00000000000000000000000000000000000000001",
+        /* just above a tie between two floats, but exactly on it once rounded to double */
+        "44.19101905822754", "-60.08145332336426",
+        /* what strtof takes beyond plain decimals */
+        "inf", "-inf", "Infinity",
+    };
+
+    for (u32 i = 0; i < ArrayCount(values); i++)
+        cr_expect(parses_like_strtof(values[i]), "%s", values[i]);
+
+    /* random bit patterns printed the ways exporters write them */
+    u32 state = 1;
+    char text[64];
+    for (u32 i = 0; i < RANDOM_COUNT; i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        f32 value;
+        MemoryCopy(&value, &state, sizeof(value));
+        if (value != value || value - value != 0.0f)
+            continue;
+
+        static const char *const formats[] = {"%.9g", "%.6f", "%.17g", "%.3e"};
+        snprintf(text, sizeof(text), formats[i % ArrayCount(formats)], (f64)value);
+        cr_expect(parses_like_strtof(text), "%s", text);
+    }
+}
+
+Test(obj, floats_stop_at_the_line_end)
+{
+    const char *line = "1.5 -2e3\t.25 7";
+    f32 values[4];
+    cr_expect(Obj_ParseFloats(line, line + strlen(line), values, 3));
+    cr_expect(values[0] == 1.5f && values[1] == -2000.0f && values[2] == 0.25f);
+
+    /* the end cuts the last number short without a terminator */
+    cr_expect(Obj_ParseFloats(line, line + 6, values, 2));
+    cr_expect(values[1] == -2.0f);
+
+    cr_expect(!Obj_ParseFloats(line, line + 3, values, 2));
+    cr_expect(!Obj_ParseFloats("x", "x" + 1, values, 1));
+}
+
+Test(obj, lines_across_chunks, .init = setup, .fini = teardown)
+{
+    u64 capacity = (u64)VERTEX_COUNT * 32 + (u64)TRIANGLE_COUNT * 32 + 64;
+    char *data = arena_push_array_no_zero(s_arena, char, capacity);
+    u64 size = write_obj(data, capacity, "\n");
+
+    obj_mesh_data_t lf;
+    cr_assert(Obj_Parse(s_arena, data, size, "lf", &lf));
+    cr_expect(check_positions(&lf));
+
+    /* crlf, and the last line without a newline */
+    char *crlf_data = arena_push_array_no_zero(s_arena, char, capacity + VERTEX_COUNT + TRIANGLE_COUNT);
+    u64 crlf_size = write_obj(crlf_data, capacity + VERTEX_COUNT + TRIANGLE_COUNT, "\r\n") - 2;
+
+    obj_mesh_data_t crlf;
+    cr_assert(Obj_Parse(s_arena, crlf_data, crlf_size, "crlf", &crlf));
+    cr_expect(check_positions(&crlf));
+    cr_expect(crlf.vertex_data_size == lf.vertex_data_size
+              && MemoryMatch(crlf.vertex_data, lf.vertex_data, lf.vertex_data_size));
+    cr_expect(crlf.index_count == lf.index_count && crlf.index_type == lf.index_type
+              && MemoryMatch(crlf.indices, lf.indices, lf.index_count * (lf.index_type == INDEX_TYPE_U16 ? 2 : 4)));
+}
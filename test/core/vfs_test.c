@@ -0,0 +1,173 @@
+#include <criterion/criterion.h>
+#include <criterion/internal/assert.h>
+
+#include <stdio.h>
+
+#include "core.h"
+#include "lz4.h"
+#include "memory_arena.h"
+#include "os_path.h"
+#include "vfs.h"
+
+#define ARCHIVE_PATH    "vfs_test.pak"
+#define LOOSE_NAME      "vfs_test_loose.txt"
+#define TEXT_SIZE       20000
+
+static arena_t *s_arena;
+static u8 s_text[TEXT_SIZE];
+static char s_loose_path[512];
+
+static void fill_text(void)
+{
+    static const char *const words[] = {"frog ", "jumps ", "over ", "the ", "lazy ", "log "};
+    u64 pos = 0;
+    for (u32 i = 0; pos < TEXT_SIZE; i = i * 7 + 3)
+    {
+        const char *word = words[i % ArrayCount(words)];
+        for (const char *c = word; *c && pos < TEXT_SIZE; c++)
+            s_text[pos++] = (u8)*c;
+    }
+}
+
+/* a stored and a compressed copy of the text, laid out like pack_assets does */
+static void write_archive(void)
+{
+    u64 capacity = Lz4_CompressBound(TEXT_SIZE);
+    u8 *compressed = arena_push_array(s_arena, u8, capacity);
+    u64 compressed_size = Lz4_Compress(s_text, TEXT_SIZE, compressed, capacity);
+    cr_assert(compressed_size > 0 && compressed_size < TEXT_SIZE);
+
+    vfs_archive_entry_t entries[2] = {
+        {
+            .hash = Vfs_HashPath("stored.obj"),
+            .offset = VFS_PAGE_ALIGN,
+            .size = TEXT_SIZE,
+            .raw_size = TEXT_SIZE,
+            .format = VFS_FORMAT_OBJ,
+            .compression = VFS_COMPRESSION_NONE,
+        },
+        {
+            .hash = Vfs_HashPath("compressed.spv"),
+            .offset = AlignPow2(VFS_PAGE_ALIGN + TEXT_SIZE, VFS_DATA_ALIGN),
+            .size = compressed_size,
+            .raw_size = TEXT_SIZE,
+            .format = VFS_FORMAT_SPIRV,
+            .compression = VFS_COMPRESSION_LZ4,
+        },
+    };
+    if (entries[0].hash > entries[1].hash)
+    {
+        vfs_archive_entry_t swap = entries[0];
+        entries[0] = entries[1];
+        entries[1] = swap;
+    }
+
+    vfs_archive_header_t header = {
+        .magic = VFS_ARCHIVE_MAGIC,
+        .version = VFS_ARCHIVE_VERSION,
+        .entry_count = ArrayCount(entries),
+    };
+
+    FILE *file = fopen(ARCHIVE_PATH, "wb");
+    cr_assert(file);
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(entries, sizeof(entries), 1, file);
+    for (u32 i = 0; i < ArrayCount(entries); i++)
+    {
+        fseek(file, (long)entries[i].offset, SEEK_SET);
+        fwrite(entries[i].compression == VFS_COMPRESSION_NONE ? s_text : compressed, entries[i].size, 1, file);
+    }
+    fclose(file);
+}
+
+static void setup(void)
+{
+    s_arena = MemoryArena_Create("vfs-test");
+    fill_text();
+    write_archive();
+
+    snprintf(s_loose_path, sizeof(s_loose_path), "%s%s", OS_GetBasePath(), LOOSE_NAME);
+    FILE *file = fopen(s_loose_path, "wb");
+    cr_assert(file);
+    fwrite(s_text, 1, 100, file);
+    fclose(file);
+}
+
+static void teardown(void)
+{
+    Vfs_Unmount();
+    remove(ARCHIVE_PATH);
+    remove(s_loose_path);
+    MemoryArena_Destroy(s_arena);
+}
+
+Test(lz4, round_trip)
+{
+    static u8 input[70000];
+    static u8 compressed[70000 + 70000 / 255 + 16];
+    static u8 output[70000];
+
+    /* incompressible, highly repetitive, then text with overlapping matches */
+    u32 state = 1;
+    for (u32 i = 0; i < sizeof(input); i++)
+    {
+        state = state * 1664525u + 1013904223u;
+        input[i] = i < 20000 ? (u8)(state >> 24) : i < 40000 ? 'a' : (u8)("abcab"[i % 5]);
+    }
+
+    u64 sizes[] = {0, 1, 12, 13, 100, 20000, 45000, sizeof(input)};
+    for (u32 i = 0; i < ArrayCount(sizes); i++)
+    {
+        u64 size = Lz4_Compress(input, sizes[i], compressed, sizeof(compressed));
+        cr_assert(size > 0, "compress %lu", sizes[i]);
+        cr_expect(Lz4_Decompress(compressed, size, output, sizes[i]), "decompress %lu", sizes[i]);
+        cr_expect(MemoryMatch(input, output, sizes[i]), "round trip %lu", sizes[i]);
+    }
+
+    u64 size = Lz4_Compress(input, sizeof(input), compressed, sizeof(compressed));
+    cr_expect(!Lz4_Decompress(compressed, size - 1, output, sizeof(input)));
+    cr_expect(!Lz4_Decompress(compressed, size, output, sizeof(input) - 1));
+}
+
+Test(vfs, archive_entries, .init = setup, .fini = teardown)
+{
+    cr_assert(Vfs_Mount(ARCHIVE_PATH));
+
+    vfs_file_t file;
+    cr_assert(Vfs_Open(s_arena, "stored.obj", &file));
+    cr_expect(file.size == TEXT_SIZE && file.format == VFS_FORMAT_OBJ);
+    cr_expect(MemoryMatch(file.data, s_text, TEXT_SIZE));
+    Vfs_Close(&file);
+
+    cr_assert(Vfs_Open(s_arena, "compressed.spv", &file));
+    cr_expect(file.size == TEXT_SIZE && file.format == VFS_FORMAT_SPIRV);
+    cr_expect(MemoryMatch(file.data, s_text, TEXT_SIZE));
+    Vfs_Close(&file);
+}
+
+Test(vfs, loose_fallback, .init = setup, .fini = teardown)
+{
+    vfs_file_t file;
+    cr_assert(Vfs_Open(s_arena, LOOSE_NAME, &file));
+    cr_expect(file.size == 100 && MemoryMatch(file.data, s_text, 100));
+    Vfs_Close(&file);
+
+    cr_assert(Vfs_Mount(ARCHIVE_PATH));
+    cr_assert(Vfs_Open(s_arena, LOOSE_NAME, &file));
+    cr_expect(file.size == 100 && file.format == VFS_FORMAT_BLOB);
+    Vfs_Close(&file);
+
+    cr_expect(!Vfs_Open(s_arena, "missing.png", &file));
+}
+
+Test(vfs, rejects_damaged_archive, .init = setup, .fini = teardown)
+{
+    FILE *file = fopen(ARCHIVE_PATH, "r+b");
+    cr_assert(file);
+    u32 entry_count = 1000;
+    fseek(file, offsetof(vfs_archive_header_t, entry_count), SEEK_SET);
+    fwrite(&entry_count, sizeof(entry_count), 1, file);
+    fclose(file);
+
+    cr_expect(!Vfs_Mount(ARCHIVE_PATH));
+}
@@ -1,16 +1,18 @@
 #!/usr/bin/env python3
 """
-.frog model exporter — writes the FROGMODL binary described in src/game/DESIGN.
+.frog model exporter — writes the FROGMODL binary described in src/game/DESIGN,
+version 2 or 3, whichever is smaller (see frog_format.py; tools/frog_upgrade.py
+converts older files).
 
 Run headless:
 
     blender -b mymodel.blend --python-exit-code 1 -P tools/export_frog.py -- \
         resources/models/mymodel.frog [--summary]
 
-Everything written to the file is echoed to stdout prefixed with its byte
-offset, so the output can be checked against the DESIGN layout (and against
-a hexdump) while writing the loader. --summary suppresses only the
-per-triangle position dump; everything else always prints.
+Everything exported is echoed to stdout, and every block of the file and
+every keyframe triangle with its byte offset, so the output can be checked
+against the DESIGN layout (and against a hexdump). --summary suppresses
+only the per-triangle dumps; everything else always prints.
 
 Scene conventions (see DESIGN, "Blender authoring model"):
   - every MESH object in the scene is exported, flattened, sorted by name
@@ -21,14 +23,15 @@ Scene conventions (see DESIGN, "Blender authoring model"):
 """
 
 import math
-import struct
 import sys
+from pathlib import Path
 
 import bpy
 from mathutils import Matrix
 
-MAGIC = b"FROGMODL"
-VERSION = 1
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+import frog_format  # noqa: E402
+
 
 # blender Z-up RH -> engine Y-up RH: (x, y, z) -> (x, z, -y)
 AXES = Matrix(((1, 0, 0, 0),
@@ -70,50 +73,6 @@ def fquat(q):
     return f"({q[0]:+7.4f} {q[1]:+7.4f} {q[2]:+7.4f} {q[3]:+7.4f})"
 
 
-class Writer:
-    def __init__(self, fh):
-        self.fh = fh
-        self.off = 0
-
-    def tell(self):
-        return self.off
-
-    def raw(self, data):
-        self.fh.write(data)
-        self.off += len(data)
-
-    def u8(self, v):
-        if not 0 <= v <= 0xFF:
-            raise ExportError(f"u8 out of range: {v}")
-        self.raw(struct.pack("<B", v))
-
-    def u16(self, v):
-        if not 0 <= v <= 0xFFFF:
-            raise ExportError(f"u16 out of range: {v}")
-        self.raw(struct.pack("<H", v))
-
-    def u32(self, v):
-        if not 0 <= v <= 0xFFFFFFFF:
-            raise ExportError(f"u32 out of range: {v}")
-        self.raw(struct.pack("<I", v))
-
-    def f32(self, v):
-        self.raw(struct.pack("<f", v))
-
-    def vec3(self, v):
-        self.raw(struct.pack("<3f", v[0], v[1], v[2]))
-
-    def quat(self, q):
-        self.raw(struct.pack("<4f", q[0], q[1], q[2], q[3]))
-
-    def string(self, s):
-        data = s.encode("utf-8")
-        if len(data) > 0xFFFF:
-            raise ExportError(f"string too long: {s!r}")
-        self.u16(len(data))
-        self.raw(data)
-
-
 def log(off, text):
     print(f"@0x{off:08x}  {text}")
 
@@ -381,7 +340,7 @@ def export():
     fps = scene.render.fps / scene.render.fps_base
 
     print("=" * 74)
-    print(f" .frog export  (FROGMODL v{VERSION})")
+    print(" .frog export  (FROGMODL)")
     print(f" blend : {bpy.data.filepath or '(unsaved)'}")
     print(f" out   : {out_path}")
     print(f" scene : frames {scene.frame_start}..{scene.frame_end} @ {fps:.2f} fps")
@@ -479,114 +438,88 @@ def export():
     print(f"  total: {triangle_count} triangles, {triangle_count * 3} vertices, "
           f"{len(palette_order)} materials")
 
+    # -- collect -------------------------------------------------------------
+    model = frog_format.Model()
+
+    section("materials")
+    for name in palette_order:
+        index, base, spec, source = palette[name]
+        print(f'  [{index}] "{name}"  base {fvec3(base)}  spec {fvec3(spec)}  ({source})')
+        model.materials.append(frog_format.Material(name, base, spec))
+
+    section("triangle materials")
+    flat = [pi for entry in entries for pi in entry.palette_indices]
+    run_start = 0
+    for i, pi in enumerate(flat):
+        if i + 1 == len(flat) or flat[i + 1] != pi:
+            print(f'  tri {run_start:5d}..{i:5d}  -> [{pi}] "{palette_order[pi]}"')
+            run_start = i + 1
+    model.triangle_materials = flat
+
+    section("anchor names")
+    if not empties:
+        print("  (none)")
+    for empty in empties:
+        print(f'  "{empty.name}"')
+    model.anchor_names = [empty.name for empty in empties]
+
+    for anim in animations:
+        section(f'animation "{anim.name}"  ({len(anim.frames)} keyframes)')
+        keyframes = []
+        prev_quats = [None] * len(empties)
+        for ki, frame in enumerate(anim.frames):
+            time = anim.times[ki]
+            set_frame(scene, frame)
+            depsgraph = bpy.context.evaluated_depsgraph_get()
+            print(f"  -- keyframe {ki}  time {time:.4f}s  (scene frame {frame:g})")
+
+            positions = []
+            degenerate_here = 0
+            for entry in entries:
+                tris = extract_triangles(entry.obj, depsgraph)
+                if len(tris) != entry.ref_tri_count:
+                    raise ExportError(
+                        f'"{entry.obj.name}" at frame {frame:g}: {len(tris)} '
+                        f"triangles vs {entry.ref_tri_count} at the reference "
+                        f"frame — topology must not change between keyframes")
+                for local, tri_index in enumerate(entry.keep):
+                    tri = tris[tri_index]
+                    if triangle_area2(tri) < AREA_EPS:
+                        degenerate_here += 1
+                    if not summary:
+                        print(f"     tri {entry.global_start + local:5d}  "
+                              f"{fvec3(tri[1])} {fvec3(tri[2])} {fvec3(tri[3])}")
+                    positions.extend(tuple(v) for v in tri[1:])
+            if summary:
+                print(f"     positions of {triangle_count} tris (suppressed by --summary)")
+            if degenerate_here:
+                warn(f'"{anim.name}" keyframe {ki}: {degenerate_here} kept '
+                     "triangle(s) are degenerate at this pose — their normal "
+                     "falls back to +Y")
+
+            anchors = []
+            for ai, empty in enumerate(empties):
+                pos, quat = anchor_transform(empty, depsgraph)
+                if prev_quats[ai] is not None:
+                    dot = sum(a * b for a, b in zip(quat, prev_quats[ai]))
+                    if dot < 0.0:
+                        quat = tuple(-c for c in quat)
+                prev_quats[ai] = quat
+                print(f'     anchor "{empty.name}"  pos {fvec3(pos)}  quat {fquat(quat)}')
+                anchors.append((tuple(pos), quat))
+
+            keyframes.append(frog_format.Keyframe(time, positions, anchors))
+        model.animations.append(frog_format.Animation(anim.name, keyframes))
+
     # -- write ---------------------------------------------------------------
-    with open(out_path, "wb") as fh:
-        w = Writer(fh)
-
-        section("header")
-        log(w.tell(), f'magic            u8[8]  "{MAGIC.decode()}"')
-        w.raw(MAGIC)
-        log(w.tell(), f"version          u16    {VERSION}")
-        w.u16(VERSION)
-        log(w.tell(), f"triangle_count   u32    {triangle_count}")
-        w.u32(triangle_count)
-        log(w.tell(), f"material_count   u16    {len(palette_order)}")
-        w.u16(len(palette_order))
-        log(w.tell(), f"anchor_count     u16    {len(empties)}")
-        w.u16(len(empties))
-        log(w.tell(), f"animation_count  u16    {len(animations)}")
-        w.u16(len(animations))
-
-        section("materials")
-        for name in palette_order:
-            index, base, spec, source = palette[name]
-            log(w.tell(), f'[{index}] "{name}"  base {fvec3(base)}  spec {fvec3(spec)}'
-                          f"  ({source})")
-            w.string(name)
-            w.vec3(base)
-            w.vec3(spec)
-
-        section("triangle materials")
-        flat = [pi for entry in entries for pi in entry.palette_indices]
-        run_start = 0
-        run_off = w.tell()
-        for i, pi in enumerate(flat):
-            w.u8(pi)
-            last = i + 1 == len(flat)
-            if last or flat[i + 1] != pi:
-                log(run_off, f"tri {run_start:5d}..{i:5d}  -> "
-                             f'[{pi}] "{palette_order[pi]}"')
-                run_start = i + 1
-                run_off = w.tell()
-
-        section("anchor names")
-        if not empties:
-            print("  (none)")
-        for empty in empties:
-            log(w.tell(), f'"{empty.name}"')
-            w.string(empty.name)
-
-        for anim in animations:
-            keyframe_bytes = 4 + triangle_count * 36 + len(empties) * 28
-            section(f'animation "{anim.name}"  ({len(anim.frames)} keyframes, '
-                    f"{keyframe_bytes} bytes each)")
-            log(w.tell(), f'name             "{anim.name}"')
-            w.string(anim.name)
-            log(w.tell(), f"keyframe_count   u16    {len(anim.frames)}")
-            w.u16(len(anim.frames))
-
-            prev_quats = [None] * len(empties)
-            for ki, frame in enumerate(anim.frames):
-                time = anim.times[ki]
-                set_frame(scene, frame)
-                depsgraph = bpy.context.evaluated_depsgraph_get()
-
-                print(f"  -- keyframe {ki}  time {time:.4f}s  (scene frame {frame:g})")
-                log(w.tell(), f"time             f32    {time:.4f}")
-                w.f32(time)
-
-                degenerate_here = 0
-                for entry in entries:
-                    tris = extract_triangles(entry.obj, depsgraph)
-                    if len(tris) != entry.ref_tri_count:
-                        raise ExportError(
-                            f'"{entry.obj.name}" at frame {frame:g}: {len(tris)} '
-                            f"triangles vs {entry.ref_tri_count} at the reference "
-                            f"frame — topology must not change between keyframes")
-                    for local, tri_index in enumerate(entry.keep):
-                        tri = tris[tri_index]
-                        if triangle_area2(tri) < AREA_EPS:
-                            degenerate_here += 1
-                        if not summary:
-                            log(w.tell(), f"tri {entry.global_start + local:5d}  "
-                                          f"{fvec3(tri[1])} {fvec3(tri[2])} {fvec3(tri[3])}")
-                        w.vec3(tri[1])
-                        w.vec3(tri[2])
-                        w.vec3(tri[3])
-                if summary:
-                    print(f"             positions of {triangle_count} tris "
-                          "(suppressed by --summary)")
-                if degenerate_here:
-                    warn(f'"{anim.name}" keyframe {ki}: {degenerate_here} kept '
-                         "triangle(s) are degenerate at this pose — the loader's "
-                         "normal derivation must guard against zero area here")
-
-                for ai, empty in enumerate(empties):
-                    pos, quat = anchor_transform(empty, depsgraph)
-                    if prev_quats[ai] is not None:
-                        dot = sum(a * b for a, b in zip(quat, prev_quats[ai]))
-                        if dot < 0.0:
-                            quat = tuple(-c for c in quat)
-                    prev_quats[ai] = quat
-                    log(w.tell(), f'anchor "{empty.name}"  pos {fvec3(pos)}  '
-                                  f"quat {fquat(quat)}")
-                    w.vec3(pos)
-                    w.quat(quat)
-
-        total = w.tell()
+    section("write")
+    try:
+        version, total = frog_format.write(out_path, model, log=log, summary=summary)
+    except frog_format.FormatError as err:
+        raise ExportError(str(err))
 
     section("summary")
-    print(f"wrote {out_path}: {total} bytes")
+    print(f"wrote {out_path}: v{version}, {total} bytes")
     print(f"  {triangle_count} tris / {triangle_count * 3} verts, "
           f"{len(palette_order)} materials, {len(empties)} anchors, "
           f"{len(animations)} animations, "
@@ -0,0 +1,499 @@
+"""
+FROGMODL layouts shared by export_frog.py (inside blender) and
+frog_upgrade.py (plain python); no bpy in here. The layouts themselves are
+described in src/game/DESIGN and at the top of src/engine/frog.c.
+
+    Model            everything a .frog holds, version independent
+    read(path)       -> Model, from any version
+    write(path, model, log=None, summary=False) -> (version, bytes written)
+    write_v2(...), write_v3(...)                  -> bytes written
+
+Version 2 stores every keyframe as the engine's vertex buffer contents
+(position, flat normal, material index per vertex), so the loader hands
+the blocks to the GPU upload as is. The normals are derived here with the
+loader's version 1 formula.
+
+Version 3 adds an index buffer shared by every keyframe. Vertices that are
+identical in all keyframes are welded, the triangles are reordered for the
+post-transform cache and the vertices for fetch order, the same passes as
+src/engine/mesh_optimize.c.
+"""
+
+import math
+import struct
+
+MAGIC = b"FROGMODL"
+VERSION_1 = 1
+VERSION_2 = 2
+VERSION_3 = 3
+
+HEADER_V2 = struct.Struct("<8sHHIHHHHII6Q")   # 80 bytes
+HEADER_V3 = struct.Struct("<8sHHIHHHHII6QIIQ")  # 96 bytes: v2, vertex and index count, indices offset
+VERTEX_V2 = struct.Struct("<3f3fI")           # normal_material_vertex_t, 28 bytes
+BLOCK_ALIGN = 16
+CACHE_SIZE = 16                               # MESH_OPTIMIZE_CACHE_SIZE
+
+
+class FormatError(Exception):
+    pass
+
+
+class Material:
+    def __init__(self, name, base, spec):
+        self.name = name
+        self.base = tuple(base)
+        self.spec = tuple(spec)
+
+
+class Keyframe:
+    def __init__(self, time, positions, anchors):
+        self.time = time
+        self.positions = positions    # 3 per triangle, CW winding
+        self.anchors = anchors        # [(pos xyz, quat xyzw)] per anchor
+
+
+class Animation:
+    def __init__(self, name, keyframes):
+        self.name = name
+        self.keyframes = keyframes
+
+
+class Model:
+    def __init__(self):
+        self.materials = []
+        self.triangle_materials = []  # palette index per triangle
+        self.anchor_names = []
+        self.animations = []
+
+    @property
+    def triangle_count(self):
+        return len(self.triangle_materials)
+
+    @property
+    def keyframe_count(self):
+        return sum(len(a.keyframes) for a in self.animations)
+
+
+def flat_normal(v0, v1, v2):
+    """normalize(cross(v2 - v0, v1 - v0)); outward for CW winding. A zero
+    area triangle gets +Y rather than NaNs."""
+    a = (v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2])
+    b = (v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2])
+    n = (a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0])
+    length = math.sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2])
+    if length == 0.0:
+        return (0.0, 1.0, 0.0)
+    return (n[0] / length, n[1] / length, n[2] / length)
+
+
+# ------------------------------------------------------------------ version 1
+
+class _Reader:
+    def __init__(self, data):
+        self.data = data
+        self.off = 0
+
+    def take(self, fmt):
+        size = struct.calcsize(fmt)
+        if self.off + size > len(self.data):
+            raise FormatError(f"truncated at byte {self.off}")
+        values = struct.unpack_from(fmt, self.data, self.off)
+        self.off += size
+        return values
+
+    def string(self):
+        (length,) = self.take("<H")
+        (raw,) = self.take(f"<{length}s")
+        return raw.decode("utf-8")
+
+
+def read(path):
+    """Any version; blocks of version 2 and 3 files come back as the
+    unshared triangles version 1 stores."""
+    with open(path, "rb") as fh:
+        data = fh.read()
+
+    if len(data) < 10 or data[:8] != MAGIC:
+        raise FormatError(f"{path}: not a frog file")
+    (version,) = struct.unpack_from("<H", data, 8)
+    if version == VERSION_1:
+        return _read_v1(path, data)
+    if version in (VERSION_2, VERSION_3):
+        return _read_blocks(path, data, version)
+    raise FormatError(f"{path}: unsupported version {version}")
+
+
+def _read_v1(path, data):
+    r = _Reader(data)
+    magic, version, triangle_count, material_count, anchor_count, animation_count = r.take("<8sHIHHH")
+
+    model = Model()
+    for _ in range(material_count):
+        name = r.string()
+        base = r.take("<3f")
+        spec = r.take("<3f")
+        model.materials.append(Material(name, base, spec))
+
+    model.triangle_materials = list(r.take(f"<{triangle_count}B"))
+    model.anchor_names = [r.string() for _ in range(anchor_count)]
+
+    for _ in range(animation_count):
+        name = r.string()
+        (keyframe_count,) = r.take("<H")
+        keyframes = []
+        for _ in range(keyframe_count):
+            (time,) = r.take("<f")
+            flat = r.take(f"<{triangle_count * 9}f")
+            positions = [flat[i:i + 3] for i in range(0, len(flat), 3)]
+            anchors = []
+            for _ in range(anchor_count):
+                values = r.take("<7f")
+                anchors.append((values[:3], values[3:]))
+            keyframes.append(Keyframe(time, positions, anchors))
+        model.animations.append(Animation(name, keyframes))
+
+    if r.off != len(r.data):
+        raise FormatError(f"{path}: {len(r.data) - r.off} trailing bytes")
+    return model
+
+
+# ------------------------------------------------------------ versions 2 and 3
+
+def _align(off):
+    return (off + BLOCK_ALIGN - 1) & ~(BLOCK_ALIGN - 1)
+
+
+def _string(s):
+    data = s.encode("utf-8")
+    if not 0 < len(data) <= 0xFFFF:
+        raise FormatError(f"bad string length: {s!r}")
+    return struct.pack("<H", len(data)) + data
+
+
+def _read_blocks(path, data, version):
+    header = HEADER_V3 if version == VERSION_3 else HEADER_V2
+    if len(data) < header.size:
+        raise FormatError(f"{path}: truncated header")
+    fields = header.unpack_from(data)
+    (_, _, _, tri_count, material_count, anchor_count, animation_count, _, keyframe_count, stride,
+     names_off, materials_off, animations_off, keyframes_off, anchors_off, vertices_off) = fields[:16]
+    if stride != VERTEX_V2.size:
+        raise FormatError(f"{path}: vertex stride {stride}")
+
+    if version == VERSION_3:
+        vertex_count, index_count, indices_off = fields[16:]
+        if index_count != tri_count * 3:
+            raise FormatError(f"{path}: {index_count} indices for {tri_count} triangles")
+        indices = struct.unpack_from(f"<{index_count}I", data, indices_off)
+    else:
+        vertex_count = tri_count * 3
+        indices = range(vertex_count)
+
+    r = _Reader(data)
+    r.off = names_off
+    model = Model()
+    material_names = [r.string() for _ in range(material_count)]
+    model.anchor_names = [r.string() for _ in range(anchor_count)]
+    animation_names = [r.string() for _ in range(animation_count)]
+
+    for i, name in enumerate(material_names):
+        colors = struct.unpack_from("<6f", data, materials_off + i * 24)
+        model.materials.append(Material(name, colors[:3], colors[3:]))
+
+    keyframe_size = _align(vertex_count * VERTEX_V2.size)
+    key = 0
+    for ai, name in enumerate(animation_names):
+        (count,) = struct.unpack_from("<I", data, animations_off + ai * 4)
+        keyframes = []
+        for _ in range(count):
+            (time,) = struct.unpack_from("<f", data, keyframes_off + key * 4)
+            vertices = [VERTEX_V2.unpack_from(data, vertices_off + key * keyframe_size + v * VERTEX_V2.size)
+                        for v in range(vertex_count)]
+            positions = [tuple(vertices[v][:3]) for v in indices]
+            anchors = []
+            for a in range(anchor_count):
+                values = struct.unpack_from("<7f", data, anchors_off + (key * anchor_count + a) * 28)
+                anchors.append((values[:3], values[3:]))
+            keyframes.append(Keyframe(time, positions, anchors))
+            if key == 0:
+                model.triangle_materials = [vertices[indices[t * 3]][6] for t in range(tri_count)]
+            key += 1
+        model.animations.append(Animation(name, keyframes))
+
+    if key != keyframe_count:
+        raise FormatError(f"{path}: {key} keyframes, header says {keyframe_count}")
+    return model
+
+
+def cache_stats(indices, vertex_count):
+    """(ACMR, ATVR) of a CACHE_SIZE fifo, as MeshOptimize_AnalyzeVertexCache."""
+    cache_time = [0] * vertex_count
+    time = CACHE_SIZE + 1
+    transformed = 0
+    for v in indices:
+        if time - cache_time[v] > CACHE_SIZE:
+            cache_time[v] = time
+            time += 1
+            transformed += 1
+    referenced = len(set(indices))
+    return transformed / max(len(indices) // 3, 1), transformed / max(referenced, 1)
+
+
+def _tipsify(indices, vertex_count):
+    """Triangles reordered for the post-transform cache (Sander et al.
+    2007); a port of MeshOptimize_VertexCache, so both give the same order."""
+    tri_count = len(indices) // 3
+    adjacency = [[] for _ in range(vertex_count)]
+    for t in range(tri_count):
+        for v in indices[t * 3:t * 3 + 3]:
+            adjacency[v].append(t)
+    live = [len(a) for a in adjacency]
+    cache_time = [0] * vertex_count
+    emitted = [False] * tri_count
+    dead_ends = []
+    out = []
+    time = CACHE_SIZE + 1
+    cursor = 0
+
+    fan = 0
+    while fan is not None:
+        candidates = []
+        for t in adjacency[fan]:
+            if emitted[t]:
+                continue
+            emitted[t] = True
+            for v in indices[t * 3:t * 3 + 3]:
+                out.append(v)
+                dead_ends.append(v)
+                candidates.append(v)
+                live[v] -= 1
+                if time - cache_time[v] > CACHE_SIZE:
+                    cache_time[v] = time
+                    time += 1
+
+        fan, best_priority = None, -1
+        for v in candidates:
+            if live[v] == 0:
+                continue
+            priority = time - cache_time[v] if time - cache_time[v] + 2 * live[v] <= CACHE_SIZE else 0
+            if priority > best_priority:
+                fan, best_priority = v, priority
+        while fan is None and dead_ends:
+            v = dead_ends.pop()
+            if live[v] > 0:
+                fan = v
+        while fan is None and cursor < vertex_count:
+            if live[cursor] > 0:
+                fan = cursor
+            else:
+                cursor += 1
+    return out
+
+
+def optimize(keyframe_vertices):
+    """keyframe_vertices: per keyframe, the packed unshared vertices of
+    every triangle. Returns (per keyframe the welded vertices in fetch
+    order, indices, stats before, stats after)."""
+    unshared = len(keyframe_vertices[0])
+    before = cache_stats(range(unshared), unshared)
+
+    # weld where a vertex matches in every keyframe
+    welded = {}
+    remap = []
+    for v in range(unshared):
+        key = b"".join(k[v] for k in keyframe_vertices)
+        remap.append(welded.setdefault(key, len(welded)))
+    originals = [0] * len(welded)
+    for v in reversed(range(unshared)):
+        originals[remap[v]] = v
+
+    indices = _tipsify(remap, len(welded))
+
+    # fetch order: vertices numbered by first use
+    order = {}
+    indices = [order.setdefault(v, len(order)) for v in indices]
+    fetch = sorted(order, key=order.get)
+    vertices = [[k[originals[v]] for v in fetch] for k in keyframe_vertices]
+    return vertices, indices, before, cache_stats(indices, len(fetch))
+
+
+def write_v2(path, model, log=None, summary=False):
+    """Writes model as version 2. log(offset, text), when given, is called
+    for every block and, unless summary, every triangle of every keyframe."""
+    log = log or (lambda off, text: None)
+    tri_count = model.triangle_count
+    vertex_count = tri_count * 3
+    anchor_count = len(model.anchor_names)
+
+    if not model.animations or model.keyframe_count == 0:
+        raise FormatError("a model needs at least one keyframe")
+    if len(model.materials) > 256:
+        raise FormatError("more than 256 materials")
+    for anim in model.animations:
+        if len(anim.keyframes) > 0xFFFF:
+            raise FormatError(f'animation "{anim.name}": keyframe count exceeds u16')
+        for key in anim.keyframes:
+            if len(key.positions) != vertex_count or len(key.anchors) != anchor_count:
+                raise FormatError(f'animation "{anim.name}": keyframe does not match the model topology')
+
+    names = b"".join(_string(n) for n in
+                     [m.name for m in model.materials] + model.anchor_names + [a.name for a in model.animations])
+    materials = b"".join(struct.pack("<6f", *m.base, *m.spec) for m in model.materials)
+    animations = b"".join(struct.pack("<I", len(a.keyframes)) for a in model.animations)
+    keyframes = [k for a in model.animations for k in a.keyframes]
+    times = b"".join(struct.pack("<f", k.time) for k in keyframes)
+    anchors = b"".join(struct.pack("<7f", *pos, *quat) for k in keyframes for pos, quat in k.anchors)
+
+    blocks = [("names", names), ("materials", materials), ("animations", animations),
+              ("keyframes", times), ("anchors", anchors)]
+    offsets = {}
+    off = HEADER_V2.size
+    for name, data in blocks:
+        off = _align(off)
+        offsets[name] = off
+        off += len(data)
+    keyframe_size = _align(vertex_count * VERTEX_V2.size)
+    offsets["vertices"] = _align(off)
+
+    header = HEADER_V2.pack(MAGIC, VERSION_2, 0, tri_count, len(model.materials), anchor_count,
+                            len(model.animations), 0, len(keyframes), VERTEX_V2.size,
+                            offsets["names"], offsets["materials"], offsets["animations"],
+                            offsets["keyframes"], offsets["anchors"], offsets["vertices"])
+
+    with open(path, "wb") as fh:
+        log(0, f"header           v{VERSION_2}  {tri_count} tris  {len(model.materials)} materials  "
+               f"{anchor_count} anchors  {len(model.animations)} animations  {len(keyframes)} keyframes")
+        fh.write(header)
+        for name, data in blocks:
+            fh.write(b"\0" * (offsets[name] - fh.tell()))
+            log(offsets[name], f"{name:<16} {len(data)} bytes")
+            fh.write(data)
+
+        fh.write(b"\0" * (offsets["vertices"] - fh.tell()))
+        log(offsets["vertices"], f"vertices         {len(keyframes)} x {keyframe_size} bytes")
+        for ki, key in enumerate(keyframes):
+            start = fh.tell()
+            out = bytearray()
+            for t in range(tri_count):
+                v0, v1, v2 = key.positions[t * 3:t * 3 + 3]
+                normal = flat_normal(v0, v1, v2)
+                material = model.triangle_materials[t]
+                if not summary:
+                    log(start + len(out), f"keyframe {ki} tri {t:5d}  normal ({normal[0]:+.3f} "
+                                          f"{normal[1]:+.3f} {normal[2]:+.3f})  material {material}")
+                for v in (v0, v1, v2):
+                    out += VERTEX_V2.pack(*v, *normal, material)
+            out += b"\0" * (keyframe_size - len(out))
+            fh.write(out)
+
+        return fh.tell()
+
+
+def _unshared_vertices(model, keyframes):
+    """Per keyframe, the packed vertices of every triangle, as version 2
+    stores them."""
+    unshared = []
+    for key in keyframes:
+        packed = []
+        for t in range(model.triangle_count):
+            v0, v1, v2 = key.positions[t * 3:t * 3 + 3]
+            normal = flat_normal(v0, v1, v2)
+            packed += [VERTEX_V2.pack(*v, *normal, model.triangle_materials[t]) for v in (v0, v1, v2)]
+        unshared.append(packed)
+    return unshared
+
+
+def write(path, model, log=None, summary=False):
+    """Writes model as version 3 when welding saves more vertex bytes than
+    the index buffer costs, else as version 2. Flat shaded vertices only
+    weld between coplanar neighbors of one material, which many models
+    barely have. Returns (version, bytes written)."""
+    keyframes = [k for a in model.animations for k in a.keyframes]
+    vertex_count = model.triangle_count * 3
+    if keyframes and all(len(k.positions) == vertex_count for k in keyframes):
+        welded = len(optimize(_unshared_vertices(model, keyframes))[0][0])
+        if (vertex_count - welded) * VERTEX_V2.size * len(keyframes) > vertex_count * 4:
+            return VERSION_3, write_v3(path, model, log, summary)
+    return VERSION_2, write_v2(path, model, log, summary)
+
+
+def write_v3(path, model, log=None, summary=False):
+    """Writes model as version 3. log(offset, text), when given, is called
+    for every block and, unless summary, every triangle of every keyframe."""
+    log = log or (lambda off, text: None)
+    tri_count = model.triangle_count
+    vertex_count = tri_count * 3
+    anchor_count = len(model.anchor_names)
+
+    if not model.animations or model.keyframe_count == 0:
+        raise FormatError("a model needs at least one keyframe")
+    if len(model.materials) > 256:
+        raise FormatError("more than 256 materials")
+    for anim in model.animations:
+        if len(anim.keyframes) > 0xFFFF:
+            raise FormatError(f'animation "{anim.name}": keyframe count exceeds u16')
+        for key in anim.keyframes:
+            if len(key.positions) != vertex_count or len(key.anchors) != anchor_count:
+                raise FormatError(f'animation "{anim.name}": keyframe does not match the model topology')
+
+    names = b"".join(_string(n) for n in
+                     [m.name for m in model.materials] + model.anchor_names + [a.name for a in model.animations])
+    materials = b"".join(struct.pack("<6f", *m.base, *m.spec) for m in model.materials)
+    animations = b"".join(struct.pack("<I", len(a.keyframes)) for a in model.animations)
+    keyframes = [k for a in model.animations for k in a.keyframes]
+    times = b"".join(struct.pack("<f", k.time) for k in keyframes)
+    anchors = b"".join(struct.pack("<7f", *pos, *quat) for k in keyframes for pos, quat in k.anchors)
+
+    triangle_logs = []
+    if not summary:
+        for ki, key in enumerate(keyframes):
+            for t in range(tri_count):
+                normal = flat_normal(*key.positions[t * 3:t * 3 + 3])
+                triangle_logs.append((ki, f"keyframe {ki} tri {t:5d}  normal ({normal[0]:+.3f} "
+                                          f"{normal[1]:+.3f} {normal[2]:+.3f})  "
+                                          f"material {model.triangle_materials[t]}"))
+    welded, indices, before, after = optimize(_unshared_vertices(model, keyframes))
+    welded_count = len(welded[0])
+
+    blocks = [("names", names), ("materials", materials), ("animations", animations),
+              ("keyframes", times), ("anchors", anchors)]
+    offsets = {}
+    off = HEADER_V3.size
+    for name, data in blocks:
+        off = _align(off)
+        offsets[name] = off
+        off += len(data)
+    keyframe_size = _align(welded_count * VERTEX_V2.size)
+    offsets["vertices"] = _align(off)
+    offsets["indices"] = offsets["vertices"] + len(keyframes) * keyframe_size
+
+    header = HEADER_V3.pack(MAGIC, VERSION_3, 0, tri_count, len(model.materials), anchor_count,
+                            len(model.animations), 0, len(keyframes), VERTEX_V2.size,
+                            offsets["names"], offsets["materials"], offsets["animations"],
+                            offsets["keyframes"], offsets["anchors"], offsets["vertices"],
+                            welded_count, len(indices), offsets["indices"])
+
+    with open(path, "wb") as fh:
+        log(0, f"header           v{VERSION_3}  {tri_count} tris  {len(model.materials)} materials  "
+               f"{anchor_count} anchors  {len(model.animations)} animations  {len(keyframes)} keyframes")
+        fh.write(header)
+        for name, data in blocks:
+            fh.write(b"\0" * (offsets[name] - fh.tell()))
+            log(offsets[name], f"{name:<16} {len(data)} bytes")
+            fh.write(data)
+
+        fh.write(b"\0" * (offsets["vertices"] - fh.tell()))
+        log(offsets["vertices"], f"vertices         {len(keyframes)} x {keyframe_size} bytes, "
+                                 f"{welded_count} of {vertex_count} vertices after welding")
+        # triangles are welded and reordered, so each logs its keyframe's block
+        for ki, text in triangle_logs:
+            log(offsets["vertices"] + ki * keyframe_size, text)
+        for vertices in welded:
+            out = b"".join(vertices)
+            fh.write(out + b"\0" * (keyframe_size - len(out)))
+
+        log(offsets["indices"], f"indices          {len(indices)} x 4 bytes, "
+                                f"ACMR {before[0]:.3f} -> {after[0]:.3f}  ATVR {before[1]:.3f} -> {after[1]:.3f}")
+        fh.write(struct.pack(f"<{len(indices)}I", *indices))
+
+        return fh.tell()
@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+"""
+Rewrites a .frog of any version as version 2 or 3, whichever is smaller
+(see frog_format.py), no blender needed:
+
+    tools/frog_upgrade.py <in.frog> [<out.frog>]
+
+Without <out.frog> the file is replaced in place. Normals are derived the
+way the engine's version 1 loader derives them, so both versions render
+the same. Exits 1 on any error.
+"""
+
+import sys
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+import frog_format  # noqa: E402
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        print(__doc__.strip(), file=sys.stderr)
+        return 1
+
+    src = sys.argv[1]
+    dst = sys.argv[2] if len(sys.argv) == 3 else src
+    try:
+        model = frog_format.read(src)
+        version, size = frog_format.write(dst, model, summary=True)
+    except (OSError, frog_format.FormatError) as err:
+        print(f"{src}: {err}", file=sys.stderr)
+        return 1
+
+    print(f"{src} -> {dst}: v{version}, {model.triangle_count} tris, {model.keyframe_count} keyframes, {size} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core.h"
+#include "file.h"
+#include "log.h"
+#include "lz4.h"
+#include "memory_arena.h"
+#include "vfs.h"
+
+/* packs built resources into one archive for Vfs_Mount:
+     pack_assets <output> <root> <file>...
+   each file is stored under its path relative to root. entries are lz4
+   compressed where that saves enough to be worth decoding; already
+   compressed formats are stored page aligned. driven by the assets.pak
+   target in the top level meson.build */
+
+/* compressed must be at most this fraction of the raw size */
+#define MIN_COMPRESSION_RATIO   0.875
+
+typedef struct
+{
+    const char          *path;
+    const u8            *data;
+    vfs_archive_entry_t entry;
+} pack_entry_t;
+
+static const char *relative_path(arena_t *arena, const char *root, const char *path);
+static bool load_entry(arena_t *arena, const char *root, const char *path, pack_entry_t *entry_out);
+static int compare_entries(const void *a, const void *b);
+static bool write_archive(const char *output, pack_entry_t *entries, u32 count);
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: pack_assets <output> <root> <file>...\n");
+        return 2;
+    }
+
+    Log_Init();
+
+    arena_t *arena = MemoryArena_CreateP("pack", (arena_params_t){
+        .reserve_size = GB(8),
+        .commit_size = MB(16),
+    });
+
+    u32 count = (u32)(argc - 3);
+    pack_entry_t *entries = arena_push_array(arena, pack_entry_t, count);
+    for (u32 i = 0; i < count; i++)
+    {
+        if (!load_entry(arena, argv[2], argv[3 + i], &entries[i]))
+            return 1;
+    }
+
+    qsort(entries, count, sizeof(pack_entry_t), compare_entries);
+    for (u32 i = 1; i < count; i++)
+    {
+        if (entries[i - 1].entry.hash == entries[i].entry.hash)
+        {
+            Log(ERROR, "path hash collision: %s and %s", entries[i - 1].path, entries[i].path);
+            return 1;
+        }
+    }
+
+    if (!write_archive(argv[1], entries, count))
+        return 1;
+
+    MemoryArena_Destroy(arena);
+    return 0;
+}
+
+/* meson hands over paths relative to the build root or absolute ones */
+static const char *relative_path(arena_t *arena, const char *root, const char *path)
+{
+    u64 root_length = MemoryStrlen(root);
+    if (MemoryMatch(path, root, root_length) && (path[root_length] == '/' || path[root_length] == '\\'))
+        path += root_length + 1;
+
+    u64 length = MemoryStrlen(path);
+    char *result = arena_push_array_no_zero(arena, char, length + 1);
+    for (u64 i = 0; i <= length; i++)
+        result[i] = path[i] == '\\' ? '/' : path[i];
+
+    return result;
+}
+
+static bool load_entry(arena_t *arena, const char *root, const char *path, pack_entry_t *entry_out)
+{
+    u64 size = 0;
+    const u8 *data = File_Read(arena, path, &size);
+    if (!data)
+        return false;
+
+    entry_out->path = relative_path(arena, root, path);
+    entry_out->data = data;
+    entry_out->entry = (vfs_archive_entry_t){
+        .hash = Vfs_HashPath(entry_out->path),
+        .size = size,
+        .raw_size = size,
+        .format = Vfs_FormatFromPath(entry_out->path),
+        .compression = VFS_COMPRESSION_NONE,
+    };
+
+    if (entry_out->entry.format == VFS_FORMAT_PNG)
+        return true;
+
+    u64 capacity = Lz4_CompressBound(size);
+    u8 *compressed = arena_push_array_no_zero(arena, u8, capacity);
+    u64 compressed_size = Lz4_Compress(data, size, compressed, capacity);
+    if (compressed_size > 0 && (f64)compressed_size <= (f64)size * MIN_COMPRESSION_RATIO)
+    {
+        entry_out->data = compressed;
+        entry_out->entry.size = compressed_size;
+        entry_out->entry.compression = VFS_COMPRESSION_LZ4;
+    }
+
+    return true;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    u64 hash_a = ((const pack_entry_t *)a)->entry.hash;
+    u64 hash_b = ((const pack_entry_t *)b)->entry.hash;
+    return (hash_a > hash_b) - (hash_a < hash_b);
+}
+
+static bool write_archive(const char *output, pack_entry_t *entries, u32 count)
+{
+    vfs_archive_header_t header = {
+        .magic = VFS_ARCHIVE_MAGIC,
+        .version = VFS_ARCHIVE_VERSION,
+        .entry_count = count,
+    };
+
+    u64 offset = sizeof(header) + (u64)count * sizeof(vfs_archive_entry_t);
+    u64 raw_total = 0;
+    for (u32 i = 0; i < count; i++)
+    {
+        vfs_archive_entry_t *entry = &entries[i].entry;
+        u64 align = entry->compression == VFS_COMPRESSION_NONE ? VFS_PAGE_ALIGN : VFS_DATA_ALIGN;
+        entry->offset = AlignPow2(offset, align);
+        offset = entry->offset + entry->size;
+        raw_total += entry->raw_size;
+    }
+
+    FILE *file = fopen(output, "wb");
+    if (!file)
+    {
+        Log(ERROR, "failed to open %s for writing", output);
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (u32 i = 0; ok && i < count; i++)
+        ok = fwrite(&entries[i].entry, sizeof(vfs_archive_entry_t), 1, file) == 1;
+
+    static const u8 padding[VFS_PAGE_ALIGN] = {};
+    u64 position = sizeof(header) + (u64)count * sizeof(vfs_archive_entry_t);
+    for (u32 i = 0; ok && i < count; i++)
+    {
+        const vfs_archive_entry_t *entry = &entries[i].entry;
+        ok = fwrite(padding, 1, entry->offset - position, file) == entry->offset - position;
+        if (ok && entry->size > 0)
+            ok = fwrite(entries[i].data, entry->size, 1, file) == 1;
+        position = entry->offset + entry->size;
+    }
+
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        Log(ERROR, "failed to write %s", output);
+        remove(output);
+        return false;
+    }
+
+    Log(INFO, "packed %u files into %s: %.2f MB from %.2f MB", count, output, (f64)position / (f64)MB(1),
+        (f64)raw_total / (f64)MB(1));
+    return true;
+}